@@ -0,0 +1,98 @@
+#include "base/histogram.h"
+
+#include <cinttypes>
+
+
+Histogram::Histogram() {
+    Clear();
+}
+
+void Histogram::Clear() {
+    for (int i = 0; i < kBucketCount; i++) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+}
+
+// Values below kSubBuckets get a bucket each. Above that, the position of
+// the highest bit picks the power of two and the next kSubBucketBits bits
+// pick the linear bucket inside it.
+int Histogram::BucketOf(uint64_t value) {
+    if (value < (uint64_t)kSubBuckets) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - kSubBucketBits;
+    int sub = (int)(value >> shift) & (kSubBuckets - 1);
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::BucketLower(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int shift = bucket / kSubBuckets - 1;
+    uint64_t sub = bucket % kSubBuckets;
+    return (kSubBuckets + sub) << shift;
+}
+
+uint64_t Histogram::BucketUpper(int bucket) {
+    if (bucket + 1 >= kBucketCount) {
+        return UINT64_MAX;
+    }
+    return BucketLower(bucket + 1) - 1;
+}
+
+void Histogram::Record(uint64_t value) {
+    buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::Count() const {
+    uint64_t count = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        count += buckets_[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t Histogram::Percentile(double percent) const {
+    uint64_t count = Count();
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(count * percent / 100.0);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            uint64_t upper = BucketUpper(i);
+            return (upper < Max()) ? upper : Max();
+        }
+    }
+    return Max();
+}
+
+void Histogram::Write(FILE *out, const char *name, double scale) const {
+    fprintf(out, "%s: count=%" PRIu64 " p50=%.0f p90=%.0f p99=%.0f"
+            " p99.9=%.0f max=%.0f\n",
+            name, Count(), Percentile(50) * scale, Percentile(90) * scale,
+            Percentile(99) * scale, Percentile(99.9) * scale, Max() * scale);
+
+    for (int i = 0; i < kBucketCount; i++) {
+        uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+        if (n != 0) {
+            fprintf(out, "  [%.0f, %.0f] %" PRIu64 "\n",
+                    BucketLower(i) * scale, BucketUpper(i) * scale, n);
+        }
+    }
+}
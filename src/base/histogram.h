@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#include "base/port.h"
+
+
+// Log-linear histogram of unsigned values: every power of two is split into
+// kSubBuckets linear buckets, which keeps the relative error under 1/8.
+// Record() is a couple of relaxed atomic operations and never blocks, so it
+// can be called from any thread while another one reads or writes it out.
+class Histogram {
+public:
+    Histogram();
+
+    void Record(uint64_t value);
+    void Clear();
+
+    uint64_t Count() const;
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding the |percent|-th percentile.
+    uint64_t Percentile(double percent) const;
+
+    // Writes a summary line followed by the non-empty buckets, with the
+    // values multiplied by |scale|.
+    void Write(FILE *out, const char *name, double scale = 1.0) const;
+
+private:
+    static const int kSubBucketBits = 3;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static int BucketOf(uint64_t value);
+    static uint64_t BucketLower(int bucket);
+    static uint64_t BucketUpper(int bucket);
+
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> max_;
+
+    DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
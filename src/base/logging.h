@@ -1,25 +1,233 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <atomic>
-#include <string>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 #define SPDLOG_CLOCK_COARSE
 #define SPDLOG_NO_NAME
 #define SPDLOG_LEVEL_NAMES  { "TRC", "DBG", "INF", "WRN", "ERR", "CRT", "OFF" }
 
+// Lowest level compiled in: 0 trace, 1 debug, 2 info, 3 warning, 4 error,
+// 5 critical, 6 off. Statements below it expand to nothing.
+#ifndef BLOG_ACTIVE_LEVEL
 #ifndef NDEBUG
-#define SPDLOG_DEBUG_ON
-#define SPDLOG_TRACE_ON
+#define BLOG_ACTIVE_LEVEL 0
+#else
+#define BLOG_ACTIVE_LEVEL 2
 #endif // NDEBUG
+#endif // BLOG_ACTIVE_LEVEL
 
 
 #include <spdlog/spdlog.h>
 
 #include "base/port.h"
 
+// Formats are only known at run time where the drain thread formats
+// them; fmt 8 and later check them at compile time unless told so.
+#if defined(FMT_VERSION) && FMT_VERSION >= 80000
+#define BLOG_RUNTIME_FORMAT(format) fmt::runtime(format)
+#else
+#define BLOG_RUNTIME_FORMAT(format) (format)
+#endif
+
 namespace unikey {
 
+namespace internal {
+
+// A log statement waiting in a ring for the drain thread: the format
+// literal, and the arguments copied in by LogArg.
+struct alignas(64) LogRecord {
+    void (*write)(spdlog::logger* logger, const LogRecord& record);
+    const char* format;
+    spdlog::level::level_enum level;
+    char payload[256 - 2 * sizeof(void*) - sizeof(int)];
+};
+
+// How an argument is kept in a record: anything trivially copyable by
+// value, put first, and strings copied in after them, cut to the room
+// left. kSize is the room an argument needs at least.
+template <typename T>
+struct LogArg {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "log arguments are copied to the drain thread as bytes");
+    typedef T Stored;
+    static const size_t kSize = sizeof(T);
+    static const int kTexts = 0;
+
+    static void put(char*& p, const T& value) {
+        memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+    static void put_text(char*&, const char*, int&, const T&) {}
+    static void get(const char*& p, Stored& value) {
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+    }
+    static void get_text(const char*&, Stored&) {}
+};
+
+struct LogText {
+    typedef const char* Stored;
+    static const size_t kSize = 1;
+    static const int kTexts = 1;
+
+    static void put(char*&, const char*) {}
+    // Takes at most an even share of the room left with the texts_after
+    // strings after it, the NUL included.
+    static void put_text(char*& p, const char* end, int& texts_after,
+                         const char* text, size_t length) {
+        size_t room = (end - p) / texts_after - 1;
+        texts_after--;
+        if (length > room)
+            length = room;
+        memcpy(p, text, length);
+        p[length] = '\0';
+        p += length + 1;
+    }
+    static void put_text(char*& p, const char* end, int& texts_after, const char* text) {
+        if (text == nullptr)
+            text = "(null)";
+        put_text(p, end, texts_after, text, strlen(text));
+    }
+    static void get(const char*&, Stored&) {}
+    static void get_text(const char*& p, Stored& value) {
+        value = p;
+        p += strlen(p) + 1;
+    }
+};
+
+template <> struct LogArg<const char*> : LogText {};
+template <> struct LogArg<char*> : LogText {};
+
+template <> struct LogArg<std::string> : LogText {
+    static void put(char*&, const std::string&) {}
+    static void put_text(char*& p, const char* end, int& texts_after, const std::string& text) {
+        LogText::put_text(p, end, texts_after, text.data(), text.size());
+    }
+};
+
+template <size_t... N> struct Sum;
+template <> struct Sum<> { static const size_t value = 0; };
+template <size_t N, size_t... Rest> struct Sum<N, Rest...> {
+    static const size_t value = N + Sum<Rest...>::value;
+};
+
+// The arguments of a statement, of the types in Types once decayed.
+template <typename... Types>
+struct LogArgs {
+    static const size_t kSize = Sum<LogArg<Types>::kSize...>::value;
+    static const int kTexts = Sum<LogArg<Types>::kTexts...>::value;
+
+    // Copies them to the record of the statement.
+    template <typename... Args>
+    static void put(LogRecord* record, const Args&... args) {
+        char* p = record->payload;
+        const char* end = record->payload + sizeof(record->payload);
+        int texts_after = kTexts;
+        int fixed[] = { (LogArg<Types>::put(p, args), 0)... };
+        int texts[] = { (LogArg<Types>::put_text(p, end, texts_after, args), 0)... };
+        (void)fixed;
+        (void)texts;
+    }
+};
+
+template <> struct LogArgs<> {
+    static const size_t kSize = 0;
+
+    static void put(LogRecord*) {}
+};
+
+template <size_t... I> struct Indices {};
+template <size_t N, size_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> Type; };
+
+// Formats a record with the arguments of the statement that filled it.
+template <typename... Args>
+struct LogWriter {
+    static void write(spdlog::logger* logger, const LogRecord& record) {
+        write(logger, record, typename MakeIndices<sizeof...(Args)>::Type());
+    }
+
+    template <size_t... I>
+    static void write(spdlog::logger* logger, const LogRecord& record, Indices<I...>) {
+        std::tuple<typename LogArg<Args>::Stored...> values;
+        const char* p = record.payload;
+        int fixed[] = { (LogArg<Args>::get(p, std::get<I>(values)), 0)... };
+        int texts[] = { (LogArg<Args>::get_text(p, std::get<I>(values)), 0)... };
+        (void)fixed;
+        (void)texts;
+        logger->log(record.level, BLOG_RUNTIME_FORMAT(record.format), std::get<I>(values)...);
+    }
+};
+
+// Without arguments the format is the message, as spdlog takes it.
+template <>
+struct LogWriter<> {
+    static void write(spdlog::logger* logger, const LogRecord& record) {
+        logger->log(record.level, record.format);
+    }
+};
+
+// Records of one thread, which is the only one to add them, on their way
+// to the drain thread, the only one to take them.
+struct LogRing {
+    static const size_t kRecords = 512;   // a power of two
+
+    // Each on a cache line of its own, as are the records.
+    alignas(64) std::atomic<size_t> head;   // next record to fill
+    size_t tail_seen;           // tail as the filling thread last read it
+    alignas(64) std::atomic<size_t> tail;   // next record to write out
+    std::atomic<size_t> dropped;
+    std::atomic<bool> owned;    // by a thread that is still running
+    LogRecord records[kRecords];
+
+    LogRing() : head(0), tail_seen(0), tail(0), dropped(0), owned(true) {}
+
+    // new aligns to 16 bytes only before C++17.
+    static void* operator new(size_t size) {
+        void* ring;
+        if (posix_memalign(&ring, 64, size) != 0)
+            throw std::bad_alloc();
+        return ring;
+    }
+    static void operator delete(void* ring) { free(ring); }
+
+    // Null when the ring is full: the statement is counted and dropped
+    // rather than wait for the drain thread.
+    LogRecord* begin(size_t* at) {
+        *at = head.load(std::memory_order_relaxed);
+        if (*at - tail_seen == kRecords) {
+            tail_seen = tail.load(std::memory_order_acquire);
+            if (*at - tail_seen == kRecords) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &records[*at & (kRecords - 1)];
+    }
+
+    // True once the ring passes half full, to drain it early.
+    bool commit(size_t at) {
+        head.store(at + 1, std::memory_order_release);
+        return at + 1 - tail_seen == kRecords / 2;
+    }
+};
+
+} // namespace internal
+
 class Logger {
 private:
     static Logger& default_instance() {
@@ -27,29 +235,155 @@ private:
         return logger;
     }
 
-    Logger() {
+    // Loggers are asynchronous: a log statement copies its format literal
+    // and arguments to a ring of its thread and returns. A drain thread
+    // formats and writes them every kDrainIntervalMs, or as soon as a ring
+    // is half full, so the time in the log is when it was written out.
+    // When a ring is full statements are dropped instead of stalling the
+    // caller, which is usually in the middle of a key event.
+    Logger() : m_level(BLOG_ACTIVE_LEVEL), m_stopping(false), m_drain_wanted(false),
+               m_drains_started(0), m_drains_done(0) {
         set_logger(spdlog::stderr_logger_mt("stderr"));
+        m_drain = std::thread(&Logger::drain_loop, this);
     }
 
-    void init() {
-        m_logger->set_level(spdlog::level::trace);
-        m_logger->set_pattern("[%Y-%m-%d %H:%M:%S][%l]: %v");
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        m_drain.join();
     }
 
-    std::shared_ptr<spdlog::logger> get_logger() {
+    void set_logger(std::shared_ptr<spdlog::logger> new_logger) {
         std::lock_guard<std::mutex> lock(m_mutex);
-        return m_logger;
+        new_logger->set_level(spdlog::level::trace);
+        new_logger->set_pattern("[%Y-%m-%d %H:%M:%S][%l]: %v");
+        m_logger = new_logger;
     }
 
-    void set_logger(std::shared_ptr<spdlog::logger> new_logger) {
+    // The ring of the calling thread, one given back by a thread that
+    // ended or a new one.
+    static internal::LogRing*& thread_ring() {
+        static thread_local internal::LogRing* ring = nullptr;
+        return ring;
+    }
+
+    struct RingOwner {
+        ~RingOwner() {
+            if (thread_ring())
+                thread_ring()->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    internal::LogRing* attach_ring() {
+        static thread_local RingOwner owner;
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_logger = new_logger;
-        init();
+        for (auto& ring : m_rings) {
+            if (!ring->owned.load(std::memory_order_acquire)) {
+                ring->owned.store(true, std::memory_order_relaxed);
+                return thread_ring() = ring.get();
+            }
+        }
+        m_rings.emplace_back(new internal::LogRing());
+        return thread_ring() = m_rings.back().get();
+    }
+
+    void wake_drain() {
+        m_drain_wanted.store(true);
+        m_wake.notify_one();
+    }
+
+    void drain_loop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping) {
+            m_wake.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs),
+                            [this] { return m_stopping || m_drain_wanted.load(); });
+            m_drain_wanted.store(false);
+            drain(lock);
+        }
+        drain(lock);
+    }
+
+    // Called with m_mutex locked, which is let go while writing.
+    void drain(std::unique_lock<std::mutex>& lock) {
+        uint64_t round = ++m_drains_started;
+        std::shared_ptr<spdlog::logger> logger = m_logger;
+        m_draining.clear();
+        for (auto& ring : m_rings)
+            m_draining.push_back(ring.get());
+        lock.unlock();
+
+        bool wrote = false;
+        for (internal::LogRing* ring : m_draining) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; tail++) {
+                const internal::LogRecord& record =
+                    ring->records[tail & (internal::LogRing::kRecords - 1)];
+                record.write(logger.get(), record);
+                ring->tail.store(tail + 1, std::memory_order_release);
+                wrote = true;
+            }
+            size_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped) {
+                logger->warn("{} log messages dropped", dropped);
+                wrote = true;
+            }
+        }
+        if (wrote)
+            logger->flush();
+        lock.lock();
+        m_drains_done = round;
+        m_drained.notify_all();
     }
 
 public:
-    static std::shared_ptr<spdlog::logger> get_default_logger() {
-        return default_instance().get_logger();
+    // The key path goes through here for every statement compiled in: no
+    // lock, no formatting and no allocation, but on the first statement
+    // of a thread. The format must be a string literal, it is written out
+    // later.
+    template <size_t N, typename... Args>
+    static void log(spdlog::level::level_enum level, const char (&format)[N],
+                    const Args&... args) {
+        typedef internal::LogArgs<typename std::decay<Args>::type...> Stored;
+        static_assert(Stored::kSize <= sizeof(internal::LogRecord::payload),
+                      "too many log arguments for a record");
+
+        Logger& logger = default_instance();
+        if (level < logger.m_level.load(std::memory_order_relaxed))
+            return;
+        internal::LogRing* ring = thread_ring();
+        if (ring == nullptr)
+            ring = logger.attach_ring();
+        size_t at;
+        internal::LogRecord* record = ring->begin(&at);
+        if (record == nullptr)
+            return;
+
+        record->write = &internal::LogWriter<typename std::decay<Args>::type...>::write;
+        record->format = format;
+        record->level = level;
+        Stored::put(record, args...);
+        if (ring->commit(at))
+            logger.wake_drain();
+    }
+
+    // Statements below level are dropped at run time, on top of those
+    // BLOG_ACTIVE_LEVEL leaves out when compiling.
+    static void set_level(spdlog::level::level_enum level) {
+        default_instance().m_level.store(level, std::memory_order_relaxed);
+    }
+
+    // Waits until what was logged before is written out.
+    static void flush() {
+        Logger& logger = default_instance();
+        std::unique_lock<std::mutex> lock(logger.m_mutex);
+        uint64_t round = logger.m_drains_started + 1;
+        logger.wake_drain();
+        while (logger.m_drains_done < round)
+            logger.m_drained.wait(lock);
     }
 
     static void set_default_logger(const std::string& name, const std::string& file) {
@@ -58,8 +392,20 @@ public:
     }
 
 private:
+    enum { kDrainIntervalMs = 100 };
+
+    std::atomic<int> m_level;
     std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_drained;
+    bool m_stopping;
+    std::atomic<bool> m_drain_wanted;
+    uint64_t m_drains_started;
+    uint64_t m_drains_done;
     std::shared_ptr<spdlog::logger> m_logger;
+    std::vector<std::unique_ptr<internal::LogRing>> m_rings;
+    std::vector<internal::LogRing*> m_draining;   // used by the drain thread only
+    std::thread m_drain;
 
 private:
     DISALLOW_COPY_AND_ASSIGN(Logger);
@@ -67,17 +413,44 @@ private:
 
 } // namespace unikey
 
-#ifndef NDEBUG
-#define BLOG_TRACE(...) SPDLOG_TRACE(unikey::Logger::get_default_logger(), __VA_ARGS__)
-#define BLOG_DEBUG(...) unikey::Logger::get_default_logger()->debug(__VA_ARGS__)
+#define BLOG_STRINGIFY_(x) #x
+#define BLOG_STRINGIFY(x) BLOG_STRINGIFY_(x)
+
+#if BLOG_ACTIVE_LEVEL <= 0
+#define BLOG_TRACE(...) unikey::Logger::log(spdlog::level::trace, \
+    "[" __FILE__ " line #" BLOG_STRINGIFY(__LINE__) "] " __VA_ARGS__)
 #else
 #define BLOG_TRACE(...)
+#endif
+
+#if BLOG_ACTIVE_LEVEL <= 1
+#define BLOG_DEBUG(...) unikey::Logger::log(spdlog::level::debug, __VA_ARGS__)
+#else
 #define BLOG_DEBUG(...)
-#endif // NDEBUG
+#endif
+
+#if BLOG_ACTIVE_LEVEL <= 2
+#define BLOG_INFO(...) unikey::Logger::log(spdlog::level::info, __VA_ARGS__)
+#else
+#define BLOG_INFO(...)
+#endif
 
-#define BLOG_INFO(...) unikey::Logger::get_default_logger()->info(__VA_ARGS__)
-#define BLOG_WARNING(...) unikey::Logger::get_default_logger()->warn(__VA_ARGS__)
-#define BLOG_ERROR(...) unikey::Logger::get_default_logger()->error(__VA_ARGS__)
-#define BLOG_CRITICAL(...) unikey::Logger::get_default_logger()->critical(__VA_ARGS__)
+#if BLOG_ACTIVE_LEVEL <= 3
+#define BLOG_WARNING(...) unikey::Logger::log(spdlog::level::warn, __VA_ARGS__)
+#else
+#define BLOG_WARNING(...)
+#endif
+
+#if BLOG_ACTIVE_LEVEL <= 4
+#define BLOG_ERROR(...) unikey::Logger::log(spdlog::level::err, __VA_ARGS__)
+#else
+#define BLOG_ERROR(...)
+#endif
+
+#if BLOG_ACTIVE_LEVEL <= 5
+#define BLOG_CRITICAL(...) unikey::Logger::log(spdlog::level::critical, __VA_ARGS__)
+#else
+#define BLOG_CRITICAL(...)
+#endif
 
-#define BLOG_SET_OUTPUT_FILE(file) unikey::Logger::set_default_logger(file, file)
\ No newline at end of file
+#define BLOG_SET_OUTPUT_FILE(file) unikey::Logger::set_default_logger(file, file)
@@ -0,0 +1,490 @@
+// Builds the tables of UkAutomaton (see ukautomaton.h), and checks and
+// times the engine running on one.
+//
+// build makes the table for an input method, output charset and options,
+// the ones UnikeyWrapper uses by default.
+//
+// check types text into two engines, one with the table and one without,
+// the way UnikeyWrapper does: the caps state, settling the prefix after
+// each key (on half of the lines), word breaks, and now and then a
+// backspace, a restore that teaches the word, a 'w' put at the beginning
+// of a word, caps lock or a stray key. Every result of the two must be the
+// same. The keys of the text are written with the tones and marks at
+// random places, with a new seed each round.
+//
+// bench types the text the same way, without the odd events, and reports
+// the time per key with the table and without.
+//
+//   ibus-unikey-automaton build [--im telex|vni|stelex|stelex2]
+//       [--charset N] [--modern] [--no-free-marking] [--no-spell-check]
+//       [--no-auto-restore] [--break-keys KEYS] TABLE
+//   ibus-unikey-automaton check TABLE [--dict FILE] [--filter FILE]
+//       [--text FILE] [--rounds N] [--seed N]
+//   ibus-unikey-automaton bench TABLE [--dict FILE] [--filter FILE]
+//       [--text FILE] [--rounds N]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include "third_party/libunikey/ukautomaton.h"
+#include "third_party/libunikey/ukengine.h"
+#include "third_party/libunikey/ukkeystroke.h"
+#include "third_party/libunikey/unikey.h"
+#include "third_party/libunikey/vnconv.h"
+
+
+namespace {
+
+struct Name {
+    const char *name;
+    int value;
+};
+
+const Name kMethods[] = {
+    {"telex",   UkTelex},
+    {"vni",     UkVni},
+    {"stelex",  UkSimpleTelex},
+    {"stelex2", UkSimpleTelex2},
+};
+
+const char kSample[] =
+    "Tiếng Việt là ngôn ngữ của người Việt và là ngôn ngữ chính thức tại "
+    "Việt Nam. Chữ Quốc ngữ dùng các chữ cái Latinh, thêm dấu thanh và dấu "
+    "phụ cho các nguyên âm: huyền, sắc, hỏi, ngã, nặng.\n"
+    "Hà Nội, Huế, Đà Nẵng, Sài Gòn; trường học, quyển sách, khuya rồi.\n"
+    "Tôi đi học bằng xe đạp, còn anh ấy đi làm bằng xe buýt. Ngoài trời "
+    "mưa rất to, nhưng chúng tôi vẫn xuống phố uống cà phê.\n"
+    "Thư viện có nhiều sách tiếng Anh: class, email, website, download.\n";
+
+// The word breaks at which UnikeyWrapper commits and resets the engine
+const char kWordBreaks[] = ",;:.\"'!?<>=+-*/\\_~`@#$%^&(){}[]| ";
+
+int g_shift = 0;
+int g_capsLock = 0;
+
+void CheckKbCase(int *shift, int *capsLock) {
+    *shift = g_shift;
+    *capsLock = g_capsLock;
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool ReadFile(const char *path, std::string *text) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text->append(buf, len);
+    }
+    fclose(file);
+    return true;
+}
+
+// The engine set up the way the table was built for
+class Setup {
+public:
+    Setup() {
+        ctrl_.input.init();
+        ctrl_.macStore.init();
+        ctrl_.vietKey = 1;
+        ctrl_.usrKeyMapLoaded = 0;
+        CreateDefaultUnikeyOptions(&ctrl_.options);
+    }
+
+    bool Load(const char *table, const char *dict, const char *filter) {
+        if (!automaton_.load(table)) {
+            fprintf(stderr, "cannot load table %s\n", table);
+            return false;
+        }
+        const UkAutomatonHeader *header = automaton_.header();
+        ctrl_.input.setIM((UkInputMethod)header->inputMethod);
+        ctrl_.charsetId = header->charsetId;
+        ctrl_.options.freeMarking = (header->options & UKAUTO_OPT_FREE_MARKING) != 0;
+        ctrl_.options.modernStyle = (header->options & UKAUTO_OPT_MODERN_STYLE) != 0;
+        ctrl_.options.spellCheckEnabled = (header->options & UKAUTO_OPT_SPELL_CHECK) != 0;
+        ctrl_.options.autoNonVnRestore = (header->options & UKAUTO_OPT_AUTO_RESTORE) != 0;
+
+        if (dict != nullptr && !dict_.load(dict)) {
+            fprintf(stderr, "cannot load dictionary %s\n", dict);
+            return false;
+        }
+        if (filter != nullptr && !filter_.load(filter)) {
+            fprintf(stderr, "cannot load foreign filter %s\n", filter);
+            return false;
+        }
+        printf("table: %u states, %ld kB\n", automaton_.stateCount(),
+               automaton_.fileSize() >> 10);
+        return true;
+    }
+
+    void Init(UkEngine *engine, bool with_table) {
+        engine->setCtrlInfo(&ctrl_);
+        engine->setCheckKbCaseFunc(CheckKbCase);
+        engine->setDictionary(&dict_);
+        engine->setForeignFilter(&filter_);
+        engine->setLearnedWords(&learned_);
+        engine->setAutomaton(with_table ? &automaton_ : nullptr);
+        engine->reset();
+    }
+
+    UkInputMethod im() { return ctrl_.input.getIM(); }
+    UkWordSet &learned() { return learned_; }
+
+private:
+    UkSharedMem ctrl_;
+    UkAutomaton automaton_;
+    UkDictionary dict_;
+    UkBloomFilter filter_;
+    UkWordSet learned_;
+};
+
+struct Result {
+    int ret;
+    int backs;
+    UkOutputType type;
+    std::string out;
+
+    bool operator==(const Result &other) const {
+        return ret == other.ret && backs == other.backs && type == other.type &&
+               out == other.out;
+    }
+};
+
+Result Process(UkEngine *engine, unsigned int key) {
+    unsigned char buf[1024];
+    Result result;
+    int size = sizeof(buf);
+    result.ret = engine->process(key, result.backs, buf, size, result.type);
+    result.out.assign((const char *)buf, size);
+    return result;
+}
+
+Result Backspace(UkEngine *engine) {
+    unsigned char buf[1024];
+    Result result;
+    int size = sizeof(buf);
+    result.ret = engine->processBackspace(result.backs, buf, size, result.type);
+    result.out.assign((const char *)buf, size);
+    return result;
+}
+
+Result Restore(UkEngine *engine) {
+    unsigned char buf[1024];
+    Result result;
+    int size = sizeof(buf);
+    result.ret = engine->restoreKeyStrokes(result.backs, buf, size, result.type);
+    result.out.assign((const char *)buf, size);
+    return result;
+}
+
+std::string Keys(UkInputMethod im, const std::string &text, uint32_t seed) {
+    UkKeyStrokeWriter writer;
+    writer.init(im);
+    if (seed != 0) {
+        writer.setPlaces(UkKeyStrokeWriter::ToneRandom, UkKeyStrokeWriter::MarkRandom);
+        writer.setSeed(seed);
+    }
+    std::string keys;
+    writer.write(text.data(), (int)text.size(), keys);
+    return keys;
+}
+
+bool IsTelex(UkInputMethod im) {
+    return im == UkTelex || im == UkSimpleTelex2;
+}
+
+// Runs the same events in both engines and counts where they differ
+class Checker {
+public:
+    Checker(Setup *setup) : setup_(setup), random_(1) {
+        setup_->Init(&table_, true);
+        setup_->Init(&plain_, false);
+    }
+
+    void Round(const std::string &keys, uint32_t seed) {
+        random_ = seed;
+        bool settle = true;
+        std::string context;
+        for (size_t i = 0; i < keys.size(); i++) {
+            unsigned char key = keys[i];
+            context += key;
+            if (context.size() > 40) {
+                context.erase(0, context.size() - 40);
+            }
+
+            if (key < 0x20 || key >= 0x7F) {
+                table_.reset();
+                plain_.reset();
+                settle = Random() & 1;
+                continue;
+            }
+
+            uint32_t r = Random() % 1000;
+            g_shift = (key >= 'A' && key <= 'Z');
+            g_capsLock = (r < 5);
+            if (r >= 5 && r < 25) {
+                key = 0x21 + Random() % 94;
+            }
+
+            bool before = table_.inAutomaton();
+            bool begin = table_.atWordBeginning();
+            Expect(begin == plain_.atWordBeginning(), "atWordBeginning", context);
+
+            if (IsTelex(setup_->im()) && begin && (key == 'w' || key == 'W') && r >= 25 && r < 100) {
+                table_.pass(key);
+                plain_.pass(key);
+            } else if (r >= 100 && r < 120) {
+                Result result = Backspace(&table_);
+                Expect(result == Backspace(&plain_), "backspace", context);
+            } else if (r >= 120 && r < 130 && !begin) {
+                uint64_t hash = table_.lastWordKeyHash();
+                Expect(hash == plain_.lastWordKeyHash(), "lastWordKeyHash", context);
+                Result restored = Restore(&table_);
+                Expect(restored == Restore(&plain_), "restore", context);
+                if (restored.backs > 0 || !restored.out.empty()) {
+                    table_.leaveAutomaton();
+                    setup_->learned().add(hash);
+                }
+            } else {
+                Result result = Process(&table_, key);
+                Expect(result == Process(&plain_, key), "key", context);
+                keys_++;
+                if (before) {
+                    table_.inAutomaton() ? hits_++ : misses_++;
+                }
+                if (strchr(kWordBreaks, key) != nullptr && r % 10 != 0) {
+                    table_.reset();
+                    plain_.reset();
+                    continue;
+                }
+            }
+
+            if (settle) {
+                int steps = table_.settlePrefix();
+                Expect(steps == plain_.settlePrefix(), "settlePrefix", context);
+            }
+        }
+    }
+
+    long keys() const { return keys_; }
+    long hits() const { return hits_; }
+    long misses() const { return misses_; }
+    long mismatches() const { return mismatches_; }
+
+private:
+    uint32_t Random() {
+        random_ = random_ * 1103515245 + 12345;
+        return random_ >> 8;
+    }
+
+    void Expect(bool same, const char *what, const std::string &context) {
+        if (same) {
+            return;
+        }
+        if (mismatches_ < 10) {
+            fprintf(stderr, "%s differs after \"%s\"\n", what, context.c_str());
+        }
+        mismatches_++;
+    }
+
+    Setup *setup_;
+    UkEngine table_;
+    UkEngine plain_;
+    uint32_t random_;
+    long keys_ = 0;
+    long hits_ = 0;
+    long misses_ = 0;
+    long mismatches_ = 0;
+};
+
+// Types the keys the way UnikeyWrapper does, returns the keys typed
+long Type(UkEngine *engine, const std::string &keys) {
+    unsigned char buf[1024];
+    long count = 0;
+    for (unsigned char key : keys) {
+        if (key < 0x20 || key >= 0x7F) {
+            engine->reset();
+            continue;
+        }
+        g_shift = (key >= 'A' && key <= 'Z');
+        int backs, size = sizeof(buf);
+        UkOutputType type;
+        engine->atWordBeginning();
+        engine->process(key, backs, buf, size, type);
+        count++;
+        if (strchr(kWordBreaks, key) != nullptr) {
+            engine->reset();
+        } else {
+            engine->settlePrefix();
+        }
+    }
+    return count;
+}
+
+int Build(int argc, char **argv) {
+    UkSharedMem ctrl;
+    ctrl.input.init();
+    ctrl.macStore.init();
+    ctrl.vietKey = 1;
+    ctrl.usrKeyMapLoaded = 0;
+    ctrl.charsetId = CONV_CHARSET_XUTF8;
+    CreateDefaultUnikeyOptions(&ctrl.options);
+    ctrl.options.spellCheckEnabled = 1;
+    ctrl.options.autoNonVnRestore = 1;
+
+    UkAutomatonBuilder builder;
+    UkInputMethod im = UkTelex;
+    const char *out = nullptr;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--im") && i + 1 < argc) {
+            const char *name = argv[++i];
+            bool found = false;
+            for (const Name &method : kMethods) {
+                if (!strcmp(method.name, name)) {
+                    im = (UkInputMethod)method.value;
+                    found = true;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "unknown input method %s\n", name);
+                return 2;
+            }
+        } else if (!strcmp(argv[i], "--charset") && i + 1 < argc) {
+            ctrl.charsetId = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--modern")) {
+            ctrl.options.modernStyle = 1;
+        } else if (!strcmp(argv[i], "--no-free-marking")) {
+            ctrl.options.freeMarking = 0;
+        } else if (!strcmp(argv[i], "--no-spell-check")) {
+            ctrl.options.spellCheckEnabled = 0;
+        } else if (!strcmp(argv[i], "--no-auto-restore")) {
+            ctrl.options.autoNonVnRestore = 0;
+        } else if (!strcmp(argv[i], "--break-keys") && i + 1 < argc) {
+            builder.setBreakKeys(argv[++i]);
+        } else if (out == nullptr && argv[i][0] != '-') {
+            out = argv[i];
+        } else {
+            out = nullptr;
+            break;
+        }
+    }
+    if (out == nullptr) {
+        fprintf(stderr, "usage: %s build [--im telex|vni|stelex|stelex2] [--charset N] "
+                        "[--modern] [--no-free-marking] [--no-spell-check] "
+                        "[--no-auto-restore] [--break-keys KEYS] TABLE\n", argv[0]);
+        return 2;
+    }
+    ctrl.input.setIM(im);
+
+    uint64_t start = NowNs();
+    if (!builder.build(&ctrl, out)) {
+        fprintf(stderr, "cannot build %s\n", out);
+        return 1;
+    }
+    printf("%u states, %u edges, %u word ends, %ld kB, in %.1f s\n",
+           builder.stateCount(), builder.edgeCount(), builder.wordEndCount(),
+           builder.fileSize() >> 10, (NowNs() - start) / 1e9);
+    return 0;
+}
+
+int CheckOrBench(int argc, char **argv, bool bench) {
+    const char *table = nullptr;
+    const char *dict = nullptr;
+    const char *filter = nullptr;
+    const char *text_file = nullptr;
+    int rounds = bench ? 20 : 50;
+    uint32_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--dict") && i + 1 < argc) {
+            dict = argv[++i];
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--text") && i + 1 < argc) {
+            text_file = argv[++i];
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc && !bench) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else if (table == nullptr && argv[i][0] != '-') {
+            table = argv[i];
+        } else {
+            table = nullptr;
+            break;
+        }
+    }
+    if (table == nullptr) {
+        fprintf(stderr, "usage: %s %s TABLE [--dict FILE] [--filter FILE] [--text FILE] "
+                        "[--rounds N]%s\n", argv[0], argv[1], bench ? "" : " [--seed N]");
+        return 2;
+    }
+
+    std::string text;
+    if (text_file == nullptr) {
+        text = kSample;
+    } else if (!ReadFile(text_file, &text)) {
+        return 1;
+    }
+
+    Setup setup;
+    if (!setup.Load(table, dict, filter)) {
+        return 1;
+    }
+
+    if (!bench) {
+        Checker checker(&setup);
+        for (int round = 0; round < rounds; round++) {
+            checker.Round(Keys(setup.im(), text, seed + round), seed + round);
+        }
+        long taken = checker.hits() + checker.misses();
+        printf("%ld keys, %.1f%% from the table, %ld left it, %ld mismatches\n",
+               checker.keys(), taken * 100.0 / (checker.keys() ? checker.keys() : 1),
+               checker.misses(), checker.mismatches());
+        return checker.mismatches() ? 1 : 0;
+    }
+
+    std::string keys = Keys(setup.im(), text, 0);
+    double ns[2];
+    for (int with_table = 0; with_table < 2; with_table++) {
+        UkEngine engine;
+        setup.Init(&engine, with_table);
+        Type(&engine, keys);  // warm up
+        uint64_t start = NowNs();
+        long count = 0;
+        for (int round = 0; round < rounds; round++) {
+            count += Type(&engine, keys);
+        }
+        ns[with_table] = (double)(NowNs() - start) / count;
+        printf("%-14s %8.1f ns/key\n", with_table ? "with table" : "without table",
+               ns[with_table]);
+    }
+    printf("%.2fx\n", ns[0] / ns[1]);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && !strcmp(argv[1], "build")) {
+        return Build(argc, argv);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "check")) {
+        return CheckOrBench(argc, argv, false);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "bench")) {
+        return CheckOrBench(argc, argv, true);
+    }
+    fprintf(stderr, "usage: %s build|check|bench ...\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,458 @@
+// Runs VnConvert over every supported input x output charset pair on
+// generated Vietnamese text and prints one JSON object with, per pair and
+// corpus size, the throughput in MB/s of input, instructions per input byte
+// (from a perf counter, null when perf events are not available) and the
+// peak RSS of the process so far.
+//
+// The UkFoldUtf8() and UkFoldHash() kernels are measured the same way on
+// the UTF-8 corpus, reported as conversions from UTF-8 to FOLD-*, and so
+// is UkCollateKeys() over its sentences, as UTF-8 to COLLATE-KEYS, and
+// UkSplitSyllables(), as UTF-8 to SYLLABLES.
+//
+// The corpus is generated in UTF-8 and converted to each input charset
+// before timing. It is converted in chunks of whole lines so the output
+// buffer stays small next to a 100 MB corpus.
+//
+//   ibus-unikey-conv-bench [--sizes 1K,1M,100M] [--min-time SECONDS]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "third_party/libunikey/ukcollate.h"
+#include "third_party/libunikey/ukfold.h"
+#include "third_party/libunikey/uksyllable.h"
+#include "third_party/libunikey/vnconv.h"
+
+
+namespace {
+
+struct Charset {
+    const char *name;
+    int id;
+};
+
+// Everything getVnCharset() knows, less the internal VNSTANDARD and XUTF8,
+// which is UTF-8 under another id.
+const Charset kCharsets[] = {
+    {"UNICODE",     CONV_CHARSET_UNICODE},
+    {"UTF-8",       CONV_CHARSET_UNIUTF8},
+    {"NCR-DEC",     CONV_CHARSET_UNIREF},
+    {"NCR-HEX",     CONV_CHARSET_UNIREF_HEX},
+    {"UNI-COMP",    CONV_CHARSET_UNIDECOMPOSED},
+    {"WINCP-1258",  CONV_CHARSET_WINCP1258},
+    {"UNI-CSTRING", CONV_CHARSET_UNI_CSTRING},
+    {"VIQR",        CONV_CHARSET_VIQR},
+    {"UVIQR",       CONV_CHARSET_UTF8VIQR},
+    {"TCVN3",       CONV_CHARSET_TCVN3},
+    {"VPS",         CONV_CHARSET_VPS},
+    {"VISCII",      CONV_CHARSET_VISCII},
+    {"BKHCM1",      CONV_CHARSET_BKHCM1},
+    {"VIETWARE-F",  CONV_CHARSET_VIETWAREF},
+    {"ISC",         CONV_CHARSET_ISC},
+    {"VNI-WIN",     CONV_CHARSET_VNIWIN},
+    {"BKHCM2",      CONV_CHARSET_BKHCM2},
+    {"VIETWARE-X",  CONV_CHARSET_VIETWAREX},
+    {"VNI-MAC",     CONV_CHARSET_VNIMAC},
+};
+const int kCharsetCount = sizeof(kCharsets) / sizeof(kCharsets[0]);
+
+struct FoldKernel {
+    const char *name;
+    int flags;
+    bool hash;  // UkFoldHash() instead of UkFoldUtf8()
+};
+
+const FoldKernel kFoldKernels[] = {
+    {"FOLD-CASE",  UKFOLD_CASE,                false},
+    {"FOLD-TONES", UKFOLD_CASE | UKFOLD_TONES, false},
+    {"FOLD-ALL",   UKFOLD_ALL,                 false},
+    {"FOLD-HASH",  UKFOLD_ALL,                 true},
+};
+
+const char *const kSyllables[] = {
+    "tiếng", "việt", "là", "một", "ngôn", "ngữ", "của", "người", "nước",
+    "nam", "được", "dùng", "chính", "thức", "tại", "có", "khoảng", "triệu",
+    "nói", "như", "tiếng", "mẹ", "đẻ", "chữ", "quốc", "ngữ", "viết", "bằng",
+    "bảng", "cái", "la", "tinh", "với", "dấu", "thanh", "điệu", "sáu", "huyền",
+    "hỏi", "ngã", "nặng", "sắc", "những", "trường", "học", "đầu", "tiên",
+    "phở", "bánh", "mì", "cà", "phê", "sữa", "đá", "quyển", "khuya", "nguyễn",
+    "Hà", "Nội", "Đà", "Nẵng", "Huế", "Sài", "Gòn", "Việt", "Nam", "Điện",
+};
+const int kSyllableCount = sizeof(kSyllables) / sizeof(kSyllables[0]);
+
+const size_t kChunkSize = 64 * 1024;
+// Worst case is a one byte character turning into a base letter and a
+// combining mark, both as numeric references.
+const size_t kOutputRatio = 16;
+
+// A corpus in one charset: the bytes and where each chunk ends.
+struct Corpus {
+    std::vector<UKBYTE> data;
+    std::vector<size_t> ends;
+};
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+long PeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Instructions retired in user space by this thread, or -1 if the kernel or
+// the hardware does not let us count them.
+class InstructionCounter {
+public:
+    InstructionCounter() {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~InstructionCounter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool available() const { return fd_ >= 0; }
+
+    void Start() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    int64_t Stop() {
+        uint64_t count;
+        if (fd_ < 0) {
+            return -1;
+        }
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+bool ParseSize(const std::string &text, size_t *size) {
+    char *end;
+    unsigned long value = strtoul(text.c_str(), &end, 10);
+    if (end == text.c_str()) {
+        return false;
+    }
+    switch (*end) {
+    case 'K': value <<= 10; end++; break;
+    case 'M': value <<= 20; end++; break;
+    case 'G': value <<= 30; end++; break;
+    }
+    *size = value;
+    return *end == '\0' && value > 0;
+}
+
+bool ParseSizes(const char *list, std::vector<size_t> *sizes) {
+    std::string rest(list);
+    size_t start = 0;
+    for (;;) {
+        size_t comma = rest.find(',', start);
+        size_t size;
+        if (!ParseSize(rest.substr(start, comma - start), &size)) {
+            return false;
+        }
+        sizes->push_back(size);
+        if (comma == std::string::npos) {
+            return true;
+        }
+        start = comma + 1;
+    }
+}
+
+// Sentences of random syllables, a line every few sentences, chunked on
+// line boundaries. Always the same text for the same size.
+void GenerateUtf8(size_t size, Corpus *corpus) {
+    uint32_t seed = 12345;
+    size_t chunk_start = 0;
+    int words = 0;
+    int sentence_words = 8;
+    int sentences = 0;
+
+    corpus->data.clear();
+    corpus->ends.clear();
+    corpus->data.reserve(size + 64);
+
+    while (corpus->data.size() < size) {
+        seed = seed * 1103515245 + 12345;
+        const char *word = kSyllables[(seed >> 16) % kSyllableCount];
+        corpus->data.insert(corpus->data.end(), word, word + strlen(word));
+
+        const char *separator = " ";
+        if (++words == sentence_words) {
+            words = 0;
+            sentence_words = 8 + (int)(seed >> 28);
+            separator = (++sentences % 4) ? ". " : ".\n";
+        }
+        corpus->data.insert(corpus->data.end(), separator, separator + strlen(separator));
+
+        if (*separator && separator[1] == '\n' &&
+            corpus->data.size() - chunk_start >= kChunkSize / 2) {
+            chunk_start = corpus->data.size();
+            corpus->ends.push_back(chunk_start);
+        }
+    }
+    if (corpus->ends.empty() || corpus->ends.back() != corpus->data.size()) {
+        corpus->ends.push_back(corpus->data.size());
+    }
+}
+
+// Converts chunk by chunk, appending to |to| when it is not null. Returns
+// the error of VnConvert, the output size in |out_bytes|.
+int ConvertCorpus(int from, int to_charset, const Corpus &corpus,
+                  std::vector<UKBYTE> *output, Corpus *to, size_t *out_bytes) {
+    size_t start = 0;
+    *out_bytes = 0;
+    for (size_t end : corpus.ends) {
+        int in_len = (int)(end - start);
+        int out_len = (int)output->size();
+        int ret = VnConvert(from, to_charset,
+                            const_cast<UKBYTE*>(&corpus.data[start]),
+                            &(*output)[0], &in_len, &out_len);
+        if (ret != VNCONV_NO_ERROR) {
+            return ret;
+        }
+        if (to) {
+            to->data.insert(to->data.end(), output->begin(), output->begin() + out_len);
+            to->ends.push_back(to->data.size());
+        }
+        *out_bytes += out_len;
+        start = end;
+    }
+    return VNCONV_NO_ERROR;
+}
+
+// Folds or hashes chunk by chunk. |out_bytes| gets the folded size, or 8
+// bytes a hash.
+int FoldCorpus(const FoldKernel &kernel, const Corpus &corpus,
+               std::vector<UKBYTE> *output, size_t *out_bytes) {
+    static volatile uint64_t sink;
+    size_t start = 0;
+    *out_bytes = 0;
+    for (size_t end : corpus.ends) {
+        const char *in = reinterpret_cast<const char*>(&corpus.data[start]);
+        int in_len = (int)(end - start);
+        if (kernel.hash) {
+            sink = sink + UkFoldHash(in, in_len, kernel.flags);
+            *out_bytes += sizeof(uint64_t);
+        } else {
+            *out_bytes += UkFoldUtf8(in, in_len, reinterpret_cast<char*>(&(*output)[0]),
+                                     kernel.flags);
+        }
+        start = end;
+    }
+    return VNCONV_NO_ERROR;
+}
+
+// Splits into syllables chunk by chunk. |out_bytes| gets the size of the
+// syllables found.
+int SplitCorpus(const Corpus &corpus, std::vector<UkSyllable> *syllables,
+                size_t *out_bytes) {
+    size_t start = 0;
+    *out_bytes = 0;
+    for (size_t end : corpus.ends) {
+        const char *in = reinterpret_cast<const char*>(&corpus.data[start]);
+        int count = UkSplitSyllables(in, (int)(end - start), &(*syllables)[0]);
+        *out_bytes += count * sizeof(UkSyllable);
+        start = end;
+    }
+    return VNCONV_NO_ERROR;
+}
+
+// Sentences of a corpus, for UkCollateKeys()
+struct Sentences {
+    std::vector<const char*> text;
+    std::vector<int> lengths;
+    size_t key_room;
+};
+
+void SplitSentences(const Corpus &corpus, Sentences *sentences) {
+    const char *data = reinterpret_cast<const char*>(&corpus.data[0]);
+    size_t start = 0;
+    sentences->key_room = 0;
+    for (size_t i = 0; i < corpus.data.size(); i++) {
+        if (data[i] == '.' || data[i] == '\n') {
+            sentences->text.push_back(data + start);
+            sentences->lengths.push_back((int)(i - start));
+            sentences->key_room += UKCOLLATE_KEY_ROOM(i - start);
+            start = i + 1;
+        }
+    }
+}
+
+struct Result {
+    int ret;
+    size_t out_bytes;
+    uint64_t iterations;
+    uint64_t elapsed_ns;
+    int64_t instructions;   // -1 if not counted
+};
+
+// Runs |run| (returning a VnConvert error, setting the output size) over
+// and over for at least |min_ns|, or until it fails.
+template <typename Run>
+Result Measure(InstructionCounter *counter, uint64_t min_ns, Run run) {
+    Result result = { VNCONV_NO_ERROR, 0, 0, 0, 0 };
+    uint64_t start = NowNs();
+    do {
+        counter->Start();
+        result.ret = run(&result.out_bytes);
+        int64_t count = counter->Stop();
+        result.instructions = (count < 0 || result.instructions < 0) ?
+            -1 : result.instructions + count;
+        result.iterations++;
+        result.elapsed_ns = NowNs() - start;
+    } while (result.ret == VNCONV_NO_ERROR && result.elapsed_ns < min_ns);
+    return result;
+}
+
+void PrintString(const char *key, const char *value) {
+    printf("\"%s\": \"%s\"", key, value);
+}
+
+void PrintResult(const char *from, const char *to, size_t corpus_bytes,
+                 size_t input_bytes, const Result &result, bool *first) {
+    printf("%s\n    {", *first ? "" : ",");
+    *first = false;
+    PrintString("from", from);
+    printf(", ");
+    PrintString("to", to);
+    printf(", \"corpus_bytes\": %zu, \"input_bytes\": %zu", corpus_bytes, input_bytes);
+    if (result.ret != VNCONV_NO_ERROR) {
+        printf(", ");
+        PrintString("error", VnConvErrMsg(result.ret));
+        printf("}");
+        return;
+    }
+
+    double bytes = (double)input_bytes * result.iterations;
+    printf(", \"output_bytes\": %zu, \"iterations\": %llu, \"mb_per_s\": %.2f",
+           result.out_bytes, (unsigned long long)result.iterations,
+           bytes / (1 << 20) / (result.elapsed_ns / 1e9));
+    if (result.instructions < 0) {
+        printf(", \"instructions_per_byte\": null");
+    } else {
+        printf(", \"instructions_per_byte\": %.2f", result.instructions / bytes);
+    }
+    printf(", \"peak_rss_kb\": %ld}", PeakRssKb());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes;
+    double min_time = 0.2;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            if (!ParseSizes(argv[++i], &sizes)) {
+                fprintf(stderr, "bad size list %s\n", argv[i]);
+                return 2;
+            }
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--sizes 1K,1M,100M] [--min-time SECONDS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sizes.empty()) {
+        sizes.push_back(1 << 10);
+        sizes.push_back(1 << 20);
+        sizes.push_back(100 << 20);
+    }
+
+    InstructionCounter counter;
+    std::vector<UKBYTE> output(kChunkSize * kOutputRatio);
+    const uint64_t min_ns = (uint64_t)(min_time * 1e9);
+    bool first = true;
+
+    printf("{\n  \"perf_counters\": %s,\n  \"results\": [", counter.available() ? "true" : "false");
+    for (size_t size : sizes) {
+        Corpus utf8;
+        GenerateUtf8(size, &utf8);
+
+        for (int i = 0; i < kCharsetCount; i++) {
+            const Charset &from = kCharsets[i];
+            Corpus input;
+            size_t input_bytes;
+            int ret = ConvertCorpus(CONV_CHARSET_UNIUTF8, from.id, utf8, &output, &input, &input_bytes);
+            if (ret != VNCONV_NO_ERROR) {
+                fprintf(stderr, "cannot make a %s corpus: %s\n", from.name, VnConvErrMsg(ret));
+                continue;
+            }
+
+            for (int j = 0; j < kCharsetCount; j++) {
+                const Charset &to = kCharsets[j];
+                Result result = Measure(&counter, min_ns, [&](size_t *out_bytes) {
+                    return ConvertCorpus(from.id, to.id, input, &output, nullptr, out_bytes);
+                });
+                PrintResult(from.name, to.name, size, input.data.size(), result, &first);
+            }
+        }
+
+        for (const FoldKernel &kernel : kFoldKernels) {
+            Result result = Measure(&counter, min_ns, [&](size_t *out_bytes) {
+                return FoldCorpus(kernel, utf8, &output, out_bytes);
+            });
+            PrintResult("UTF-8", kernel.name, size, utf8.data.size(), result, &first);
+        }
+
+        Sentences sentences;
+        SplitSentences(utf8, &sentences);
+        std::vector<UKBYTE> keys(sentences.key_room);
+        std::vector<long> key_ends(sentences.text.size());
+        Result result = Measure(&counter, min_ns, [&](size_t *out_bytes) {
+            *out_bytes = UkCollateKeys(&sentences.text[0], &sentences.lengths[0],
+                                       (int)sentences.text.size(), &keys[0], &key_ends[0]);
+            return VNCONV_NO_ERROR;
+        });
+        PrintResult("UTF-8", "COLLATE-KEYS", size, utf8.data.size(), result, &first);
+
+        size_t longest = 0;
+        size_t start = 0;
+        for (size_t end : utf8.ends) {
+            longest = std::max(longest, end - start);
+            start = end;
+        }
+        std::vector<UkSyllable> syllables(UKSYLLABLE_ROOM(longest));
+        result = Measure(&counter, min_ns, [&](size_t *out_bytes) {
+            return SplitCorpus(utf8, &syllables, out_bytes);
+        });
+        PrintResult("UTF-8", "SYLLABLES", size, utf8.data.size(), result, &first);
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Converts the same text from many threads at once, each thread through its
+// own VnConvContext (see charset.h), and checks every result against the
+// one a single context got alone. Each thread goes from UTF-8 to every
+// charset and back, starting at a different charset, and odd threads
+// convert with toUpper and removeTone set, so a context that picks up the
+// options or the charset state of another shows up as a mismatch. Then it
+// reports the throughput at 1, 2, 4 ... up to --threads threads.
+//
+// Built with -fsanitize=thread, ThreadSanitizer also watches the charsets
+// the contexts share; a clean run prints no reports.
+//
+//   ibus-unikey-conv-stress [--threads N] [--size BYTES] [--rounds N]
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "third_party/libunikey/charset.h"
+
+
+namespace {
+
+const int kCharsets[] = {
+    CONV_CHARSET_UNICODE, CONV_CHARSET_UNIUTF8, CONV_CHARSET_UNIREF,
+    CONV_CHARSET_UNIREF_HEX, CONV_CHARSET_UNIDECOMPOSED, CONV_CHARSET_WINCP1258,
+    CONV_CHARSET_UNI_CSTRING, CONV_CHARSET_VIQR, CONV_CHARSET_UTF8VIQR,
+    CONV_CHARSET_TCVN3, CONV_CHARSET_VPS, CONV_CHARSET_VISCII,
+    CONV_CHARSET_BKHCM1, CONV_CHARSET_VIETWAREF, CONV_CHARSET_ISC,
+    CONV_CHARSET_VNIWIN, CONV_CHARSET_BKHCM2, CONV_CHARSET_VIETWAREX,
+    CONV_CHARSET_VNIMAC,
+};
+const int kCharsetCount = sizeof(kCharsets) / sizeof(kCharsets[0]);
+
+const char *const kSyllables[] = {
+    "tiếng", "việt", "là", "một", "ngôn", "ngữ", "của", "người", "được",
+    "dùng", "chính", "thức", "khoảng", "quốc", "viết", "bằng", "dấu",
+    "huyền", "hỏi", "ngã", "nặng", "sắc", "những", "trường", "phở", "cà",
+    "phê", "quyển", "khuya", "nguyễn", "Hà", "Nội", "Đà", "Nẵng", "Huế",
+    "Sài", "Gòn", "www.vnexpress.net", "Điện", "C:\\\\", "email:", "ư?",
+};
+const int kSyllableCount = sizeof(kSyllables) / sizeof(kSyllables[0]);
+
+// Worst case is a one byte character turning into a base letter and a
+// combining mark, both as numeric references.
+const size_t kOutputRatio = 16;
+
+typedef std::vector<UKBYTE> Bytes;
+
+// What a context with the options of one thread kind makes of the corpus:
+// per charset, the corpus in it and that converted back to UTF-8.
+struct Expected {
+    Bytes to[kCharsetCount];
+    Bytes back[kCharsetCount];
+};
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void GenerateUtf8(size_t size, Bytes *text) {
+    uint32_t seed = 12345;
+    std::string line;
+    while (text->size() < size) {
+        seed = seed * 1103515245 + 12345;
+        line += kSyllables[(seed >> 16) % kSyllableCount];
+        line += (seed & 0x700) ? " " : ". ";
+        if (line.size() > 70 || text->size() + line.size() >= size) {
+            line += '\n';
+            text->insert(text->end(), line.begin(), line.end());
+            line.clear();
+        }
+    }
+    text->resize(size);
+}
+
+void SetOptions(VnConvContext *context, int thread) {
+    VnConvResetOptions(&context->m_options);
+    if (thread & 1) {
+        context->m_options.toUpper = 1;
+        context->m_options.removeTone = 1;
+    }
+}
+
+int Convert(VnConvContext *context, int from, int to, const Bytes &in, Bytes *out) {
+    int in_len = (int)in.size();
+    int out_len = (int)(in.size() * kOutputRatio + 16);
+    out->resize(out_len);
+    int ret = context->convert(from, to, const_cast<UKBYTE*>(in.data()), out->data(),
+                               &in_len, &out_len);
+    out->resize(ret == VNCONV_NO_ERROR ? out_len : 0);
+    return ret;
+}
+
+// One thread: every charset and back, |rounds| times, counting the results
+// that differ from |expected|.
+void Work(int thread, int rounds, const Bytes &utf8, const Expected &expected,
+          long *mismatches) {
+    VnConvContext context;
+    SetOptions(&context, thread);
+    Bytes to, back;
+    *mismatches = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int k = 0; k < kCharsetCount; k++) {
+            int i = (k + thread) % kCharsetCount;
+            Convert(&context, CONV_CHARSET_UNIUTF8, kCharsets[i], utf8, &to);
+            Convert(&context, kCharsets[i], CONV_CHARSET_UNIUTF8, to, &back);
+            *mismatches += (to != expected.to[i]) + (back != expected.back[i]);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int max_threads = (int)std::thread::hardware_concurrency();
+    size_t size = 256 << 10;
+    int rounds = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            size = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--threads N] [--size BYTES] [--rounds N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+
+    Bytes utf8;
+    GenerateUtf8(size, &utf8);
+
+    Expected expected[2];
+    for (int kind = 0; kind < 2; kind++) {
+        VnConvContext context;
+        SetOptions(&context, kind);
+        for (int i = 0; i < kCharsetCount; i++) {
+            int ret = Convert(&context, CONV_CHARSET_UNIUTF8, kCharsets[i], utf8,
+                              &expected[kind].to[i]);
+            if (ret == VNCONV_NO_ERROR) {
+                ret = Convert(&context, kCharsets[i], CONV_CHARSET_UNIUTF8,
+                              expected[kind].to[i], &expected[kind].back[i]);
+            }
+            if (ret != VNCONV_NO_ERROR) {
+                fprintf(stderr, "cannot convert to charset %d: %s\n", kCharsets[i],
+                        VnConvErrMsg(ret));
+                return 1;
+            }
+        }
+    }
+
+    // Bytes of UTF-8 in and out per thread and round, both directions
+    const double round_mb = 2.0 * kCharsetCount * utf8.size() / 1e6;
+    double one_thread = 0;
+    long total_mismatches = 0;
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        std::vector<long> mismatches(threads);
+        std::vector<std::thread> workers;
+        uint64_t start = NowNs();
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(std::thread(Work, t, rounds, std::cref(utf8),
+                                          std::cref(expected[t & 1]), &mismatches[t]));
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        double seconds = (NowNs() - start) / 1e9;
+
+        long bad = 0;
+        for (long m : mismatches) {
+            bad += m;
+        }
+        total_mismatches += bad;
+        double mb_per_s = threads * rounds * round_mb / seconds;
+        if (threads == 1) {
+            one_thread = mb_per_s;
+        }
+        printf("%d threads: %.2f MB/s, %.2fx one thread, %ld mismatches\n",
+               threads, mb_per_s, mb_per_s / one_thread, bad);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    return total_mismatches ? 1 : 0;
+}
@@ -0,0 +1,420 @@
+// Builds the syllable bigram model of diacritic restoration (see
+// ukdiacritic.h), restores text with it and measures it.
+//
+// The corpus is UTF-8 Vietnamese with its diacritics, any length of lines.
+// Syllables are counted the way UkDiacriticModel::splitWords() cuts them:
+// pairs are only counted between syllables with nothing but blanks between
+// them, so a comma or the end of a line starts over. Pairs seen fewer than
+// --min-count times are left out of the model.
+//
+// restore reads stdin and writes stdout. bench strips the diacritics of the
+// corpus, restores it and reports the throughput and the syllables restored
+// right. Both cut their input at line ends into one part per thread; the
+// model is only read, so the threads share it.
+//   ibus-unikey-diacritics build corpus.txt vietnamese.ngram [--min-count N]
+//   ibus-unikey-diacritics restore vietnamese.ngram [--threads N]
+//   ibus-unikey-diacritics bench vietnamese.ngram corpus.txt [--threads N]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "third_party/libunikey/charset.h"
+#include "third_party/libunikey/ukdiacritic.h"
+
+
+namespace {
+
+typedef std::string Key;  // UKNGRAM_MAX_LETTERS bytes
+typedef UkDiacriticModel::Word Word;
+
+const uint32_t kStart = 0xFFFFFFFF;
+// ln(0.4), the usual weight of stupid backoff
+const double kBackoff = -0.916;
+
+bool ReadFile(FILE *file, std::string *text) {
+    char buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text->append(buf, len);
+    }
+    return !ferror(file);
+}
+
+bool ReadFile(const char *path, std::string *text) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    bool ok = ReadFile(file, text);
+    fclose(file);
+    return ok;
+}
+
+int16_t Scaled(double log_prob) {
+    double scaled = floor(log_prob * UKNGRAM_LOG_SCALE + 0.5);
+    return (int16_t)std::max(-32768.0, std::min(32767.0, scaled));
+}
+
+Key RootOf(const Key &key) {
+    Key root(key);
+    for (size_t i = 0; i < root.size() && root[i]; i++) {
+        root[i] = StdVnRootChar[(unsigned char)root[i]];
+    }
+    return root;
+}
+
+class ModelBuilder {
+public:
+    ModelBuilder() : total_(0) {}
+
+    void AddText(const std::string &text) {
+        std::vector<Word> words;
+        UkDiacriticModel::splitWords(text.data(), text.size(), words);
+
+        uint32_t prev = kStart;
+        for (const Word &word : words) {
+            if (word.letters == 0) {
+                prev = kStart;
+                continue;
+            }
+            if (word.newRun) {
+                prev = kStart;
+            }
+            uint32_t id = Intern(Key((const char *)word.key, UKNGRAM_MAX_LETTERS));
+            counts_[id]++;
+            total_++;
+            pairs_[(uint64_t)prev << 32 | id]++;
+            prev = id;
+        }
+    }
+
+    bool Write(const char *path, uint32_t min_count) const {
+        const uint32_t n = keys_.size();
+        if (n == 0) {
+            fprintf(stderr, "no syllables in the corpus\n");
+            return false;
+        }
+
+        // Syllables are renumbered in key order.
+        std::vector<uint32_t> order(n);
+        for (uint32_t i = 0; i < n; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return keys_[a] < keys_[b];
+        });
+        std::vector<uint32_t> new_id(n);
+        for (uint32_t i = 0; i < n; i++) {
+            new_id[order[i]] = i;
+        }
+
+        std::vector<int16_t> unigram(n);
+        for (uint32_t i = 0; i < n; i++) {
+            unigram[new_id[i]] = Scaled(log((double)counts_[i] / total_));
+        }
+
+        // Candidates of a root, the most frequent first
+        std::vector<std::pair<Key, uint32_t> > by_root(n);
+        for (uint32_t i = 0; i < n; i++) {
+            by_root[i] = std::make_pair(RootOf(keys_[order[i]]), i);
+        }
+        std::sort(by_root.begin(), by_root.end(),
+                  [&unigram](const std::pair<Key, uint32_t> &a,
+                             const std::pair<Key, uint32_t> &b) {
+                      if (a.first != b.first) {
+                          return a.first < b.first;
+                      }
+                      return unigram[a.second] > unigram[b.second] ||
+                             (unigram[a.second] == unigram[b.second] &&
+                              a.second < b.second);
+                  });
+        std::string roots;
+        std::vector<uint32_t> root_start;
+        std::vector<uint32_t> candidates(n);
+        for (uint32_t i = 0; i < n; i++) {
+            if (i == 0 || by_root[i].first != by_root[i - 1].first) {
+                root_start.push_back(i);
+                roots += by_root[i].first;
+            }
+            candidates[i] = by_root[i].second;
+        }
+        const uint32_t r = root_start.size();
+        root_start.push_back(n);
+
+        // Pairs, row by row; row n is the start of a run.
+        std::vector<uint64_t> row_total(n + 1);
+        std::vector<std::pair<uint64_t, uint32_t> > pairs;
+        for (const std::pair<const uint64_t, uint32_t> &pair : pairs_) {
+            uint32_t prev = pair.first >> 32;
+            uint32_t row = prev == kStart ? n : new_id[prev];
+            row_total[row] += pair.second;
+            if (pair.second >= min_count) {
+                uint32_t next = new_id[(uint32_t)pair.first];
+                pairs.push_back(std::make_pair((uint64_t)row << 32 | next, pair.second));
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        const uint32_t b = pairs.size();
+        std::vector<uint32_t> bigram_start(n + 2);
+        std::vector<uint32_t> bigram_next(b);
+        std::vector<int16_t> bigram(b);
+        for (uint32_t i = 0; i < b; i++) {
+            uint32_t row = pairs[i].first >> 32;
+            bigram_start[row + 1]++;
+            bigram_next[i] = (uint32_t)pairs[i].first;
+            bigram[i] = Scaled(log((double)pairs[i].second / row_total[row]));
+        }
+        for (uint32_t row = 0; row <= n; row++) {
+            bigram_start[row + 1] += bigram_start[row];
+        }
+
+        std::string syllables;
+        for (uint32_t i = 0; i < n; i++) {
+            syllables += keys_[order[i]];
+        }
+
+        UkNgramHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, UKNGRAM_MAGIC, sizeof(header.magic));
+        header.syllableCount = n;
+        header.rootCount = r;
+        header.bigramCount = b;
+        header.backoff = Scaled(kBackoff);
+
+        FILE *file = fopen(path, "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return false;
+        }
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(&bigram_start[0], sizeof(uint32_t), bigram_start.size(), file);
+        fwrite(bigram_next.data(), sizeof(uint32_t), bigram_next.size(), file);
+        fwrite(&root_start[0], sizeof(uint32_t), root_start.size(), file);
+        fwrite(&candidates[0], sizeof(uint32_t), candidates.size(), file);
+        fwrite(&unigram[0], sizeof(int16_t), unigram.size(), file);
+        fwrite(bigram.data(), sizeof(int16_t), bigram.size(), file);
+        fwrite(syllables.data(), 1, syllables.size(), file);
+        fwrite(roots.data(), 1, roots.size(), file);
+        bool ok = !ferror(file);
+        ok = (fclose(file) == 0) && ok;
+
+        printf("%llu syllables in the corpus, %u distinct, %u roots, %u pairs of %zu\n",
+               (unsigned long long)total_, n, r, b, pairs_.size());
+        return ok;
+    }
+
+private:
+    uint32_t Intern(const Key &key) {
+        std::unordered_map<Key, uint32_t>::iterator it = ids_.find(key);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        uint32_t id = keys_.size();
+        ids_[key] = id;
+        keys_.push_back(key);
+        counts_.push_back(0);
+        return id;
+    }
+
+    std::unordered_map<Key, uint32_t> ids_;
+    std::vector<Key> keys_;
+    std::vector<uint32_t> counts_;
+    std::unordered_map<uint64_t, uint32_t> pairs_;
+    uint64_t total_;
+};
+
+int Build(const char *corpus, const char *out, uint32_t min_count) {
+    FILE *file = fopen(corpus, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", corpus);
+        return 1;
+    }
+
+    ModelBuilder builder;
+    char *line = nullptr;
+    size_t size = 0;
+    ssize_t len;
+    while ((len = getline(&line, &size, file)) > 0) {
+        builder.AddText(std::string(line, len));
+    }
+    free(line);
+    fclose(file);
+    return builder.Write(out, min_count) ? 0 : 1;
+}
+
+// Cuts text after a line end into at most |parts| pieces of about the same
+// size.
+std::vector<size_t> SplitLines(const std::string &text, int parts) {
+    std::vector<size_t> cuts(1, 0);
+    for (int i = 1; i < parts; i++) {
+        size_t pos = text.find('\n', std::max(cuts.back(), text.size() * i / parts));
+        if (pos == std::string::npos) {
+            break;
+        }
+        cuts.push_back(pos + 1);
+    }
+    cuts.push_back(text.size());
+    return cuts;
+}
+
+void RestoreParallel(const UkDiacriticModel &model, const std::string &text,
+                     int threads, std::vector<std::string> *parts) {
+    std::vector<size_t> cuts = SplitLines(text, threads);
+    parts->assign(cuts.size() - 1, std::string());
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < cuts.size(); i++) {
+        workers.push_back(std::thread([&model, &text, &cuts, parts, i] {
+            (*parts)[i].reserve(cuts[i + 1] - cuts[i] + 64);
+            model.restore(text.data() + cuts[i], cuts[i + 1] - cuts[i], (*parts)[i]);
+        }));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+int Restore(const char *model_path, int threads) {
+    UkDiacriticModel model;
+    if (!model.load(model_path)) {
+        fprintf(stderr, "cannot load %s\n", model_path);
+        return 1;
+    }
+
+    std::string text;
+    if (!ReadFile(stdin, &text)) {
+        return 1;
+    }
+    std::vector<std::string> parts;
+    RestoreParallel(model, text, threads, &parts);
+    for (const std::string &part : parts) {
+        fwrite(part.data(), 1, part.size(), stdout);
+    }
+    return 0;
+}
+
+// The text with every syllable written with its root letters.
+std::string StripDiacritics(const std::string &text) {
+    std::vector<Word> words;
+    UkDiacriticModel::splitWords(text.data(), text.size(), words);
+
+    std::string stripped;
+    size_t pos = 0;
+    for (const Word &word : words) {
+        stripped.append(text, pos, word.start - pos);
+        if (word.letters > 0) {
+            Key root = RootOf(Key((const char *)word.key, UKNGRAM_MAX_LETTERS));
+            UkDiacriticModel::putSyllable(stripped, (const uint8_t *)root.data(),
+                                          word.upper, word.letters);
+        } else {
+            stripped.append(text, word.start, word.end - word.start);
+        }
+        pos = word.end;
+    }
+    stripped.append(text, pos, std::string::npos);
+    return stripped;
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Restores the stripped corpus until a second has passed, then compares
+// the syllables of the last result with those of the corpus.
+int Bench(const char *model_path, const char *corpus, int threads) {
+    UkDiacriticModel model;
+    if (!model.load(model_path)) {
+        fprintf(stderr, "cannot load %s\n", model_path);
+        return 1;
+    }
+
+    std::string text;
+    if (!ReadFile(corpus, &text)) {
+        return 1;
+    }
+    const std::string stripped = StripDiacritics(text);
+
+    std::vector<std::string> parts;
+    uint64_t bytes = 0;
+    uint64_t start = NowNs();
+    uint64_t elapsed;
+    do {
+        RestoreParallel(model, stripped, threads, &parts);
+        bytes += stripped.size();
+        elapsed = NowNs() - start;
+    } while (elapsed < 1000000000);
+
+    std::string restored;
+    for (const std::string &part : parts) {
+        restored += part;
+    }
+    std::vector<Word> expected;
+    std::vector<Word> got;
+    UkDiacriticModel::splitWords(text.data(), text.size(), expected);
+    UkDiacriticModel::splitWords(restored.data(), restored.size(), got);
+    if (expected.size() != got.size()) {
+        fprintf(stderr, "restored text has %zu words, not %zu\n",
+                got.size(), expected.size());
+        return 1;
+    }
+
+    size_t syllables = 0;
+    size_t right = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (expected[i].letters > 0) {
+            syllables++;
+            right += !memcmp(expected[i].key, got[i].key, UKNGRAM_MAX_LETTERS);
+        }
+    }
+
+    double mb_per_s = bytes / 1e6 / (elapsed / 1e9);
+    printf("%zu bytes, %d threads, %.2f MB/s (%.2f MB/s per thread), "
+           "%zu syllables, %.2f%% restored right\n",
+           stripped.size(), threads, mb_per_s, mb_per_s / threads,
+           syllables, syllables ? 100.0 * right / syllables : 0.0);
+    return 0;
+}
+
+// Takes "--NAME N" off the end of the arguments, or returns |fallback|.
+int IntOption(int *argc, char **argv, const char *name, int fallback) {
+    if (*argc >= 2 && !strcmp(argv[*argc - 2], name)) {
+        *argc -= 2;
+        return std::max(1, atoi(argv[*argc + 1]));
+    }
+    return fallback;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int threads = IntOption(&argc, argv, "--threads", 1);
+    int min_count = IntOption(&argc, argv, "--min-count", 1);
+
+    if (argc == 4 && !strcmp(argv[1], "build")) {
+        return Build(argv[2], argv[3], min_count);
+    }
+    if (argc == 3 && !strcmp(argv[1], "restore")) {
+        return Restore(argv[2], threads);
+    }
+    if (argc == 4 && !strcmp(argv[1], "bench")) {
+        return Bench(argv[2], argv[3], threads);
+    }
+    fprintf(stderr, "usage: %s build CORPUS MODEL [--min-count N]\n"
+                    "       %s restore MODEL [--threads N]\n"
+                    "       %s bench MODEL CORPUS [--threads N]\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+}
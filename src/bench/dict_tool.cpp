@@ -0,0 +1,539 @@
+// Builds the data files of the libunikey spell check and of word completion
+// and measures their lookups: the syllable dictionary (see ukdict.h), the
+// filter of foreign words (see ukbloom.h) and the completion index (see
+// unix/ibus/completion_index.h).
+//
+// The syllable list is UTF-8, one syllable or word per line, syllables of
+// a word separated by a space. The foreign word list has one word per
+// line, written with the keys typed for it. Words which are also typed for
+// Vietnamese syllables ("mix" for "mĩ") stay Vietnamese: the filter only
+// decides how a word the spell check rejects is given back. Lines with
+// anything else are skipped.
+//
+// The completion list is UTF-8, one word or phrase per line, optionally
+// followed by a tab and its frequency; it is folded to lower case NFC and
+// repeated lines add up.
+//   ibus-unikey-dict build syllables.txt vietnamese.dict
+//   ibus-unikey-dict bench vietnamese.dict syllables.txt
+//   ibus-unikey-dict bloom english.txt english.bloom
+//   ibus-unikey-dict bench-bloom english.bloom english.txt
+//   ibus-unikey-dict complete frequencies.txt vietnamese.complete
+//   ibus-unikey-dict bench-complete vietnamese.complete frequencies.txt
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "third_party/libunikey/ukbloom.h"
+#include "third_party/libunikey/ukdict.h"
+#include "unix/ibus/completion_index.h"
+
+
+namespace {
+
+typedef std::basic_string<unsigned char> Key;
+
+bool ReadKeys(const char *path, std::vector<Key> *keys) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    char line[1024];
+    int skipped = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        unsigned char key[UKDICT_MAX_KEY];
+        int len = UkDictMakeKey(line, key, UKDICT_MAX_KEY);
+        if (len <= 0) {
+            skipped++;
+            continue;
+        }
+        keys->push_back(Key(key, len));
+    }
+    fclose(file);
+
+    if (skipped) {
+        fprintf(stderr, "%s: skipped %d lines\n", path, skipped);
+    }
+    return true;
+}
+
+// Trie of all keys, minimised bottom up into a DAWG: states with the same
+// outgoing edges are merged.
+class DictBuilder {
+public:
+    DictBuilder() : nodes_(1) {}
+
+    void Add(const Key &key) {
+        int node = 0;
+        for (unsigned char label : key) {
+            std::map<unsigned char, int>::iterator it = nodes_[node].next.find(label);
+            if (it == nodes_[node].next.end()) {
+                nodes_.push_back(Node());
+                it = nodes_[node].next.insert(std::make_pair(label, (int)nodes_.size() - 1)).first;
+            }
+            node = it->second;
+        }
+        nodes_[node].accept = true;
+    }
+
+    bool Write(const char *path) {
+        uint32_t root = Minimize(0);
+        if (states_.size() > UKDICT_MAX_STATES) {
+            fprintf(stderr, "too many states: %zu\n", states_.size());
+            return false;
+        }
+
+        std::vector<uint32_t> first_edge;
+        std::vector<uint32_t> edges;
+        for (const std::vector<uint32_t> &state : states_) {
+            first_edge.push_back(edges.size());
+            edges.insert(edges.end(), state.begin(), state.end());
+        }
+        first_edge.push_back(edges.size());
+
+        UkDictHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, UKDICT_MAGIC, sizeof(header.magic));
+        header.stateCount = states_.size();
+        header.edgeCount = edges.size();
+        header.root = root;
+
+        FILE *file = fopen(path, "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return false;
+        }
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(&first_edge[0], sizeof(uint32_t), first_edge.size(), file);
+        if (!edges.empty()) {
+            fwrite(&edges[0], sizeof(uint32_t), edges.size(), file);
+        }
+        bool ok = !ferror(file);
+        ok = (fclose(file) == 0) && ok;
+
+        printf("%zu trie nodes, %zu states, %zu edges\n",
+               nodes_.size(), states_.size(), edges.size());
+        return ok;
+    }
+
+private:
+    struct Node {
+        Node() : accept(false) {}
+        bool accept;
+        std::map<unsigned char, int> next;
+    };
+
+    uint32_t Minimize(int node) {
+        std::vector<uint32_t> signature;
+        for (const std::pair<const unsigned char, int> &edge : nodes_[node].next) {
+            uint32_t target = Minimize(edge.second);
+            signature.push_back((uint32_t)edge.first << 24 |
+                                (uint32_t)nodes_[edge.second].accept << 23 |
+                                target);
+        }
+
+        std::map<std::vector<uint32_t>, uint32_t>::iterator it = registry_.find(signature);
+        if (it != registry_.end()) {
+            return it->second;
+        }
+        uint32_t id = states_.size();
+        states_.push_back(signature);
+        registry_.insert(std::make_pair(signature, id));
+        return id;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<std::vector<uint32_t> > states_;
+    std::map<std::vector<uint32_t>, uint32_t> registry_;
+};
+
+int Build(const char *words, const char *out) {
+    std::vector<Key> keys;
+    if (!ReadKeys(words, &keys)) {
+        return 1;
+    }
+
+    DictBuilder builder;
+    for (const Key &key : keys) {
+        builder.Add(key);
+    }
+    return builder.Write(out) ? 0 : 1;
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Looks up every word of the list, and the same words with their last
+// letter changed to get misses, until a second has passed.
+int Bench(const char *dict_path, const char *words) {
+    UkDictionary dict;
+    if (!dict.load(dict_path)) {
+        fprintf(stderr, "cannot load %s\n", dict_path);
+        return 1;
+    }
+
+    std::vector<Key> keys;
+    if (!ReadKeys(words, &keys) || keys.empty()) {
+        return 1;
+    }
+    size_t count = keys.size();
+    for (size_t i = 0; i < count; i++) {
+        Key miss = keys[i];
+        miss[miss.size() - 1] ^= 2;
+        keys.push_back(miss);
+    }
+
+    uint64_t lookups = 0;
+    uint64_t found = 0;
+    uint64_t start = NowNs();
+    uint64_t elapsed;
+    do {
+        for (const Key &key : keys) {
+            found += dict.contains(key.data(), key.size());
+        }
+        lookups += keys.size();
+        elapsed = NowNs() - start;
+    } while (elapsed < 1000000000);
+
+    printf("%zu words, %llu lookups, %.1f%% found, %.1f ns per lookup\n",
+           count, (unsigned long long)lookups, 100.0 * found / lookups,
+           (double)elapsed / lookups);
+    return 0;
+}
+
+// Foreign words hash the way the engine hashes key strokes.
+bool ReadWordHashes(const char *path, std::vector<uint64_t> *hashes) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    char line[1024];
+    int skipped = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        uint64_t hash = UKBLOOM_HASH_START;
+        bool ok = true;
+        for (const char *p = line; *p && ok; p++) {
+            ok = (*p > ' ' && *p < 0x7F);
+            hash = UkBloomHashAdd(hash, (unsigned char)*p);
+        }
+        if (!ok) {
+            skipped++;
+            continue;
+        }
+        hashes->push_back(hash);
+    }
+    fclose(file);
+
+    if (skipped) {
+        fprintf(stderr, "%s: skipped %d lines\n", path, skipped);
+    }
+    return true;
+}
+
+// About 10 bits per word for a 1% false positive rate, as long as that
+// fits in UKBLOOM_MAX_BITS.
+int BuildBloom(const char *words, const char *out) {
+    std::vector<uint64_t> hashes;
+    if (!ReadWordHashes(words, &hashes) || hashes.empty()) {
+        return 1;
+    }
+
+    uint32_t bits = 64;
+    while (bits < UKBLOOM_MAX_BITS && bits < hashes.size() * 10) {
+        bits *= 2;
+    }
+    uint32_t hash_count = (uint32_t)((double)bits / hashes.size() * 0.693 + 0.5);
+    hash_count = std::max(1u, std::min(hash_count, (uint32_t)UKBLOOM_MAX_HASHES));
+
+    std::vector<unsigned char> filter(bits / 8);
+    uint32_t pos[UKBLOOM_MAX_HASHES];
+    for (uint64_t hash : hashes) {
+        UkBloomFilter::probes(hash, bits, hash_count, pos);
+        for (uint32_t i = 0; i < hash_count; i++) {
+            filter[pos[i] >> 3] |= 1 << (pos[i] & 7);
+        }
+    }
+
+    UkBloomHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UKBLOOM_MAGIC, sizeof(header.magic));
+    header.bitCount = bits;
+    header.hashCount = hash_count;
+
+    FILE *file = fopen(out, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&filter[0], 1, filter.size(), file);
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+
+    printf("%zu words, %u bytes, %u hashes\n", hashes.size(), bits / 8, hash_count);
+    return ok ? 0 : 1;
+}
+
+// Looks up every word of the list and as many made up ones, which give
+// the false positive rate.
+int BenchBloom(const char *filter_path, const char *words) {
+    UkBloomFilter filter;
+    if (!filter.load(filter_path)) {
+        fprintf(stderr, "cannot load %s\n", filter_path);
+        return 1;
+    }
+
+    std::vector<uint64_t> hashes;
+    if (!ReadWordHashes(words, &hashes) || hashes.empty()) {
+        return 1;
+    }
+    size_t count = hashes.size();
+    for (size_t i = 0; i < count; i++) {
+        hashes.push_back(UkBloomHashAdd(hashes[i], '#'));
+    }
+
+    uint64_t found = 0;
+    uint64_t false_positives = 0;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        bool hit = filter.mayContain(hashes[i]);
+        found += (i < count) && hit;
+        false_positives += (i >= count) && hit;
+    }
+
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t start = NowNs();
+    uint64_t elapsed;
+    do {
+        for (uint64_t hash : hashes) {
+            hits += filter.mayContain(hash);
+        }
+        lookups += hashes.size();
+        elapsed = NowNs() - start;
+    } while (elapsed < 1000000000);
+
+    printf("%zu words, %.1f%% found, %.2f%% false positives, %.1f%% hits, %.1f ns per lookup\n",
+           count, 100.0 * found / count, 100.0 * false_positives / count,
+           100.0 * hits / lookups, (double)elapsed / lookups);
+    return 0;
+}
+
+// Word list for completion: the words with the sum of their frequencies,
+// sorted by key, then by word.
+typedef std::map<std::pair<std::string, std::string>, uint32_t> Completions;
+
+bool ReadCompletions(const char *path, Completions *entries) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    char line[1024];
+    int skipped = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        unsigned long frequency = 1;
+        char *tab = strchr(line, '\t');
+        if (tab) {
+            *tab = '\0';
+            frequency = strtoul(tab + 1, nullptr, 10);
+        }
+        if (line[0] == '\0' || !g_utf8_validate(line, -1, nullptr)) {
+            skipped++;
+            continue;
+        }
+
+        std::pair<std::string, std::string> entry(CompletionIndex::MakeKey(line),
+                                                  CompletionIndex::Normalize(line));
+        uint32_t &score = (*entries)[entry];
+        score = (uint32_t)std::min<unsigned long>(score + frequency, UINT32_MAX);
+    }
+    fclose(file);
+
+    if (skipped) {
+        fprintf(stderr, "%s: skipped %d lines\n", path, skipped);
+    }
+    return true;
+}
+
+int BuildCompletion(const char *words, const char *out) {
+    Completions entries;
+    if (!ReadCompletions(words, &entries) || entries.empty()) {
+        return 1;
+    }
+
+    std::vector<uint32_t> key_offset;
+    std::vector<uint32_t> word_offset;
+    std::vector<uint32_t> score;
+    std::string keys;
+    std::string text;
+    for (const Completions::value_type &entry : entries) {
+        key_offset.push_back(keys.size());
+        word_offset.push_back(text.size());
+        score.push_back(entry.second);
+        keys += entry.first.first;
+        text += entry.first.second;
+    }
+    key_offset.push_back(keys.size());
+    word_offset.push_back(text.size());
+
+    // Inner node i plays off the best entries of nodes 2i and 2i + 1; on a
+    // tie the first key wins.
+    const uint32_t count = entries.size();
+    uint32_t leaf_count = 1;
+    while (leaf_count < count) {
+        leaf_count *= 2;
+    }
+    std::vector<uint32_t> best(leaf_count, kCompletionNone);
+    for (uint32_t node = leaf_count - 1; node > 0; node--) {
+        uint32_t winner = kCompletionNone;
+        for (uint32_t child = 2 * node; child <= 2 * node + 1; child++) {
+            uint32_t entry = child >= leaf_count ? child - leaf_count : best[child];
+            if (entry < count && (winner == kCompletionNone || score[entry] > score[winner])) {
+                winner = entry;
+            }
+        }
+        best[node] = winner;
+    }
+
+    CompletionHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kCompletionMagic, sizeof(header.magic));
+    header.entry_count = count;
+    header.leaf_count = leaf_count;
+    header.key_size = keys.size();
+    header.word_size = text.size();
+
+    FILE *file = fopen(out, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&key_offset[0], sizeof(uint32_t), key_offset.size(), file);
+    fwrite(&word_offset[0], sizeof(uint32_t), word_offset.size(), file);
+    fwrite(&score[0], sizeof(uint32_t), score.size(), file);
+    fwrite(&best[0], sizeof(uint32_t), best.size(), file);
+    fwrite(keys.data(), 1, keys.size(), file);
+    fwrite(text.data(), 1, text.size(), file);
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+
+    printf("%u entries, %zu + %zu bytes of keys and words\n",
+           count, keys.size(), text.size());
+    return ok ? 0 : 1;
+}
+
+// Completes every prefix, one character more at a time, of the first
+// words of the list, the way the engine does per key, and reports the time
+// per query.
+int BenchCompletion(const char *index_path, const char *words) {
+    const size_t kWords = 20000;
+    const size_t kCandidates = 10;
+
+    CompletionIndex index;
+    if (!index.Load(index_path)) {
+        fprintf(stderr, "cannot load %s\n", index_path);
+        return 1;
+    }
+
+    Completions entries;
+    if (!ReadCompletions(words, &entries) || entries.empty()) {
+        return 1;
+    }
+    // Every step'th word, to spread the queries over the whole index.
+    std::vector<std::string> typed;
+    size_t step = std::max<size_t>(1, entries.size() / kWords);
+    size_t i = 0;
+    for (const Completions::value_type &entry : entries) {
+        if (i++ % step == 0) {
+            typed.push_back(entry.first.second);
+        }
+    }
+
+    std::vector<CompletionIndex::Candidate> candidates;
+    std::vector<uint64_t> times;
+    uint64_t found = 0;
+    for (const std::string &word : typed) {
+        for (const char *p = g_utf8_next_char(word.c_str()); ; p = g_utf8_next_char(p)) {
+            const std::string prefix(word.c_str(), p);
+            uint64_t start = NowNs();
+            index.Complete(prefix.c_str(), kCandidates, &candidates);
+            times.push_back(NowNs() - start);
+            found += candidates.size();
+            if (*p == '\0') {
+                break;
+            }
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    uint64_t total = 0;
+    size_t over_budget = 0;
+    for (uint64_t t : times) {
+        total += t;
+        over_budget += t > 1000000;
+    }
+    printf("%zu entries, %zu queries, %.1f candidates per query, "
+           "mean %.2f us, p99 %.2f us, max %.2f us, %zu over 1 ms\n",
+           index.size(), times.size(), (double)found / times.size(),
+           total / 1e3 / times.size(), times[times.size() * 99 / 100] / 1e3,
+           times.back() / 1e3, over_budget);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 4 && !strcmp(argv[1], "build")) {
+        return Build(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "bench")) {
+        return Bench(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "bloom")) {
+        return BuildBloom(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "bench-bloom")) {
+        return BenchBloom(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "complete")) {
+        return BuildCompletion(argv[2], argv[3]);
+    }
+    if (argc == 4 && !strcmp(argv[1], "bench-complete")) {
+        return BenchCompletion(argv[2], argv[3]);
+    }
+    fprintf(stderr, "usage: %s build WORDLIST DICT\n"
+                    "       %s bench DICT WORDLIST\n"
+                    "       %s bloom WORDLIST FILTER\n"
+                    "       %s bench-bloom FILTER WORDLIST\n"
+                    "       %s complete WORDLIST INDEX\n"
+                    "       %s bench-complete INDEX WORDLIST\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,385 @@
+// Replays key traces through UnikeyWrapper with a stand-in IBusEngine, so
+// the whole key path of the IBus layer (libunikey, preedit buffer, IBusText
+// construction, preedit and commit calls) can be timed on a machine without
+// ibus-daemon or a display. See headless_ibus.cpp for the stand-in.
+//
+// A trace has one key per line, "keyval [modifiers]", both numbers in any
+// base strtoul accepts; blank lines and lines starting with '#' are skipped.
+// --text types a string instead, one press per character.
+//
+//   ibus-unikey-headless-driver [options] trace-file
+//   ibus-unikey-headless-driver [options] --text "tieengs vieetj "
+//
+// The keys the engine lets through reach the committed text the way they
+// would reach an application. The driver never reads or writes the data of
+// the user: data files come from --data DIR only, and restore exceptions
+// are kept in a temporary directory removed at exit.
+//
+// Options: --vni, --repeat N, --print (the committed text), --data DIR (the
+// directory of the data files, see UnikeyWrapper::SetUp), --dict FILE and
+// --foreign FILE (spell check data, see ibus-unikey-dict), --complete FILE
+// (word completion index), --no-latency (KeyLatency off, as the engine
+// starts; the driver turns it on otherwise, so the time per key against a
+// run with it is what the timing costs when asked for), --no-log (log
+// level off at run time; builds with debug logging compiled in log every
+// key otherwise, as UnikeyEngine::ProcessKeyEvent does). A tab in --text
+// is the Tab key.
+//
+// Every kKeysPerLogFlush keys the driver waits for the drain thread of the
+// log to write out what the keys logged, as it does between keys typed by
+// hand. The time per key leaves that out; it is given apart, with the log
+// written out, which on one core is what logging costs in all.
+//
+// The driver gives the time to the first key handled, from main() and from
+// UnikeyWrapper::SetUp, and when it was on CLOCK_MONOTONIC so that a
+// launcher can take it from exec. The main loop is then let run until
+// idle, which loads the data files as it does in the engine, and the time
+// that took is given too; the files of --dict, --foreign and --complete
+// are loaded after them.
+//
+// The driver counts the allocations the key path makes on its thread (with
+// glibc, whose malloc it wraps), over all keys and over the keys after the
+// first pass through the trace, when everything is warmed up. Those of the
+// IBusText each preedit and commit call takes are counted apart: the
+// driver fails if the keys after the first pass make any other, so run it
+// with --repeat 2 or more to check the key path.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <ibus.h>
+#include <glib/gstdio.h>
+
+#include "headless_ibus.h"
+#include "base/logging.h"
+#include "base/singleton.h"
+#include "unix/ibus/key_latency.h"
+#include "unix/ibus/unikey_wrapper.h"
+#include "third_party/libunikey/unikey.h"
+
+
+// Allocations made on this thread while counting is on.
+thread_local bool t_counting = false;
+thread_local uint64_t t_allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+    if (t_counting) {
+        t_allocations++;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (t_counting) {
+        t_allocations++;
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (t_counting) {
+        t_allocations++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+}  // extern "C"
+#endif  // __GLIBC__
+
+namespace {
+
+// At a few log statements a key, well within a ring of the log
+const int kKeysPerLogFlush = 64;
+
+struct Key {
+    guint keyval;
+    guint modifiers;
+};
+
+bool ReadTrace(const char *path, std::vector<Key> *keys) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+
+        char *end;
+        Key key;
+        key.keyval = strtoul(p, &end, 0);
+        if (end == p) {
+            fprintf(stderr, "%s:%d: bad keyval\n", path, number);
+            fclose(file);
+            return false;
+        }
+        key.modifiers = strtoul(end, nullptr, 0);
+        keys->push_back(key);
+    }
+    fclose(file);
+    return true;
+}
+
+// Printable ASCII keyvals are the characters themselves.
+void TextToTrace(const char *text, std::vector<Key> *keys) {
+    for (const char *p = text; *p; p++) {
+        Key key;
+        if (*p == '\n') {
+            key.keyval = IBUS_Return;
+        } else if (*p == '\t') {
+            key.keyval = IBUS_Tab;
+        } else {
+            key.keyval = (guchar)*p;
+        }
+        key.modifiers = (*p >= 'A' && *p <= 'Z') ? IBUS_SHIFT_MASK : 0;
+        keys->push_back(key);
+    }
+}
+
+// What an application does with a key the engine did not take.
+void PassThrough(const Key &key, std::string *text) {
+    if (key.keyval == IBUS_BackSpace) {
+        while (!text->empty() && ((guchar)text->back() & 0xC0) == 0x80) {
+            text->pop_back();
+        }
+        if (!text->empty()) {
+            text->pop_back();
+        }
+    } else if (key.keyval == IBUS_Return) {
+        *text += '\n';
+    } else if (key.keyval == IBUS_Tab) {
+        *text += '\t';
+    } else if (key.keyval >= IBUS_space && key.keyval <= IBUS_asciitilde) {
+        *text += (char)key.keyval;
+    }
+}
+
+// Loads the files given on the command line over those of the data
+// directory, returns the one that cannot be loaded if any.
+const char *LoadFiles(UnikeyWrapper *wrapper, const char *dict,
+                      const char *foreign, const char *complete) {
+    if (dict && !UnikeyLoadDictionary(dict)) {
+        return dict;
+    }
+    if (foreign && !UnikeyLoadForeignFilter(foreign)) {
+        return foreign;
+    }
+    if (complete && !wrapper->LoadCompletion(complete)) {
+        return complete;
+    }
+    return nullptr;
+}
+
+// Stops the wrapper and removes the temporary directory it kept its files
+// in.
+void CleanUp(UnikeyWrapper *wrapper, gchar *temp_dir, gchar *restore_log) {
+    wrapper->CleanUp();
+    g_remove(restore_log);
+    g_rmdir(temp_dir);
+    g_free(restore_log);
+    g_free(temp_dir);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    uint64_t main_start = KeyLatency::Now();
+    int repeat = 1;
+    bool vni = false;
+    bool print = false;
+    bool timed = true;
+    bool logged = true;
+    const char *text = nullptr;
+    const char *trace = nullptr;
+    const char *data = nullptr;
+    const char *dict = nullptr;
+    const char *foreign = nullptr;
+    const char *complete = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--text") && i + 1 < argc) {
+            text = argv[++i];
+        } else if (!strcmp(argv[i], "--data") && i + 1 < argc) {
+            data = argv[++i];
+        } else if (!strcmp(argv[i], "--dict") && i + 1 < argc) {
+            dict = argv[++i];
+        } else if (!strcmp(argv[i], "--foreign") && i + 1 < argc) {
+            foreign = argv[++i];
+        } else if (!strcmp(argv[i], "--complete") && i + 1 < argc) {
+            complete = argv[++i];
+        } else if (!strcmp(argv[i], "--vni")) {
+            vni = true;
+        } else if (!strcmp(argv[i], "--print")) {
+            print = true;
+        } else if (!strcmp(argv[i], "--no-latency")) {
+            timed = false;
+        } else if (!strcmp(argv[i], "--no-log")) {
+            logged = false;
+        } else {
+            trace = argv[i];
+        }
+    }
+    if ((text == nullptr) == (trace == nullptr) || repeat <= 0) {
+        fprintf(stderr, "usage: %s [--vni] [--repeat N] [--print] [--no-latency] [--no-log] [--data DIR] [--dict FILE] [--foreign FILE] [--complete FILE] (--text STRING | trace-file)\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Key> keys;
+    if (text) {
+        TextToTrace(text, &keys);
+    } else if (!ReadTrace(trace, &keys)) {
+        return 1;
+    }
+
+    // Never registered with GType, only its address is passed around.
+    IBusEngine *engine = g_new0(IBusEngine, 1);
+    UnikeyWrapper *wrapper = Singleton<UnikeyWrapper>::get();
+    KeyLatency *latency = Singleton<KeyLatency>::get();
+    HeadlessCalls *calls = GetHeadlessCalls();
+
+    gchar *temp_dir = g_dir_make_tmp("ibus-unikey-driver-XXXXXX", nullptr);
+    if (temp_dir == nullptr) {
+        fprintf(stderr, "cannot make a temporary directory\n");
+        g_free(engine);
+        return 1;
+    }
+    gchar *restore_log = g_build_filename(temp_dir, "restore-exceptions.txt", nullptr);
+    uint64_t setup_start = KeyLatency::Now();
+    wrapper->SetUp(data ? data : temp_dir, restore_log);
+    if (vni) {
+        wrapper->SetInputMethod(InputMethod::VNI);
+    }
+    calls->Clear();
+    // What the stand-in records must not count as allocations of the key
+    // path: a key commits a few characters at most.
+    calls->committed.reserve(keys.size() * repeat * 16);
+    calls->preedit_text.reserve(256);
+    latency->SetEnabled(timed);
+    if (!logged) {
+        unikey::Logger::set_level(spdlog::level::off);
+    }
+
+    uint64_t handled = 0;
+    uint64_t first_key = 0;
+    uint64_t data_loaded = 0;
+    const char *missing = nullptr;
+    uint64_t text_allocations = 0;
+    uint64_t warm_allocations = 0;
+    uint64_t warm_text_allocations = 0;
+    int since_flush = 0;
+    uint64_t flushing = 0;
+    uint64_t start = KeyLatency::Now();
+    for (int r = 0; r < repeat; r++) {
+        if (r == 1) {
+            warm_allocations = t_allocations;
+            warm_text_allocations = text_allocations;
+        }
+        for (const Key &key : keys) {
+            latency->BeginKey();
+            uint64_t text_before = calls->text_allocations;
+            t_counting = true;
+            BLOG_DEBUG("keyval: {}, keycode: {}, modifiers:  {}", key.keyval, 0, key.modifiers);
+            gboolean taken = wrapper->ProcessKeyEvent(engine, key.keyval, 0, key.modifiers);
+            t_counting = false;
+            text_allocations += calls->text_allocations - text_before;
+            if (taken) {
+                handled++;
+            } else {
+                PassThrough(key, &calls->committed);
+            }
+            latency->EndKey();
+            if (++since_flush == kKeysPerLogFlush) {
+                // Keys come slower than this in use, and the drain thread
+                // of the log keeps up: let it, outside the time per key.
+                uint64_t flush_start = KeyLatency::Now();
+                unikey::Logger::flush();
+                flushing += KeyLatency::Now() - flush_start;
+                since_flush = 0;
+            }
+            if (first_key == 0) {
+                // The main loop is idle after the first key: the wrapper
+                // loads its data files, then come those given here.
+                first_key = KeyLatency::Now();
+                while (g_main_context_iteration(nullptr, FALSE)) {
+                }
+                missing = LoadFiles(wrapper, dict, foreign, complete);
+                data_loaded = KeyLatency::Now();
+                if (missing) {
+                    break;
+                }
+            }
+        }
+        if (missing) {
+            break;
+        }
+        wrapper->Reset(engine);
+    }
+    uint64_t elapsed = KeyLatency::Now() - start - (data_loaded - first_key) - flushing;
+    if (missing) {
+        fprintf(stderr, "cannot load %s\n", missing);
+        CleanUp(wrapper, temp_dir, restore_log);
+        g_free(engine);
+        return 1;
+    }
+
+    if (print) {
+        printf("%s\n", calls->committed.c_str());
+    }
+
+    uint64_t total = (uint64_t)keys.size() * repeat;
+    printf("keys %" PRIu64 " handled %" PRIu64 " %.1f ns/key, %.1f with the log written out\n",
+           total, handled, total ? (double)elapsed / total : 0.0,
+           total ? (double)(elapsed + flushing) / total : 0.0);
+    printf("first key after %.2f ms from main(), %.2f ms from SetUp; done at %" PRIu64
+           " ns CLOCK_MONOTONIC\n",
+           (first_key - main_start) / 1e6, (first_key - setup_start) / 1e6, first_key);
+    printf("data files loaded %.2f ms after it\n", (data_loaded - first_key) / 1e6);
+    uint64_t warm_keys = total - keys.size();
+    uint64_t warm_other = (t_allocations - warm_allocations) -
+                          (text_allocations - warm_text_allocations);
+    printf("allocations %.2f/key (IBusText %.2f/key)",
+           total ? (double)t_allocations / total : 0.0,
+           total ? (double)text_allocations / total : 0.0);
+    if (repeat > 1) {
+        printf(", after the first pass %.2f/key (IBusText %.2f/key)",
+               (double)(t_allocations - warm_allocations) / warm_keys,
+               (double)(text_allocations - warm_text_allocations) / warm_keys);
+    }
+    printf("\n");
+    printf("calls preedit %" PRIu64 " commit %" PRIu64 " hide %" PRIu64
+           " text_new %" PRIu64 " lookup_table %" PRIu64 "\n",
+           calls->preedit, calls->commit, calls->hide, calls->text_new,
+           calls->lookup_table);
+    latency->Write(stdout);
+
+    CleanUp(wrapper, temp_dir, restore_log);
+    g_free(engine);
+    if (repeat > 1 && warm_other > 0) {
+        fprintf(stderr, "%" PRIu64 " allocations after the first pass besides IBusText\n",
+                warm_other);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Stand-in for the few libibus and GObject entry points the IBus layer calls,
+// so that UnikeyWrapper runs without ibus-daemon or a display. Texts,
+// attributes and lookup tables are plain zeroed structs: nothing here goes
+// through the GObject type system, so the driver must not link libibus or
+// libgobject.
+
+#include "headless_ibus.h"
+
+#include <ibus.h>
+
+
+namespace {
+
+HeadlessCalls g_calls;
+
+// Texts handed to the engine are floating and owned by the callee, as with
+// libibus, so they are released once recorded.
+void FreeText(IBusText *text) {
+    if (!text->is_static) {
+        g_free(text->text);
+    }
+    g_free(text);
+}
+
+}  // namespace
+
+
+void HeadlessCalls::Clear() {
+    preedit = 0;
+    commit = 0;
+    hide = 0;
+    text_new = 0;
+    text_allocations = 0;
+    lookup_table = 0;
+    preedit_text.clear();
+    committed.clear();
+}
+
+HeadlessCalls *GetHeadlessCalls() {
+    return &g_calls;
+}
+
+
+IBusText *ibus_text_new_from_static_string(const gchar *str) {
+    IBusText *text = g_new0(IBusText, 1);
+    text->is_static = TRUE;
+    text->text = const_cast<gchar*>(str);
+    g_calls.text_new++;
+    g_calls.text_allocations++;
+    return text;
+}
+
+IBusText *ibus_text_new_from_string(const gchar *str) {
+    IBusText *text = g_new0(IBusText, 1);
+    text->text = g_strdup(str);
+    g_calls.text_new++;
+    g_calls.text_allocations += 2;
+    return text;
+}
+
+guint ibus_text_get_length(IBusText *text) {
+    return g_utf8_strlen(text->text, -1);
+}
+
+void ibus_text_set_attributes(IBusText *text, IBusAttrList *attrs) {
+    text->attrs = attrs;
+}
+
+IBusAttrList *ibus_attr_list_new() {
+    return g_new0(IBusAttrList, 1);
+}
+
+void ibus_attr_list_append(IBusAttrList *attr_list, IBusAttribute *attr) {
+}
+
+IBusAttribute *ibus_attr_underline_new(guint underline_type,
+                                       guint start_index,
+                                       guint end_index) {
+    IBusAttribute *attr = g_new0(IBusAttribute, 1);
+    attr->type = IBUS_ATTR_TYPE_UNDERLINE;
+    attr->value = underline_type;
+    attr->start_index = start_index;
+    attr->end_index = end_index;
+    return attr;
+}
+
+// Candidates are kept in a GArray of texts, as in libibus; only the cursor
+// moves and the candidates themselves are modelled.
+IBusLookupTable *ibus_lookup_table_new(guint page_size,
+                                       guint cursor_pos,
+                                       gboolean cursor_visible,
+                                       gboolean round) {
+    IBusLookupTable *table = g_new0(IBusLookupTable, 1);
+    table->page_size = page_size;
+    table->cursor_pos = cursor_pos;
+    table->cursor_visible = cursor_visible;
+    table->round = round;
+    table->candidates = g_array_new(FALSE, TRUE, sizeof(IBusText*));
+    return table;
+}
+
+void ibus_lookup_table_clear(IBusLookupTable *table) {
+    for (guint i = 0; i < table->candidates->len; i++) {
+        FreeText(g_array_index(table->candidates, IBusText*, i));
+    }
+    g_array_set_size(table->candidates, 0);
+    table->cursor_pos = 0;
+}
+
+void ibus_lookup_table_append_candidate(IBusLookupTable *table, IBusText *text) {
+    g_array_append_vals(table->candidates, &text, 1);
+}
+
+guint ibus_lookup_table_get_number_of_candidates(IBusLookupTable *table) {
+    return table->candidates->len;
+}
+
+guint ibus_lookup_table_get_cursor_pos(IBusLookupTable *table) {
+    return table->cursor_pos;
+}
+
+guint ibus_lookup_table_get_page_size(IBusLookupTable *table) {
+    return table->page_size;
+}
+
+gboolean ibus_lookup_table_cursor_up(IBusLookupTable *table) {
+    if (table->cursor_pos == 0) {
+        return FALSE;
+    }
+    table->cursor_pos--;
+    return TRUE;
+}
+
+gboolean ibus_lookup_table_cursor_down(IBusLookupTable *table) {
+    if (table->cursor_pos + 1 >= table->candidates->len) {
+        return FALSE;
+    }
+    table->cursor_pos++;
+    return TRUE;
+}
+
+gboolean ibus_lookup_table_page_up(IBusLookupTable *table) {
+    if (table->cursor_pos < table->page_size) {
+        return FALSE;
+    }
+    table->cursor_pos -= table->page_size;
+    return TRUE;
+}
+
+gboolean ibus_lookup_table_page_down(IBusLookupTable *table) {
+    guint next_page = (table->cursor_pos / table->page_size + 1) * table->page_size;
+    if (next_page >= table->candidates->len) {
+        return FALSE;
+    }
+    table->cursor_pos = MIN(table->cursor_pos + table->page_size,
+                            table->candidates->len - 1);
+    return TRUE;
+}
+
+void ibus_engine_update_lookup_table(IBusEngine *engine,
+                                     IBusLookupTable *table,
+                                     gboolean visible) {
+    g_calls.lookup_table++;
+}
+
+void ibus_engine_hide_lookup_table(IBusEngine *engine) {
+    g_calls.lookup_table++;
+}
+
+void ibus_engine_commit_text(IBusEngine *engine, IBusText *text) {
+    g_calls.commit++;
+    g_calls.committed += text->text;
+    FreeText(text);
+}
+
+void ibus_engine_hide_preedit_text(IBusEngine *engine) {
+    g_calls.hide++;
+    g_calls.preedit_text.clear();
+}
+
+void ibus_engine_update_preedit_text_with_mode(IBusEngine *engine,
+                                               IBusText *text,
+                                               guint cursor_pos,
+                                               gboolean visible,
+                                               IBusPreeditFocusMode mode) {
+    g_calls.preedit++;
+    if (visible) {
+        g_calls.preedit_text = text->text;
+    } else {
+        g_calls.preedit_text.clear();
+    }
+    FreeText(text);
+}
+
+// The shared attribute list of the wrapper lives as long as the process.
+gpointer (g_object_ref_sink)(gpointer object) {
+    return object;
+}
+
+void (g_object_unref)(gpointer object) {
+}
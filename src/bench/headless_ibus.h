@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// What the IBus layer asked of the engine it was given. The stand-in
+// functions in headless_ibus.cpp fill it in place of libibus.
+struct HeadlessCalls {
+    uint64_t preedit;
+    uint64_t commit;
+    uint64_t hide;
+    uint64_t text_new;
+    // Allocations of the text_new calls. libibus sinks the floating
+    // reference of a new IBusText in every call taking one, so the engine
+    // cannot keep them across keys.
+    uint64_t text_allocations;
+    uint64_t lookup_table;  // updates and hides of the lookup table
+
+    std::string preedit_text;  // last preedit shown, empty when hidden
+    std::string committed;     // everything committed so far
+
+    void Clear();
+};
+
+HeadlessCalls *GetHeadlessCalls();
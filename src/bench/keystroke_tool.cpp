@@ -0,0 +1,460 @@
+// Turns UTF-8 Vietnamese text into the keys typed for it (see
+// ukkeystroke.h), to make key stroke corpora of real text for the engine
+// benchmarks and the headless driver.
+//
+// Reads stdin and writes the keys to stdout, one line of keys per line of
+// text. The input is cut at line ends into one part per thread; part i is
+// randomised with seed + i, so the output does not depend on the thread
+// count only when nothing is random.
+//
+// --bench writes the keys of stdin over and over for a second and reports
+// the throughput instead. --check types the keys into libunikey, set up as
+// the IBus engine sets it up, and reports the words that come back as they
+// were in the text. --replay types them over and over for a second and
+// reports the time per key, with the instructions and L1 data cache misses
+// per key when the kernel lets us count them; --no-spell-check turns spell
+// check off for both. --filter loads a foreign word filter made by
+// ibus-unikey-dict for both: syllables must still come back when their
+// keys are in it, e.g. "cả á má bố" with "car as mas boos" in the filter.
+// --learn KEYS, which may be given more than once, teaches libunikey the
+// word typed with KEYS as if the user had restored it (see
+// UnikeyAddLearnedWord); --check then expects the words typed with them
+// back as typed, e.g. "car" for "cả" with --learn car.
+//
+//   ibus-unikey-keystrokes [--im telex|vni|stelex|stelex2]
+//       [--tone end|vowel|random] [--mark letter|end|random] [--seed N]
+//       [--threads N] [--no-spell-check] [--filter FILE] [--learn KEYS]
+//       [--bench | --check | --replay] < text.txt
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "third_party/libunikey/ukkeystroke.h"
+#include "third_party/libunikey/unikey.h"
+#include "third_party/libunikey/vnconv.h"
+
+
+namespace {
+
+struct Name {
+    const char *name;
+    int value;
+};
+
+const Name kMethods[] = {
+    {"telex",   UkTelex},
+    {"vni",     UkVni},
+    {"stelex",  UkSimpleTelex},
+    {"stelex2", UkSimpleTelex2},
+};
+
+const Name kTonePlaces[] = {
+    {"end",    UkKeyStrokeWriter::ToneAtWordEnd},
+    {"vowel",  UkKeyStrokeWriter::ToneAfterVowel},
+    {"random", UkKeyStrokeWriter::ToneRandom},
+};
+
+const Name kMarkPlaces[] = {
+    {"letter", UkKeyStrokeWriter::MarkAfterLetter},
+    {"end",    UkKeyStrokeWriter::MarkAtWordEnd},
+    {"random", UkKeyStrokeWriter::MarkRandom},
+};
+
+template <size_t N>
+bool Lookup(const Name (&names)[N], const char *name, int *value) {
+    for (size_t i = 0; i < N; i++) {
+        if (!strcmp(names[i].name, name)) {
+            *value = names[i].value;
+            return true;
+        }
+    }
+    fprintf(stderr, "unknown value %s\n", name);
+    return false;
+}
+
+struct Options {
+    int im = UkTelex;
+    int tone = UkKeyStrokeWriter::ToneAtWordEnd;
+    int mark = UkKeyStrokeWriter::MarkAfterLetter;
+    uint32_t seed = 1;
+    int threads = 1;
+    bool spell_check = true;
+    const char *filter = nullptr;
+    std::vector<std::string> learned;
+};
+
+bool ReadAll(FILE *file, std::string *text) {
+    char buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text->append(buf, len);
+    }
+    return !ferror(file);
+}
+
+// Cuts text after a line end into at most |parts| pieces of about the same
+// size.
+std::vector<size_t> SplitLines(const std::string &text, int parts) {
+    std::vector<size_t> cuts(1, 0);
+    for (int i = 1; i < parts; i++) {
+        size_t pos = text.find('\n', std::max(cuts.back(), text.size() * i / parts));
+        if (pos == std::string::npos) {
+            break;
+        }
+        cuts.push_back(pos + 1);
+    }
+    cuts.push_back(text.size());
+    return cuts;
+}
+
+void WriteParallel(const Options &options, const std::string &text,
+                   std::vector<std::string> *parts) {
+    std::vector<size_t> cuts = SplitLines(text, options.threads);
+    parts->resize(cuts.size() - 1);
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < cuts.size(); i++) {
+        workers.push_back(std::thread([&options, &text, &cuts, parts, i] {
+            UkKeyStrokeWriter writer;
+            writer.init((UkInputMethod)options.im);
+            writer.setPlaces((UkKeyStrokeWriter::TonePlace)options.tone,
+                             (UkKeyStrokeWriter::MarkPlace)options.mark);
+            writer.setSeed(options.seed + i);
+
+            std::string &keys = (*parts)[i];
+            keys.clear();
+            keys.reserve((cuts[i + 1] - cuts[i]) * 5 / 4);
+            writer.write(text.data() + cuts[i], cuts[i + 1] - cuts[i], keys);
+        }));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int Bench(const Options &options, const std::string &text) {
+    std::vector<std::string> parts;
+    uint64_t in_bytes = 0;
+    uint64_t out_bytes = 0;
+    uint64_t start = NowNs();
+    uint64_t elapsed;
+    do {
+        WriteParallel(options, text, &parts);
+        in_bytes += text.size();
+        for (const std::string &part : parts) {
+            out_bytes += part.size();
+        }
+        elapsed = NowNs() - start;
+    } while (elapsed < 1000000000);
+
+    double mb_per_s = in_bytes / 1e6 / (elapsed / 1e9);
+    printf("%zu bytes of text, %d threads, %.1f MB/s of text (%.1f MB/s per thread), "
+           "%.2f keys per byte\n",
+           text.size(), options.threads, mb_per_s, mb_per_s / options.threads,
+           (double)out_bytes / in_bytes);
+    return 0;
+}
+
+// Types |keys| the way UnikeyWrapper does, committing at anything that is
+// not a printable ASCII key.
+std::string Type(const std::string &keys) {
+    std::string out;
+    for (unsigned char key : keys) {
+        if (key < 0x20 || key >= 0x7F) {
+            out += key;
+            UnikeyResetBuf();
+            continue;
+        }
+
+        UnikeySetCapsState(key >= 'A' && key <= 'Z', 0);
+        UnikeyFilter(key);
+        for (int i = 0; i < UnikeyBackspaces && !out.empty(); i++) {
+            // one UTF-8 character
+            while (!out.empty() && ((unsigned char)out.back() & 0xC0) == 0x80) {
+                out.pop_back();
+            }
+            if (!out.empty()) {
+                out.pop_back();
+            }
+        }
+        if (UnikeyBufChars > 0) {
+            out.append((const char *)UnikeyBuf, UnikeyBufChars);
+        } else {
+            out += key;
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> SplitBlanks(const std::string &line) {
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while ((pos = line.find_first_not_of(" \t", pos)) != std::string::npos) {
+        size_t end = line.find_first_of(" \t", pos);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        words.push_back(line.substr(pos, end - pos));
+        pos = end;
+    }
+    return words;
+}
+
+bool SetUpUnikey(const Options &options) {
+    UnikeySetup();
+    if (options.filter != nullptr && !UnikeyLoadForeignFilter(options.filter)) {
+        fprintf(stderr, "cannot load foreign filter %s\n", options.filter);
+        UnikeyCleanup();
+        return false;
+    }
+    UnikeyOptions unikey_options;
+    UnikeyGetOptions(&unikey_options);
+    unikey_options.spellCheckEnabled = options.spell_check;
+    unikey_options.autoNonVnRestore = 1;
+    unikey_options.modernStyle = 0;
+    unikey_options.freeMarking = 1;
+    unikey_options.macroEnabled = 0;
+    UnikeySetOptions(&unikey_options);
+    UnikeySetInputMethod((UkInputMethod)options.im);
+    UnikeySetOutputCharset(CONV_CHARSET_XUTF8);
+    for (const std::string &keys : options.learned) {
+        UnikeyResetBuf();
+        Type(keys);
+        UnikeyAddLearnedWord(UnikeyLastWordKeyHash());
+    }
+    UnikeyResetBuf();
+    return true;
+}
+
+int Check(const Options &options, const std::string &text) {
+    if (!SetUpUnikey(options)) {
+        return 1;
+    }
+
+    UkKeyStrokeWriter writer;
+    writer.init((UkInputMethod)options.im);
+    writer.setPlaces((UkKeyStrokeWriter::TonePlace)options.tone,
+                     (UkKeyStrokeWriter::MarkPlace)options.mark);
+    writer.setSeed(options.seed);
+
+    size_t words = 0;
+    size_t right = 0;
+    int shown = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::string keys;
+        writer.write(line.data(), line.size(), keys);
+        UnikeyResetBuf();
+        const std::string typed = Type(keys);
+
+        std::vector<std::string> expected = SplitBlanks(line);
+        std::vector<std::string> got = SplitBlanks(typed);
+        std::vector<std::string> key_words = SplitBlanks(keys);
+        words += expected.size();
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (i < key_words.size() &&
+                std::find(options.learned.begin(), options.learned.end(),
+                          key_words[i]) != options.learned.end()) {
+                expected[i] = key_words[i];
+            }
+            if (i < got.size() && got[i] == expected[i]) {
+                right++;
+            } else if (shown < 20) {
+                shown++;
+                fprintf(stderr, "%s -> %s -> %s\n", expected[i].c_str(),
+                        i < key_words.size() ? key_words[i].c_str() : "",
+                        i < got.size() ? got[i].c_str() : "");
+            }
+        }
+    }
+    UnikeyCleanup();
+
+    printf("%zu words, %zu typed back right (%.2f%%)\n",
+           words, right, words ? 100.0 * right / words : 0.0);
+    return right == words ? 0 : 1;
+}
+
+// A hardware counter of this thread, see perf_event_open(2).
+class EventCounter {
+public:
+    EventCounter(uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~EventCounter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Start() {
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    int64_t Stop() {
+        uint64_t count;
+        if (fd_ < 0) {
+            return -1;
+        }
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+int Replay(const Options &options, const std::string &text) {
+    std::vector<std::string> parts;
+    WriteParallel(options, text, &parts);
+    std::string keys;
+    for (const std::string &part : parts) {
+        keys += part;
+    }
+
+    EventCounter instructions(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    EventCounter l1d_misses(PERF_TYPE_HW_CACHE,
+                            PERF_COUNT_HW_CACHE_L1D |
+                            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    if (!SetUpUnikey(options)) {
+        return 1;
+    }
+    Type(keys);  // warm up
+    uint64_t count = 0;
+    uint64_t start = NowNs();
+    uint64_t elapsed;
+    instructions.Start();
+    l1d_misses.Start();
+    do {
+        UnikeyResetBuf();
+        Type(keys);
+        count += keys.size();
+        elapsed = NowNs() - start;
+    } while (elapsed < 1000000000);
+    const int64_t instruction_count = instructions.Stop();
+    const int64_t miss_count = l1d_misses.Stop();
+    UnikeyCleanup();
+
+    printf("%zu keys, %.1f ns per key", keys.size(), (double)elapsed / count);
+    if (instruction_count >= 0) {
+        printf(", %.1f instructions", (double)instruction_count / count);
+    }
+    if (miss_count >= 0) {
+        printf(", %.3f L1d misses", (double)miss_count / count);
+    }
+    printf("\n");
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    bool bench = false;
+    bool check = false;
+    bool replay = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+        if (!strcmp(argv[i], "--im") && i + 1 < argc) {
+            ok = Lookup(kMethods, argv[++i], &options.im);
+        } else if (!strcmp(argv[i], "--tone") && i + 1 < argc) {
+            ok = Lookup(kTonePlaces, argv[++i], &options.tone);
+        } else if (!strcmp(argv[i], "--mark") && i + 1 < argc) {
+            ok = Lookup(kMarkPlaces, argv[++i], &options.mark);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            options.seed = strtoul(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--bench")) {
+            bench = true;
+        } else if (!strcmp(argv[i], "--check")) {
+            check = true;
+        } else if (!strcmp(argv[i], "--replay")) {
+            replay = true;
+        } else if (!strcmp(argv[i], "--no-spell-check")) {
+            options.spell_check = false;
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--learn") && i + 1 < argc) {
+            options.learned.push_back(argv[++i]);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "usage: %s [--im telex|vni|stelex|stelex2] "
+                            "[--tone end|vowel|random] [--mark letter|end|random] "
+                            "[--seed N] [--threads N] [--no-spell-check] "
+                            "[--filter FILE] [--learn KEYS] "
+                            "[--bench | --check | --replay] < text\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    UkKeyStrokeWriter writer;
+    if (!writer.init((UkInputMethod)options.im)) {
+        fprintf(stderr, "no keys for this input method\n");
+        return 1;
+    }
+
+    std::string text;
+    if (!ReadAll(stdin, &text)) {
+        return 1;
+    }
+    if (bench) {
+        return Bench(options, text);
+    }
+    if (check) {
+        return Check(options, text);
+    }
+    if (replay) {
+        return Replay(options, text);
+    }
+
+    std::vector<std::string> parts;
+    WriteParallel(options, text, &parts);
+    for (const std::string &part : parts) {
+        fwrite(part.data(), 1, part.size(), stdout);
+    }
+    return 0;
+}
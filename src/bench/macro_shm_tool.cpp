@@ -0,0 +1,70 @@
+// Manages the shared images of system macro tables (see ukshm.h and
+// CMacroTable::loadSharedFile). Run publish as root, from a boot or login
+// script, for the image to be shared by every user on the host; run as a
+// user, it is shared among that user's processes only.
+//
+//   ibus-unikey-macro-shm publish MACROFILE
+//   ibus-unikey-macro-shm status MACROFILE
+//   ibus-unikey-macro-shm remove MACROFILE
+
+#include <cstdio>
+#include <cstring>
+
+#include "third_party/libunikey/mactab.h"
+#include "third_party/libunikey/ukshm.h"
+
+
+namespace {
+
+int Publish(const char *path) {
+    CMacroTable table;
+    int ok = table.loadSharedFile(path);
+    if (!ok) {
+        fprintf(stderr, "cannot read %s\n", path);
+    } else if (!table.isSharedMapped()) {
+        fprintf(stderr, "cannot publish %s to shared memory\n", path);
+        ok = 0;
+    } else {
+        printf("%d macros shared\n", table.getSharedCount());
+    }
+    return ok ? 0 : 1;
+}
+
+int Status(const char *path) {
+    UkShmImage image;
+    if (!image.attach(path, UKMACRO_IMAGE_VERSION)) {
+        printf("%s: no current shared image\n", path);
+        return 1;
+    }
+    const MacroImageHeader *header = (const MacroImageHeader *)image.data();
+    printf("%s: %d macros, %ld bytes, published by %s\n", path, header->count,
+           image.size(), image.ownedByRoot() ? "root for all users" : "this user");
+    return 0;
+}
+
+int Remove(const char *path) {
+    if (!CMacroTable::removeSharedFile(path)) {
+        fprintf(stderr, "no shared image of %s to remove\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 3 && !strcmp(argv[1], "publish")) {
+        return Publish(argv[2]);
+    }
+    if (argc == 3 && !strcmp(argv[1], "status")) {
+        return Status(argv[2]);
+    }
+    if (argc == 3 && !strcmp(argv[1], "remove")) {
+        return Remove(argv[2]);
+    }
+    fprintf(stderr, "usage: %s publish MACROFILE\n"
+                    "       %s status MACROFILE\n"
+                    "       %s remove MACROFILE\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+}
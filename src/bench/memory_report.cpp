@@ -0,0 +1,265 @@
+// Reports what each libunikey subsystem adds to the memory of a process,
+// set up the way the IBus engine sets it up, for keeping engine processes
+// within a memory budget.
+//
+// Each row is what the step added, in kB: RSS, PSS (RSS with the pages
+// shared with other processes divided among them) and private pages,
+// read from /proc/self/smaps_rollup. Data files are mapped and only count
+// once their pages are touched, which the typing, restoring and
+// converting steps do with the text (a built-in sample if none is given).
+// With --budget-kb, exits with 1 if the PSS of the process ends up over it.
+//
+//   ibus-unikey-memory [--macros FILE] [--system-macros FILE] [--dict FILE]
+//       [--filter FILE] [--ngram FILE] [--text FILE] [--budget-kb N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "third_party/libunikey/ukengine.h"
+#include "third_party/libunikey/ukkeystroke.h"
+#include "third_party/libunikey/unikey.h"
+#include "third_party/libunikey/vnconv.h"
+
+
+namespace {
+
+const char kSample[] =
+    "Tiếng Việt là ngôn ngữ của người Việt và là ngôn ngữ chính thức tại "
+    "Việt Nam. Chữ Quốc ngữ dùng các chữ cái Latinh, thêm dấu thanh và dấu "
+    "phụ cho các nguyên âm: huyền, sắc, hỏi, ngã, nặng.\n"
+    "Hà Nội, Huế, Đà Nẵng, Sài Gòn; trường học, quyển sách, khuya rồi.\n";
+
+const int kCharsets[] = {
+    CONV_CHARSET_UNICODE, CONV_CHARSET_UNIREF, CONV_CHARSET_UNIREF_HEX,
+    CONV_CHARSET_UNIDECOMPOSED, CONV_CHARSET_WINCP1258, CONV_CHARSET_UNI_CSTRING,
+    CONV_CHARSET_VIQR, CONV_CHARSET_UTF8VIQR, CONV_CHARSET_TCVN3,
+    CONV_CHARSET_VPS, CONV_CHARSET_VISCII, CONV_CHARSET_BKHCM1,
+    CONV_CHARSET_VIETWAREF, CONV_CHARSET_ISC, CONV_CHARSET_VNIWIN,
+    CONV_CHARSET_BKHCM2, CONV_CHARSET_VIETWAREX, CONV_CHARSET_VNIMAC,
+};
+
+struct Usage {
+    long rss = 0;
+    long pss = 0;
+    long priv = 0;
+};
+
+bool ReadUsage(Usage *usage) {
+    FILE *file = fopen("/proc/self/smaps_rollup", "r");
+    if (file == nullptr) {
+        return false;
+    }
+    *usage = Usage();
+    char line[256];
+    long kb;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "Rss: %ld", &kb) == 1) {
+            usage->rss = kb;
+        } else if (sscanf(line, "Pss: %ld", &kb) == 1) {
+            usage->pss = kb;
+        } else if (sscanf(line, "Private_Clean: %ld", &kb) == 1 ||
+                   sscanf(line, "Private_Dirty: %ld", &kb) == 1) {
+            usage->priv += kb;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+class Report {
+public:
+    Report() {
+        ReadUsage(&first_);
+        last_ = first_;
+    }
+
+    void Row(const char *name) {
+        Usage now;
+        ReadUsage(&now);
+        printf("%-16s %8ld %8ld %8ld\n", name, now.rss - last_.rss,
+               now.pss - last_.pss, now.priv - last_.priv);
+        last_ = now;
+    }
+
+    const Usage &first() const { return first_; }
+    const Usage &last() const { return last_; }
+
+private:
+    Usage first_;
+    Usage last_;
+};
+
+bool ReadFile(const char *path, std::string *text) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        text->append(buf, len);
+    }
+    fclose(file);
+    return true;
+}
+
+void Load(const char *name, const char *path, int (*load)(const char *)) {
+    if (path != nullptr && !load(path)) {
+        fprintf(stderr, "cannot load %s %s\n", name, path);
+    }
+}
+
+// Types the text the way UnikeyWrapper does, in each input method.
+void Type(const std::string &text) {
+    const UkInputMethod methods[] = {UkTelex, UkVni, UkSimpleTelex2};
+    for (UkInputMethod im : methods) {
+        UkKeyStrokeWriter writer;
+        writer.init(im);
+        std::string keys;
+        writer.write(text.data(), (int)text.size(), keys);
+
+        UnikeySetInputMethod(im);
+        UnikeyResetBuf();
+        for (unsigned char key : keys) {
+            if (key < 0x20 || key >= 0x7F) {
+                UnikeyResetBuf();
+                continue;
+            }
+            UnikeySetCapsState(key >= 'A' && key <= 'Z', 0);
+            UnikeyFilter(key);
+        }
+    }
+    UnikeySetInputMethod(UkTelex);
+}
+
+void Restore(const std::string &text) {
+    std::string out(text.size() * 4 + 1, '\0');
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(start, end - start);
+        UnikeyRestoreDiacritics(nullptr, line.c_str(), &out[0], (int)out.size());
+        start = end + 1;
+    }
+}
+
+void Convert(const std::string &text) {
+    std::string to(text.size() * 16 + 16, '\0');
+    std::string back(text.size() * 4 + 16, '\0');
+    for (int charset : kCharsets) {
+        int in_len = (int)text.size();
+        int to_len = (int)to.size();
+        if (VnConvert(CONV_CHARSET_UNIUTF8, charset, (UKBYTE *)text.data(),
+                      (UKBYTE *)&to[0], &in_len, &to_len) != 0) {
+            continue;
+        }
+        int back_len = (int)back.size();
+        VnConvert(charset, CONV_CHARSET_UNIUTF8, (UKBYTE *)to.data(),
+                  (UKBYTE *)&back[0], &to_len, &back_len);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const char *macros = nullptr;
+    const char *system_macros = nullptr;
+    const char *dict = nullptr;
+    const char *filter = nullptr;
+    const char *ngram = nullptr;
+    const char *text_file = nullptr;
+    long budget_kb = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--macros") && i + 1 < argc) {
+            macros = argv[++i];
+        } else if (!strcmp(argv[i], "--system-macros") && i + 1 < argc) {
+            system_macros = argv[++i];
+        } else if (!strcmp(argv[i], "--dict") && i + 1 < argc) {
+            dict = argv[++i];
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--ngram") && i + 1 < argc) {
+            ngram = argv[++i];
+        } else if (!strcmp(argv[i], "--text") && i + 1 < argc) {
+            text_file = argv[++i];
+        } else if (!strcmp(argv[i], "--budget-kb") && i + 1 < argc) {
+            budget_kb = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--macros FILE] [--system-macros FILE] "
+                            "[--dict FILE] [--filter FILE] [--ngram FILE] "
+                            "[--text FILE] [--budget-kb N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::string text;
+    if (text_file == nullptr) {
+        text = kSample;
+    } else if (!ReadFile(text_file, &text)) {
+        return 1;
+    }
+
+    Usage usage;
+    if (!ReadUsage(&usage)) {
+        fprintf(stderr, "cannot read /proc/self/smaps_rollup\n");
+        return 1;
+    }
+    printf("engine state: UkSharedMem %zu bytes, UkEngine %zu bytes\n\n",
+           sizeof(UkSharedMem), sizeof(UkEngine));
+    printf("%-16s %8s %8s %8s\n", "kB", "RSS", "PSS", "private");
+
+    Report report;
+    const Usage &start = report.first();
+    printf("%-16s %8ld %8ld %8ld\n", "process", start.rss, start.pss, start.priv);
+    UnikeySetup();
+    UnikeyOptions options;
+    UnikeyGetOptions(&options);
+    options.spellCheckEnabled = 1;
+    options.autoNonVnRestore = 1;
+    options.macroEnabled = (macros != nullptr || system_macros != nullptr);
+    UnikeySetOptions(&options);
+    report.Row("engine");
+
+    if (macros != nullptr || system_macros != nullptr) {
+        Load("macros", macros, UnikeyLoadMacroTable);
+        Load("system macros", system_macros, UnikeyLoadSystemMacroTable);
+        report.Row("macros");
+    }
+    if (dict != nullptr || filter != nullptr) {
+        Load("dictionary", dict, UnikeyLoadDictionary);
+        Load("foreign filter", filter, UnikeyLoadForeignFilter);
+        report.Row("spell check");
+    }
+    if (ngram != nullptr) {
+        Load("diacritic model", ngram, UnikeyLoadDiacriticModel);
+        report.Row("diacritic model");
+    }
+
+    Type(text);
+    report.Row("typing");
+    if (ngram != nullptr) {
+        Restore(text);
+        report.Row("restoring");
+    }
+    Convert(text);
+    report.Row("charsets");
+
+    const Usage &end = report.last();
+    printf("%-16s %8ld %8ld %8ld\n", "libunikey", end.rss - start.rss,
+           end.pss - start.pss, end.priv - start.priv);
+    printf("%-16s %8ld %8ld %8ld\n", "total", end.rss, end.pss, end.priv);
+
+    UnikeyCleanup();
+    if (budget_kb > 0 && end.pss > budget_kb) {
+        fprintf(stderr, "PSS %ld kB is over the budget of %ld kB\n", end.pss, budget_kb);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Measures how long a freshly exec'd ibus-engine-unikey takes to handle its
+// first key: exec -> bus name acquired -> engine created and focused -> first
+// key event answered.
+//
+// Needs a running ibus-daemon with the Unikey component installed, and no
+// other Unikey engine process. Run as root with --drop-caches to measure with
+// a cold page cache.
+//
+//   ibus-unikey-startup-bench [--runs N] [--drop-caches] /path/to/ibus-engine-unikey
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ibus.h>
+
+
+namespace {
+
+const gchar kComponentName[] = "org.freedesktop.IBus.Unikey";
+const gchar kEngineName[] = "Unikey";
+const gint64 kTimeoutUs = 5 * G_USEC_PER_SEC;
+
+struct Sample {
+    gint64 name_us;    // exec -> bus name owned
+    gint64 engine_us;  // exec -> engine created and focused
+    gint64 key_us;     // exec -> first key answered
+};
+
+bool DropCaches() {
+    sync();
+    FILE *file = fopen("/proc/sys/vm/drop_caches", "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fputs("3\n", file);
+    fclose(file);
+    return true;
+}
+
+// Returns false if |name| is not owned within kTimeoutUs.
+bool WaitForName(IBusBus *bus, const gchar *name) {
+    gint64 start = g_get_monotonic_time();
+    while (!ibus_bus_name_has_owner(bus, name)) {
+        if (g_get_monotonic_time() - start > kTimeoutUs) {
+            return false;
+        }
+        g_usleep(200);
+    }
+    return true;
+}
+
+// Returns false if the engine of |context| is not |name| within kTimeoutUs.
+bool WaitForEngine(IBusInputContext *context, const gchar *name) {
+    gint64 start = g_get_monotonic_time();
+    for (;;) {
+        IBusEngineDesc *desc = ibus_input_context_get_engine(context);
+        if (desc && !g_strcmp0(ibus_engine_desc_get_name(desc), name)) {
+            return true;
+        }
+        if (g_get_monotonic_time() - start > kTimeoutUs) {
+            return false;
+        }
+        g_usleep(200);
+    }
+}
+
+// Focuses a new input context on the engine and sends it one key.
+bool FirstKey(IBusBus *bus, gint64 start, Sample *sample) {
+    IBusInputContext *context = ibus_bus_create_input_context(bus, "unikey-startup-bench");
+    if (context == nullptr) {
+        fprintf(stderr, "cannot create an input context\n");
+        return false;
+    }
+
+    ibus_input_context_set_capabilities(context, IBUS_CAP_PREEDIT_TEXT | IBUS_CAP_FOCUS);
+    ibus_input_context_focus_in(context);
+    ibus_input_context_set_engine(context, kEngineName);
+
+    bool ok = WaitForEngine(context, kEngineName);
+    if (ok) {
+        sample->engine_us = g_get_monotonic_time() - start;
+        // Synchronous: returns once the engine has answered.
+        ibus_input_context_process_key_event(context, IBUS_a, 30, 0);
+        sample->key_us = g_get_monotonic_time() - start;
+    } else {
+        fprintf(stderr, "engine %s was not set\n", kEngineName);
+    }
+
+    ibus_proxy_destroy(IBUS_PROXY(context));
+    g_object_unref(context);
+    return ok;
+}
+
+bool RunOnce(IBusBus *bus, const char *engine_path, Sample *sample) {
+    gchar *argv[] = { const_cast<gchar*>(engine_path), nullptr };
+    GPid pid;
+    GError *error = nullptr;
+
+    gint64 start = g_get_monotonic_time();
+    if (!g_spawn_async(nullptr, argv, nullptr, G_SPAWN_DO_NOT_REAP_CHILD,
+                       nullptr, nullptr, &pid, &error)) {
+        fprintf(stderr, "cannot start %s: %s\n", engine_path, error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    bool ok = WaitForName(bus, kComponentName);
+    if (ok) {
+        sample->name_us = g_get_monotonic_time() - start;
+        ok = FirstKey(bus, start, sample);
+    } else {
+        fprintf(stderr, "%s did not acquire %s\n", engine_path, kComponentName);
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    g_spawn_close_pid(pid);
+
+    // Let the bus notice the engine is gone before the next run.
+    while (ibus_bus_name_has_owner(bus, kComponentName)) {
+        g_usleep(1000);
+    }
+    return ok;
+}
+
+void Report(const char *name, std::vector<gint64> values) {
+    std::sort(values.begin(), values.end());
+    printf("%-8s min %8.2f ms  median %8.2f ms  max %8.2f ms\n",
+           name,
+           values.front() / 1000.0,
+           values[values.size() / 2] / 1000.0,
+           values.back() / 1000.0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int runs = 10;
+    bool drop_caches = false;
+    const char *engine_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--drop-caches")) {
+            drop_caches = true;
+        } else {
+            engine_path = argv[i];
+        }
+    }
+    if (engine_path == nullptr || runs <= 0) {
+        fprintf(stderr, "usage: %s [--runs N] [--drop-caches] /path/to/ibus-engine-unikey\n", argv[0]);
+        return 2;
+    }
+
+    ibus_init();
+    IBusBus *bus = ibus_bus_new();
+    if (!ibus_bus_is_connected(bus)) {
+        fprintf(stderr, "cannot connect to ibus-daemon\n");
+        return 1;
+    }
+    if (ibus_bus_name_has_owner(bus, kComponentName)) {
+        fprintf(stderr, "%s is already running, stop it first\n", kComponentName);
+        return 1;
+    }
+
+    std::vector<gint64> name, engine, key;
+    for (int i = 0; i < runs; i++) {
+        if (drop_caches && !DropCaches()) {
+            fprintf(stderr, "cannot drop caches, run as root\n");
+            return 1;
+        }
+
+        Sample sample;
+        if (!RunOnce(bus, engine_path, &sample)) {
+            return 1;
+        }
+        name.push_back(sample.name_us);
+        engine.push_back(sample.engine_us);
+        key.push_back(sample.key_us);
+    }
+
+    printf("%d runs, %s page cache\n", runs, drop_caches ? "cold" : "warm");
+    Report("name", name);
+    Report("engine", engine);
+    Report("key", key);
+
+    g_object_unref(bus);
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Checks the word start, Vietnamese mark and converted key flags UkEngine
+// keeps with its buffers (see UkEngine::updateWordInfo) against scans of
+// the buffers back to the last word break, the way the engine found them
+// before it kept them.
+//
+// Each round sets up the engine with a random input method and options,
+// then runs random edits on it: keys of the input method, word breaks,
+// backspaces, restores that teach the word, passed keys, settling the
+// prefix and resets. After every edit, the flags of every entry of both
+// buffers and the start settlePrefix() would keep must be the ones the
+// scans give.
+//
+//   ibus-unikey-word-info [--rounds N] [--edits N] [--seed N]
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "third_party/libunikey/ukengine.h"
+#include "third_party/libunikey/unikey.h"
+#include "third_party/libunikey/vnconv.h"
+
+
+namespace {
+
+const UkInputMethod kMethods[] = {UkTelex, UkVni, UkSimpleTelex, UkSimpleTelex2};
+
+// Keys of the input methods, letters that make syllables more often
+const char *const kKeys[] = {
+    "aaaeeeiooouuuydddnnghtcmpwwwsfrxjzAEODWS[]",
+    "aaaeeeiooouuuydddnnghtcmpq1234567890AEOD",
+    "aaaeeeiooouuuydddnnghtcmpwwwsfrxjzAEODWS",
+    "aaaeeeiooouuuydddnnghtcmpwwwsfrxjzAEODWS",
+};
+
+const char kBreaks[] = " ,.;!?";
+
+int g_shift = 0;
+
+void CheckKbCase(int *shift, int *capsLock) {
+    *shift = g_shift;
+    *capsLock = 0;
+}
+
+// The engine, with the scans the flags replace
+class CheckedEngine : public UkEngine {
+public:
+    // the message of the first flag that differs from its scan, nullptr if
+    // they are all right
+    const char *Verify() {
+        for (int i = 0; i <= m_current; i++) {
+            int start = i;
+            while (start > 0 && m_buffer[start-1].form != vnw_empty)
+                start--;
+            if (m_buffer[i].form == vnw_empty)
+                start = i + 1;
+            if (getWordStart(i) != start)
+                return "word start";
+
+            bool marked = false;
+            for (int j = i; j >= 0 && m_buffer[j].form != vnw_empty; j--) {
+                if (hasVnMark(j))
+                    marked = true;
+            }
+            if (m_buffer[i].wordMarked != marked)
+                return "Vietnamese mark";
+        }
+
+        for (int k = 0; k <= m_keyCurrent; k++) {
+            int start = k;
+            bool converted = false;
+            for (; start >= 0 && m_keyStrokes[start].ev.chType != ukcWordBreak; start--) {
+                if (m_keyStrokes[start].converted)
+                    converted = true;
+            }
+            if (getKeyWordStart(k) != start + 1)
+                return "key word start";
+            if ((m_keyStrokes[k].convertedPos != SCHAR_MAX) != converted)
+                return "converted key";
+        }
+
+        if (m_current >= 0 && getSettleStart() != ScanSettleStart())
+            return "settle start";
+        return nullptr;
+    }
+
+private:
+    // settleBuffers() before the flags were kept
+    int ScanSettleStart() {
+        int start = m_current + 1;
+        while (start > 0 && m_buffer[start-1].form != vnw_empty)
+            start--;
+        if (m_current - start < SETTLE_WORD_LIMIT)
+            return start;
+
+        start = getActiveStart();
+        for (int i = start-1; i >= 0 && m_buffer[i].form != vnw_empty; i--) {
+            if (hasVnMark(i)) {
+                while (i >= 0 && m_buffer[i].form != vnw_empty)
+                    i--;
+                start = i+1;
+                break;
+            }
+        }
+
+        if (start > 0 && keepsConvertedPrefix()) {
+            for (int k = m_keyCurrent; k >= 0 && m_keyStrokes[k].ev.chType != ukcWordBreak; k--) {
+                if (m_keyStrokes[k].bufPos < start && m_keyStrokes[k].converted) {
+                    while (start > 0 && m_buffer[start-1].form != vnw_empty)
+                        start--;
+                    break;
+                }
+            }
+        }
+        return start;
+    }
+};
+
+class Fuzzer {
+public:
+    Fuzzer(uint32_t seed) : random_(seed) {
+        ctrl_.input.init();
+        ctrl_.macStore.init();
+        ctrl_.vietKey = 1;
+        ctrl_.usrKeyMapLoaded = 0;
+        ctrl_.charsetId = CONV_CHARSET_UNIUTF8;
+        CreateDefaultUnikeyOptions(&ctrl_.options);
+    }
+
+    // false if a flag went wrong
+    bool Round(int edits) {
+        int im = Random() % 4;
+        ctrl_.input.setIM(kMethods[im]);
+        ctrl_.options.freeMarking = Random() & 1;
+        ctrl_.options.modernStyle = Random() & 1;
+        ctrl_.options.spellCheckEnabled = (Random() % 4) != 0;
+        ctrl_.options.autoNonVnRestore = Random() & 1;
+        learned_.clear();
+
+        CheckedEngine engine;
+        engine.setCtrlInfo(&ctrl_);
+        engine.setCheckKbCaseFunc(CheckKbCase);
+        engine.setLearnedWords(&learned_);
+        engine.reset();
+
+        const char *keys = kKeys[im];
+        size_t key_count = strlen(keys);
+        unsigned char buf[1024];
+        int backs, size;
+        UkOutputType type;
+        for (int i = 0; i < edits; i++) {
+            uint32_t r = Random() % 100;
+            const char *edit;
+            size = sizeof(buf);
+            if (r < 70) {
+                unsigned char key = keys[Random() % key_count];
+                g_shift = (key >= 'A' && key <= 'Z');
+                engine.process(key, backs, buf, size, type);
+                edit = "key";
+            } else if (r < 78) {
+                engine.process(kBreaks[Random() % (sizeof(kBreaks) - 1)], backs, buf, size, type);
+                edit = "word break";
+            } else if (r < 88) {
+                engine.processBackspace(backs, buf, size, type);
+                edit = "backspace";
+            } else if (r < 92) {
+                uint64_t hash = engine.lastWordKeyHash();
+                if (engine.restoreKeyStrokes(backs, buf, size, type) && hash != 0)
+                    learned_.add(hash);
+                edit = "restore";
+            } else if (r < 94) {
+                engine.pass(keys[Random() % key_count]);
+                edit = "pass";
+            } else if (r < 99) {
+                engine.settlePrefix();
+                edit = "settle";
+            } else {
+                engine.reset();
+                edit = "reset";
+            }
+            edits_++;
+
+            const char *wrong = engine.Verify();
+            if (wrong != nullptr) {
+                fprintf(stderr, "%s differs after %s, edit %d\n", wrong, edit, i);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    long edits() const { return edits_; }
+
+private:
+    uint32_t Random() {
+        random_ = random_ * 1103515245 + 12345;
+        return random_ >> 8;
+    }
+
+    UkSharedMem ctrl_;
+    UkWordSet learned_;
+    uint32_t random_;
+    long edits_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int rounds = 2000;
+    int edits = 500;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--edits") && i + 1 < argc) {
+            edits = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--rounds N] [--edits N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Fuzzer fuzzer(seed);
+    for (int round = 0; round < rounds; round++) {
+        if (!fuzzer.Round(edits)) {
+            fprintf(stderr, "in round %d of seed %u\n", round, seed);
+            return 1;
+        }
+    }
+    printf("%ld edits in %d rounds, flags right\n", fuzzer.edits(), rounds);
+    return 0;
+}
@@ -28,16 +28,22 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "charset.h"
 #include "data.h"
+#include "uktables.h"
 
-int LoVowel['z'-'a'+1];
-int HiVowel['Z'-'A'+1];
+// a e i o u y
+static const int LoVowel['z'-'a'+1] = {
+	1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0
+};
+static const int HiVowel['Z'-'A'+1] = {
+	1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0
+};
 
 #define IS_VOWEL(x) ((x >= 'a' && x <= 'z' && LoVowel[x-'a']) || (x >= 'A' && x <= 'Z' && HiVowel[x-'A']))
 
 SingleByteCharset *SgCharsets[CONV_TOTAL_SINGLE_CHARSETS];
 DoubleByteCharset *DbCharsets[CONV_TOTAL_DOUBLE_CHARSETS];
 
-DllExport CVnCharsetLib VnCharsetLibObj;
+DllExport VnConvContext VnCharsetLibObj;
 
 //////////////////////////////////////////////////////
 // Generic VnCharset class
@@ -73,15 +79,10 @@ int VnInternalCharset::elementSize()
 }
 
 //-------------------------------------------
-SingleByteCharset::SingleByteCharset(unsigned char * vnChars)
+SingleByteCharset::SingleByteCharset(const unsigned char * vnChars, const UKWORD * stdMap)
 {
-	int i;
 	m_vnChars = vnChars;
-	memset(m_stdMap, 0, 256*sizeof(UKWORD));
-	for (i=0; i<TOTAL_VNCHARS; i++) {
-		if (vnChars[i] != 0 && (i==TOTAL_VNCHARS-1 || vnChars[i] != vnChars[i+1]))
-			m_stdMap[vnChars[i]] = i + 1;
-	}
+	m_stdMap = stdMap;
 }
 
 //-------------------------------------------
@@ -129,21 +130,10 @@ int SingleByteCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outL
 }
 
 //-------------------------------------------
-int wideCharCompare(const void *ele1, const void *ele2)
+UnicodeCharset::UnicodeCharset(const UnicodeChar *vnChars, const UKDWORD *sortedChars)
 {
-	UKWORD ch1 = LOWORD(*((UKDWORD *)ele1));
-	UKWORD ch2 = LOWORD(*((UKDWORD *)ele2));
-	return (ch1 == ch2)? 0 : ((ch1 > ch2)? 1 : -1);
-}
-
-//-------------------------------------------
-UnicodeCharset::UnicodeCharset(UnicodeChar *vnChars)
-{
-	UKDWORD i;
 	m_toUnicode = vnChars;
-	for (i=0; i<TOTAL_VNCHARS; i++)
-		m_vnChars[i] = (i << 16) + vnChars[i]; // high word is used for index
-	qsort(m_vnChars, TOTAL_VNCHARS, sizeof(UKDWORD), wideCharCompare);
+	m_vnChars = sortedChars;
 }
 
 //-------------------------------------------
@@ -181,34 +171,12 @@ int UnicodeCharset::elementSize()
 ////////////////////////////////////////
 // Unicode decomposed
 ////////////////////////////////////////
-//-------------------------------------------
-int uniCompInfoCompare(const void *ele1, const void *ele2)
-{
-	UKDWORD ch1 = ((UniCompCharInfo *)ele1)->compChar;
-	UKDWORD ch2 = ((UniCompCharInfo *)ele2)->compChar;
-	return (ch1 == ch2)? 0 : ((ch1 > ch2)? 1 : -1);
-}
-
-UnicodeCompCharset::UnicodeCompCharset(UnicodeChar *uniChars, UKDWORD *uniCompChars)
+UnicodeCompCharset::UnicodeCompCharset(const UKDWORD *uniCompChars,
+                                       const UniCompCharInfo *sortedInfo, int totalChars)
 {
-  int i,k;
 	m_uniCompChars = uniCompChars;
-	m_totalChars = 0;
-	for (i=0; i<TOTAL_VNCHARS; i++) {
-		m_info[i].compChar = uniCompChars[i];
-		m_info[i].stdIndex = i;
-		m_totalChars++;
-	}
-
-	for (k=0, i=TOTAL_VNCHARS; k<TOTAL_VNCHARS; k++)
-		if (uniChars[k] != uniCompChars[k]) {
-			m_info[i].compChar = uniChars[k];
-			m_info[i].stdIndex = k;
-			m_totalChars++;
-			i++;
-		}
-
-	qsort(m_info, m_totalChars, sizeof(UniCompCharInfo), uniCompInfoCompare);
+	m_info = sortedInfo;
+	m_totalChars = totalChars;
 }
 
 //---------------------------------------------
@@ -594,18 +562,12 @@ int UnicodeCStringCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int &
 /////////////////////////////////
 // Double-byte charsets        //
 /////////////////////////////////
-DoubleByteCharset::DoubleByteCharset(UKWORD *vnChars)
+DoubleByteCharset::DoubleByteCharset(const UKWORD *vnChars, const UKWORD *stdMap,
+                                     const UKDWORD *sortedChars)
 {
 	m_toDoubleChar = vnChars;
-	memset(m_stdMap, 0, 256*sizeof(UKWORD));
-	for (int i=0; i<TOTAL_VNCHARS; i++) {
-		if (vnChars[i] >> 8) // a 2-byte character
-			m_stdMap[vnChars[i] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
-		else if (m_stdMap[vnChars[i]] == 0)
-			m_stdMap[vnChars[i]] = i+1;
-		m_vnChars[i] = (i << 16) + vnChars[i]; // high word is used for StdChar index
-	}
-	qsort(m_vnChars, TOTAL_VNCHARS, sizeof(UKDWORD), wideCharCompare);
+	m_stdMap = stdMap;
+	m_vnChars = sortedChars;
 }
 
 //---------------------------------------------
@@ -700,31 +662,14 @@ const char *VIQREscapes[] = {
 
 const int VIQREscCount = sizeof(VIQREscapes) / sizeof(char*);
 
-VIQRCharset::VIQRCharset(UKDWORD *vnChars)
+VIQRCharset::VIQRCharset(const UKDWORD *vnChars, const UKWORD *stdMap,
+                         const VnConvOptions *pOptions)
 {
-	memset(m_stdMap, 0, 256*sizeof(UKWORD));
-	int i;
-	UKDWORD dw;
 	m_vnChars = vnChars;
-	for (i=0; i<TOTAL_VNCHARS; i++) {
-		dw = m_vnChars[i];
-		if (!(dw & 0xffffff00)) { //single byte
-			//ch = (unsigned char)(dw & 0xff);
-			m_stdMap[dw] = i+256;
-		}
-	}
-
-	// set offset from base characters according to tone marks
-	m_stdMap[(unsigned char)'\''] = 2;
-	m_stdMap[(unsigned char)'`'] = 4;
-	m_stdMap[(unsigned char)'?'] = 6;
-	m_stdMap[(unsigned char)'~'] = 8;
-	m_stdMap[(unsigned char)'.'] = 10;
-	m_stdMap[(unsigned char)'^'] = 12;
-
-	m_stdMap[(unsigned char)'('] = 24;
-	m_stdMap[(unsigned char)'+'] = 26;
-	m_stdMap[(unsigned char)'*'] = 26;
+	m_stdMap = stdMap;
+	m_pOptions = pOptions;
+	m_escPatterns.init((char**)VIQREscapes, VIQREscCount);
+	m_outEscPatterns.init((char**)VIQREscapes, VIQREscCount);
 }
 
 //---------------------------------------------------
@@ -734,8 +679,8 @@ void VIQRCharset::startInput()
 	m_atWordBeginning = 1;
 	m_gotTone = 0;
 	m_escAll = 0;
-	if (VnCharsetLibObj.m_options.viqrEsc)
-		VnCharsetLibObj.m_VIQREscPatterns.reset();
+	if (m_pOptions->viqrEsc)
+		m_escPatterns.reset();
 }
 
 //---------------------------------------------------
@@ -749,8 +694,8 @@ int VIQRCharset::nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRe
 	bytesRead = 1;
 	stdChar = m_stdMap[ch1];
 
-	if (VnCharsetLibObj.m_options.viqrEsc) {
-		if (VnCharsetLibObj.m_VIQREscPatterns.foundAtNextChar(ch1)!=-1) {
+	if (m_pOptions->viqrEsc) {
+		if (m_escPatterns.foundAtNextChar(ch1)!=-1) {
 			m_escAll = 1;
 		}
 	}
@@ -774,7 +719,7 @@ int VIQRCharset::nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRe
 		unsigned char ch2;
 		is.peekNext(ch2);
 		unsigned char upper = toupper(ch1);
-        if ((!VnCharsetLibObj.m_options.smartViqr || m_atWordBeginning) &&
+        if ((!m_pOptions->smartViqr || m_atWordBeginning) &&
              upper == 'D' && (ch2 == 'd' || ch2 == 'D')) 
         {
 			is.getNext(ch2);
@@ -844,7 +789,7 @@ void VIQRCharset::startOutput()
 	m_escapeHook = 0;
 	m_escapeTone = 0;
 	m_noOutEsc = 0;
-	VnCharsetLibObj.m_VIQROutEscPatterns.reset();
+	m_outEscPatterns.reset();
 }
 
 //---------------------------------------------------
@@ -861,7 +806,7 @@ int VIQRCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen)
 
 		b = (UKBYTE)dw;
 		ret = os.putB(b);
-		if (VnCharsetLibObj.m_VIQROutEscPatterns.foundAtNextChar(b) != -1)
+		if (m_outEscPatterns.foundAtNextChar(b) != -1)
 		  m_noOutEsc = 1;
 
 		if (m_noOutEsc && (b==' ' || b=='\t' || b=='\r' || b=='\n'))
@@ -884,7 +829,7 @@ int VIQRCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen)
 				m_escapeTone = (index == 12 || index == 24 || index == 26);
 			}
 
-                        VnCharsetLibObj.m_VIQROutEscPatterns.reset();
+                        m_outEscPatterns.reset();
 
 			m_escapeBowl = 0;
 			m_escapeHook = 0;
@@ -901,13 +846,13 @@ int VIQRCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen)
 		if (stdChar > 255) {
 			outLen = 1;
 			ret = os.putB((UKBYTE)PadChar);
-                        if (VnCharsetLibObj.m_VIQROutEscPatterns.foundAtNextChar((UKBYTE)PadChar) != -1)
+                        if (m_outEscPatterns.foundAtNextChar((UKBYTE)PadChar) != -1)
 			  m_noOutEsc = 1;
 		}
 		else {
 			outLen = 1;
 			UKWORD index = m_stdMap[stdChar];
-			if (!VnCharsetLibObj.m_options.viqrMixed && !m_noOutEsc &&
+			if (!m_pOptions->viqrMixed && !m_noOutEsc &&
 				   (stdChar=='\\' || 
 					(index > 0 && index <= 10 && m_escapeTone) ||
 					(index == 12 && m_escapeRoof) ||
@@ -917,12 +862,12 @@ int VIQRCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen)
 				// tone mark, needs an escape character
 				outLen++;
 				ret = os.putB('\\');
-				if (VnCharsetLibObj.m_VIQROutEscPatterns.foundAtNextChar('\\') != -1)
+				if (m_outEscPatterns.foundAtNextChar('\\') != -1)
 				  m_noOutEsc = 1;
 			}
 			b = (UKBYTE)stdChar;
 			ret = os.putB(b);
-			if (VnCharsetLibObj.m_VIQROutEscPatterns.foundAtNextChar(b) != -1)
+			if (m_outEscPatterns.foundAtNextChar(b) != -1)
 			  m_noOutEsc = 1;
 			if (m_noOutEsc && (b==' ' || b=='\t' || b=='\r' || b=='\n'))
 			  m_noOutEsc = 0;
@@ -986,159 +931,137 @@ int UTF8VIQRCharset::putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen
 
 
 //-----------------------------------------
-CVnCharsetLib::CVnCharsetLib()
+// Charsets that only hold tables, shared by all contexts. The tables are
+// const data (see uktables.h), the objects only point at them. Each is
+// created on first use; function statics make that safe from any thread.
+//-----------------------------------------
+template <class Charset, int count>
+struct VnCharsetGroup {
+	Charset *m_charsets[count];
+	VnCharsetGroup(Charset *(*make)(int)) {
+		for (int i = 0; i < count; i++)
+			m_charsets[i] = make(i);
+	}
+	~VnCharsetGroup() {
+		for (int i = 0; i < count; i++)
+			delete m_charsets[i];
+	}
+};
+
+static SingleByteCharset *newSingleByteCharset(int i)
 {
-	unsigned char ch;
-	for (ch = 'a'; ch < 'z'; ch++)
-		LoVowel[ch-'a'] = 0;
-	LoVowel['a'-'a'] = 1;
-	LoVowel['e'-'a'] = 1;
-	LoVowel['i'-'a'] = 1;
-	LoVowel['o'-'a'] = 1;
-	LoVowel['u'-'a'] = 1;
-	LoVowel['y'-'a'] = 1;
-
-	for (ch = 'A'; ch < 'Z'; ch++)
-		HiVowel[ch-'A'] = 0;
-	HiVowel['A'-'A'] = 1;
-	HiVowel['E'-'A'] = 1;
-	HiVowel['I'-'A'] = 1;
-	HiVowel['O'-'A'] = 1;
-	HiVowel['U'-'A'] = 1;
-	HiVowel['Y'-'A'] = 1;
-
-	m_pUniCharset = NULL;
-	m_pUniCompCharset = NULL;
-	m_pUniUTF8 = NULL;
-	m_pUniRef = NULL;
-	m_pUniHex = NULL;
-	m_pVIQRCharObj = NULL;
-	m_pUVIQRCharObj = NULL;
-	m_pWinCP1258 = NULL;
-	m_pVnIntCharset = NULL;
+	return new SingleByteCharset(SingleByteTables[i], SingleByteStdMaps[i]);
+}
 
-	int i;
-	for (i = 0; i < CONV_TOTAL_SINGLE_CHARSETS; i++)
-		m_sgCharsets[i] = NULL;
+static DoubleByteCharset *newDoubleByteCharset(int i)
+{
+	return new DoubleByteCharset(DoubleByteTables[i], DoubleByteStdMaps[i], DoubleByteSortedChars[i]);
+}
 
-	for (i = 0; i < CONV_TOTAL_DOUBLE_CHARSETS; i++)
-		m_dbCharsets[i] = NULL;
+//-----------------------------------------
+DllExport VnCharset * VnSharedCharset(int charsetIdx)
+{
+	switch (charsetIdx) {
 
-	VnConvResetOptions(&m_options);
-	m_VIQREscPatterns.init((char**)VIQREscapes, VIQREscCount);
-	m_VIQROutEscPatterns.init((char**)VIQREscapes, VIQREscCount);
+	case CONV_CHARSET_UNICODE: {
+		static UnicodeCharset uni(UnicodeTable, UnicodeSortedChars);
+		return &uni;
+	}
+	case CONV_CHARSET_UNIDECOMPOSED: {
+		static UnicodeCompCharset uniComp(UnicodeComposite, UnicodeCompSortedInfo,
+						  UnicodeCompCharCount);
+		return &uniComp;
+	}
+	case CONV_CHARSET_UNIUTF8:
+	case CONV_CHARSET_XUTF8: {
+		static UnicodeUTF8Charset uniUTF8(UnicodeTable, UnicodeSortedChars);
+		return &uniUTF8;
+	}
+	case CONV_CHARSET_UNIREF: {
+		static UnicodeRefCharset uniRef(UnicodeTable, UnicodeSortedChars);
+		return &uniRef;
+	}
+	case CONV_CHARSET_UNIREF_HEX: {
+		static UnicodeHexCharset uniHex(UnicodeTable, UnicodeSortedChars);
+		return &uniHex;
+	}
+	case CONV_CHARSET_WINCP1258: {
+		static WinCP1258Charset winCP1258(WinCP1258, WinCP1258StdMap, WinCP1258SortedChars,
+						  WinCP1258CharCount);
+		return &winCP1258;
+	}
+	case CONV_CHARSET_VNSTANDARD: {
+		static VnInternalCharset vnInt;
+		return &vnInt;
+	}
+	default:
+		if (IS_SINGLE_BYTE_CHARSET(charsetIdx)) {
+			static VnCharsetGroup<SingleByteCharset, CONV_TOTAL_SINGLE_CHARSETS>
+				sg(newSingleByteCharset);
+			return sg.m_charsets[charsetIdx - CONV_CHARSET_TCVN3];
+		}
+		else if (IS_DOUBLE_BYTE_CHARSET(charsetIdx)) {
+			static VnCharsetGroup<DoubleByteCharset, CONV_TOTAL_DOUBLE_CHARSETS>
+				db(newDoubleByteCharset);
+			return db.m_charsets[charsetIdx - CONV_CHARSET_VNIWIN];
+		}
+	}
+	return NULL;
 }
 
+//-----------------------------------------
+VnConvContext::VnConvContext()
+{
+	m_pVIQRCharObj = NULL;
+	m_pUVIQRCharObj = NULL;
+	m_pUniCString = NULL;
+	VnConvResetOptions(&m_options);
+}
 
 //-----------------------------------------
-CVnCharsetLib::~CVnCharsetLib()
+VnConvContext::~VnConvContext()
 {
-	if (m_pUniCharset)
-		delete m_pUniCharset;
-	if (m_pUniUTF8)
-		delete m_pUniUTF8;
-	if (m_pUniRef)
-		delete m_pUniRef;
-	if (m_pUniHex)
-		delete m_pUniHex;
-	if (m_pVIQRCharObj)
-		delete m_pVIQRCharObj;
-	if (m_pUVIQRCharObj)
-		delete m_pUVIQRCharObj;
-	if (m_pWinCP1258)
-		delete m_pWinCP1258;
-	if (m_pUniCString)
-		delete m_pUniCString;
-	if (m_pVnIntCharset)
-		delete m_pVnIntCharset;
-
-	int i;
-	for (i = 0; i < CONV_TOTAL_SINGLE_CHARSETS; i++)
-		if (m_sgCharsets[i]) delete m_sgCharsets[i];
-
-	for (i = 0; i < CONV_TOTAL_DOUBLE_CHARSETS; i++)
-		if (m_dbCharsets[i]) delete m_dbCharsets[i];
+	releaseCharsets();
+}
 
+//-----------------------------------------
+void VnConvContext::releaseCharsets()
+{
+	delete m_pUVIQRCharObj;
+	delete m_pVIQRCharObj;
+	delete m_pUniCString;
+	m_pVIQRCharObj = NULL;
+	m_pUVIQRCharObj = NULL;
+	m_pUniCString = NULL;
 }
 
 //-----------------------------------------
-VnCharset * CVnCharsetLib::getVnCharset(int charsetIdx)
+VnCharset * VnConvContext::getVnCharset(int charsetIdx)
 {
 	switch (charsetIdx) {
 
-	case CONV_CHARSET_UNICODE:
-		if (m_pUniCharset == NULL)
-			m_pUniCharset = new UnicodeCharset(UnicodeTable);
-		return m_pUniCharset;
-	case CONV_CHARSET_UNIDECOMPOSED:
-		if (m_pUniCompCharset == NULL)
-			m_pUniCompCharset = new UnicodeCompCharset(UnicodeTable, UnicodeComposite);
-		return m_pUniCompCharset;
-	case CONV_CHARSET_UNIUTF8:
-  case CONV_CHARSET_XUTF8:
-		if (m_pUniUTF8 == NULL)
-			m_pUniUTF8 = new UnicodeUTF8Charset(UnicodeTable);
-		return m_pUniUTF8;
-	
-	case CONV_CHARSET_UNIREF:
-		if (m_pUniRef == NULL)
-			m_pUniRef = new UnicodeRefCharset(UnicodeTable);
-		return m_pUniRef;
-
-	case CONV_CHARSET_UNIREF_HEX:
-		if (m_pUniHex == NULL)
-			m_pUniHex = new UnicodeHexCharset(UnicodeTable);
-		return m_pUniHex;
-
 	case CONV_CHARSET_UNI_CSTRING:
 		if (m_pUniCString == NULL)
-			m_pUniCString = new UnicodeCStringCharset(UnicodeTable);
+			m_pUniCString = new UnicodeCStringCharset(UnicodeTable, UnicodeSortedChars);
 		return m_pUniCString;
 
-	case CONV_CHARSET_WINCP1258:
-		if (m_pWinCP1258 == NULL)
-			m_pWinCP1258 = new WinCP1258Charset(WinCP1258, WinCP1258Pre);
-		return m_pWinCP1258;
-
 	case CONV_CHARSET_VIQR:
 		if (m_pVIQRCharObj == NULL)
-			m_pVIQRCharObj = new VIQRCharset(VIQRTable);
+			m_pVIQRCharObj = new VIQRCharset(VIQRTable, VIQRStdMap, &m_options);
 		return m_pVIQRCharObj;
 
-	case CONV_CHARSET_VNSTANDARD:
-		if (m_pVnIntCharset == NULL)
-			m_pVnIntCharset = new VnInternalCharset();
-		return m_pVnIntCharset;
-
 	case CONV_CHARSET_UTF8VIQR:
 	  if (m_pUVIQRCharObj == NULL) {
 	    if (m_pVIQRCharObj == NULL)
-	      m_pVIQRCharObj = new VIQRCharset(VIQRTable);
-
-	    if (m_pUniUTF8 == NULL)
-	      m_pUniUTF8 = new UnicodeUTF8Charset(UnicodeTable);
-	    m_pUVIQRCharObj = new UTF8VIQRCharset(m_pUniUTF8, m_pVIQRCharObj);
+	      m_pVIQRCharObj = new VIQRCharset(VIQRTable, VIQRStdMap, &m_options);
+	    m_pUVIQRCharObj = new UTF8VIQRCharset(
+	      (UnicodeUTF8Charset *)VnSharedCharset(CONV_CHARSET_UNIUTF8), m_pVIQRCharObj);
 	  }
 	  return m_pUVIQRCharObj;
-
-	default:
-		if (IS_SINGLE_BYTE_CHARSET(charsetIdx)) {
-			int i = charsetIdx - CONV_CHARSET_TCVN3;
-			if (m_sgCharsets[i] == NULL)
-				m_sgCharsets[i] = new SingleByteCharset(SingleByteTables[i]);
-			return m_sgCharsets[i];
-		}
-		else if (IS_DOUBLE_BYTE_CHARSET(charsetIdx)) {
-			int i = charsetIdx - CONV_CHARSET_VNIWIN;
-			if (m_dbCharsets[i] == NULL)
-				m_dbCharsets[i] = new DoubleByteCharset(DoubleByteTables[i]);
-			return m_dbCharsets[i];
-		}
 	}
-	return NULL;
+	return VnSharedCharset(charsetIdx);
 }
 
-
 //-------------------------------------------------
 DllExport void VnConvSetOptions(VnConvOptions *pOptions)
 {
@@ -1166,41 +1089,15 @@ DllExport void VnConvResetOptions(VnConvOptions *pOptions)
 /////////////////////////////////////////////
 // Class WinCP1258Charset
 /////////////////////////////////////////////
-WinCP1258Charset::WinCP1258Charset(UKWORD *compositeChars, UKWORD *precomposedChars)
+WinCP1258Charset::WinCP1258Charset(const UKWORD *compositeChars, const UKWORD *stdMap,
+                                   const UKDWORD *sortedChars, int totalChars)
 {
-  int i,k;
 	m_toDoubleChar = compositeChars;
-	memset(m_stdMap, 0, 256*sizeof(UKWORD));
-
-	// encode composite chars
-	for (i=0; i<TOTAL_VNCHARS; i++) {
-		if (compositeChars[i] >> 8) // a 2-byte character
-			m_stdMap[compositeChars[i] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
-		else if (m_stdMap[compositeChars[i]] == 0)
-			m_stdMap[compositeChars[i]] = i+1;
-
-		m_vnChars[i] = (i << 16) + compositeChars[i]; // high word is used for StdChar index
-	}
-
-	m_totalChars = TOTAL_VNCHARS;
-
-	//add precomposed chars to the table
-	for (k=0, i=TOTAL_VNCHARS; k<TOTAL_VNCHARS; k++)
-		if (precomposedChars[k] != compositeChars[k]) {
-			if (precomposedChars[k] >> 8) // a 2-byte character
-				m_stdMap[precomposedChars[k] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
-			else if (m_stdMap[precomposedChars[k]] == 0)
-				m_stdMap[precomposedChars[k]] = k+1;
-
-			m_vnChars[i] = (k << 16) + precomposedChars[k];
-			m_totalChars++;
-			i++;
-		}
-
-	qsort(m_vnChars, m_totalChars, sizeof(UKDWORD), wideCharCompare);
+	m_stdMap = stdMap;
+	m_vnChars = sortedChars;
+	m_totalChars = totalChars;
 }
 
-
 //---------------------------------------------------------------------
 // This fuction is basically the same as that of DoubleByteCharset
 // with m_totalChars is used instead of constant TOTAL_VNCHARS
@@ -108,10 +108,10 @@ public:
 //--------------------------------------------------
 class SingleByteCharset: public VnCharset {
 protected:
-	UKWORD m_stdMap[256];
-	unsigned char * m_vnChars;
+	const UKWORD * m_stdMap;
+	const unsigned char * m_vnChars;
 public:
-	SingleByteCharset(unsigned char * vnChars);
+	SingleByteCharset(const unsigned char * vnChars, const UKWORD * stdMap);
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
 };
@@ -128,10 +128,10 @@ public:
 //--------------------------------------------------
 class UnicodeCharset: public VnCharset {
 protected:
-	UKDWORD m_vnChars[TOTAL_VNCHARS];
-	UnicodeChar * m_toUnicode;
+	const UKDWORD * m_vnChars;
+	const UnicodeChar * m_toUnicode;
 public:
-	UnicodeCharset(UnicodeChar *vnChars);
+	UnicodeCharset(const UnicodeChar *vnChars, const UKDWORD *sortedChars);
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
     virtual int elementSize();
@@ -140,11 +140,11 @@ public:
 //--------------------------------------------------
 class DoubleByteCharset: public VnCharset {
 protected:
-	UKWORD m_stdMap[256];
-	UKDWORD m_vnChars[TOTAL_VNCHARS];
-	UKWORD * m_toDoubleChar;
+	const UKWORD * m_stdMap;
+	const UKDWORD * m_vnChars;
+	const UKWORD * m_toDoubleChar;
 public:
-	DoubleByteCharset(UKWORD *vnChars);
+	DoubleByteCharset(const UKWORD *vnChars, const UKWORD *stdMap, const UKDWORD *sortedChars);
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
 };
@@ -153,7 +153,8 @@ public:
 class UnicodeUTF8Charset: public UnicodeCharset
 {
 public:
-	UnicodeUTF8Charset(UnicodeChar *vnChars) : UnicodeCharset(vnChars)	{}
+	UnicodeUTF8Charset(const UnicodeChar *vnChars, const UKDWORD *sortedChars)
+		: UnicodeCharset(vnChars, sortedChars)	{}
 
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
@@ -163,7 +164,8 @@ public:
 class UnicodeRefCharset: public UnicodeCharset
 {
 public:
-	UnicodeRefCharset(UnicodeChar *vnChars) : UnicodeCharset(vnChars)	{}
+	UnicodeRefCharset(const UnicodeChar *vnChars, const UKDWORD *sortedChars)
+		: UnicodeCharset(vnChars, sortedChars)	{}
 
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
@@ -173,7 +175,8 @@ public:
 class UnicodeHexCharset: public UnicodeRefCharset
 {
 public:
-	UnicodeHexCharset(UnicodeChar *vnChars) : UnicodeRefCharset(vnChars) {}
+	UnicodeHexCharset(const UnicodeChar *vnChars, const UKDWORD *sortedChars)
+		: UnicodeRefCharset(vnChars, sortedChars) {}
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
 };
 
@@ -183,7 +186,8 @@ class UnicodeCStringCharset: public UnicodeCharset
 protected:
 	int m_prevIsHex;
 public:
-	UnicodeCStringCharset(UnicodeChar *vnChars) : UnicodeCharset(vnChars) {}
+	UnicodeCStringCharset(const UnicodeChar *vnChars, const UKDWORD *sortedChars)
+		: UnicodeCharset(vnChars, sortedChars) {}
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
 	virtual void startInput();
@@ -192,13 +196,14 @@ public:
 //--------------------------------------------------
 class WinCP1258Charset: public VnCharset {
 protected:
-	UKWORD m_stdMap[256];
-	UKDWORD m_vnChars[TOTAL_VNCHARS*2];
-	UKWORD *m_toDoubleChar;
+	const UKWORD * m_stdMap;
+	const UKDWORD * m_vnChars;
+	const UKWORD *m_toDoubleChar;
 	int m_totalChars;
 
 public:
-	WinCP1258Charset(UKWORD *compositeChars, UKWORD *precomposedChars);
+	WinCP1258Charset(const UKWORD *compositeChars, const UKWORD *stdMap,
+			 const UKDWORD *sortedChars, int totalChars);
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
 };
@@ -211,11 +216,11 @@ struct UniCompCharInfo {
 
 class UnicodeCompCharset: public VnCharset {
 protected:
-	UniCompCharInfo m_info[TOTAL_VNCHARS*2];
-	UKDWORD *m_uniCompChars;
+	const UniCompCharInfo * m_info;
+	const UKDWORD *m_uniCompChars;
 	int m_totalChars;
 public:
-	UnicodeCompCharset(UnicodeChar *uniChars, UKDWORD *uniCompChars);
+	UnicodeCompCharset(const UKDWORD *uniCompChars, const UniCompCharInfo *sortedInfo, int totalChars);
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
 	virtual int putChar(ByteOutStream & os, StdVnChar stdChar, int & outLen);
     virtual int elementSize();
@@ -224,8 +229,10 @@ public:
 //--------------------------------------------------
 class VIQRCharset: public VnCharset {
 protected:
-	UKDWORD *m_vnChars;
-	UKWORD m_stdMap[256];
+	const UKDWORD *m_vnChars;
+	const UKWORD *m_stdMap;
+	const VnConvOptions *m_pOptions;
+	PatternList m_escPatterns, m_outEscPatterns;
 	int m_atWordBeginning;
 	int m_escapeBowl;
 	int m_escapeRoof;
@@ -236,7 +243,7 @@ protected:
 	int m_noOutEsc;
 public:
 	int m_suspicious;
-	VIQRCharset(UKDWORD *vnChars);
+	VIQRCharset(const UKDWORD *vnChars, const UKWORD *stdMap, const VnConvOptions *pOptions);
 	virtual void startInput();
 	virtual void startOutput();
 	virtual int nextInput(ByteInStream & is, StdVnChar & stdChar, int & bytesRead);
@@ -260,42 +267,53 @@ public:
 
 
 //--------------------------------------------------
-class DllInterface CVnCharsetLib {
+// Conversion context: options plus the charsets that keep state while
+// converting (VIQR, UTF8VIQR and C string). All other charsets only hold
+// tables, are built once and shared by every context, so a context is
+// cheap to create. Conversions through different contexts may run in
+// different threads at the same time; one context must not be used by two
+// threads at once.
+//--------------------------------------------------
+class DllInterface VnConvContext {
 protected:
-	SingleByteCharset * m_sgCharsets[CONV_TOTAL_SINGLE_CHARSETS];
-	DoubleByteCharset * m_dbCharsets[CONV_TOTAL_DOUBLE_CHARSETS];
-	UnicodeCharset * m_pUniCharset;	
-	UnicodeCompCharset * m_pUniCompCharset;
-	UnicodeUTF8Charset * m_pUniUTF8;
-	UnicodeRefCharset * m_pUniRef;
-	UnicodeHexCharset * m_pUniHex;
 	VIQRCharset * m_pVIQRCharObj;
 	UTF8VIQRCharset * m_pUVIQRCharObj;
-	WinCP1258Charset * m_pWinCP1258;
 	UnicodeCStringCharset *m_pUniCString;
-	VnInternalCharset *m_pVnIntCharset;
 
 public:
-	PatternList m_VIQREscPatterns, m_VIQROutEscPatterns;
 	VnConvOptions m_options;
-	CVnCharsetLib();
-	~CVnCharsetLib();
+	VnConvContext();
+	~VnConvContext();
 	VnCharset * getVnCharset(int charsetIdx);
+	// frees the charsets of the context; they are made again when needed
+	void releaseCharsets();
+
+	// same arguments and results as VnConvert() and genConvert()
+	int convert(int inCharset, int outCharset, UKBYTE *input, UKBYTE *output,
+		    int * pInLen, int * pMaxOutLen);
+	int convert(VnCharset & incs, VnCharset & outcs, ByteInStream & input, ByteOutStream & output);
 };
 
-extern unsigned char SingleByteTables[][TOTAL_VNCHARS];
-extern UKWORD DoubleByteTables[][TOTAL_VNCHARS];
-extern UnicodeChar UnicodeTable[TOTAL_VNCHARS];
-extern UKDWORD VIQRTable[TOTAL_VNCHARS];
-extern UKDWORD UnicodeComposite[TOTAL_VNCHARS];
-extern UKWORD WinCP1258[TOTAL_VNCHARS];
-extern UKWORD WinCP1258Pre[TOTAL_VNCHARS];
+typedef VnConvContext CVnCharsetLib;
 
-extern DllInterface CVnCharsetLib VnCharsetLibObj;
+extern const unsigned char SingleByteTables[][TOTAL_VNCHARS];
+extern const UKWORD DoubleByteTables[][TOTAL_VNCHARS];
+extern const UnicodeChar UnicodeTable[TOTAL_VNCHARS];
+extern const UKDWORD VIQRTable[TOTAL_VNCHARS];
+extern const UKDWORD UnicodeComposite[TOTAL_VNCHARS];
+extern const UKWORD WinCP1258[TOTAL_VNCHARS];
+extern const UKWORD WinCP1258Pre[TOTAL_VNCHARS];
+
+// context of VnConvert(), VnFileConvert(), VnConvSetOptions() and the engine
+extern DllInterface VnConvContext VnCharsetLibObj;
 extern VnConvOptions VnConvGlobalOptions;
-extern int StdVnNoTone[TOTAL_VNCHARS];
-extern int StdVnRootChar[TOTAL_VNCHARS];
+extern const int StdVnNoTone[TOTAL_VNCHARS];
+extern const int StdVnRootChar[TOTAL_VNCHARS];
+
+int wideCharCompare(const void *ele1, const void *ele2);
+int uniCompInfoCompare(const void *ele1, const void *ele2);
 
+DllInterface VnCharset * VnSharedCharset(int charsetIdx);
 DllInterface int genConvert(VnCharset & incs, VnCharset & outcs, ByteInStream & input, ByteOutStream & output);
 
 StdVnChar StdVnToUpper(StdVnChar ch);
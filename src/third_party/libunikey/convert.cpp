@@ -35,6 +35,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 int vnFileStreamConvert(int inCharset, int outCharset, FILE * inf, FILE *outf);
 
 DllExport int genConvert(VnCharset & incs, VnCharset & outcs, ByteInStream & input, ByteOutStream & output)
+{
+	return VnCharsetLibObj.convert(incs, outcs, input, output);
+}
+
+//----------------------------------------------
+int VnConvContext::convert(VnCharset & incs, VnCharset & outcs, ByteInStream & input, ByteOutStream & output)
 {
 	StdVnChar stdChar;
 	int bytesRead, bytesWritten;
@@ -47,11 +53,11 @@ DllExport int genConvert(VnCharset & incs, VnCharset & outcs, ByteInStream & inp
         stdChar = 0;
 		if (incs.nextInput(input, stdChar, bytesRead)) {
 			if (stdChar != INVALID_STD_CHAR) {
-			  if (VnCharsetLibObj.m_options.toLower)
+			  if (m_options.toLower)
 			    stdChar = StdVnToLower(stdChar);
-			  else if (VnCharsetLibObj.m_options.toUpper)
+			  else if (m_options.toUpper)
 			    stdChar = StdVnToUpper(stdChar);
-			  if (VnCharsetLibObj.m_options.removeTone)
+			  if (m_options.removeTone)
 			    stdChar = StdVnGetRoot(stdChar);
 			  ret = outcs.putChar(output, stdChar, bytesWritten);
 			}
@@ -79,6 +85,13 @@ DllExport int genConvert(VnCharset & incs, VnCharset & outcs, ByteInStream & inp
 
 DllExport int VnConvert(int inCharset, int outCharset, UKBYTE *input, UKBYTE *output, 
 	      int * pInLen, int * pMaxOutLen)
+{
+	return VnCharsetLibObj.convert(inCharset, outCharset, input, output, pInLen, pMaxOutLen);
+}
+
+//----------------------------------------------
+int VnConvContext::convert(int inCharset, int outCharset, UKBYTE *input, UKBYTE *output,
+			   int * pInLen, int * pMaxOutLen)
 {
 	int inLen, maxOutLen;
 	int ret = -1;
@@ -89,8 +102,8 @@ DllExport int VnConvert(int inCharset, int outCharset, UKBYTE *input, UKBYTE *ou
 	if (inLen != -1 && inLen < 0) // invalid inLen
 		return ret;
 
-	VnCharset *pInCharset = VnCharsetLibObj.getVnCharset(inCharset);
-	VnCharset *pOutCharset = VnCharsetLibObj.getVnCharset(outCharset);
+	VnCharset *pInCharset = getVnCharset(inCharset);
+	VnCharset *pOutCharset = getVnCharset(outCharset);
 
 	if (!pInCharset || !pOutCharset)
 		return VNCONV_INVALID_CHARSET;
@@ -98,7 +111,7 @@ DllExport int VnConvert(int inCharset, int outCharset, UKBYTE *input, UKBYTE *ou
 	StringBIStream is(input, inLen, pInCharset->elementSize());
 	StringBOStream os(output, maxOutLen);
 
-	ret = genConvert(*pInCharset, *pOutCharset, is, os);
+	ret = convert(*pInCharset, *pOutCharset, is, os);
 	*pMaxOutLen = os.getOutBytes();
 	*pInLen = is.left();
 	return ret;
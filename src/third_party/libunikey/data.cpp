@@ -55,10 +55,10 @@ Steps to add a 2-byte charset:
 - Double-byte characters are represented as a word in which the
   low byte is base character, high byte is tone mark (if present).
 */
-extern CharsetNameId CharsetIdMap[];
+extern const CharsetNameId CharsetIdMap[];
 extern const int CharsetCount;
 
-CharsetNameId CharsetIdMap[] = {
+const CharsetNameId CharsetIdMap[] = {
 	{"BKHCM1",		CONV_CHARSET_BKHCM1},
 	{"BKHCM2",		CONV_CHARSET_BKHCM2},
 	{"ISC",			CONV_CHARSET_ISC},
@@ -93,7 +93,7 @@ its code point in the charset must be set to zero.
 See TCVN3 & VPS below for examples
 */
 
-unsigned char SingleByteTables[][TOTAL_VNCHARS] = 
+const unsigned char SingleByteTables[][TOTAL_VNCHARS] = 
 
 // TCVN3
 {{'A','a','','','','','','','','','','',      // 0: a
@@ -241,7 +241,7 @@ unsigned char SingleByteTables[][TOTAL_VNCHARS] =
   0x00, 0x00, 0x00}
 };
 
-UKWORD DoubleByteTables[][TOTAL_VNCHARS] = {
+const UKWORD DoubleByteTables[][TOTAL_VNCHARS] = {
 //VNI-WIN
 { 0x0041, 0x0061, 0xd941, 0xf961, 0xd841, 0xf861, 0xdb41, 0xfb61, 0xd541, 0xf561, 0xcf41, 0xef61, //a
   0xc241, 0xe261, 0xc141, 0xe161, 0xc041, 0xe061, 0xc541, 0xe561, 0xc341, 0xe361, 0xc441, 0xe461, //a^
@@ -340,7 +340,7 @@ UKWORD DoubleByteTables[][TOTAL_VNCHARS] = {
   0x00cf, 0x003f, 0x00d9}
 };
 
-UKWORD WinCP1258[TOTAL_VNCHARS]=
+const UKWORD WinCP1258[TOTAL_VNCHARS]=
 //Windows CP 1258
 { 0x0041, 0x0061, 0xec41, 0xec61, 0xcc41, 0xcc61, 0xd241, 0xd261, 0xde41, 0xde61, 0xf241, 0xf261, //a
   0x00c2, 0x00e2, 0xecc2, 0xece2, 0xccc2, 0xcce2, 0xd2c2, 0xd2e2, 0xdec2, 0xdee2, 0xf2c2, 0xf2e2, //a^
@@ -366,7 +366,7 @@ UKWORD WinCP1258[TOTAL_VNCHARS]=
   0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009A, 0x009B,
   0x009C, 0x009E, 0x009F};
 
-UKWORD WinCP1258Pre[TOTAL_VNCHARS]=
+const UKWORD WinCP1258Pre[TOTAL_VNCHARS]=
 //Windows CP1258 - with some more precomposed characters
 { 0x0041, 0x0061, 0x00c1, 0x00e1, 0x00c0, 0x00e0, 0xd241, 0xd261, 0xde41, 0xde61, 0xf241, 0xf261, //a
   0x00c2, 0x00e2, 0xecc2, 0xece2, 0xccc2, 0xcce2, 0xd2c2, 0xd2e2, 0xdec2, 0xdee2, 0xf2c2, 0xf2e2, //a^
@@ -392,7 +392,7 @@ UKWORD WinCP1258Pre[TOTAL_VNCHARS]=
   0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009A, 0x009B,
   0x009C, 0x009E, 0x009F};
 
-UnicodeChar UnicodeTable[TOTAL_VNCHARS] =
+const UnicodeChar UnicodeTable[TOTAL_VNCHARS] =
 	{0x0041, 0x0061, 0x00c1, 0x00e1, 0x00c0, 0x00e0, 0x1ea2, 0x1ea3, 0x00c3, 0x00e3, 0x1ea0, 0x1ea1, //a
      0x00c2, 0x00e2, 0x1ea4, 0x1ea5, 0x1ea6, 0x1ea7, 0x1ea8, 0x1ea9, 0x1eaa, 0x1eab, 0x1eac, 0x1ead, //a^
 	 0x0102, 0x0103, 0x1eae, 0x1eaf, 0x1eb0, 0x1eb1, 0x1eb2, 0x1eb3, 0x1eb4, 0x1eb5, 0x1eb6, 0x1eb7, //a(
@@ -438,7 +438,7 @@ unsigned char WesternSymbols[] =
 + 0x2b
 
 */
-UKDWORD VIQRTable[TOTAL_VNCHARS] = 
+const UKDWORD VIQRTable[TOTAL_VNCHARS] = 
 	{  0x41,   0x61,   0x2741,   0x2761,   0x6041,   0x6061,   0x3f41,   0x3f61,   0x7e41,   0x7e61,   0x2e41,   0x2e61, //a
 	 0x5e41, 0x5e61, 0x275e41, 0x275e61, 0x605e41, 0x605e61, 0x3f5e41, 0x3f5e61, 0x7e5e41, 0x7e5e61, 0x2e5e41, 0x2e5e61, //a^
 	 0x2841, 0x2861, 0x272841, 0x272861, 0x602841, 0x602861, 0x3f2841, 0x3f2861, 0x7e2841, 0x7e2861, 0x2e2841, 0x2e2861, //a(
@@ -464,7 +464,7 @@ UKDWORD VIQRTable[TOTAL_VNCHARS] =
 	   0x9C, 0x9E, 0x9F};
 
 
-UKDWORD UnicodeComposite[TOTAL_VNCHARS] = 
+const UKDWORD UnicodeComposite[TOTAL_VNCHARS] = 
 { 0x00000041, 0x00000061, 0x03010041, 0x03010061, 0x03000041, 0x03000061, //a
   0x03090041, 0x03090061, 0x03030041, 0x03030061, 0x03230041, 0x03230061, //a
 
@@ -518,7 +518,7 @@ UKDWORD UnicodeComposite[TOTAL_VNCHARS] =
   0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 
   0x0153, 0x017E, 0x0178};
 
-int StdVnRootChar[TOTAL_VNCHARS] = {
+const int StdVnRootChar[TOTAL_VNCHARS] = {
   0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, //a [A=0]
   0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, //a^ -> a
   0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, //a( -> a
@@ -544,7 +544,7 @@ int StdVnRootChar[TOTAL_VNCHARS] = {
   210, 211, 212
 };
 
-int StdVnNoTone[TOTAL_VNCHARS] = {
+const int StdVnNoTone[TOTAL_VNCHARS] = {
   0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, //a [A=0]
   12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, //a^
   24, 25, 24, 25, 24, 25, 24, 25, 24, 25, 24, 25, //a(
@@ -569,3 +569,21 @@ int StdVnNoTone[TOTAL_VNCHARS] = {
   202, 203, 204, 205, 206, 207, 208, 209,
   210, 211, 212
 };
+
+//-------------------------------------------
+// Orders of the sorted tables in uktables.h
+//-------------------------------------------
+int wideCharCompare(const void *ele1, const void *ele2)
+{
+	UKWORD ch1 = LOWORD(*((UKDWORD *)ele1));
+	UKWORD ch2 = LOWORD(*((UKDWORD *)ele2));
+	return (ch1 == ch2)? 0 : ((ch1 > ch2)? 1 : -1);
+}
+
+//-------------------------------------------
+int uniCompInfoCompare(const void *ele1, const void *ele2)
+{
+	UKDWORD ch1 = ((UniCompCharInfo *)ele1)->compChar;
+	UKDWORD ch2 = ((UniCompCharInfo *)ele2)->compChar;
+	return (ch1 == ch2)? 0 : ((ch1 > ch2)? 1 : -1);
+}
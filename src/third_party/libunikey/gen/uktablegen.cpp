@@ -0,0 +1,385 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+// Writes uktables.cpp, the tables of uktables.h, deriving them from the
+// charset tables of data.cpp and the engine tables of ukdata.cpp. It is
+// built and run by the libunikey build; the library itself does none of
+// this work at run time.
+//
+//   uktablegen OUTPUT.cpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uktables.h"
+
+//----------------------------------------------------------------------------
+// Charsets
+//----------------------------------------------------------------------------
+static void makeUnicode(UKDWORD *sorted, const UnicodeChar *vnChars)
+{
+    for (UKDWORD i = 0; i < TOTAL_VNCHARS; i++)
+        sorted[i] = (i << 16) + vnChars[i]; // high word is used for index
+    qsort(sorted, TOTAL_VNCHARS, sizeof(UKDWORD), wideCharCompare);
+}
+
+//----------------------------------------------------------------------------
+static void makeSingleByte(UKWORD *stdMap, const unsigned char *vnChars)
+{
+    memset(stdMap, 0, 256*sizeof(UKWORD));
+    for (int i = 0; i < TOTAL_VNCHARS; i++) {
+        if (vnChars[i] != 0 && (i == TOTAL_VNCHARS-1 || vnChars[i] != vnChars[i+1]))
+            stdMap[vnChars[i]] = i + 1;
+    }
+}
+
+//----------------------------------------------------------------------------
+static void makeDoubleByte(UKWORD *stdMap, UKDWORD *sorted, const UKWORD *vnChars)
+{
+    memset(stdMap, 0, 256*sizeof(UKWORD));
+    for (int i = 0; i < TOTAL_VNCHARS; i++) {
+        if (vnChars[i] >> 8) // a 2-byte character
+            stdMap[vnChars[i] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
+        else if (stdMap[vnChars[i]] == 0)
+            stdMap[vnChars[i]] = i+1;
+        sorted[i] = (i << 16) + vnChars[i]; // high word is used for StdChar index
+    }
+    qsort(sorted, TOTAL_VNCHARS, sizeof(UKDWORD), wideCharCompare);
+}
+
+//----------------------------------------------------------------------------
+// Returns the number of characters in sorted
+//----------------------------------------------------------------------------
+static int makeWinCP1258(UKWORD *stdMap, UKDWORD *sorted,
+                         const UKWORD *compositeChars, const UKWORD *precomposedChars)
+{
+    int i, k, total;
+    memset(stdMap, 0, 256*sizeof(UKWORD));
+
+    // encode composite chars
+    for (i = 0; i < TOTAL_VNCHARS; i++) {
+        if (compositeChars[i] >> 8) // a 2-byte character
+            stdMap[compositeChars[i] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
+        else if (stdMap[compositeChars[i]] == 0)
+            stdMap[compositeChars[i]] = i+1;
+
+        sorted[i] = (i << 16) + compositeChars[i]; // high word is used for StdChar index
+    }
+
+    total = TOTAL_VNCHARS;
+
+    //add precomposed chars to the table
+    for (k = 0, i = TOTAL_VNCHARS; k < TOTAL_VNCHARS; k++)
+        if (precomposedChars[k] != compositeChars[k]) {
+            if (precomposedChars[k] >> 8) // a 2-byte character
+                stdMap[precomposedChars[k] >> 8] = 0xFFFF; //INVALID_STD_CHAR;
+            else if (stdMap[precomposedChars[k]] == 0)
+                stdMap[precomposedChars[k]] = k+1;
+
+            sorted[i] = (k << 16) + precomposedChars[k];
+            total++;
+            i++;
+        }
+
+    qsort(sorted, total, sizeof(UKDWORD), wideCharCompare);
+    return total;
+}
+
+//----------------------------------------------------------------------------
+// Returns the number of entries in info
+//----------------------------------------------------------------------------
+static int makeUnicodeComp(UniCompCharInfo *info, const UnicodeChar *uniChars,
+                           const UKDWORD *uniCompChars)
+{
+    int i, k, total = 0;
+    for (i = 0; i < TOTAL_VNCHARS; i++) {
+        info[i].compChar = uniCompChars[i];
+        info[i].stdIndex = i;
+        total++;
+    }
+
+    for (k = 0, i = TOTAL_VNCHARS; k < TOTAL_VNCHARS; k++)
+        if (uniChars[k] != uniCompChars[k]) {
+            info[i].compChar = uniChars[k];
+            info[i].stdIndex = k;
+            total++;
+            i++;
+        }
+
+    qsort(info, total, sizeof(UniCompCharInfo), uniCompInfoCompare);
+    return total;
+}
+
+//----------------------------------------------------------------------------
+static void makeVIQR(UKWORD *stdMap, const UKDWORD *vnChars)
+{
+    memset(stdMap, 0, 256*sizeof(UKWORD));
+    for (int i = 0; i < TOTAL_VNCHARS; i++) {
+        UKDWORD dw = vnChars[i];
+        if (!(dw & 0xffffff00)) //single byte
+            stdMap[dw] = i+256;
+    }
+
+    // set offset from base characters according to tone marks
+    stdMap[(unsigned char)'\''] = 2;
+    stdMap[(unsigned char)'`'] = 4;
+    stdMap[(unsigned char)'?'] = 6;
+    stdMap[(unsigned char)'~'] = 8;
+    stdMap[(unsigned char)'.'] = 10;
+    stdMap[(unsigned char)'^'] = 12;
+
+    stdMap[(unsigned char)'('] = 24;
+    stdMap[(unsigned char)'+'] = 26;
+    stdMap[(unsigned char)'*'] = 26;
+}
+
+//----------------------------------------------------------------------------
+// Engine
+//----------------------------------------------------------------------------
+static void makeSeqLists(VSeqPair *vSeqs, CSeqPair *cSeqs, VCPair *vcPairs)
+{
+    int i, j;
+
+    for (i = 0; i < VSeqCount; i++) {
+        for (j = 0; j < 3; j++)
+            vSeqs[i].v[j] = VSeqList[i].v[j];
+        vSeqs[i].vs = (VowelSeq)i;
+    }
+
+    for (i = 0; i < CSeqCount; i++) {
+        for (j = 0; j < 3; j++)
+            cSeqs[i].c[j] = CSeqList[i].c[j];
+        cSeqs[i].cs = (ConSeq)i;
+    }
+
+    memcpy(vcPairs, VCPairList, VCPairCount * sizeof(VCPair));
+
+    qsort(vSeqs, VSeqCount, sizeof(VSeqPair), tripleVowelCompare);
+    qsort(cSeqs, CSeqCount, sizeof(CSeqPair), tripleConCompare);
+    qsort(vcPairs, VCPairCount, sizeof(VCPair), VCPairCompare);
+}
+
+//----------------------------------------------------------------------------
+static void makeIsVnVowel(bool *isVowel)
+{
+    for (int i = 0; i < vnl_lastChar; i++)
+        isVowel[i] = true;
+
+    for (unsigned char ch = 'a'; ch <= 'z'; ch++) {
+        if (ch != 'a' && ch != 'e' && ch != 'i' &&
+            ch != 'o' && ch != 'u' && ch != 'y') {
+            isVowel[AZLexiLower[ch-'a']] = false;
+            isVowel[AZLexiUpper[ch-'a']] = false;
+        }
+    }
+    isVowel[vnl_dd] = false;
+    isVowel[vnl_DD] = false;
+}
+
+//----------------------------------------------------------------------------
+static void makeInputMaps(UkCharType *charTypes, VnLexiName *lexiMap, StdVnChar *stdMap)
+{
+    unsigned int c;
+    int i;
+
+    for (c = 0; c <= 32; c++)
+        charTypes[c] = ukcReset;
+    for (c = 33; c < 256; c++)
+        charTypes[c] = ukcNonVn;
+    for (c = 'a'; c <= 'z'; c++)
+        charTypes[c] = ukcVn;
+    for (c = 'A'; c <= 'Z'; c++)
+        charTypes[c] = ukcVn;
+    for (i = 0; AscVnLexiList[i].asc; i++)
+        charTypes[AscVnLexiList[i].asc] = ukcVn;
+
+    charTypes[(unsigned char)'j'] = ukcNonVn;
+    charTypes[(unsigned char)'J'] = ukcNonVn;
+    charTypes[(unsigned char)'f'] = ukcNonVn;
+    charTypes[(unsigned char)'F'] = ukcNonVn;
+    charTypes[(unsigned char)'w'] = ukcNonVn;
+    charTypes[(unsigned char)'W'] = ukcNonVn;
+
+    for (i = 0; i < WordBreakSymCount; i++)
+        charTypes[WordBreakSyms[i]] = ukcWordBreak;
+
+    for (i = 0; i < 256; i++)
+        lexiMap[i] = vnl_nonVnChar;
+    for (i = 0; AscVnLexiList[i].asc; i++)
+        lexiMap[AscVnLexiList[i].asc] = AscVnLexiList[i].lexi;
+    for (c = 'a'; c <= 'z'; c++)
+        lexiMap[c] = AZLexiLower[c - 'a'];
+    for (c = 'A'; c <= 'Z'; c++)
+        lexiMap[c] = AZLexiUpper[c - 'A'];
+
+    for (i = 0; i < 256; i++)
+        stdMap[i] = i;
+    for (i = 0; SpecialWesternChars[i]; i++)
+        stdMap[SpecialWesternChars[i]] = (vnl_lastChar + i) + VnStdCharOffset;
+    for (i = 0; i < 256; i++) {
+        if (lexiMap[i] != vnl_nonVnChar)
+            stdMap[i] = lexiMap[i] + VnStdCharOffset;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Output
+//----------------------------------------------------------------------------
+template <class T>
+static void writeValues(FILE *f, const T *values, int count, const char *format,
+                        const char *indent)
+{
+    for (int i = 0; i < count; i++) {
+        if (i % 8 == 0)
+            fputs(indent, f);
+        fprintf(f, format, (long long)values[i]);
+        fputs(i == count - 1 ? "\n" : (i % 8 == 7 ? ",\n" : ", "), f);
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+static void writeArray(FILE *f, const char *decl, const T *values, int count,
+                       const char *format)
+{
+    fprintf(f, "%s = {\n", decl);
+    writeValues(f, values, count, format, "    ");
+    fputs("};\n\n", f);
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+static void writeArrays(FILE *f, const char *decl, const T *values, int rows, int count,
+                        const char *format)
+{
+    fprintf(f, "%s = {\n", decl);
+    for (int r = 0; r < rows; r++) {
+        fputs("    {\n", f);
+        writeValues(f, values + r * count, count, format, "        ");
+        fputs(r == rows - 1 ? "    }\n" : "    },\n", f);
+    }
+    fputs("};\n\n", f);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s OUTPUT.cpp\n", argv[0]);
+        return 2;
+    }
+
+    static UKDWORD unicodeSorted[TOTAL_VNCHARS];
+    static UKWORD singleByteMaps[CONV_TOTAL_SINGLE_CHARSETS][256];
+    static UKWORD doubleByteMaps[CONV_TOTAL_DOUBLE_CHARSETS][256];
+    static UKDWORD doubleByteSorted[CONV_TOTAL_DOUBLE_CHARSETS][TOTAL_VNCHARS];
+    static UKWORD winCP1258Map[256];
+    static UKDWORD winCP1258Sorted[TOTAL_VNCHARS*2];
+    static UniCompCharInfo uniCompInfo[TOTAL_VNCHARS*2];
+    static UKWORD viqrMap[256];
+    static VSeqPair vSeqs[256];
+    static CSeqPair cSeqs[256];
+    static VCPair vcPairs[1024];
+    static bool isVowel[vnl_lastChar];
+    static UkCharType charTypes[256];
+    static VnLexiName lexiMap[256];
+    static StdVnChar isoStdMap[256];
+    int i;
+
+    if (VSeqCount > 256 || CSeqCount > 256 || VCPairCount > 1024) {
+        fprintf(stderr, "%s: sequence lists too long\n", argv[0]);
+        return 1;
+    }
+
+    makeUnicode(unicodeSorted, UnicodeTable);
+    for (i = 0; i < CONV_TOTAL_SINGLE_CHARSETS; i++)
+        makeSingleByte(singleByteMaps[i], SingleByteTables[i]);
+    for (i = 0; i < CONV_TOTAL_DOUBLE_CHARSETS; i++)
+        makeDoubleByte(doubleByteMaps[i], doubleByteSorted[i], DoubleByteTables[i]);
+    int winCP1258Count = makeWinCP1258(winCP1258Map, winCP1258Sorted, WinCP1258, WinCP1258Pre);
+    int uniCompCount = makeUnicodeComp(uniCompInfo, UnicodeTable, UnicodeComposite);
+    makeVIQR(viqrMap, VIQRTable);
+
+    makeSeqLists(vSeqs, cSeqs, vcPairs);
+    makeIsVnVowel(isVowel);
+    makeInputMaps(charTypes, lexiMap, isoStdMap);
+
+    FILE *f = fopen(argv[1], "w");
+    if (!f) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    fputs("// Generated by uktablegen from data.cpp and ukdata.cpp, do not edit.\n\n"
+          "#include \"uktables.h\"\n\n", f);
+
+    writeArray(f, "const UKDWORD UnicodeSortedChars[TOTAL_VNCHARS]",
+               unicodeSorted, TOTAL_VNCHARS, "0x%08llX");
+    writeArrays(f, "const UKWORD SingleByteStdMaps[CONV_TOTAL_SINGLE_CHARSETS][256]",
+                &singleByteMaps[0][0], CONV_TOTAL_SINGLE_CHARSETS, 256, "%lld");
+    writeArrays(f, "const UKWORD DoubleByteStdMaps[CONV_TOTAL_DOUBLE_CHARSETS][256]",
+                &doubleByteMaps[0][0], CONV_TOTAL_DOUBLE_CHARSETS, 256, "0x%04llX");
+    writeArrays(f, "const UKDWORD DoubleByteSortedChars[CONV_TOTAL_DOUBLE_CHARSETS][TOTAL_VNCHARS]",
+                &doubleByteSorted[0][0], CONV_TOTAL_DOUBLE_CHARSETS, TOTAL_VNCHARS, "0x%08llX");
+    writeArray(f, "const UKWORD WinCP1258StdMap[256]", winCP1258Map, 256, "0x%04llX");
+    writeArray(f, "const UKDWORD WinCP1258SortedChars[]", winCP1258Sorted, winCP1258Count,
+               "0x%08llX");
+    fprintf(f, "const int WinCP1258CharCount = %d;\n\n", winCP1258Count);
+
+    fputs("const UniCompCharInfo UnicodeCompSortedInfo[] = {\n", f);
+    for (i = 0; i < uniCompCount; i++)
+        fprintf(f, "    {0x%08X, %d}%s\n", (unsigned)uniCompInfo[i].compChar,
+                uniCompInfo[i].stdIndex, i == uniCompCount - 1 ? "" : ",");
+    fputs("};\n\n", f);
+    fprintf(f, "const int UnicodeCompCharCount = %d;\n\n", uniCompCount);
+
+    writeArray(f, "const UKWORD VIQRStdMap[256]", viqrMap, 256, "%lld");
+
+    fputs("const VSeqPair SortedVSeqList[] = {\n", f);
+    for (i = 0; i < VSeqCount; i++)
+        fprintf(f, "    {{(VnLexiName)%d, (VnLexiName)%d, (VnLexiName)%d}, (VowelSeq)%d}%s\n",
+                vSeqs[i].v[0], vSeqs[i].v[1], vSeqs[i].v[2], vSeqs[i].vs,
+                i == VSeqCount - 1 ? "" : ",");
+    fputs("};\n\n", f);
+
+    fputs("const CSeqPair SortedCSeqList[] = {\n", f);
+    for (i = 0; i < CSeqCount; i++)
+        fprintf(f, "    {{(VnLexiName)%d, (VnLexiName)%d, (VnLexiName)%d}, (ConSeq)%d}%s\n",
+                cSeqs[i].c[0], cSeqs[i].c[1], cSeqs[i].c[2], cSeqs[i].cs,
+                i == CSeqCount - 1 ? "" : ",");
+    fputs("};\n\n", f);
+
+    fputs("const VCPair SortedVCPairList[] = {\n", f);
+    for (i = 0; i < VCPairCount; i++)
+        fprintf(f, "    {(VowelSeq)%d, (ConSeq)%d}%s\n", vcPairs[i].v, vcPairs[i].c,
+                i == VCPairCount - 1 ? "" : ",");
+    fputs("};\n\n", f);
+
+    writeArray(f, "const bool IsVnVowel[vnl_lastChar]", isVowel, vnl_lastChar, "%lld");
+    writeArray(f, "const UkCharType UkcMap[256]", charTypes, 256, "(UkCharType)%lld");
+    writeArray(f, "const VnLexiName IsoVnLexiMap[256]", lexiMap, 256, "(VnLexiName)%lld");
+    writeArray(f, "const StdVnChar IsoStdVnCharMap[256]", isoStdMap, 256, "0x%llX");
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    return 0;
+}
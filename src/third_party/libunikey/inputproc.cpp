@@ -22,81 +22,12 @@
  */
 
 #include <iostream>
+#include <string.h>
 #include "inputproc.h"
+#include "uktables.h"
 
 using namespace std;
 
-/*
-unsigned char WordBreakSyms[] = {
-	',', ';', ':', '.', '\"', '\'', '!', '?', ' ',
-	'<', '>', '=', '+', '-', '*', '/', '\\',
-	'_', '~', '`', '@', '#', '$', '%', '^', '&', '(', ')', '{', '}', '[', ']'};
-*/
-
-unsigned char WordBreakSyms[] = {
-	',', ';', ':', '.', '\"', '\'', '!', '?', ' ',
-	'<', '>', '=', '+', '-', '*', '/', '\\',
-	'_', '@', '#', '$', '%', '&', '(', ')', '{', '}', '[', ']', '|'}; //we excluded ~, `, ^
-
-VnLexiName AZLexiUpper[] = 
-  {vnl_A, vnl_B, vnl_C, vnl_D, vnl_E, vnl_F, vnl_G, vnl_H, vnl_I, vnl_J,
-   vnl_K, vnl_L, vnl_M, vnl_N, vnl_O, vnl_P, vnl_Q, vnl_R, vnl_S, vnl_T,
-   vnl_U, vnl_V, vnl_W, vnl_X, vnl_Y, vnl_Z};
-
-VnLexiName AZLexiLower[] =
-  {vnl_a, vnl_b, vnl_c, vnl_d, vnl_e, vnl_f, vnl_g, vnl_h, vnl_i, vnl_j,
-   vnl_k, vnl_l, vnl_m, vnl_n, vnl_o, vnl_p, vnl_q, vnl_r, vnl_s, vnl_t,
-   vnl_u, vnl_v, vnl_w, vnl_x, vnl_y, vnl_z};
-
-UkCharType UkcMap[256];
-
-struct _ascVnLexi {
-    int asc;
-    VnLexiName lexi;
-};
-
-//List of western characters outside range A-Z that are
-//also Vietnamese characters
-_ascVnLexi AscVnLexiList[] = {
-    {0xC0, vnl_A2},
-    {0xC1, vnl_A1},
-    {0xC2, vnl_Ar},
-    {0xC2, vnl_A4},
-    {0xC8, vnl_E2},
-    {0xC9, vnl_E1},
-    {0xCA, vnl_Er},
-    {0xCC, vnl_I2},
-    {0xCD, vnl_I1},
-    {0xD2, vnl_O2},
-    {0xD3, vnl_O1},
-    {0xD4, vnl_Or},
-    {0xD5, vnl_O4},
-    {0xD9, vnl_U2},
-    {0xDA, vnl_U1},
-    {0xDD, vnl_Y1},
-    {0xE0, vnl_a2},
-    {0xE1, vnl_a1},
-    {0xE2, vnl_ar},
-    {0xE3, vnl_a4},
-    {0xE8, vnl_e2},
-    {0xE9, vnl_e1},
-    {0xEA, vnl_er},
-    {0xEC, vnl_i2},
-    {0xED, vnl_i1},
-    {0xF2, vnl_o2},
-    {0xF3, vnl_o1},
-    {0xF4, vnl_or},
-    {0xF5, vnl_o4},
-    {0xF9, vnl_u2},
-    {0xFA, vnl_u1},
-    {0xFD, vnl_y1},
-    {0x00, vnl_nonVnChar}
-};
-
-VnLexiName IsoVnLexiMap[256];
-
-bool ClassifierTableInitialized = false;
-
 DllExport UkKeyMapping TelexMethodMapping[] = {
     {'Z', vneTone0},
     {'S', vneTone1},
@@ -204,70 +135,9 @@ DllExport UkKeyMapping MsViMethodMapping[] = {
     {0, vneNormal}
 };
 
-//-------------------------------------------
-void SetupInputClassifierTable()
-{
-  unsigned int c;
-  int i;
-
-  for (c=0; c<=32; c++) {
-    UkcMap[c] = ukcReset;
-  }
-
-  for (c=33; c<256; c++) {
-    UkcMap[c] = ukcNonVn;
-  }
-
-  /*
-  for (c = '0'; c <= '9'; c++)
-    UkcMap[c] = ukcNonVn;
-  */
-
-  for (c = 'a'; c <= 'z'; c++)
-    UkcMap[c] = ukcVn;
-  for (c = 'A'; c <= 'Z'; c++)
-    UkcMap[c] = ukcVn;
-
-  for (i=0; AscVnLexiList[i].asc; i++) {
-      UkcMap[AscVnLexiList[i].asc] = ukcVn;
-  }
-
-  UkcMap[(unsigned char)'j'] = ukcNonVn;
-  UkcMap[(unsigned char)'J'] = ukcNonVn;
-  UkcMap[(unsigned char)'f'] = ukcNonVn;
-  UkcMap[(unsigned char)'F'] = ukcNonVn;
-  UkcMap[(unsigned char)'w'] = ukcNonVn;
-  UkcMap[(unsigned char)'W'] = ukcNonVn;
-
-  int count = sizeof(WordBreakSyms)/sizeof(unsigned char);
-  for (i = 0; i < count; i++)
-    UkcMap[WordBreakSyms[i]] = ukcWordBreak;
-
-  //Calculate IsoVnLexiMap
-  for (i = 0; i < 256; i++) {
-      IsoVnLexiMap[i] = vnl_nonVnChar;
-  }
-
-  for (i = 0; AscVnLexiList[i].asc; i++) {
-      IsoVnLexiMap[AscVnLexiList[i].asc] = AscVnLexiList[i].lexi;
-  }
-
-  for (c = 'a'; c <= 'z'; c++) {
-      IsoVnLexiMap[c] = AZLexiLower[c - 'a'];
-  }
-
-  for (c = 'A'; c <= 'Z'; c++) {
-      IsoVnLexiMap[c] = AZLexiUpper[c - 'A'];
-  }
-}
-
 //-------------------------------------------
 void UkInputProcessor::init()
 {
-  if (!ClassifierTableInitialized) {
-    SetupInputClassifierTable();
-    ClassifierTableInitialized = true;
-  }
   setIM(UkTelex);
 }
 
@@ -320,6 +190,12 @@ void UkResetKeyMap(int keyMap[256])
     keyMap[c] = vneNormal;
 }
 
+//-------------------------------------------
+void UkResetKeyMap(unsigned char keyMap[256])
+{
+  memset(keyMap, vneNormal, 256);
+}
+
 //-------------------------------------------
 void UkInputProcessor::useBuiltIn(UkKeyMapping *map)
 {
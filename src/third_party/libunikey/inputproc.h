@@ -52,7 +52,7 @@ enum UkKeyEvName {
   vneCount //just to count how many event types there are
 };
 
-enum UkCharType {
+enum UkCharType : unsigned char {
   ukcVn,
   ukcWordBreak, 
   ukcNonVn, 
@@ -60,11 +60,11 @@ enum UkCharType {
 };
 
 struct UkKeyEvent {
-  int evType;
-  UkCharType chType;
-  VnLexiName vnSym; //meaningful only when chType==ukcVn
   unsigned int keyCode;
-  int tone; //meaningful only when this is a vowel
+  VnLexiName vnSym; //meaningful only when chType==ukcVn
+  unsigned char evType;
+  UkCharType chType;
+  signed char tone; //meaningful only when this is a vowel
 };
 
 struct UkKeyMapping {
@@ -100,22 +100,23 @@ protected:
   static bool m_classInit;
 
   UkInputMethod m_im;
-  int m_keyMap[256];
+  unsigned char m_keyMap[256]; //actions are below vneCount + vnl_lastChar
 
   void useBuiltIn(UkKeyMapping *map);
 
 };
 
 void UkResetKeyMap(int keyMap[256]);
-void SetupInputClassifierTable();
+void UkResetKeyMap(unsigned char keyMap[256]);
 
 DllInterface extern UkKeyMapping TelexMethodMapping[];
 DllInterface extern UkKeyMapping SimpleTelexMethodMapping[];
+DllInterface extern UkKeyMapping SimpleTelex2MethodMapping[];
 DllInterface extern UkKeyMapping VniMethodMapping[];
 DllInterface extern UkKeyMapping VIQRMethodMapping[];
 DllInterface extern UkKeyMapping MsViMethodMapping[];
 
-extern VnLexiName IsoVnLexiMap[];
+extern const VnLexiName IsoVnLexiMap[];
 inline VnLexiName IsoToVnLexi(unsigned int keyCode)
 {
     return (keyCode >= 256)? vnl_nonVnChar : IsoVnLexiMap[keyCode];
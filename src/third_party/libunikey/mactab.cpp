@@ -32,11 +32,90 @@ using namespace std;
 #define UKMACRO_VERSION_UTF8 1
 
 //---------------------------------------------------------------
-void CMacroTable::init()
+CMacroTable::CMacroTable()
 {
-  m_memSize = MACRO_MEM_SIZE;
+  m_table = 0;
+  m_macroMem = 0;
+  m_tableSize = 0;
+  m_memSize = 0;
   m_count = 0;
   m_occupied = 0;
+  m_sharedCopy = 0;
+  m_sharedTable = 0;
+  m_sharedMem = 0;
+  m_sharedCount = 0;
+}
+
+//---------------------------------------------------------------
+CMacroTable::~CMacroTable()
+{
+  resetContent();
+  unloadShared();
+}
+
+//---------------------------------------------------------------
+void CMacroTable::init()
+{
+  resetContent();
+}
+
+//---------------------------------------------------------------
+// Make room for count items and memSize bytes of keys and texts,
+// within MAX_MACRO_ITEMS and MACRO_MEM_SIZE. Returns false if the
+// table is full
+//---------------------------------------------------------------
+bool CMacroTable::reserve(int count, int memSize)
+{
+  if (count > MAX_MACRO_ITEMS)
+    return false;
+  if (memSize > MACRO_MEM_SIZE)
+    memSize = MACRO_MEM_SIZE;
+
+  if (count > m_tableSize) {
+    int size = m_tableSize ? m_tableSize * 2 : 64;
+    if (size > MAX_MACRO_ITEMS)
+      size = MAX_MACRO_ITEMS;
+    MacroDef *table = (MacroDef *)realloc(m_table, size * sizeof(MacroDef));
+    if (!table)
+      return false;
+    m_table = table;
+    m_tableSize = size;
+  }
+
+  if (memSize > m_memSize) {
+    int size = m_memSize ? m_memSize * 2 : 4096;
+    if (size < memSize)
+      size = memSize;
+    if (size > MACRO_MEM_SIZE)
+      size = MACRO_MEM_SIZE;
+    char *mem = (char *)realloc(m_macroMem, size);
+    if (!mem)
+      return false;
+    m_macroMem = mem;
+    m_memSize = size;
+  }
+  return m_occupied < m_memSize;
+}
+
+//---------------------------------------------------------------
+// Give back the room reserved but not used
+//---------------------------------------------------------------
+void CMacroTable::compact()
+{
+  if (m_count == 0) {
+    resetContent();
+    return;
+  }
+  MacroDef *table = (MacroDef *)realloc(m_table, m_count * sizeof(MacroDef));
+  if (table) {
+    m_table = table;
+    m_tableSize = m_count;
+  }
+  char *mem = (char *)realloc(m_macroMem, m_occupied);
+  if (mem) {
+    m_macroMem = mem;
+    m_memSize = m_occupied;
+  }
 }
 
 //---------------------------------------------------------------
@@ -108,6 +187,13 @@ const StdVnChar *CMacroTable::lookup(StdVnChar *key)
   MacroDef *p = (MacroDef *)bsearch(key, m_table, m_count, sizeof(MacroDef), macKeyCompare);
   if (p)
     return (StdVnChar *)(m_macroMem + p->textOffset);
+
+  if (m_sharedCount == 0)
+    return 0;
+  MacCompareStartMem = (char *)m_sharedMem;
+  p = (MacroDef *)bsearch(key, m_sharedTable, m_sharedCount, sizeof(MacroDef), macKeyCompare);
+  if (p)
+    return (StdVnChar *)(m_sharedMem + p->textOffset);
   return 0;
 }
 
@@ -164,7 +250,9 @@ void CMacroTable::writeHeader(FILE *f)
 #endif
 }
 //---------------------------------------------------------------
-int CMacroTable::loadFromFile(const char *fname)
+// Read and sort the macros of a file, without converting it
+//---------------------------------------------------------------
+int CMacroTable::readFile(const char *fname, int & version)
 {
     FILE *f;
 #if defined(WIN32)
@@ -181,7 +269,6 @@ int CMacroTable::loadFromFile(const char *fname)
     resetContent();
 
     //read possible header
-    int version;
     if (!readHeader(f, version)) {
         version = 0;
     }
@@ -200,6 +287,16 @@ int CMacroTable::loadFromFile(const char *fname)
     fclose(f);
     MacCompareStartMem = m_macroMem;
     qsort(m_table, m_count, sizeof(MacroDef), macCompare);
+    compact();
+    return 1;
+}
+
+//---------------------------------------------------------------
+int CMacroTable::loadFromFile(const char *fname)
+{
+    int version;
+    if (!readFile(fname, version))
+        return 0;
     // Convert old version
     if (version != UKMACRO_VERSION_UTF8) {
         writeToFile(fname);
@@ -207,6 +304,104 @@ int CMacroTable::loadFromFile(const char *fname)
     return 1;
 }
 
+//---------------------------------------------------------------
+// Load the system macros from their shared image, publishing one
+// if there is none yet
+//---------------------------------------------------------------
+int CMacroTable::loadSharedFile(const char *fname)
+{
+    unloadShared();
+
+    if (m_sharedImage.attach(fname, UKMACRO_IMAGE_VERSION) &&
+        setShared(m_sharedImage.data(), m_sharedImage.size()))
+        return 1;
+    m_sharedImage.detach();
+
+    CMacroTable table;
+    int version;
+    long size = 0;
+    char *image = 0;
+    if (table.readFile(fname, version))
+        image = table.makeImage(size);
+    if (!image)
+        return 0;
+
+    if (m_sharedImage.publish(fname, UKMACRO_IMAGE_VERSION, image, size) &&
+        setShared(m_sharedImage.data(), m_sharedImage.size())) {
+        delete [] image;
+        return 1;
+    }
+    m_sharedImage.detach();
+
+    m_sharedCopy = image;
+    setShared(m_sharedCopy, size);
+    return 1;
+}
+
+//---------------------------------------------------------------
+void CMacroTable::unloadShared()
+{
+  m_sharedImage.detach();
+  delete [] m_sharedCopy;
+  m_sharedCopy = 0;
+  m_sharedTable = 0;
+  m_sharedMem = 0;
+  m_sharedCount = 0;
+}
+
+//---------------------------------------------------------------
+int CMacroTable::removeSharedFile(const char *fname)
+{
+  return UkShmImage::remove(fname, UKMACRO_IMAGE_VERSION);
+}
+
+//---------------------------------------------------------------
+char *CMacroTable::makeImage(long & size)
+{
+  MacroImageHeader header;
+  header.count = m_count;
+  header.memSize = m_occupied;
+  size = sizeof(header) + m_count * sizeof(MacroDef) + m_occupied;
+
+  char *image = new char[size];
+  memcpy(image, &header, sizeof(header));
+  if (m_count > 0) {
+    memcpy(image + sizeof(header), m_table, m_count * sizeof(MacroDef));
+    memcpy(image + sizeof(header) + m_count * sizeof(MacroDef), m_macroMem, m_occupied);
+  }
+  return image;
+}
+
+//---------------------------------------------------------------
+// Point the system table at an image, if it is well formed
+//---------------------------------------------------------------
+bool CMacroTable::setShared(const void *image, long size)
+{
+  const MacroImageHeader *header = (const MacroImageHeader *)image;
+  if (size < (long)sizeof(MacroImageHeader) || header->count < 0 ||
+      header->memSize < 0 || header->memSize % sizeof(StdVnChar) != 0 ||
+      size != (long)(sizeof(MacroImageHeader) + header->count * sizeof(MacroDef) + header->memSize))
+    return false;
+
+  const MacroDef *table = (const MacroDef *)(header + 1);
+  const char *mem = (const char *)(table + header->count);
+  if (header->count > 0 &&
+      *(const StdVnChar *)(mem + header->memSize - sizeof(StdVnChar)) != 0)
+    return false;
+  for (int i = 0; i < header->count; i++) {
+    if (table[i].keyOffset < 0 || table[i].keyOffset >= header->memSize ||
+        table[i].keyOffset % sizeof(StdVnChar) != 0 ||
+        table[i].textOffset < 0 || table[i].textOffset >= header->memSize ||
+        table[i].textOffset % sizeof(StdVnChar) != 0)
+      return false;
+  }
+
+  m_sharedTable = table;
+  m_sharedMem = mem;
+  m_sharedCount = header->count;
+  return true;
+}
+
 //---------------------------------------------------------------
 int CMacroTable::writeToFile(const char *fname)
 {
@@ -264,11 +459,12 @@ int CMacroTable::addItem(const void *key, const void *text, int charset)
   int ret;
   int inLen, maxOutLen;
   int offset = m_occupied;
-  char *p = m_macroMem + offset;
 
-  if (m_count >= MAX_MACRO_ITEMS)
+  if (!reserve(m_count + 1,
+               offset + (MAX_MACRO_KEY_LEN + MAX_MACRO_TEXT_LEN) * sizeof(StdVnChar)))
     return -1;
-  
+
+  char *p = m_macroMem + offset;
   m_table[m_count].keyOffset = offset;
 
   // Convert macro key to VN standard
@@ -325,6 +521,12 @@ int CMacroTable::addItem(const char *item, int charset)
 //---------------------------------------------------------------
 void CMacroTable::resetContent()
 {
+  free(m_table);
+  free(m_macroMem);
+  m_table = 0;
+  m_macroMem = 0;
+  m_tableSize = 0;
+  m_memSize = 0;
   m_occupied = 0;
   m_count = 0;
 }
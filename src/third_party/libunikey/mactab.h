@@ -26,6 +26,7 @@
 
 #include "keycons.h"
 #include "charset.h"
+#include "ukshm.h"
 
 #if defined(_WIN32)
     #if defined(UNIKEYHOOK)
@@ -49,13 +50,40 @@ struct MacroDef
 typedef char TCHAR;
 #endif
 
+//---------------------------------------------------------------
+// Macros of the user, layered over the read-only system macros of the
+// host. lookup() looks in the user's own table first. The system table is
+// loaded with loadSharedFile() as an image that all processes map from
+// shared memory (see ukshm.h), or a private copy of it where that fails.
+// getCount(), getKey() and getText() only see the user's own macros.
+//
+// Image layout: MacroImageHeader, MacroDef[count], memSize bytes of keys
+// and texts, each a null-terminated StdVnChar string.
+//---------------------------------------------------------------
+#define UKMACRO_IMAGE_VERSION 1
+
+struct MacroImageHeader
+{
+  int count;
+  int memSize;
+};
+
 class DllInterface CMacroTable
 {
 public:
+    CMacroTable();
+    ~CMacroTable();
+
     void init();
     int loadFromFile(const char *fname);
     int writeToFile(const char *fname);
 
+    int loadSharedFile(const char *fname);
+    void unloadShared();
+    int getSharedCount() { return m_sharedCount; }
+    bool isSharedMapped() { return m_sharedImage.isAttached(); }
+    static int removeSharedFile(const char *fname);
+
     const StdVnChar *lookup(StdVnChar *key);
     const StdVnChar *getKey(int idx);
     const StdVnChar *getText(int idx);
@@ -67,12 +95,26 @@ public:
 protected:
     bool readHeader(FILE *f, int & version);
     void writeHeader(FILE *f);
+    int readFile(const char *fname, int & version);
+    bool reserve(int count, int memSize);
+    void compact();
+    char *makeImage(long & size);
+    bool setShared(const void *image, long size);
 
-    MacroDef m_table[MAX_MACRO_ITEMS];
-    char m_macroMem[MACRO_MEM_SIZE];
+    // allocated on the first item and grown as needed, up to
+    // MAX_MACRO_ITEMS and MACRO_MEM_SIZE; trimmed to size after loading
+    MacroDef *m_table;
+    char *m_macroMem;
+    int m_tableSize;
 
     int m_count;
     int m_memSize, m_occupied;
+
+    UkShmImage m_sharedImage;
+    char *m_sharedCopy; //the image, if it could not be shared
+    const MacroDef *m_sharedTable;
+    const char *m_sharedMem;
+    int m_sharedCount;
 };
 
 #endif
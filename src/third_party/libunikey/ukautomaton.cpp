@@ -0,0 +1,791 @@
+// -*- mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ * Copyright (C) 2000-2005 Pham Kim Long
+ * Contact:
+ *   unikey@gmail.com
+ *   UniKey project: http://unikey.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ukautomaton.h"
+#include "ukengine.h"
+#include "ukdata.h"
+#include "ukkeystroke.h"
+#include "vnconv.h"
+
+bool isValidCVC(ConSeq c1, VowelSeq v, ConSeq c2);
+
+//---------------------------------------------------------------
+static uint32_t OptionBits(const UnikeyOptions & opt)
+{
+    return (opt.freeMarking? UKAUTO_OPT_FREE_MARKING : 0) |
+           (opt.modernStyle? UKAUTO_OPT_MODERN_STYLE : 0) |
+           (opt.spellCheckEnabled? UKAUTO_OPT_SPELL_CHECK : 0) |
+           (opt.autoNonVnRestore? UKAUTO_OPT_AUTO_RESTORE : 0);
+}
+
+//---------------------------------------------------------------
+UkAutomaton::UkAutomaton()
+{
+    m_map = 0;
+    m_mapSize = 0;
+    m_header = 0;
+    m_states = 0;
+    m_edges = 0;
+    m_edgeOps = 0;
+    m_wordEnds = 0;
+    m_ops = 0;
+    m_keys = 0;
+}
+
+//---------------------------------------------------------------
+UkAutomaton::~UkAutomaton()
+{
+    unload();
+}
+
+//---------------------------------------------------------------
+// Checks every offset in the file, the engine follows them unchecked
+//---------------------------------------------------------------
+static bool ValidOp(uint32_t offset, uint32_t opSize, const unsigned char *ops)
+{
+    return offset + 3 <= opSize && offset + 3 + ops[offset+2] <= opSize;
+}
+
+//---------------------------------------------------------------
+int UkAutomaton::load(const char *fileName)
+{
+    unload();
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (long)sizeof(UkAutomatonHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const UkAutomatonHeader *header = (const UkAutomatonHeader *)map;
+    long expected = sizeof(UkAutomatonHeader) +
+        ((long)header->stateCount + 1) * sizeof(UkAutomatonState) +
+        (long)header->edgeCount * 2 * sizeof(uint32_t) +
+        (long)header->wordEndCount * sizeof(UkAutomatonWordEnd) +
+        header->opSize + header->keySize;
+
+    if (memcmp(header->magic, UKAUTO_MAGIC, sizeof(header->magic)) != 0 ||
+        header->stateCount == 0 || header->stateCount > UKAUTO_MAX_STATES ||
+        header->root >= header->stateCount || header->wordBreak >= header->stateCount ||
+        expected != st.st_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    const UkAutomatonState *states = (const UkAutomatonState *)(header + 1);
+    const uint32_t *edges = (const uint32_t *)(states + header->stateCount + 1);
+    const uint32_t *edgeOps = edges + header->edgeCount;
+    const UkAutomatonWordEnd *wordEnds = (const UkAutomatonWordEnd *)(edgeOps + header->edgeCount);
+    const unsigned char *ops = (const unsigned char *)(wordEnds + header->wordEndCount);
+    const unsigned char *keys = ops + header->opSize;
+
+    bool valid = states[0].firstEdge == 0 &&
+                 states[header->stateCount].firstEdge == header->edgeCount;
+    for (uint32_t s = 0; valid && s < header->stateCount; s++) {
+        const UkAutomatonState & state = states[s];
+        valid = state.firstEdge <= states[s+1].firstEdge &&
+                state.settleTarget < header->stateCount &&
+                state.wordEnd <= header->wordEndCount;
+    }
+    for (uint32_t e = 0; valid && e < header->edgeCount; e++) {
+        valid = UKAUTO_EDGE_TARGET(edges[e]) < header->stateCount &&
+                ValidOp(edgeOps[e], header->opSize, ops);
+    }
+    for (uint32_t w = 0; valid && w < header->wordEndCount; w++) {
+        const UkAutomatonWordEnd & end = wordEnds[w];
+        for (int r = 0; r < ukr_count; r++)
+            valid = valid && ValidOp(end.op[r], header->opSize, ops);
+        valid = valid && (end.dictKey >> 8) + (end.dictKey & 0xFF) <= header->keySize &&
+                (end.dictKey & 0xFF) <= UKDICT_MAX_KEY;
+    }
+    if (!valid) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    m_map = map;
+    m_mapSize = st.st_size;
+    m_header = header;
+    m_states = states;
+    m_edges = edges;
+    m_edgeOps = edgeOps;
+    m_wordEnds = wordEnds;
+    m_ops = ops;
+    m_keys = keys;
+    return 1;
+}
+
+//---------------------------------------------------------------
+void UkAutomaton::unload()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_header = 0;
+    m_states = 0;
+    m_edges = 0;
+    m_edgeOps = 0;
+    m_wordEnds = 0;
+    m_ops = 0;
+    m_keys = 0;
+}
+
+//---------------------------------------------------------------
+bool UkAutomaton::matches(UkSharedMem *ctrl) const
+{
+    if (!m_header)
+        return false;
+    return ctrl->vietKey && !ctrl->options.macroEnabled &&
+           (uint32_t)ctrl->input.getIM() == m_header->inputMethod &&
+           (uint32_t)ctrl->charsetId == m_header->charsetId &&
+           OptionBits(ctrl->options) == m_header->options;
+}
+
+//---------------------------------------------------------------
+// Binary search without data dependent branches, as in UkDictionary
+//---------------------------------------------------------------
+int UkAutomaton::findEdge(uint32_t s, unsigned int label) const
+{
+    uint32_t lo = m_states[s].firstEdge;
+    uint32_t n = m_states[s+1].firstEdge - lo;
+    if (n == 0)
+        return -1;
+
+    const uint32_t *base = m_edges + lo;
+    while (n > 1) {
+        uint32_t half = n / 2;
+        base = (UKAUTO_EDGE_LABEL(base[half]) <= label) ? base + half : base;
+        n -= half;
+    }
+    if (UKAUTO_EDGE_LABEL(*base) != label)
+        return -1;
+    return base - m_edges;
+}
+
+//---------------------------------------------------------------
+UkAutomatonBuilder::UkAutomatonBuilder()
+{
+    setBreakKeys(" ,.");
+    m_stateCount = 0;
+    m_edgeCount = 0;
+    m_wordEndCount = 0;
+    m_fileSize = 0;
+}
+
+//---------------------------------------------------------------
+void UkAutomatonBuilder::setBreakKeys(const char *keys)
+{
+    memset(m_breakKeys, 0, sizeof(m_breakKeys));
+    for (const unsigned char *p = (const unsigned char *)keys; *p; p++)
+        m_breakKeys[*p] = 1;
+}
+
+
+//---------------------------------------------------------------
+// The state of one build: the keys of the syllables as a trie, and the
+// states and edges found so far. A state is known by two 64 bit hashes of
+// everything in the engine that a later call may read, the 'w' as "ư"
+// flag aside, which goes into the edge labels.
+//---------------------------------------------------------------
+class UkAutomatonBuilder::Explorer {
+public:
+    struct TrieNode {
+        std::map<unsigned char, int> next;
+        bool end;
+        TrieNode() : end(false) {}
+    };
+
+    struct StateInfo {
+        UkAutomatonState state;
+        std::map<unsigned int, std::pair<uint32_t, uint32_t> > edges; //label -> target, op
+    };
+
+    Explorer(UkSharedMem *ctrl, const char *breakKeys, UkDictionary *emptyDict);
+
+    bool addSyllables();
+    void run();
+
+    std::vector<TrieNode> m_trie;
+    std::vector<StateInfo> m_states;
+    std::vector<UkAutomatonWordEnd> m_wordEnds;
+    std::string m_ops;
+    std::string m_keys;
+    uint32_t m_root;
+    bool m_error;
+
+protected:
+    struct Signature {
+        uint64_t a, b;
+        bool operator==(const Signature & other) const { return a == other.a && b == other.b; }
+    };
+    struct SignatureHash {
+        size_t operator()(const Signature & sig) const { return sig.a ^ (sig.b >> 7); }
+    };
+
+    static Signature signature(const UkEngine & e);
+    uint32_t stateOf(const UkEngine & e);
+    void explore(const UkEngine & e, uint32_t id, int node);
+    void addEdge(uint32_t id, unsigned int label, uint32_t target, uint32_t op);
+    void addWordEnd(const UkEngine & e, uint32_t id);
+    std::string step(UkEngine & e, unsigned int keyCode);
+    uint32_t addOp(const std::string & op);
+    void addKeys(const std::string & keys);
+
+    UkSharedMem *m_ctrl;
+    const char *m_breakKeys;
+    UkDictionary *m_emptyDict;
+    UkWordSet m_keeping; //any learned word makes keepsConvertedPrefix() true
+    std::unordered_map<Signature, uint32_t, SignatureHash> m_ids;
+    std::unordered_set<uint64_t> m_visited; //state << 32 | trie node
+    std::map<std::string, uint32_t> m_opIds;
+    std::map<std::string, uint32_t> m_keyIds;
+};
+
+//---------------------------------------------------------------
+UkAutomatonBuilder::Explorer::Explorer(UkSharedMem *ctrl, const char *breakKeys, UkDictionary *emptyDict)
+{
+    m_ctrl = ctrl;
+    m_breakKeys = breakKeys;
+    m_emptyDict = emptyDict;
+    m_keeping.add(1);
+    m_trie.push_back(TrieNode());
+    m_root = 0;
+    m_error = false;
+}
+
+//---------------------------------------------------------------
+UkAutomatonBuilder::Explorer::Signature UkAutomatonBuilder::Explorer::signature(const UkEngine & e)
+{
+    uint64_t values[24];
+    Signature sig;
+    sig.a = 0xcbf29ce484222325ULL;
+    sig.b = 0x9e3779b97f4a7c15ULL;
+
+    int n = 0;
+    values[n++] = e.m_current;
+    values[n++] = e.m_keyCurrent;
+    values[n++] = e.m_singleMode;
+    values[n++] = e.m_toEscape;
+    for (int i = -1; i <= e.m_current || i <= e.m_keyCurrent; i++) {
+        if (i >= 0 && i <= e.m_current) {
+            const UkEngine::WordInfo & w = e.m_buffer[i];
+            values[n++] = w.form;
+            values[n++] = w.c1Offset;
+            values[n++] = w.vOffset;
+            values[n++] = w.c2Offset;
+            values[n++] = w.vseq;
+            values[n++] = w.caps;
+            values[n++] = w.tone;
+            values[n++] = w.vnSym;
+            values[n++] = w.keyCode;
+        }
+        if (i >= 0 && i <= e.m_keyCurrent) {
+            const KeyBufEntry & k = e.m_keyStrokes[i];
+            values[n++] = k.ev.evType;
+            values[n++] = k.ev.chType;
+            values[n++] = k.ev.vnSym;
+            values[n++] = k.ev.keyCode;
+            //the tone of other events is not set
+            values[n++] = (k.ev.evType >= vneTone0 && k.ev.evType <= vneTone5)? k.ev.tone : 0;
+            values[n++] = k.converted;
+            values[n++] = k.bufPos;
+        }
+        values[n++] = (i >= 0 && i <= e.m_keyCurrent)? e.m_keyStrokes[i].wordHash : 0;
+
+        for (int j = 0; j < n; j++) {
+            uint64_t v = values[j];
+            for (int b = 0; b < 64; b += 8)
+                sig.a = (sig.a ^ ((v >> b) & 0xFF)) * 0x100000001b3ULL;
+            sig.b = (sig.b ^ v) * 0xff51afd7ed558ccdULL;
+            sig.b ^= sig.b >> 33;
+        }
+        n = 0;
+    }
+    return sig;
+}
+
+//---------------------------------------------------------------
+// Every syllable the rules of the engine allow: a vowel sequence, with
+// consonant sequences before and after that make a valid syllable, and
+// every tone it may take
+//---------------------------------------------------------------
+bool UkAutomatonBuilder::Explorer::addSyllables()
+{
+    UkKeyStrokeWriter writer;
+    if (!writer.init(m_ctrl->input.getIM()))
+        return false;
+
+    UkEngine e;
+    e.setCtrlInfo(m_ctrl);
+
+    std::vector<std::string> words;
+    for (int c1 = -1; c1 < CSeqCount; c1++) {
+        for (int v = 0; v < VSeqCount; v++) {
+            for (int c2 = -1; c2 < CSeqCount; c2++) {
+                if (!VSeqList[v].complete || (c2 >= 0 && !CSeqList[c2].suffix))
+                    continue;
+                if (!isValidCVC((ConSeq)c1, (VowelSeq)v, (ConSeq)c2))
+                    continue;
+
+                VnLexiName syms[9];
+                int len = 0;
+                if (c1 >= 0) {
+                    for (int i = 0; i < CSeqList[c1].len; i++)
+                        syms[len++] = CSeqList[c1].c[i];
+                }
+                int tonePos = len + e.getTonePosition((VowelSeq)v, c2 < 0);
+                for (int i = 0; i < VSeqList[v].len; i++)
+                    syms[len++] = VSeqList[v].v[i];
+                if (c2 >= 0) {
+                    for (int i = 0; i < CSeqList[c2].len; i++)
+                        syms[len++] = CSeqList[c2].c[i];
+                }
+
+                bool stop = (c2 == cs_c || c2 == cs_ch || c2 == cs_p || c2 == cs_t);
+                for (int tone = 0; tone < 6; tone++) {
+                    if (stop && (tone == 2 || tone == 3 || tone == 4))
+                        continue;
+                    //lower case, capitalised, upper case
+                    for (int caps = 0; caps < 3; caps++) {
+                        StdVnChar text[10];
+                        for (int i = 0; i < len; i++) {
+                            text[i] = syms[i] + VnStdCharOffset;
+                            if (caps == 2 || (caps == 1 && i == 0))
+                                text[i]--;
+                            if (i == tonePos)
+                                text[i] += tone * 2;
+                        }
+                        text[len] = 0;
+
+                        char utf8[64];
+                        int inLen = -1;
+                        int outLen = sizeof(utf8);
+                        if (VnConvert(CONV_CHARSET_VNSTANDARD, CONV_CHARSET_UNIUTF8,
+                                      (UKBYTE *)text, (UKBYTE *)utf8, &inLen, &outLen) == 0)
+                            words.push_back(utf8);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int tonePlace = 0; tonePlace < 2; tonePlace++) {
+        for (int markPlace = 0; markPlace < 2; markPlace++) {
+            writer.setPlaces((UkKeyStrokeWriter::TonePlace)tonePlace,
+                             (UkKeyStrokeWriter::MarkPlace)markPlace);
+            for (size_t i = 0; i < words.size(); i++) {
+                std::string keys;
+                writer.write(words[i].data(), words[i].size(), keys);
+                addKeys(keys);
+            }
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------
+void UkAutomatonBuilder::Explorer::addKeys(const std::string & keys)
+{
+    int node = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        unsigned char key = keys[i];
+        if (key == 0 || key >= UKAUTO_TELEX_W_LABEL || m_breakKeys[key])
+            return;
+        std::map<unsigned char, int>::iterator it = m_trie[node].next.find(key);
+        if (it == m_trie[node].next.end()) {
+            int child = m_trie.size();
+            m_trie[node].next[key] = child;
+            m_trie.push_back(TrieNode());
+            node = child;
+        }
+        else {
+            node = it->second;
+        }
+    }
+    m_trie[node].end = true;
+}
+
+//---------------------------------------------------------------
+void UkAutomatonBuilder::Explorer::run()
+{
+    UkEngine e;
+    e.setCtrlInfo(m_ctrl);
+    e.reset();
+    m_root = stateOf(e);
+    explore(e, m_root, 0);
+}
+
+//---------------------------------------------------------------
+// The id of the state of e, new states get what settlePrefix() and
+// atWordBeginning() give there
+//---------------------------------------------------------------
+uint32_t UkAutomatonBuilder::Explorer::stateOf(const UkEngine & e)
+{
+    Signature sig = signature(e);
+    std::unordered_map<Signature, uint32_t, SignatureHash>::iterator it = m_ids.find(sig);
+    if (it != m_ids.end())
+        return it->second;
+
+    uint32_t id = m_states.size();
+    m_ids[sig] = id;
+    m_states.push_back(StateInfo());
+
+    UkAutomatonState state;
+    memset(&state, 0, sizeof(state));
+    state.settleTarget = id;
+
+    UkEngine *copy = new UkEngine(e);
+    if (copy->atWordBeginning())
+        state.flags |= UKAUTO_WORD_BEGINNING;
+
+    int steps = copy->settlePrefix();
+    if (steps >= 0 && steps < 0x8000) {
+        state.flags |= UKAUTO_SETTLE;
+        state.settleSteps = steps;
+        Signature settled = signature(*copy);
+        if (!(settled == sig))
+            state.settleTarget = stateOf(*copy);
+
+        *copy = e;
+        copy->m_pLearned = &m_keeping;
+        if (copy->settlePrefix() == steps && signature(*copy) == settled)
+            state.flags |= UKAUTO_SETTLE_KEEPING;
+    }
+    delete copy;
+
+    m_states[id].state = state;
+    return id;
+}
+
+//---------------------------------------------------------------
+// Follows the keys of the trie from node, in state id. The engines are on
+// the heap, a few of them per level of the trie.
+//---------------------------------------------------------------
+void UkAutomatonBuilder::Explorer::explore(const UkEngine & e, uint32_t id, int node)
+{
+    if (!m_visited.insert((uint64_t)id << 32 | node).second)
+        return;
+
+    std::unique_ptr<UkEngine> next(new UkEngine);
+    std::map<unsigned char, int>::const_iterator it;
+    for (it = m_trie[node].next.begin(); it != m_trie[node].next.end(); ++it) {
+        unsigned int keyCode = it->first;
+
+        *next = e;
+        next->m_telexWAsMapChar = false;
+        std::string op = step(*next, keyCode);
+        uint32_t target = stateOf(*next);
+        addEdge(id, keyCode, target, addOp(op));
+
+        UkKeyEvent ev;
+        m_ctrl->input.keyCodeToEvent(keyCode, ev);
+        if (ev.evType == vne_telex_w) {
+            std::unique_ptr<UkEngine> nextW(new UkEngine(e));
+            nextW->m_telexWAsMapChar = true;
+            std::string opW = step(*nextW, keyCode);
+            uint32_t targetW = stateOf(*nextW);
+            if (opW != op || targetW != target) {
+                addEdge(id, keyCode | UKAUTO_TELEX_W_LABEL, targetW, addOp(opW));
+                explore(*nextW, targetW, it->second);
+            }
+        }
+        explore(*next, target, it->second);
+    }
+
+    //the same keys follow when the prefix was settled
+    const UkAutomatonState & state = m_states[id].state;
+    if ((state.flags & UKAUTO_SETTLE) && state.settleTarget != id) {
+        uint32_t target = state.settleTarget;
+        *next = e;
+        next->settlePrefix();
+        explore(*next, target, node);
+    }
+
+    if (m_trie[node].end)
+        addWordEnd(e, id);
+}
+
+//---------------------------------------------------------------
+void UkAutomatonBuilder::Explorer::addEdge(uint32_t id, unsigned int label, uint32_t target, uint32_t op)
+{
+    std::pair<uint32_t, uint32_t> edge(target, op);
+    std::map<unsigned int, std::pair<uint32_t, uint32_t> > & edges = m_states[id].edges;
+    std::map<unsigned int, std::pair<uint32_t, uint32_t> >::iterator it = edges.find(label);
+    if (it == edges.end())
+        edges[label] = edge;
+    else if (it->second != edge)
+        m_error = true; //the engine did not do the same twice
+}
+
+//---------------------------------------------------------------
+// The outputs of the word break keys at the end of a syllable, one per
+// restore: none (or the restore of a non-Vietnamese word, which needs no
+// word list), the restore of an unknown word and that of a foreign or
+// learned one. The engine gives a learned word back whatever it is, a
+// foreign one only when it rejects it; words that are not Vietnamese get
+// no dictKey, they are rejected whatever the dictionary says (see
+// UkEngine::wordEndRestore). A word break key is put after the output of
+// a restore; the rest must be the same for all of them.
+//---------------------------------------------------------------
+void UkAutomatonBuilder::Explorer::addWordEnd(const UkEngine & e, uint32_t id)
+{
+    if (m_states[id].state.wordEnd)
+        return;
+
+    std::unique_ptr<UkEngine> copy(new UkEngine(e));
+    UkAutomatonWordEnd end;
+    memset(&end, 0, sizeof(end));
+    end.keyHash = copy->lastWordKeyHash();
+    if (end.keyHash == 0)
+        return;
+
+    unsigned char key[UKDICT_MAX_KEY];
+    int keyLen = copy->lastWordIsNonVn()? 0 : copy->lastWordDictKey(key);
+
+    UkWordSet learned;
+    learned.add(end.keyHash);
+
+    for (int restore = 0; restore < ukr_count; restore++) {
+        if (restore == ukr_keys && keyLen == 0) {
+            end.op[restore] = end.op[ukr_none];
+            continue;
+        }
+
+        std::string first;
+        for (int keyCode = 1; keyCode < 256; keyCode++) {
+            if (!m_breakKeys[keyCode])
+                continue;
+            *copy = e;
+            copy->m_pDict = (restore != ukr_none)? m_emptyDict : 0;
+            copy->m_pLearned = (restore == ukr_word)? &learned : 0;
+            std::string op = step(*copy, keyCode);
+            if (!copy->atWordBeginning())
+                return;
+
+            if ((unsigned char)op[2] > 0 && (unsigned char)op[op.size()-1] == keyCode) {
+                op.resize(op.size() - 1);
+                op[0] |= UKAUTO_OP_APPEND_KEY;
+                op[2]--;
+            }
+            if (first.empty())
+                first = op;
+            else if (op != first)
+                return;
+        }
+        end.op[restore] = addOp(first);
+    }
+
+    if (keyLen > 0) {
+        std::string k((const char *)key, keyLen);
+        std::map<std::string, uint32_t>::iterator it = m_keyIds.find(k);
+        uint32_t offset;
+        if (it != m_keyIds.end()) {
+            offset = it->second;
+        }
+        else {
+            offset = m_keys.size();
+            m_keys += k;
+            m_keyIds[k] = offset;
+        }
+        end.dictKey = offset << 8 | keyLen;
+    }
+
+    m_wordEnds.push_back(end);
+    m_states[id].state.wordEnd = m_wordEnds.size();
+}
+
+//---------------------------------------------------------------
+// Runs the key in e and returns the op of what it gave
+//---------------------------------------------------------------
+std::string UkAutomatonBuilder::Explorer::step(UkEngine & e, unsigned int keyCode)
+{
+    bool telexW = e.m_telexWAsMapChar;
+    unsigned char outBuf[1024];
+    int backs = 0;
+    int outSize = sizeof(outBuf);
+    UkOutputType outType;
+    int ret = e.process(keyCode, backs, outBuf, outSize, outType);
+
+    if (ret < 0 || ret > 1 || backs < 0 || backs > 255 || outSize > 255) {
+        m_error = true;
+        outSize = 0;
+    }
+
+    unsigned char flags = 0;
+    if (ret)
+        flags |= UKAUTO_OP_RETURN;
+    if (outType == UkKeyOutput)
+        flags |= UKAUTO_OP_KEY_OUTPUT;
+    if (e.m_telexWAsMapChar != telexW)
+        flags |= UKAUTO_OP_SET_TELEX_W | (e.m_telexWAsMapChar? UKAUTO_OP_TELEX_W : 0);
+
+    std::string op;
+    op += (char)flags;
+    op += (char)backs;
+    op += (char)outSize;
+    op.append((const char *)outBuf, outSize);
+    return op;
+}
+
+//---------------------------------------------------------------
+uint32_t UkAutomatonBuilder::Explorer::addOp(const std::string & op)
+{
+    std::map<std::string, uint32_t>::iterator it = m_opIds.find(op);
+    if (it != m_opIds.end())
+        return it->second;
+    uint32_t offset = m_ops.size();
+    m_ops += op;
+    m_opIds[op] = offset;
+    return offset;
+}
+
+//---------------------------------------------------------------
+// A dictionary without words, for the restore of unknown words
+//---------------------------------------------------------------
+static bool LoadEmptyDictionary(UkDictionary & dict)
+{
+    FILE *file = tmpfile();
+    if (!file)
+        return false;
+
+    UkDictHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UKDICT_MAGIC, sizeof(header.magic));
+    header.stateCount = 1;
+    uint32_t firstEdge[2] = {0, 0};
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(firstEdge, sizeof(firstEdge), 1, file) == 1 &&
+              fflush(file) == 0;
+    if (ok) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", fileno(file));
+        ok = dict.load(path);
+    }
+    fclose(file);
+    return ok;
+}
+
+//---------------------------------------------------------------
+int UkAutomatonBuilder::build(UkSharedMem *ctrl, const char *fileName)
+{
+    if (!ctrl->vietKey || ctrl->options.macroEnabled)
+        return 0;
+
+    UkDictionary emptyDict;
+    if (!LoadEmptyDictionary(emptyDict))
+        return 0;
+
+    Explorer explorer(ctrl, m_breakKeys, &emptyDict);
+    if (!explorer.addSyllables())
+        return 0;
+    explorer.run();
+
+    std::vector<Explorer::StateInfo> & states = explorer.m_states;
+    uint32_t wordBreak = states.size();
+    states.push_back(Explorer::StateInfo());
+    memset(&states[wordBreak].state, 0, sizeof(UkAutomatonState));
+    states[wordBreak].state.flags = UKAUTO_WORD_BEGINNING;
+    states[wordBreak].state.settleTarget = wordBreak;
+
+    if (explorer.m_error || states.size() > UKAUTO_MAX_STATES)
+        return 0;
+
+    UkAutomatonHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UKAUTO_MAGIC, sizeof(header.magic));
+    header.inputMethod = ctrl->input.getIM();
+    header.charsetId = ctrl->charsetId;
+    header.options = OptionBits(ctrl->options);
+    header.stateCount = states.size();
+    header.wordEndCount = explorer.m_wordEnds.size();
+    header.opSize = explorer.m_ops.size();
+    header.keySize = explorer.m_keys.size();
+    header.root = explorer.m_root;
+    header.wordBreak = wordBreak;
+    for (int key = 0; key < 256; key++) {
+        if (m_breakKeys[key])
+            header.breakKeys[key >> 3] |= 1 << (key & 7);
+    }
+
+    std::vector<UkAutomatonState> stateTable;
+    std::vector<uint32_t> edges, edgeOps;
+    for (size_t s = 0; s < states.size(); s++) {
+        UkAutomatonState state = states[s].state;
+        state.firstEdge = edges.size();
+        stateTable.push_back(state);
+        std::map<unsigned int, std::pair<uint32_t, uint32_t> >::const_iterator it;
+        for (it = states[s].edges.begin(); it != states[s].edges.end(); ++it) {
+            edges.push_back(it->first << 24 | it->second.first);
+            edgeOps.push_back(it->second.second);
+        }
+    }
+    UkAutomatonState last;
+    memset(&last, 0, sizeof(last));
+    last.firstEdge = edges.size();
+    stateTable.push_back(last);
+    header.edgeCount = edges.size();
+
+    FILE *file = fopen(fileName, "wb");
+    if (!file)
+        return 0;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(&stateTable[0], sizeof(UkAutomatonState), stateTable.size(), file) == stateTable.size() &&
+        fwrite(edges.data(), sizeof(uint32_t), edges.size(), file) == edges.size() &&
+        fwrite(edgeOps.data(), sizeof(uint32_t), edgeOps.size(), file) == edgeOps.size() &&
+        fwrite(explorer.m_wordEnds.data(), sizeof(UkAutomatonWordEnd), explorer.m_wordEnds.size(), file) ==
+            explorer.m_wordEnds.size() &&
+        fwrite(explorer.m_ops.data(), 1, explorer.m_ops.size(), file) == explorer.m_ops.size() &&
+        fwrite(explorer.m_keys.data(), 1, explorer.m_keys.size(), file) == explorer.m_keys.size();
+    m_fileSize = ftell(file);
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok) {
+        remove(fileName);
+        return 0;
+    }
+
+    m_stateCount = header.stateCount;
+    m_edgeCount = header.edgeCount;
+    m_wordEndCount = header.wordEndCount;
+    return 1;
+}
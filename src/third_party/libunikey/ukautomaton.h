@@ -0,0 +1,201 @@
+// -*- mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ * Copyright (C) 2000-2005 Pham Kim Long
+ * Contact:
+ *   unikey@gmail.com
+ *   UniKey project: http://unikey.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef __UK_AUTOMATON_H
+#define __UK_AUTOMATON_H
+
+#include <stdint.h>
+#include "keycons.h"
+
+struct UkSharedMem;
+
+//----------------------------------------------------------------------
+// Transitions of UkEngine compiled into a table for one input method,
+// output charset and set of options, in a file that is mapped read-only.
+//
+// A state is the whole state of the engine after some keys typed from
+// reset(); UkAutomatonBuilder finds them by running the engine on the keys
+// of every syllable its rules allow. An edge gives, for a key, the next
+// state and the output of the engine for it (backspaces and bytes), so a
+// key of a known syllable costs a lookup and a copy. The state also gives
+// what settlePrefix() and atWordBeginning() return there, and at the end
+// of a syllable, the output of a word break for each of the restores the
+// dictionary, foreign filter and learned words may ask for.
+//
+// The engine keeps the keys it took from the table and runs them itself
+// from reset() when it meets anything the table does not have, then goes
+// on without the table until the next reset(). See UkEngine::process().
+//
+// Keys that behave differently after 'w' was typed as "ư" in Telex (see
+// UkEngine::processTelexW) have a second edge, labelled key | 0x80.
+//
+// File layout, all numbers in host byte order:
+//   UkAutomatonHeader
+//   UkAutomatonState states[stateCount+1]  the last one ends the edges
+//   uint32_t edges[edgeCount]              label:8 | target:24, sorted by
+//                                          label within a state
+//   uint32_t edgeOps[edgeCount]            offset of the op in ops
+//   UkAutomatonWordEnd wordEnds[wordEndCount]
+//   uint8_t ops[opSize]                    flags, backs, length, bytes
+//   uint8_t keys[keySize]                  dictionary keys of syllables
+//----------------------------------------------------------------------
+
+#define UKAUTO_MAGIC "UKAUTO2"
+#define UKAUTO_MAX_STATES 0x1000000
+#define UKAUTO_MAX_LOG 64
+
+#define UKAUTO_EDGE_LABEL(e) ((e) >> 24)
+#define UKAUTO_EDGE_TARGET(e) ((e) & 0xFFFFFF)
+#define UKAUTO_TELEX_W_LABEL 0x80
+
+//options the table was built with
+#define UKAUTO_OPT_FREE_MARKING 0x01
+#define UKAUTO_OPT_MODERN_STYLE 0x02
+#define UKAUTO_OPT_SPELL_CHECK  0x04
+#define UKAUTO_OPT_AUTO_RESTORE 0x08
+
+//state flags
+#define UKAUTO_WORD_BEGINNING 0x01
+#define UKAUTO_SETTLE         0x02 //settleSteps and settleTarget are known
+#define UKAUTO_SETTLE_KEEPING 0x04 //and hold when converted prefixes are kept
+
+//op flags
+#define UKAUTO_OP_RETURN      0x01 //process() returns 1
+#define UKAUTO_OP_KEY_OUTPUT  0x02 //UkKeyOutput
+#define UKAUTO_OP_SET_TELEX_W 0x04 //sets the 'w' as "ư" flag...
+#define UKAUTO_OP_TELEX_W     0x08 //...to this
+#define UKAUTO_OP_APPEND_KEY  0x10 //the key follows the bytes
+
+//restores of a word break, see UkEngine::processWordEnd
+enum UkWordEndRestore { ukr_none, ukr_keys, ukr_word, ukr_count };
+
+struct UkAutomatonHeader {
+    char magic[8];
+    uint32_t inputMethod;
+    uint32_t charsetId;
+    uint32_t options;
+    uint32_t stateCount;
+    uint32_t edgeCount;
+    uint32_t wordEndCount;
+    uint32_t opSize;
+    uint32_t keySize;
+    uint32_t root;
+    uint32_t wordBreak; //the state after a word break, with no edges
+    uint8_t breakKeys[32]; //bit set of the word break keys in wordEnds
+};
+
+struct UkAutomatonState {
+    uint32_t firstEdge;
+    uint32_t settleTarget;
+    int16_t settleSteps;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t wordEnd; //index in wordEnds + 1, 0 if none
+};
+
+struct UkAutomatonWordEnd {
+    uint64_t keyHash; //lastWordKeyHash() of the state
+    uint32_t op[ukr_count];
+    uint32_t dictKey; //offset in keys << 8 | length, 0 if not looked up
+                      //or not a Vietnamese word
+};
+
+class UkAutomaton {
+public:
+    UkAutomaton();
+    ~UkAutomaton();
+
+    int load(const char *fileName); // 1 on success
+    void unload();
+    bool isLoaded() const { return m_states != 0; }
+
+    // whether the table was built for the engine set up as in ctrl
+    bool matches(UkSharedMem *ctrl) const;
+
+    const UkAutomatonHeader *header() const { return m_header; }
+
+    uint32_t root() const { return m_header->root; }
+    uint32_t wordBreak() const { return m_header->wordBreak; }
+    const UkAutomatonState & state(uint32_t s) const { return m_states[s]; }
+    const UkAutomatonWordEnd & wordEnd(const UkAutomatonState & st) const
+    {
+        return m_wordEnds[st.wordEnd - 1];
+    }
+    const unsigned char *op(uint32_t offset) const { return m_ops + offset; }
+    const unsigned char *key(uint32_t dictKey) const { return m_keys + (dictKey >> 8); }
+
+    bool isBreakKey(unsigned int keyCode) const
+    {
+        return keyCode < 256 && (m_header->breakKeys[keyCode >> 3] >> (keyCode & 7) & 1);
+    }
+
+    // index of the edge of state s for label, -1 if there is none
+    int findEdge(uint32_t s, unsigned int label) const;
+    uint32_t edgeTarget(int edge) const { return UKAUTO_EDGE_TARGET(m_edges[edge]); }
+    uint32_t edgeOp(int edge) const { return m_edgeOps[edge]; }
+
+    uint32_t stateCount() const { return m_header ? m_header->stateCount : 0; }
+    long fileSize() const { return m_mapSize; }
+
+protected:
+    void *m_map;
+    long m_mapSize;
+    const UkAutomatonHeader *m_header;
+    const UkAutomatonState *m_states;
+    const uint32_t *m_edges;
+    const uint32_t *m_edgeOps;
+    const UkAutomatonWordEnd *m_wordEnds;
+    const unsigned char *m_ops;
+    const unsigned char *m_keys;
+};
+
+//----------------------------------------------------------------------
+// Builds the table of UkAutomaton for the engine set up as in ctrl, which
+// must have macros off. The syllables are made from the vowel and
+// consonant sequences of ukdata.h, with every tone they may take, in
+// lower case, capitalised and upper case, and typed with the tone and the
+// marks after their letters and at the end of the word (see
+// UkKeyStrokeWriter).
+//----------------------------------------------------------------------
+class UkAutomatonBuilder {
+public:
+    UkAutomatonBuilder();
+
+    // the keys after which the end of a syllable is in the table;
+    // " ,." by default, the others go through the engine
+    void setBreakKeys(const char *keys);
+
+    // 1 on success
+    int build(UkSharedMem *ctrl, const char *fileName);
+
+    uint32_t stateCount() const { return m_stateCount; }
+    uint32_t edgeCount() const { return m_edgeCount; }
+    uint32_t wordEndCount() const { return m_wordEndCount; }
+    long fileSize() const { return m_fileSize; }
+
+protected:
+    class Explorer; //runs the engine, as a friend of UkEngine
+
+    char m_breakKeys[256];
+    uint32_t m_stateCount;
+    uint32_t m_edgeCount;
+    uint32_t m_wordEndCount;
+    long m_fileSize;
+};
+
+#endif
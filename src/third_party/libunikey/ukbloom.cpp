@@ -0,0 +1,126 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ukbloom.h"
+
+//---------------------------------------------------------------
+UkBloomFilter::UkBloomFilter()
+{
+    m_map = 0;
+    m_mapSize = 0;
+    m_bits = 0;
+    m_bitCount = 0;
+    m_hashCount = 0;
+}
+
+//---------------------------------------------------------------
+UkBloomFilter::~UkBloomFilter()
+{
+    unload();
+}
+
+//---------------------------------------------------------------
+int UkBloomFilter::load(const char *fileName)
+{
+    unload();
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (long)sizeof(UkBloomHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const UkBloomHeader *header = (const UkBloomHeader *)map;
+    uint32_t bits = header->bitCount;
+
+    if (memcmp(header->magic, UKBLOOM_MAGIC, sizeof(header->magic)) != 0 ||
+        bits < 8 || bits > UKBLOOM_MAX_BITS || (bits & (bits - 1)) != 0 ||
+        header->hashCount == 0 || header->hashCount > UKBLOOM_MAX_HASHES ||
+        (long)(sizeof(UkBloomHeader) + bits / 8) != st.st_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    m_map = map;
+    m_mapSize = st.st_size;
+    m_bitCount = bits;
+    m_hashCount = header->hashCount;
+    m_bits = (const unsigned char *)(header + 1);
+    return 1;
+}
+
+//---------------------------------------------------------------
+void UkBloomFilter::unload()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_bits = 0;
+    m_bitCount = 0;
+    m_hashCount = 0;
+}
+
+//---------------------------------------------------------------
+// The FNV hash is mixed once more (the murmur3 finalizer) and split in
+// two halves, which give all the probes by double hashing.
+//---------------------------------------------------------------
+void UkBloomFilter::probes(uint64_t hash, uint32_t bitCount, uint32_t hashCount,
+                           uint32_t *pos)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    for (uint32_t i = 0; i < hashCount; i++)
+        pos[i] = (h1 + i * h2) & (bitCount - 1);
+}
+
+//---------------------------------------------------------------
+bool UkBloomFilter::mayContain(uint64_t hash) const
+{
+    if (!m_bits)
+        return false;
+
+    uint32_t pos[UKBLOOM_MAX_HASHES];
+    probes(hash, m_bitCount, m_hashCount, pos);
+    for (uint32_t i = 0; i < m_hashCount; i++) {
+        if (!(m_bits[pos[i] >> 3] & (1 << (pos[i] & 7))))
+            return false;
+    }
+    return true;
+}
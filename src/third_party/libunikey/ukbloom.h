@@ -0,0 +1,79 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_BLOOM_H
+#define __UK_BLOOM_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Bloom filter over the key strokes of foreign (English) words, in a file
+// that is mapped read-only.
+//
+// Words are hashed one key at a time with UkBloomHashAdd(), starting from
+// UKBLOOM_HASH_START, upper case keys folded to lower case, so the engine
+// can keep the hash of the word being typed next to each key stroke.
+//
+// File layout: UkBloomHeader, then bitCount/8 bytes of bits.
+// bitCount is a power of two, at most UKBLOOM_MAX_BITS (1 MB of bits).
+//----------------------------------------------------------------------
+
+#define UKBLOOM_MAGIC "UKBLOOM"
+#define UKBLOOM_MAX_BITS (8u << 20)
+#define UKBLOOM_MAX_HASHES 16
+#define UKBLOOM_HASH_START 0xcbf29ce484222325ULL
+
+struct UkBloomHeader {
+    char magic[8];
+    uint32_t bitCount;
+    uint32_t hashCount;
+};
+
+// FNV-1a step
+inline uint64_t UkBloomHashAdd(uint64_t hash, unsigned int keyCode)
+{
+    if (keyCode >= 'A' && keyCode <= 'Z')
+        keyCode += 'a' - 'A';
+    return (hash ^ (keyCode & 0xFF)) * 0x100000001b3ULL;
+}
+
+class UkBloomFilter {
+public:
+    UkBloomFilter();
+    ~UkBloomFilter();
+
+    int load(const char *fileName); // 1 on success
+    void unload();
+    bool isLoaded() const { return m_bits != 0; }
+
+    bool mayContain(uint64_t hash) const;
+
+    // bit positions probed for a word hash, for building filters
+    static void probes(uint64_t hash, uint32_t bitCount, uint32_t hashCount,
+                       uint32_t *pos);
+
+protected:
+    void *m_map;
+    long m_mapSize;
+    const unsigned char *m_bits;
+    uint32_t m_bitCount;
+    uint32_t m_hashCount;
+};
+
+#endif
@@ -0,0 +1,267 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+
+#include "ukcollate.h"
+#include "ukutf8.h"
+#include "charset.h"
+#include "uksimd.h"
+
+#define COLLATE_LEVEL_END 0x01
+// the lowest weight of every level
+#define COLLATE_LOWEST 0x02
+// Level 1: ASCII that is neither a digit nor a letter, then digits, then
+// letters. Other characters get COLLATE_OTHER and 3 bytes of code point.
+#define COLLATE_DIGITS (COLLATE_LOWEST + 66)
+#define COLLATE_LETTERS (COLLATE_DIGITS + 10)
+#define COLLATE_OTHER 0xFF
+
+//---------------------------------------------------------------
+// The Vietnamese alphabet, with the Latin letters it lacks in between
+//---------------------------------------------------------------
+static const VnLexiName Alphabet[] = {
+    vnl_a, vnl_ab, vnl_ar, vnl_b, vnl_c, vnl_d, vnl_dd, vnl_e, vnl_er, vnl_f,
+    vnl_g, vnl_h, vnl_i, vnl_j, vnl_k, vnl_l, vnl_m, vnl_n, vnl_o, vnl_or,
+    vnl_oh, vnl_p, vnl_q, vnl_r, vnl_s, vnl_t, vnl_u, vnl_uh, vnl_v, vnl_w,
+    vnl_x, vnl_y, vnl_z
+};
+
+// Level 2 weight of the tones as charset.h numbers them: none, sắc, huyền,
+// hỏi, ngã, nặng
+static const unsigned char ToneWeight[] = {
+    COLLATE_LOWEST, COLLATE_LOWEST + 4, COLLATE_LOWEST + 1,
+    COLLATE_LOWEST + 2, COLLATE_LOWEST + 3, COLLATE_LOWEST + 5
+};
+
+//---------------------------------------------------------------
+// Level 1 weight of an ASCII byte: the letters that only the Vietnamese
+// alphabet has make room for themselves after a, d, e, o and u. The
+// vector version below computes the same.
+//---------------------------------------------------------------
+static unsigned char asciiWeight(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    if (c >= 'a' && c <= 'z')
+        return COLLATE_LETTERS + (c - 'a') + 2 * (c > 'a') + (c > 'd') +
+            (c > 'e') + 2 * (c > 'o') + (c > 'u');
+    if (c >= '0' && c <= '9')
+        return COLLATE_DIGITS + (c - '0');
+    return COLLATE_LOWEST + c - 10 * (c > '9') - 26 * (c > 'Z') - 26 * (c > 'z');
+}
+
+#ifdef UK_BLOCK
+//---------------------------------------------------------------
+// Level 1 and level 3 weights of a block of ASCII
+//---------------------------------------------------------------
+static inline void asciiWeights(UkBlock v, UkBlock &level1, UkBlock &level3)
+{
+    UkBlock upper = UkInRange(v, 'A', 'Z');
+    UkBlock lower = UkInRange(v, 'a', 'z');
+    UkBlock digit = UkInRange(v, '0', '9');
+
+    // masks are -1 where set
+    UkBlock c = UkAdd(v, UkAnd(upper, UkSetBlock('a' - 'A')));
+    UkBlock letter = UkAdd(c, UkSetBlock(COLLATE_LETTERS - 'a'));
+    letter = UkAdd(letter, UkAnd(UkGreater(c, UkSetBlock('a')), UkSetBlock(2)));
+    letter = UkSub(letter, UkGreater(c, UkSetBlock('d')));
+    letter = UkSub(letter, UkGreater(c, UkSetBlock('e')));
+    letter = UkAdd(letter, UkAnd(UkGreater(c, UkSetBlock('o')), UkSetBlock(2)));
+    letter = UkSub(letter, UkGreater(c, UkSetBlock('u')));
+
+    UkBlock other = UkAdd(v, UkSetBlock(COLLATE_LOWEST));
+    other = UkSub(other, UkAnd(UkGreater(v, UkSetBlock('9')), UkSetBlock(10)));
+    other = UkSub(other, UkAnd(UkGreater(v, UkSetBlock('Z')), UkSetBlock(26)));
+    other = UkSub(other, UkAnd(UkGreater(v, UkSetBlock('z')), UkSetBlock(26)));
+
+    UkBlock number = UkAdd(v, UkSetBlock(COLLATE_DIGITS - '0'));
+    level1 = UkSelect(UkOr(upper, lower), UkSelect(digit, other, number), letter);
+    level3 = UkSub(UkSetBlock(COLLATE_LOWEST), upper);
+}
+#endif
+
+//---------------------------------------------------------------
+// Weights of ASCII bytes and of the letters of charset.h, built once, on
+// first use. Most letters are looked up by their UTF-8 bytes directly:
+// near[] has the weights of U+00C0..U+01BF (2 byte sequences led by
+// C3..C6) and U+1E80..U+1EFF (E1 BA xx and E1 BB xx), as
+// level1 | level2 << 8 | level3 << 16, 0 for the code points there that
+// are no letters.
+//---------------------------------------------------------------
+struct UkCollateTables {
+    unsigned char ascii1[128];
+    unsigned char ascii3[128];
+    unsigned char letter1[vnl_lastChar];
+    unsigned char letter2[vnl_lastChar];
+    unsigned char letter3[vnl_lastChar];
+    uint32_t near[384];
+
+    UkCollateTables()
+    {
+        for (int c = 0; c < 128; c++) {
+            ascii1[c] = asciiWeight(c);
+            ascii3[c] = COLLATE_LOWEST + (c >= 'A' && c <= 'Z');
+        }
+
+        unsigned char alphabetWeight[vnl_lastChar];
+        memset(alphabetWeight, 0, sizeof(alphabetWeight));
+        for (unsigned i = 0; i < sizeof(Alphabet) / sizeof(Alphabet[0]); i++)
+            alphabetWeight[Alphabet[i]] = COLLATE_LETTERS + i;
+
+        for (int i = 0; i < vnl_lastChar; i++) {
+            int noTone = StdVnNoTone[i];
+            letter1[i] = alphabetWeight[noTone | 1];
+            letter2[i] = ToneWeight[(i - noTone) / 2];
+            letter3[i] = COLLATE_LOWEST + !(i & 1);
+        }
+
+        for (int i = 0; i < 384; i++) {
+            VnLexiName lexi = UkUnicodeToLexi(i < 256 ? 0xC0 + i : 0x1E80 + i - 256);
+            near[i] = lexi == vnl_nonVnChar ? 0 :
+                letter1[lexi] | (letter2[lexi] << 8) | (letter3[lexi] << 16);
+        }
+    }
+};
+
+static const UkCollateTables &collateTables()
+{
+    static const UkCollateTables tables;
+    return tables;
+}
+
+//---------------------------------------------------------------
+// Writes the key with the tables t. Levels 2 and 3 are put together
+// further down key, one weight a character, and moved next to level 1
+// at the end:
+//   [0, 4 inLen)                level 1, 4 bytes at most a byte of in
+//   [4 inLen + 1, 5 inLen]      level 2
+//   [5 inLen + 2, 6 inLen + 1]  level 3
+//---------------------------------------------------------------
+static int collateKey(const UkCollateTables &t, const char *in, int inLen,
+                      unsigned char *key)
+{
+    const unsigned char *p = (const unsigned char *)in;
+    const unsigned char *end = p + inLen;
+    unsigned char *level1 = key;
+    unsigned char *start2 = key + 4 * (long)inLen + 1;
+    unsigned char *start3 = start2 + inLen + 1;
+    unsigned char *level2 = start2;
+    unsigned char *level3 = start3;
+
+    while (p < end) {
+#ifdef UK_BLOCK
+        // Whole blocks fit in each area while a block is left to read.
+        if (end - p >= UK_BLOCK) {
+            UkBlock v = UkLoadBlock(p);
+            UkBlock weight1, weight3;
+            asciiWeights(v, weight1, weight3);
+            UkStoreBlock(level1, weight1);
+            UkStoreBlock(level2, UkSetBlock(COLLATE_LOWEST));
+            UkStoreBlock(level3, weight3);
+
+            uint32_t high = UkHighBits(v);
+            int ascii = high ? __builtin_ctz(high) : UK_BLOCK;
+            p += ascii;
+            level1 += ascii;
+            level2 += ascii;
+            level3 += ascii;
+            if (!high)
+                continue;
+        }
+#endif
+        unsigned char c = *p;
+        if (c < 0x80) {
+            *level1++ = t.ascii1[c];
+            *level2++ = COLLATE_LOWEST;
+            *level3++ = t.ascii3[c];
+            p++;
+            continue;
+        }
+
+        unsigned c1 = end - p > 1 ? p[1] : 0;
+        unsigned c2 = end - p > 2 ? p[2] : 0;
+        uint32_t weights = 0;
+        int n = 0;
+        if (c - 0xC3u < 4 && (c1 & 0xC0) == 0x80) {
+            weights = t.near[(((c & 0x1F) << 6) | (c1 & 0x3F)) - 0xC0];
+            n = 2;
+        } else if (c == 0xE1 && c1 - 0xBAu < 2 && (c2 & 0xC0) == 0x80) {
+            weights = t.near[256 + (((c1 & 1) << 6) | (c2 & 0x3F))];
+            n = 3;
+        }
+        if (weights) {
+            *level1++ = (unsigned char)weights;
+            *level2++ = (unsigned char)(weights >> 8);
+            *level3++ = (unsigned char)(weights >> 16);
+            p += n;
+            continue;
+        }
+
+        uint32_t cp;
+        p += UkReadUtf8(p, end - p, cp);
+        VnLexiName lexi = UkUnicodeToLexi(cp);
+        if (lexi != vnl_nonVnChar) {
+            *level1++ = t.letter1[lexi];
+            *level2++ = t.letter2[lexi];
+            *level3++ = t.letter3[lexi];
+        } else {
+            // 7 bits a byte keeps clear of the level ends
+            level1[0] = COLLATE_OTHER;
+            level1[1] = 0x80 | (cp >> 14);
+            level1[2] = 0x80 | ((cp >> 7) & 0x7F);
+            level1[3] = 0x80 | (cp & 0x7F);
+            level1 += 4;
+            *level2++ = COLLATE_LOWEST;
+            *level3++ = COLLATE_LOWEST;
+        }
+    }
+
+    while (level2 > start2 && level2[-1] == COLLATE_LOWEST)
+        level2--;
+    while (level3 > start3 && level3[-1] == COLLATE_LOWEST)
+        level3--;
+
+    unsigned char *k = level1;
+    *k++ = COLLATE_LEVEL_END;
+    memmove(k, start2, level2 - start2);
+    k += level2 - start2;
+    *k++ = COLLATE_LEVEL_END;
+    memmove(k, start3, level3 - start3);
+    k += level3 - start3;
+    return (int)(k - key);
+}
+
+//---------------------------------------------------------------
+int UkCollateKey(const char *in, int inLen, unsigned char *key)
+{
+    return collateKey(collateTables(), in, inLen, key);
+}
+
+//---------------------------------------------------------------
+long UkCollateKeys(const char *const *strings, const int *lengths, int count,
+                   unsigned char *keys, long *ends)
+{
+    const UkCollateTables &t = collateTables();
+    long len = 0;
+    for (int i = 0; i < count; i++) {
+        len += collateKey(t, strings[i], lengths[i], keys + len);
+        ends[i] = len;
+    }
+    return len;
+}
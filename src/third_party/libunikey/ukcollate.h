@@ -0,0 +1,55 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_COLLATE_H
+#define __UK_COLLATE_H
+
+//----------------------------------------------------------------------
+// Sort keys of UTF-8 Vietnamese text: memcmp() of the keys of two strings
+// orders them as a Vietnamese dictionary does, without a locale.
+//
+// Levels, each compared over the whole string before the next one:
+//  1. letters, in the order of the Vietnamese alphabet
+//       a ă â b c d đ e ê (f) g h i (j) k l m n o ô ơ p q r s t u ư v (w) x y (z)
+//     after blanks and punctuation (in ASCII order) and digits; anything
+//     else comes last, by code point. The marks of ă â đ ê ô ơ ư count
+//     here, as the alphabet makes them letters of their own.
+//  2. tones: none, huyền, hỏi, ngã, sắc, nặng ("a à ả ã á ạ").
+//  3. case: lower before upper.
+//
+// A key is the weights of level 1, 0x01, those of level 2, 0x01, those of
+// level 3. Weights are 0x02 and up, and the trailing lowest ones of levels
+// 2 and 3 are left out, so keys of plain lower case ASCII are short.
+// Letters are the precomposed ones of charset.h, as in ukfold.h.
+//----------------------------------------------------------------------
+
+// Bytes a key of a string of len bytes may take
+#define UKCOLLATE_KEY_ROOM(len) (6 * (long)(len) + 2)
+
+// Writes the key of in[0, inLen) to key, which has room for
+// UKCOLLATE_KEY_ROOM(inLen) bytes, and returns its length.
+int UkCollateKey(const char *in, int inLen, unsigned char *key);
+
+// Writes the keys of strings[0, count) one after the other to keys, and
+// where each ends to ends[]. keys has room for the sum of the
+// UKCOLLATE_KEY_ROOM() of their lengths. Returns the bytes written.
+long UkCollateKeys(const char *const *strings, const int *lengths, int count,
+                   unsigned char *keys, long *ends);
+
+#endif
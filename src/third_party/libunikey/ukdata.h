@@ -0,0 +1,96 @@
+// -*- mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ * Copyright (C) 2000-2005 Pham Kim Long
+ * Contact:
+ *   unikey@gmail.com
+ *   UniKey project: http://unikey.org
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//----------------------------------------------------------------------------
+// Source tables of the input engine: the vowel and consonant sequences of
+// Vietnamese syllables, the pairs of them that make valid syllables and the
+// letters of the Latin-1 range. uktablegen derives the sorted lookups and
+// byte maps of uktables.h from these at build time, so this file and
+// data.cpp must not use anything it generates.
+//----------------------------------------------------------------------------
+
+#ifndef __UK_DATA_H
+#define __UK_DATA_H
+
+#include "vnlexi.h"
+
+struct VowelSeqInfo {
+    int len;
+    int complete;
+    int conSuffix; //allow consonnant suffix
+    VnLexiName v[3];
+    VowelSeq sub[3];
+
+    int roofPos;
+    VowelSeq withRoof;
+
+    int hookPos;
+    VowelSeq withHook; //hook & bowl
+};
+
+struct ConSeqInfo {
+    int len;
+    VnLexiName c[3];
+    bool suffix;
+};
+
+struct VSeqPair {
+    VnLexiName v[3];
+    VowelSeq vs;
+};
+
+struct CSeqPair {
+    VnLexiName c[3];
+    ConSeq cs;
+};
+
+struct VCPair {
+    VowelSeq v;
+    ConSeq c;
+};
+
+struct _ascVnLexi {
+    int asc;
+    VnLexiName lexi;
+};
+
+extern const VowelSeqInfo VSeqList[];
+extern const int VSeqCount;
+extern const ConSeqInfo CSeqList[];
+extern const int CSeqCount;
+extern const VCPair VCPairList[];
+extern const int VCPairCount;
+
+extern const unsigned char WordBreakSyms[];
+extern const int WordBreakSymCount;
+extern const VnLexiName AZLexiUpper[];
+extern const VnLexiName AZLexiLower[];
+extern const _ascVnLexi AscVnLexiList[];
+extern const unsigned char SpecialWesternChars[];
+
+// orders of SortedVSeqList, SortedCSeqList and SortedVCPairList
+int tripleVowelCompare(const void *p1, const void *p2);
+int tripleConCompare(const void *p1, const void *p2);
+int VCPairCompare(const void *p1, const void *p2);
+
+#endif
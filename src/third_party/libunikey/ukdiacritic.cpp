@@ -0,0 +1,407 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "ukdiacritic.h"
+#include "charset.h"
+#include "ukutf8.h"
+
+#define NO_SYLLABLE 0xFFFFFFFF
+
+//---------------------------------------------------------------
+// A word touching one of these is part of something else: a number, an
+// identifier, a word of another language.
+//---------------------------------------------------------------
+static bool gluesToWord(uint32_t cp)
+{
+    return cp >= 0x80 || (cp >= '0' && cp <= '9') || cp == '_';
+}
+
+//---------------------------------------------------------------
+UkDiacriticModel::UkDiacriticModel()
+{
+    maxCandidates = 16;
+    beamWidth = 8;
+    m_map = 0;
+    m_mapSize = 0;
+    m_syllableCount = 0;
+    m_rootCount = 0;
+    m_backoff = 0;
+    m_bigramStart = 0;
+    m_bigramNext = 0;
+    m_rootStart = 0;
+    m_candidates = 0;
+    m_unigram = 0;
+    m_bigram = 0;
+    m_syllables = 0;
+    m_roots = 0;
+}
+
+//---------------------------------------------------------------
+UkDiacriticModel::~UkDiacriticModel()
+{
+    unload();
+}
+
+//---------------------------------------------------------------
+static bool offsetsValid(const uint32_t *offset, uint32_t count, uint32_t size)
+{
+    if (offset[0] != 0 || offset[count] != size)
+        return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (offset[i] > offset[i + 1])
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------
+static bool idsValid(const uint32_t *ids, uint32_t count, uint32_t limit)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (ids[i] >= limit)
+            return false;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------
+int UkDiacriticModel::load(const char *fileName)
+{
+    unload();
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (long)sizeof(UkNgramHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const UkNgramHeader *header = (const UkNgramHeader *)map;
+    uint64_t n = header->syllableCount;
+    uint64_t r = header->rootCount;
+    uint64_t b = header->bigramCount;
+
+    if (memcmp(header->magic, UKNGRAM_MAGIC, sizeof(header->magic)) != 0 ||
+        n == 0 || n > UKNGRAM_MAX_SYLLABLES || r == 0 || r > n ||
+        (uint64_t)st.st_size != sizeof(UkNgramHeader) +
+            4 * (2 * n + 2 + b + r + 1) + 2 * (n + b) +
+            UKNGRAM_MAX_LETTERS * (n + r)) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    const uint32_t *bigramStart = (const uint32_t *)(header + 1);
+    const uint32_t *bigramNext = bigramStart + n + 2;
+    const uint32_t *rootStart = bigramNext + b;
+    const uint32_t *candidates = rootStart + r + 1;
+    if (!offsetsValid(bigramStart, n + 1, b) || !idsValid(bigramNext, b, n) ||
+        !offsetsValid(rootStart, r, n) || !idsValid(candidates, n, n)) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    m_map = map;
+    m_mapSize = st.st_size;
+    m_syllableCount = n;
+    m_rootCount = r;
+    m_backoff = header->backoff;
+    m_bigramStart = bigramStart;
+    m_bigramNext = bigramNext;
+    m_rootStart = rootStart;
+    m_candidates = candidates;
+    m_unigram = (const int16_t *)(candidates + n);
+    m_bigram = m_unigram + n;
+    m_syllables = (const uint8_t *)(m_bigram + b);
+    m_roots = m_syllables + UKNGRAM_MAX_LETTERS * n;
+    return 1;
+}
+
+//---------------------------------------------------------------
+void UkDiacriticModel::unload()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_syllableCount = 0;
+    m_rootCount = 0;
+    m_backoff = 0;
+    m_bigramStart = 0;
+    m_bigramNext = 0;
+    m_rootStart = 0;
+    m_candidates = 0;
+    m_unigram = 0;
+    m_bigram = 0;
+    m_syllables = 0;
+    m_roots = 0;
+}
+
+//---------------------------------------------------------------
+static int findKey(const uint8_t *table, uint32_t count, const uint8_t *key)
+{
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int ret = memcmp(table + mid * UKNGRAM_MAX_LETTERS, key, UKNGRAM_MAX_LETTERS);
+        if (ret == 0)
+            return mid;
+        if (ret < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+//---------------------------------------------------------------
+int UkDiacriticModel::findSyllable(const uint8_t *key) const
+{
+    return findKey(m_syllables, m_syllableCount, key);
+}
+
+//---------------------------------------------------------------
+int UkDiacriticModel::findRoot(const uint8_t *key) const
+{
+    return findKey(m_roots, m_rootCount, key);
+}
+
+//---------------------------------------------------------------
+bool UkDiacriticModel::splitWords(const char *in, int inLen, std::vector<Word> &words)
+{
+    const unsigned char *p = (const unsigned char *)in;
+    bool blanksOnly = true; // since the last word
+    bool glued = false;     // the last code point glues to a word
+    bool inWord = false;
+    Word word;
+
+    words.clear();
+    for (int pos = 0; pos <= inLen; ) {
+        uint32_t cp = 0;
+        int len = pos < inLen ? UkReadUtf8(p + pos, inLen - pos, cp) : 1;
+        int index = pos < inLen ? UkUnicodeToLexi(cp) : -1;
+
+        if (index >= 0) {
+            if (!inWord) {
+                inWord = true;
+                word.start = pos;
+                word.letters = 0;
+                word.newRun = !blanksOnly;
+                word.marked = false;
+                memset(word.key, 0, sizeof(word.key));
+                memset(word.upper, 0, sizeof(word.upper));
+                if (glued)
+                    word.letters = -1;
+            }
+            if (StdVnRootChar[index] != index)
+                word.marked = true;
+            if (word.letters >= 0 && word.letters < UKNGRAM_MAX_LETTERS) {
+                word.key[word.letters] = index | 1; //lower case letters are odd
+                word.upper[word.letters] = !(index & 1);
+                word.letters++;
+            } else {
+                word.letters = -1;
+            }
+        } else {
+            if (inWord) {
+                inWord = false;
+                word.end = pos;
+                if (word.letters < 0 || (pos < inLen && gluesToWord(cp)))
+                    word.letters = 0;
+                words.push_back(word);
+                blanksOnly = true;
+            }
+            if (pos < inLen && cp != ' ' && cp != '\t')
+                blanksOnly = false;
+            glued = gluesToWord(cp);
+        }
+        pos += len;
+    }
+    return !words.empty() && blanksOnly;
+}
+
+//---------------------------------------------------------------
+void UkDiacriticModel::putSyllable(std::string &out, const uint8_t *key,
+                                   const uint8_t *upper, int letters)
+{
+    for (int i = 0; i < letters; i++)
+        UkWriteUtf8(out, UnicodeTable[key[i] - (upper[i] ? 1 : 0)]);
+}
+
+//---------------------------------------------------------------
+uint32_t UkDiacriticModel::contextSyllable(const char *context) const
+{
+    std::vector<Word> words;
+    if (!context || !splitWords(context, strlen(context), words))
+        return m_syllableCount;
+
+    const Word &last = words.back();
+    if (last.letters == 0)
+        return m_syllableCount;
+    int id = findSyllable(last.key);
+    return id >= 0 ? (uint32_t)id : m_syllableCount;
+}
+
+//---------------------------------------------------------------
+// Viterbi over the candidates of words[first, last), keeping the best
+// beamWidth paths at each word. found[] holds the syllable of a marked
+// word, the root of the others.
+//---------------------------------------------------------------
+void UkDiacriticModel::decodeRun(const std::vector<Word> &words,
+                                 const std::vector<int> &found,
+                                 int first, int last, uint32_t start,
+                                 std::vector<uint32_t> &best) const
+{
+    std::vector<State> states;
+    states.reserve((last - first) * (maxCandidates + 1) + 1);
+    State init = { start, 0, -1 };
+    states.push_back(init);
+    int beamStart = 0, beamEnd = 1;
+    int top = 0;
+
+    for (int w = first; w < last; w++) {
+        uint32_t single = found[w];
+        const uint32_t *cand = &single;
+        int count = 1;
+        if (!words[w].marked) {
+            cand = m_candidates + m_rootStart[found[w]];
+            count = std::min<int>(m_rootStart[found[w] + 1] - m_rootStart[found[w]],
+                                  maxCandidates);
+        }
+
+        // The new states go in syllable order, so that each row of pairs is
+        // searched once for all of them.
+        int next = states.size();
+        for (int c = 0; c < count; c++) {
+            State s = { cand[c], INT32_MIN, -1 };
+            states.push_back(s);
+        }
+        std::sort(states.begin() + next, states.end(),
+                  [](const State &a, const State &b) {
+                      return a.syllable < b.syllable;
+                  });
+
+        for (int p = beamStart; p < beamEnd; p++) {
+            const uint32_t *pair = m_bigramNext + m_bigramStart[states[p].syllable];
+            const uint32_t *rowEnd = m_bigramNext + m_bigramStart[states[p].syllable + 1];
+            for (size_t c = next; c < states.size(); c++) {
+                State &s = states[c];
+                pair = std::lower_bound(pair, rowEnd, s.syllable);
+                int32_t score = states[p].score;
+                if (pair != rowEnd && *pair == s.syllable)
+                    score += m_bigram[pair - m_bigramNext];
+                else
+                    score += m_backoff + m_unigram[s.syllable];
+                if (score > s.score) {
+                    s.score = score;
+                    s.back = p;
+                }
+            }
+        }
+
+        if ((int)states.size() - next > beamWidth) {
+            std::partial_sort(states.begin() + next, states.begin() + next + beamWidth,
+                              states.end(),
+                              [](const State &a, const State &b) {
+                                  return a.score > b.score;
+                              });
+            states.resize(next + beamWidth);
+        }
+        beamStart = next;
+        beamEnd = states.size();
+
+        // Scores only compare within a word; keep them from running off
+        // on long runs.
+        top = beamStart;
+        for (int p = beamStart + 1; p < beamEnd; p++) {
+            if (states[p].score > states[top].score)
+                top = p;
+        }
+        int32_t shift = states[top].score;
+        for (int p = beamStart; p < beamEnd; p++)
+            states[p].score -= shift;
+    }
+
+    for (int w = last - 1; w >= first; w--) {
+        best[w] = states[top].syllable;
+        top = states[top].back;
+    }
+}
+
+//---------------------------------------------------------------
+void UkDiacriticModel::restore(const char *in, int inLen, std::string &out,
+                               const char *context) const
+{
+    if (!isLoaded()) {
+        out.append(in, inLen);
+        return;
+    }
+
+    std::vector<Word> words;
+    splitWords(in, inLen, words);
+    int count = words.size();
+
+    std::vector<int> found(count, -1);
+    for (int i = 0; i < count; i++) {
+        if (words[i].letters > 0)
+            found[i] = words[i].marked ? findSyllable(words[i].key) : findRoot(words[i].key);
+    }
+
+    // Runs of syllables with nothing but blanks between them
+    std::vector<uint32_t> best(count, NO_SYLLABLE);
+    for (int i = 0; i < count; ) {
+        if (found[i] < 0) {
+            i++;
+            continue;
+        }
+        int j = i + 1;
+        while (j < count && found[j] >= 0 && !words[j].newRun)
+            j++;
+        uint32_t start = (i == 0 && !words[0].newRun) ?
+            contextSyllable(context) : m_syllableCount;
+        decodeRun(words, found, i, j, start, best);
+        i = j;
+    }
+
+    int pos = 0;
+    for (int i = 0; i < count; i++) {
+        const Word &word = words[i];
+        out.append(in + pos, word.start - pos);
+        if (!word.marked && best[i] != NO_SYLLABLE)
+            putSyllable(out, m_syllables + best[i] * UKNGRAM_MAX_LETTERS,
+                        word.upper, word.letters);
+        else
+            out.append(in + word.start, word.end - word.start);
+        pos = word.end;
+    }
+    out.append(in + pos, inLen - pos);
+}
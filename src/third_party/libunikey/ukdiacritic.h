@@ -0,0 +1,137 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_DIACRITIC_H
+#define __UK_DIACRITIC_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Puts the tones and marks back into Vietnamese typed without them
+// ("tieng viet" -> "tiếng việt"), with a syllable bigram model in a file
+// that is mapped read-only.
+//
+// A syllable is written as in ukdict.h: one lower case VnLexiName per
+// letter, UKNGRAM_MAX_LETTERS at most, padded with 0. Its root is the same
+// with StdVnGetRoot() applied to every letter. The candidates of a word
+// typed without marks are the syllables of the model with that root.
+//
+// Scores are natural logs times UKNGRAM_LOG_SCALE. A pair missing from the
+// bigrams scores backoff + unigram of the second syllable ("stupid
+// backoff"). Syllable id syllableCount stands for the start of a sentence.
+//
+// File layout, all numbers in host byte order:
+//   UkNgramHeader
+//   uint32_t bigramStart[syllableCount+2]  bigrams after syllable s are
+//                                          [bigramStart[s], bigramStart[s+1])
+//   uint32_t bigramNext[bigramCount]       second syllable, sorted per row
+//   uint32_t rootStart[rootCount+1]        candidates of root r are
+//                                          [rootStart[r], rootStart[r+1])
+//   uint32_t candidates[syllableCount]     syllable ids, best unigram first
+//                                          within a root
+//   int16_t unigram[syllableCount]
+//   int16_t bigram[bigramCount]
+//   uint8_t syllables[syllableCount][UKNGRAM_MAX_LETTERS]  sorted
+//   uint8_t roots[rootCount][UKNGRAM_MAX_LETTERS]          sorted
+//----------------------------------------------------------------------
+
+#define UKNGRAM_MAGIC "UKNGRAM"
+#define UKNGRAM_MAX_LETTERS 8
+#define UKNGRAM_LOG_SCALE 256
+#define UKNGRAM_MAX_SYLLABLES 0x1000000
+
+struct UkNgramHeader {
+    char magic[8];
+    uint32_t syllableCount;
+    uint32_t rootCount;
+    uint32_t bigramCount;
+    int32_t backoff;
+};
+
+class UkDiacriticModel {
+public:
+    // A run of letters of the input
+    struct Word {
+        int start;      // byte offsets in the input
+        int end;
+        int letters;    // 0 if it cannot be a syllable
+        bool newRun;    // first word, or something else than blanks before it
+        bool marked;    // has a tone or a mark already
+        uint8_t key[UKNGRAM_MAX_LETTERS];
+        uint8_t upper[UKNGRAM_MAX_LETTERS];
+    };
+
+    UkDiacriticModel();
+    ~UkDiacriticModel();
+
+    int load(const char *fileName); // 1 on success
+    void unload();
+    bool isLoaded() const { return m_syllables != 0; }
+
+    // Appends the UTF-8 text in[0, inLen) to out with the diacritics of its
+    // words restored. Words which already have a mark stay as they are,
+    // and so does everything that is not a syllable. The last syllable of
+    // context (UTF-8, may be 0) leads into the first one of in.
+    // Only reads the model, so threads may share it.
+    void restore(const char *in, int inLen, std::string &out,
+                 const char *context = 0) const;
+
+    // Splits UTF-8 text into words the way restore() does. ibus-unikey-
+    // diacritics builds models with it. Returns false if text ends with
+    // something else than blanks after its last word.
+    static bool splitWords(const char *in, int inLen, std::vector<Word> &words);
+    static void putSyllable(std::string &out, const uint8_t *key,
+                            const uint8_t *upper, int letters);
+
+    // Candidates kept per word and paths kept per position of the beam
+    int maxCandidates;
+    int beamWidth;
+
+protected:
+    struct State {
+        uint32_t syllable;
+        int32_t score;
+        int back;       // index of the state before, -1 at the start
+    };
+
+    int findSyllable(const uint8_t *key) const;
+    int findRoot(const uint8_t *key) const;
+    uint32_t contextSyllable(const char *context) const;
+    void decodeRun(const std::vector<Word> &words, const std::vector<int> &found,
+                   int first, int last, uint32_t start,
+                   std::vector<uint32_t> &best) const;
+
+    void *m_map;
+    long m_mapSize;
+    uint32_t m_syllableCount;
+    uint32_t m_rootCount;
+    int32_t m_backoff;
+    const uint32_t *m_bigramStart;
+    const uint32_t *m_bigramNext;
+    const uint32_t *m_rootStart;
+    const uint32_t *m_candidates;
+    const int16_t *m_unigram;
+    const int16_t *m_bigram;
+    const uint8_t *m_syllables;
+    const uint8_t *m_roots;
+};
+
+#endif
@@ -0,0 +1,161 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ukdict.h"
+#include "charset.h"
+#include "vnlexi.h"
+#include "vnconv.h"
+
+//---------------------------------------------------------------
+UkDictionary::UkDictionary()
+{
+    m_map = 0;
+    m_mapSize = 0;
+    m_firstEdge = 0;
+    m_edges = 0;
+    m_stateCount = 0;
+    m_root = 0;
+}
+
+//---------------------------------------------------------------
+UkDictionary::~UkDictionary()
+{
+    unload();
+}
+
+//---------------------------------------------------------------
+int UkDictionary::load(const char *fileName)
+{
+    unload();
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (long)sizeof(UkDictHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const UkDictHeader *header = (const UkDictHeader *)map;
+    long expected = sizeof(UkDictHeader) +
+        ((long)header->stateCount + 1 + header->edgeCount) * sizeof(uint32_t);
+
+    if (memcmp(header->magic, UKDICT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->stateCount == 0 || header->stateCount > UKDICT_MAX_STATES ||
+        header->root >= header->stateCount || expected != st.st_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    m_map = map;
+    m_mapSize = st.st_size;
+    m_stateCount = header->stateCount;
+    m_root = header->root;
+    m_firstEdge = (const uint32_t *)(header + 1);
+    m_edges = m_firstEdge + m_stateCount + 1;
+    return 1;
+}
+
+//---------------------------------------------------------------
+void UkDictionary::unload()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_firstEdge = 0;
+    m_edges = 0;
+    m_stateCount = 0;
+}
+
+//---------------------------------------------------------------
+// One binary search over the edges of a state per label. The search is
+// written without data dependent branches, the labels of a syllable are
+// too random for the branch predictor.
+//---------------------------------------------------------------
+bool UkDictionary::contains(const unsigned char *key, int len) const
+{
+    if (!m_edges || len <= 0)
+        return false;
+
+    uint32_t state = m_root;
+    uint32_t edge = 0;
+
+    for (int i = 0; i < len; i++) {
+        if (state >= m_stateCount)
+            return false;
+
+        uint32_t lo = m_firstEdge[state];
+        uint32_t n = m_firstEdge[state+1] - lo;
+        if (n == 0)
+            return false;
+
+        const uint32_t *base = m_edges + lo;
+        uint32_t label = key[i];
+        while (n > 1) {
+            uint32_t half = n / 2;
+            base = (UKDICT_EDGE_LABEL(base[half]) <= label) ? base + half : base;
+            n -= half;
+        }
+        edge = *base;
+        if (UKDICT_EDGE_LABEL(edge) != label)
+            return false;
+        state = UKDICT_EDGE_TARGET(edge);
+    }
+    return UKDICT_EDGE_FINAL(edge);
+}
+
+//---------------------------------------------------------------
+int UkDictMakeKey(const char *utf8, unsigned char *key, int maxLen)
+{
+    StdVnChar stdChars[UKDICT_MAX_KEY];
+    int inLen = strlen(utf8);
+    int outLen = sizeof(stdChars);
+
+    if (VnConvert(CONV_CHARSET_UNIUTF8, CONV_CHARSET_VNSTANDARD,
+                  (UKBYTE *)utf8, (UKBYTE *)stdChars, &inLen, &outLen) != 0)
+        return -1;
+
+    int len = outLen / sizeof(StdVnChar);
+    if (len > maxLen)
+        return -1;
+
+    for (int i = 0; i < len; i++) {
+        StdVnChar ch = stdChars[i];
+        if (ch == ' ')
+            key[i] = UKDICT_SEPARATOR;
+        else if (ch >= VnStdCharOffset && ch < VnStdCharOffset + vnl_lastChar)
+            key[i] = (ch - VnStdCharOffset) | 1; //lower case letters are odd
+        else
+            return -1;
+    }
+    return len;
+}
@@ -0,0 +1,83 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_DICTIONARY_H
+#define __UK_DICTIONARY_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Set of Vietnamese syllables and words, stored as a minimal DFA in a
+// file that is mapped read-only, so it costs no heap and is shared
+// between processes.
+//
+// A key is a string of labels: one lower case VnLexiName (tone included)
+// per letter, and UKDICT_SEPARATOR between the syllables of a word.
+//
+// File layout, all numbers in host byte order:
+//   UkDictHeader
+//   uint32_t firstEdge[stateCount+1]  edges of state s are
+//                                     [firstEdge[s], firstEdge[s+1])
+//   uint32_t edges[edgeCount]         label:8 | final:1 | target:23,
+//                                     sorted by label within a state
+//----------------------------------------------------------------------
+
+#define UKDICT_MAGIC "UKDICT1"
+#define UKDICT_SEPARATOR 0xFF
+#define UKDICT_MAX_KEY 64
+
+#define UKDICT_EDGE_LABEL(e) ((e) >> 24)
+#define UKDICT_EDGE_FINAL(e) (((e) >> 23) & 1)
+#define UKDICT_EDGE_TARGET(e) ((e) & 0x7FFFFF)
+#define UKDICT_MAX_STATES 0x800000
+
+struct UkDictHeader {
+    char magic[8];
+    uint32_t stateCount;
+    uint32_t edgeCount;
+    uint32_t root;
+    uint32_t reserved;
+};
+
+class UkDictionary {
+public:
+    UkDictionary();
+    ~UkDictionary();
+
+    int load(const char *fileName); // 1 on success
+    void unload();
+    bool isLoaded() const { return m_edges != 0; }
+
+    bool contains(const unsigned char *key, int len) const;
+
+protected:
+    void *m_map;
+    long m_mapSize;
+    const uint32_t *m_firstEdge;
+    const uint32_t *m_edges;
+    uint32_t m_stateCount;
+    uint32_t m_root;
+};
+
+// Turns a UTF-8 syllable or word (syllables separated by spaces) into a
+// key. Returns the key length, or -1 if the text has characters other
+// than Vietnamese letters and spaces or is longer than maxLen.
+int UkDictMakeKey(const char *utf8, unsigned char *key, int maxLen);
+
+#endif
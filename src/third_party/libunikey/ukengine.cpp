@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <iostream>
 #include "keycons.h"
 
@@ -36,6 +37,7 @@
 #include "ukengine.h"
 
 #include "charset.h"
+#include "uktables.h"
 
 using namespace std;
 
@@ -46,223 +48,11 @@ using namespace std;
 #define IS_STD_VN_LOWER(x) ((x) >= VnStdCharOffset && (x) < (VnStdCharOffset + TOTAL_ALPHA_VNCHARS) && IS_ODD(x))
 #define IS_STD_VN_UPPER(x) ((x) >= VnStdCharOffset && (x) < (VnStdCharOffset + TOTAL_ALPHA_VNCHARS) && IS_EVEN(x))
 
-bool IsVnVowel[vnl_lastChar];
-
-extern VnLexiName AZLexiUpper[]; //defined in inputproc.cpp
-extern VnLexiName AZLexiLower[];
-
-//see vnconv/data.cpp for explanation of these characters
-unsigned char SpecialWesternChars[] = {
-  0x80, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
-  0x89, 0x8A, 0x8B, 0x8C, 0x8E, 0x91, 0x92, 0x93,
-  0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B,
-  0x9C, 0x9E, 0x9F, 0x00};
-
-StdVnChar IsoStdVnCharMap[256];
-
 inline StdVnChar IsoToStdVnChar(int keyCode)
 {
     return (keyCode < 256)? IsoStdVnCharMap[keyCode] : keyCode;
 }
 
-struct VowelSeqInfo {
-    int len;
-    int complete;
-    int conSuffix; //allow consonnant suffix
-    VnLexiName v[3];
-    VowelSeq sub[3];
-
-    int roofPos;
-    VowelSeq withRoof;
-
-    int hookPos;
-    VowelSeq withHook; //hook & bowl
-};
-
-VowelSeqInfo VSeqList[] = {
-    {1, 1, 1, {vnl_a, vnl_nonVnChar, vnl_nonVnChar}, {vs_a, vs_nil, vs_nil}, -1, vs_ar, -1, vs_ab},
-    {1, 1, 1, {vnl_ar, vnl_nonVnChar, vnl_nonVnChar}, {vs_ar, vs_nil, vs_nil}, 0, vs_nil, -1, vs_ab},
-    {1, 1, 1, {vnl_ab, vnl_nonVnChar, vnl_nonVnChar}, {vs_ab, vs_nil, vs_nil}, -1, vs_ar, 0, vs_nil},
-    {1, 1, 1, {vnl_e, vnl_nonVnChar, vnl_nonVnChar}, {vs_e, vs_nil, vs_nil}, -1, vs_er, -1, vs_nil},
-    {1, 1, 1, {vnl_er, vnl_nonVnChar, vnl_nonVnChar}, {vs_er, vs_nil, vs_nil}, 0, vs_nil, -1, vs_nil},
-    {1, 1, 1, {vnl_i, vnl_nonVnChar, vnl_nonVnChar}, {vs_i, vs_nil, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {1, 1, 1, {vnl_o, vnl_nonVnChar, vnl_nonVnChar}, {vs_o, vs_nil, vs_nil}, -1, vs_or, -1, vs_oh},
-    {1, 1, 1, {vnl_or, vnl_nonVnChar, vnl_nonVnChar}, {vs_or, vs_nil, vs_nil}, 0, vs_nil, -1, vs_oh},
-    {1, 1, 1, {vnl_oh, vnl_nonVnChar, vnl_nonVnChar}, {vs_oh, vs_nil, vs_nil}, -1, vs_or, 0, vs_nil},
-    {1, 1, 1, {vnl_u, vnl_nonVnChar, vnl_nonVnChar}, {vs_u, vs_nil, vs_nil}, -1, vs_nil, -1, vs_uh},
-    {1, 1, 1, {vnl_uh, vnl_nonVnChar, vnl_nonVnChar}, {vs_uh, vs_nil, vs_nil}, -1, vs_nil, 0, vs_nil},
-    {1, 1, 1, {vnl_y, vnl_nonVnChar, vnl_nonVnChar}, {vs_y, vs_nil, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_a, vnl_i, vnl_nonVnChar}, {vs_a, vs_ai, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_a, vnl_o, vnl_nonVnChar}, {vs_a, vs_ao, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_a, vnl_u, vnl_nonVnChar}, {vs_a, vs_au, vs_nil}, -1, vs_aru, -1, vs_nil},
-    {2, 1, 0, {vnl_a, vnl_y, vnl_nonVnChar}, {vs_a, vs_ay, vs_nil}, -1, vs_ary, -1, vs_nil},
-    {2, 1, 0, {vnl_ar, vnl_u, vnl_nonVnChar}, {vs_ar, vs_aru, vs_nil}, 0, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_ar, vnl_y, vnl_nonVnChar}, {vs_ar, vs_ary, vs_nil}, 0, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_e, vnl_o, vnl_nonVnChar}, {vs_e, vs_eo, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 0, 0, {vnl_e, vnl_u, vnl_nonVnChar}, {vs_e, vs_eu, vs_nil}, -1, vs_eru, -1, vs_nil},
-    {2, 1, 0, {vnl_er, vnl_u, vnl_nonVnChar}, {vs_er, vs_eru, vs_nil}, 0, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_i, vnl_a, vnl_nonVnChar}, {vs_i, vs_ia, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 0, 1, {vnl_i, vnl_e, vnl_nonVnChar}, {vs_i, vs_ie, vs_nil}, -1, vs_ier, -1, vs_nil},
-    {2, 1, 1, {vnl_i, vnl_er, vnl_nonVnChar}, {vs_i, vs_ier, vs_nil}, 1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_i, vnl_u, vnl_nonVnChar}, {vs_i, vs_iu, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 1, {vnl_o, vnl_a, vnl_nonVnChar}, {vs_o, vs_oa, vs_nil}, -1, vs_nil, -1, vs_oab},
-    {2, 1, 1, {vnl_o, vnl_ab, vnl_nonVnChar}, {vs_o, vs_oab, vs_nil}, -1, vs_nil, 1, vs_nil},
-    {2, 1, 1, {vnl_o, vnl_e, vnl_nonVnChar}, {vs_o, vs_oe, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_o, vnl_i, vnl_nonVnChar}, {vs_o, vs_oi, vs_nil}, -1, vs_ori, -1, vs_ohi},
-    {2, 1, 0, {vnl_or, vnl_i, vnl_nonVnChar}, {vs_or, vs_ori, vs_nil}, 0, vs_nil, -1, vs_ohi},
-    {2, 1, 0, {vnl_oh, vnl_i, vnl_nonVnChar}, {vs_oh, vs_ohi, vs_nil}, -1, vs_ori, 0, vs_nil},
-    {2, 1, 1, {vnl_u, vnl_a, vnl_nonVnChar}, {vs_u, vs_ua, vs_nil}, -1, vs_uar, -1, vs_uha},
-    {2, 1, 1, {vnl_u, vnl_ar, vnl_nonVnChar}, {vs_u, vs_uar, vs_nil}, 1, vs_nil, -1, vs_nil},
-    {2, 0, 1, {vnl_u, vnl_e, vnl_nonVnChar}, {vs_u, vs_ue, vs_nil}, -1, vs_uer, -1, vs_nil},
-    {2, 1, 1, {vnl_u, vnl_er, vnl_nonVnChar}, {vs_u, vs_uer, vs_nil}, 1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_u, vnl_i, vnl_nonVnChar}, {vs_u, vs_ui, vs_nil}, -1, vs_nil, -1, vs_uhi},
-    {2, 0, 1, {vnl_u, vnl_o, vnl_nonVnChar}, {vs_u, vs_uo, vs_nil}, -1, vs_uor, -1, vs_uho},
-    {2, 1, 1, {vnl_u, vnl_or, vnl_nonVnChar}, {vs_u, vs_uor, vs_nil}, 1, vs_nil, -1, vs_uoh},
-    {2, 1, 1, {vnl_u, vnl_oh, vnl_nonVnChar}, {vs_u, vs_uoh, vs_nil}, -1, vs_uor, 1, vs_uhoh},
-    {2, 0, 0, {vnl_u, vnl_u, vnl_nonVnChar}, {vs_u, vs_uu, vs_nil}, -1, vs_nil, -1, vs_uhu},
-    {2, 1, 1, {vnl_u, vnl_y, vnl_nonVnChar}, {vs_u, vs_uy, vs_nil}, -1, vs_nil, -1, vs_nil},
-    {2, 1, 0, {vnl_uh, vnl_a, vnl_nonVnChar}, {vs_uh, vs_uha, vs_nil}, -1, vs_nil, 0, vs_nil},
-    {2, 1, 0, {vnl_uh, vnl_i, vnl_nonVnChar}, {vs_uh, vs_uhi, vs_nil}, -1, vs_nil, 0, vs_nil},
-    {2, 0, 1, {vnl_uh, vnl_o, vnl_nonVnChar}, {vs_uh, vs_uho, vs_nil}, -1, vs_nil, 0, vs_uhoh},
-    {2, 1, 1, {vnl_uh, vnl_oh, vnl_nonVnChar}, {vs_uh, vs_uhoh, vs_nil}, -1, vs_nil, 0, vs_nil},
-    {2, 1, 0, {vnl_uh, vnl_u, vnl_nonVnChar}, {vs_uh, vs_uhu, vs_nil}, -1, vs_nil, 0, vs_nil},
-    {2, 0, 1, {vnl_y, vnl_e, vnl_nonVnChar}, {vs_y, vs_ye, vs_nil}, -1, vs_yer, -1, vs_nil},
-    {2, 1, 1, {vnl_y, vnl_er, vnl_nonVnChar}, {vs_y, vs_yer, vs_nil}, 1, vs_nil, -1, vs_nil},
-    {3, 0, 0, {vnl_i, vnl_e, vnl_u}, {vs_i, vs_ie, vs_ieu}, -1, vs_ieru, -1, vs_nil},
-    {3, 1, 0, {vnl_i, vnl_er, vnl_u}, {vs_i, vs_ier, vs_ieru}, 1, vs_nil, -1, vs_nil},
-    {3, 1, 0, {vnl_o, vnl_a, vnl_i}, {vs_o, vs_oa, vs_oai}, -1, vs_nil, -1, vs_nil},
-    {3, 1, 0, {vnl_o, vnl_a, vnl_y}, {vs_o, vs_oa, vs_oay}, -1, vs_nil, -1, vs_nil},  
-    {3, 1, 0, {vnl_o, vnl_e, vnl_o}, {vs_o, vs_oe, vs_oeo}, -1, vs_nil, -1, vs_nil},
-    {3, 0, 0, {vnl_u, vnl_a, vnl_y}, {vs_u, vs_ua, vs_uay}, -1, vs_uary, -1, vs_nil},
-    {3, 1, 0, {vnl_u, vnl_ar, vnl_y}, {vs_u, vs_uar, vs_uary}, 1, vs_nil, -1, vs_nil},
-    {3, 0, 0, {vnl_u, vnl_o, vnl_i}, {vs_u, vs_uo, vs_uoi}, -1, vs_uori, -1, vs_uhoi},
-    {3, 0, 0, {vnl_u, vnl_o, vnl_u}, {vs_u, vs_uo, vs_uou}, -1, vs_nil, -1, vs_uhou},
-    {3, 1, 0, {vnl_u, vnl_or, vnl_i}, {vs_u, vs_uor, vs_uori}, 1, vs_nil, -1, vs_uohi},
-    {3, 0, 0, {vnl_u, vnl_oh, vnl_i}, {vs_u, vs_uoh, vs_uohi}, -1, vs_uori, 1, vs_uhohi},
-    {3, 0, 0, {vnl_u, vnl_oh, vnl_u}, {vs_u, vs_uoh, vs_uohu}, -1, vs_nil, 1, vs_uhohu},
-    {3, 1, 0, {vnl_u, vnl_y, vnl_a}, {vs_u, vs_uy, vs_uya}, -1, vs_nil, -1, vs_nil},
-    {3, 0, 1, {vnl_u, vnl_y, vnl_e}, {vs_u, vs_uy, vs_uye}, -1, vs_uyer, -1, vs_nil},
-    {3, 1, 1, {vnl_u, vnl_y, vnl_er}, {vs_u, vs_uy, vs_uyer}, 2, vs_nil, -1, vs_nil},
-    {3, 1, 0, {vnl_u, vnl_y, vnl_u}, {vs_u, vs_uy, vs_uyu}, -1, vs_nil, -1, vs_nil},
-    {3, 0, 0, {vnl_uh, vnl_o, vnl_i}, {vs_uh, vs_uho, vs_uhoi}, -1, vs_nil, 0, vs_uhohi},
-    {3, 0, 0, {vnl_uh, vnl_o, vnl_u}, {vs_uh, vs_uho, vs_uhou}, -1, vs_nil, 0, vs_uhohu},
-    {3, 1, 0, {vnl_uh, vnl_oh, vnl_i}, {vs_uh, vs_uhoh, vs_uhohi}, -1, vs_nil, 0, vs_nil},
-    {3, 1, 0, {vnl_uh, vnl_oh, vnl_u}, {vs_uh, vs_uhoh, vs_uhohu}, -1, vs_nil, 0, vs_nil},
-    {3, 0, 0, {vnl_y, vnl_e, vnl_u}, {vs_y, vs_ye, vs_yeu}, -1, vs_yeru, -1, vs_nil},
-    {3, 1, 0, {vnl_y, vnl_er, vnl_u}, {vs_y, vs_yer, vs_yeru}, 1, vs_nil, -1, vs_nil}
-};
-
-struct ConSeqInfo {
-    int len;
-    VnLexiName c[3];
-    bool suffix;
-};
-
-ConSeqInfo CSeqList[] = {
-    {1, {vnl_b, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_c, vnl_nonVnChar, vnl_nonVnChar}, true},
-    {2, {vnl_c, vnl_h, vnl_nonVnChar}, true},
-    {1, {vnl_d, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_dd, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {2, {vnl_d, vnl_z, vnl_nonVnChar}, false},
-    {1, {vnl_g, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {2, {vnl_g, vnl_h, vnl_nonVnChar}, false},
-    {2, {vnl_g, vnl_i, vnl_nonVnChar}, false},
-    {3, {vnl_g, vnl_i, vnl_n}, false},
-    {1, {vnl_h, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_k, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {2, {vnl_k, vnl_h, vnl_nonVnChar}, false},
-    {1, {vnl_l, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_m, vnl_nonVnChar, vnl_nonVnChar}, true},
-    {1, {vnl_n, vnl_nonVnChar, vnl_nonVnChar}, true},
-    {2, {vnl_n, vnl_g, vnl_nonVnChar}, true},
-    {3, {vnl_n, vnl_g, vnl_h}, false},
-    {2, {vnl_n, vnl_h, vnl_nonVnChar}, true},
-    {1, {vnl_p, vnl_nonVnChar, vnl_nonVnChar}, true},
-    {2, {vnl_p, vnl_h, vnl_nonVnChar}, false},
-    {1, {vnl_q, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {2, {vnl_q, vnl_u, vnl_nonVnChar}, false},
-    {1, {vnl_r, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_s, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_t, vnl_nonVnChar, vnl_nonVnChar}, true},
-    {2, {vnl_t, vnl_h, vnl_nonVnChar}, false},
-    {2, {vnl_t, vnl_r, vnl_nonVnChar}, false},
-    {1, {vnl_v, vnl_nonVnChar, vnl_nonVnChar}, false},
-    {1, {vnl_x, vnl_nonVnChar, vnl_nonVnChar}, false}
-};
-
-const int VSeqCount = sizeof(VSeqList)/sizeof(VowelSeqInfo);
-struct VSeqPair {
-    VnLexiName v[3];
-    VowelSeq vs;
-};
-VSeqPair SortedVSeqList[VSeqCount];
-
-const int CSeqCount = sizeof(CSeqList)/sizeof(ConSeqInfo);
-struct CSeqPair {
-    VnLexiName c[3];
-    ConSeq cs;
-};
-CSeqPair SortedCSeqList[CSeqCount];
-
-struct VCPair {
-    VowelSeq v;
-    ConSeq c;
-};
-
-VCPair VCPairList [] = {
-  {vs_a, cs_c}, {vs_a, cs_ch}, {vs_a, cs_m}, {vs_a, cs_n}, {vs_a, cs_ng},
-                {vs_a, cs_nh}, {vs_a, cs_p}, {vs_a, cs_t},
-  {vs_ar, cs_c}, {vs_ar, cs_m}, {vs_ar, cs_n}, {vs_ar, cs_ng}, {vs_ar, cs_p}, {vs_ar, cs_t},
-  {vs_ab, cs_c}, {vs_ab, cs_m}, {vs_ab, cs_n}, {vs_ab, cs_ng}, {vs_ab, cs_p}, {vs_ab, cs_t},
-
-  {vs_e, cs_c}, {vs_e, cs_ch}, {vs_e, cs_m}, {vs_e, cs_n}, {vs_e, cs_ng},
-                {vs_e, cs_nh}, {vs_e, cs_p}, {vs_e, cs_t},
-  {vs_er, cs_c}, {vs_er, cs_ch}, {vs_er, cs_m}, {vs_er, cs_n}, {vs_er, cs_nh},
-                {vs_er, cs_p}, {vs_er, cs_t},
-
-  {vs_i, cs_c}, {vs_i, cs_ch}, {vs_i, cs_m}, {vs_i, cs_n}, {vs_i, cs_nh}, {vs_i, cs_p}, {vs_i, cs_t},
-
-  {vs_o, cs_c}, {vs_o, cs_m}, {vs_o, cs_n}, {vs_o, cs_ng}, {vs_o, cs_p}, {vs_o, cs_t},
-  {vs_or, cs_c}, {vs_or, cs_m}, {vs_or, cs_n}, {vs_or, cs_ng}, {vs_or, cs_p}, {vs_or, cs_t},
-  {vs_oh, cs_m}, {vs_oh, cs_n}, {vs_oh, cs_p}, {vs_oh, cs_t},
-
-  {vs_u, cs_c}, {vs_u, cs_m}, {vs_u, cs_n}, {vs_u, cs_ng}, {vs_u, cs_p}, {vs_u, cs_t},
-  {vs_uh, cs_c}, {vs_uh, cs_m}, {vs_uh, cs_n}, {vs_uh, cs_ng}, {vs_uh, cs_t},
-
-  {vs_y, cs_t},
-  {vs_ie, cs_c}, {vs_ie, cs_m}, {vs_ie, cs_n}, {vs_ie, cs_ng}, {vs_ie, cs_p}, {vs_ie, cs_t},
-  {vs_ier, cs_c}, {vs_ier, cs_m}, {vs_ier, cs_n}, {vs_ier, cs_ng}, {vs_ier, cs_p}, {vs_ier, cs_t},
-
-  {vs_oa, cs_c}, {vs_oa, cs_ch}, {vs_oa, cs_m}, {vs_oa, cs_n}, {vs_oa, cs_ng},
-                 {vs_oa, cs_nh}, {vs_oa, cs_p}, {vs_oa, cs_t},
-  {vs_oab, cs_c}, {vs_oab, cs_m}, {vs_oab, cs_n}, {vs_oab, cs_ng}, {vs_oab, cs_t},
-
-  {vs_oe, cs_n}, {vs_oe, cs_t},
-
-  {vs_ua, cs_n}, {vs_ua, cs_ng}, {vs_ua, cs_t},
-  {vs_uar, cs_n}, {vs_uar, cs_ng}, {vs_uar, cs_t},
-
-  {vs_ue, cs_c}, {vs_ue, cs_ch}, {vs_ue, cs_n}, {vs_ue, cs_nh},
-  {vs_uer, cs_c}, {vs_uer, cs_ch}, {vs_uer, cs_n}, {vs_uer, cs_nh},
-
-  {vs_uo, cs_c}, {vs_uo, cs_m}, {vs_uo, cs_n}, {vs_uo, cs_ng}, {vs_uo, cs_p}, {vs_uo, cs_t},
-  {vs_uor, cs_c}, {vs_uor, cs_m}, {vs_uor, cs_n}, {vs_uor, cs_ng}, {vs_uor, cs_t},
-  {vs_uho, cs_c}, {vs_uho, cs_m}, {vs_uho, cs_n}, {vs_uho, cs_ng}, {vs_uho, cs_p}, {vs_uho, cs_t},
-  {vs_uhoh, cs_c}, {vs_uhoh, cs_m}, {vs_uhoh, cs_n}, {vs_uhoh, cs_ng}, {vs_uhoh, cs_p}, {vs_uhoh, cs_t},
-
-  {vs_uy, cs_c}, {vs_uy, cs_ch}, {vs_uy, cs_n}, {vs_uy, cs_nh}, {vs_uy, cs_p}, {vs_uy, cs_t},
-
-  {vs_ye, cs_m}, {vs_ye, cs_n}, {vs_ye, cs_ng}, {vs_ye, cs_p}, {vs_ye, cs_t},
-  {vs_yer, cs_m}, {vs_yer, cs_n}, {vs_yer, cs_ng}, {vs_yer, cs_t},
-
-  {vs_uye, cs_n}, {vs_uye, cs_t},
-  {vs_uyer, cs_n}, {vs_uyer, cs_t}
-
-};
-
-const int VCPairCount = sizeof(VCPairList)/sizeof(VCPair);
-
 //TODO: auto-complete: e.g. luan -> lua^n
 
 typedef int (UkEngine::* UkKeyProc)(UkKeyEvent & ev);
@@ -294,63 +84,13 @@ UkKeyProc UkKeyProcList[vneCount] = {
 VowelSeq lookupVSeq(VnLexiName v1, VnLexiName v2 = vnl_nonVnChar, VnLexiName v3 = vnl_nonVnChar);
 ConSeq lookupCSeq(VnLexiName c1, VnLexiName c2 = vnl_nonVnChar, VnLexiName c3 = vnl_nonVnChar);
 
-bool UkEngine::m_classInit = false;
-
-//------------------------------------------------
-int tripleVowelCompare(const void *p1, const void *p2)
-{
-    VSeqPair *t1 = (VSeqPair *)p1;
-    VSeqPair *t2 = (VSeqPair *)p2;
-
-    for (int i=0; i<3; i++) {
-        if (t1->v[i] < t2->v[i])
-            return -1;
-        if (t1->v[i] > t2->v[i])
-            return 1;
-    }
-    return 0;
-}
-
-//------------------------------------------------
-int tripleConCompare(const void *p1, const void *p2)
-{
-    CSeqPair *t1 = (CSeqPair *)p1;
-    CSeqPair *t2 = (CSeqPair *)p2;
-
-    for (int i=0; i<3; i++) {
-        if (t1->c[i] < t2->c[i])
-            return -1;
-        if (t1->c[i] > t2->c[i])
-            return 1;
-    }
-    return 0;
-}
-
-//------------------------------------------------
-int VCPairCompare(const void *p1, const void *p2)
-{
-    VCPair *t1 = (VCPair *)p1;
-    VCPair *t2 = (VCPair *)p2;
-
-    if (t1->v < t2->v)
-        return -1;
-    if (t1->v > t2->v)
-      return 1;
-  
-    if (t1->c < t2->c)
-        return -1;
-    if (t1->c > t2->c)
-        return 1;
-    return 0;
-}
-
 //----------------------------------------------------------
 bool isValidCV(ConSeq c, VowelSeq v)
 {
     if (c == cs_nil || v == vs_nil)
         return true;
 
-    VowelSeqInfo & vInfo = VSeqList[v];
+    const VowelSeqInfo & vInfo = VSeqList[v];
 
     if ((c == cs_gi && vInfo.v[0] == vnl_i) ||
         (c == cs_qu && vInfo.v[0] == vnl_u))
@@ -375,18 +115,18 @@ bool isValidVC(VowelSeq v, ConSeq c)
     if (v == vs_nil || c == cs_nil)
         return true;
 
-    VowelSeqInfo & vInfo = VSeqList[v];
+    const VowelSeqInfo & vInfo = VSeqList[v];
     if (!vInfo.conSuffix)
         return false;
 
-    ConSeqInfo & cInfo = CSeqList[c];
+    const ConSeqInfo & cInfo = CSeqList[c];
     if (!cInfo.suffix)
         return false;
 
     VCPair p;
     p.v = v;
     p.c = c;
-    if (bsearch(&p, VCPairList, VCPairCount, sizeof(VCPair), VCPairCompare))
+    if (bsearch(&p, SortedVCPairList, VCPairCount, sizeof(VCPair), VCPairCompare))
         return true;
 
     return false;
@@ -424,42 +164,6 @@ bool isValidCVC(ConSeq c1, VowelSeq v, ConSeq c2)
     return false;
 }
 
-//------------------------------------------------
-void engineClassInit()
-{
-    int i, j;
-
-    for (i=0; i < VSeqCount; i++) {
-        for (j=0; j<3; j++)
-            SortedVSeqList[i].v[j] = VSeqList[i].v[j];
-        SortedVSeqList[i].vs = (VowelSeq)i;
-    }
-
-    for (i=0; i < CSeqCount; i++) {
-        for (j=0; j<3; j++)
-            SortedCSeqList[i].c[j] = CSeqList[i].c[j];
-        SortedCSeqList[i].cs = (ConSeq)i;
-    }
-
-    qsort(SortedVSeqList, VSeqCount, sizeof(VSeqPair), tripleVowelCompare);
-    qsort(SortedCSeqList, CSeqCount, sizeof(CSeqPair), tripleConCompare);
-    qsort(VCPairList, VCPairCount, sizeof(VCPair), VCPairCompare);
-
-    for (i=0; i<vnl_lastChar; i++)
-        IsVnVowel[i] = true;
-
-    unsigned char ch;
-    for (ch='a'; ch <= 'z'; ch++) {
-        if (ch != 'a' && ch != 'e' && ch != 'i' &&
-            ch != 'o' && ch != 'u' && ch != 'y') {
-            IsVnVowel[AZLexiLower[ch-'a']] = false;
-            IsVnVowel[AZLexiUpper[ch-'a']] = false;
-        }
-    }
-    IsVnVowel[vnl_dd] = false;
-    IsVnVowel[vnl_DD] = false;
-}
-
 //------------------------------------------------
 VowelSeq lookupVSeq(VnLexiName v1, VnLexiName v2, VnLexiName v3)
 {
@@ -468,7 +172,7 @@ VowelSeq lookupVSeq(VnLexiName v1, VnLexiName v2, VnLexiName v3)
     key.v[1] = v2;
     key.v[2] = v3;
 
-    VSeqPair *pInfo = (VSeqPair *)bsearch(&key, SortedVSeqList, VSeqCount, sizeof(VSeqPair), tripleVowelCompare);
+    const VSeqPair *pInfo = (const VSeqPair *)bsearch(&key, SortedVSeqList, VSeqCount, sizeof(VSeqPair), tripleVowelCompare);
     if (pInfo == 0)
         return vs_nil;
     return pInfo->vs;
@@ -482,7 +186,7 @@ ConSeq lookupCSeq(VnLexiName c1, VnLexiName c2, VnLexiName c3)
     key.c[1] = c2;
     key.c[2] = c3;
 
-    CSeqPair *pInfo = (CSeqPair *)bsearch(&key, SortedCSeqList, CSeqCount, sizeof(CSeqPair), tripleConCompare);
+    const CSeqPair *pInfo = (const CSeqPair *)bsearch(&key, SortedCSeqList, CSeqCount, sizeof(CSeqPair), tripleConCompare);
     if (pInfo == 0)
         return cs_nil;
     return pInfo->cs;
@@ -532,7 +236,7 @@ int UkEngine::processRoof(UkKeyEvent & ev)
         newVs = VSeqList[vs].withRoof;
     }
 
-    VowelSeqInfo *pInfo;
+    const VowelSeqInfo *pInfo;
 
     if (newVs == vs_nil) {
         if (VSeqList[vs].roofPos == -1)
@@ -644,7 +348,7 @@ int UkEngine::processHookWithUO(UkKeyEvent & ev)
     
     (void)toneRemoved; // fix warning
     
-    VnLexiName *v;
+    const VnLexiName *v;
 
     if (!m_pCtrl->options.freeMarking && m_buffer[m_current].vOffset != 0)
         return processAppend(ev);    
@@ -754,7 +458,7 @@ int UkEngine::processHookWithUO(UkKeyEvent & ev)
         break;
     }
 
-    VowelSeqInfo *p = &VSeqList[newVs];
+    const VowelSeqInfo *p = &VSeqList[newVs];
     for (i=0; i < p->len; i++) { //update sub-sequences
         m_buffer[vStart+i].vseq = p->sub[i];
     }
@@ -797,8 +501,8 @@ int UkEngine::processHook(UkKeyEvent & ev)
     int curTonePos, newTonePos, tone;
     int changePos;
     bool hookRemoved = false;
-    VowelSeqInfo *pInfo;
-    VnLexiName *v;
+    const VowelSeqInfo *pInfo;
+    const VnLexiName *v;
 
     vEnd = m_current - m_buffer[m_current].vOffset;
     vs = m_buffer[vEnd].vseq;
@@ -934,9 +638,12 @@ int UkEngine::processHook(UkKeyEvent & ev)
 }
 
 //----------------------------------------------------------
-int UkEngine::getTonePosition(VowelSeq vs, bool terminated)
+// Position in vs of the vowel that takes the tone, terminated if no
+// consonant follows vs
+//----------------------------------------------------------
+int getVowelTonePosition(VowelSeq vs, bool terminated, bool modernStyle)
 {
-    VowelSeqInfo & info = VSeqList[vs];
+    const VowelSeqInfo & info = VSeqList[vs];
     if (info.len == 1)
         return 0;
 
@@ -951,13 +658,19 @@ int UkEngine::getTonePosition(VowelSeq vs, bool terminated)
     if (info.len == 3)
         return 1;
 
-    if (m_pCtrl->options.modernStyle &&
+    if (modernStyle &&
         (vs == vs_oa || vs == vs_oe ||vs == vs_uy))
         return 1;
 
     return terminated ? 0 : 1;
 }
 
+//----------------------------------------------------------
+int UkEngine::getTonePosition(VowelSeq vs, bool terminated)
+{
+    return getVowelTonePosition(vs, terminated, m_pCtrl->options.modernStyle);
+}
+
 //----------------------------------------------------------
 int UkEngine::processTone(UkKeyEvent & ev)
 {
@@ -989,7 +702,7 @@ int UkEngine::processTone(UkKeyEvent & ev)
 
     vEnd = m_current - m_buffer[m_current].vOffset;
     vs = m_buffer[vEnd].vseq;
-    VowelSeqInfo & info = VSeqList[vs];
+    const VowelSeqInfo & info = VSeqList[vs];
     if (m_pCtrl->options.spellCheckEnabled && !m_pCtrl->options.freeMarking && !info.complete)
         return processAppend(ev);
 
@@ -1183,13 +896,12 @@ int UkEngine::processTelexW(UkKeyEvent & ev)
         return processAppend(ev);
 
     int ret;
-    static bool usedAsMapChar = false;
     int capsLockOn = 0;
     int shiftPressed = 0;
     if (m_keyCheckFunc)
         m_keyCheckFunc(&shiftPressed, &capsLockOn);
 
-    if (usedAsMapChar) {
+    if (m_telexWAsMapChar) {
         ev.evType = vneMapChar;
         ev.vnSym = isupper(ev.keyCode)? vnl_Uh : vnl_uh;
         if (capsLockOn)
@@ -1199,7 +911,7 @@ int UkEngine::processTelexW(UkKeyEvent & ev)
         if (ret == 0) {
             if (m_current >= 0)
                 m_current--;
-            usedAsMapChar = false;
+            m_telexWAsMapChar = false;
             ev.evType = vneHookAll;
             return processHook(ev);
         }
@@ -1207,7 +919,7 @@ int UkEngine::processTelexW(UkKeyEvent & ev)
     }
 
     ev.evType = vneHookAll;
-    usedAsMapChar = false;
+    m_telexWAsMapChar = false;
     ret = processHook(ev);
     if (ret == 0) {
         if (m_current >= 0)
@@ -1217,7 +929,7 @@ int UkEngine::processTelexW(UkKeyEvent & ev)
         if (capsLockOn)
             ev.vnSym = changeCase(ev.vnSym);
         ev.chType = ukcVn;
-        usedAsMapChar = true;
+        m_telexWAsMapChar = true;
         return processMapChar(ev);
     }
     return ret;
@@ -1634,7 +1346,7 @@ int UkEngine::appendConsonnant(UkKeyEvent & ev)
     case vnw_vc:
     case vnw_cvc:
         cs = prev.cseq;
-        if (CSeqList[cs].len == 3)
+        if (cs == cs_nil || CSeqList[cs].len == 3) //cs_nil after 'z'
             newCs = cs_nil;
         else if (CSeqList[cs].len == 2)
             newCs = lookupCSeq(CSeqList[cs].c[0], CSeqList[cs].c[1], lowerSym);
@@ -1705,9 +1417,12 @@ int UkEngine::processEscChar(UkKeyEvent & ev)
 //----------------------------------------------------------
 void UkEngine::pass(int keyCode)
 {
+    leaveAutomaton();
     UkKeyEvent ev;
     m_pCtrl->input.keyCodeToEvent(keyCode, ev);
+    m_changePos = m_current+1;
     processAppend(ev);
+    updateWordInfo(m_changePos);
 }
 
 //---------------------------------------------
@@ -1739,7 +1454,22 @@ int UkEngine::processNoSpellCheck(UkKeyEvent & ev)
     return 1;
 }
 //----------------------------------------------------------
+// Keys of known syllables come from the table of m_pAuto while the engine
+// is in it, the engine runs the others
+//----------------------------------------------------------
 int UkEngine::process(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
+{
+    if (m_autoState >= 0) {
+        int ret = processAutomaton(keyCode, backs, outBuf, outSize, outType);
+        if (ret >= 0)
+            return ret;
+        leaveAutomaton();
+    }
+    return processKey(keyCode, backs, outBuf, outSize, outType);
+}
+
+//----------------------------------------------------------
+int UkEngine::processKey(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
 {
     UkKeyEvent ev;
     prepareBuffer();
@@ -1791,12 +1521,21 @@ int UkEngine::process(unsigned int keyCode, int & backs, unsigned char *outBuf,
         */
     }
 
+    updateWordInfo(m_changePos);
+
     //we add key to key buffer only if that key has not caused a reset
     if (m_current >= 0) {
         ev.chType = m_pCtrl->input.getCharType(ev.keyCode);
         m_keyCurrent++;
         m_keyStrokes[m_keyCurrent].ev = ev;
         m_keyStrokes[m_keyCurrent].converted = (ret && !m_keyRestored);
+        m_keyStrokes[m_keyCurrent].bufPos = m_current;
+        updateKeyWordInfo(m_keyCurrent);
+
+        uint64_t hash = UKBLOOM_HASH_START;
+        if (m_keyCurrent > 0 && m_keyStrokes[m_keyCurrent-1].ev.chType != ukcWordBreak)
+            hash = m_keyStrokes[m_keyCurrent-1].wordHash;
+        m_keyStrokes[m_keyCurrent].wordHash = UkBloomHashAdd(hash, ev.keyCode);
     }
 
     if (ret == 0) {
@@ -1815,6 +1554,131 @@ int UkEngine::process(unsigned int keyCode, int & backs, unsigned char *outBuf,
     return ret;
 }
 
+//----------------------------------------------------------
+// Takes the key from the table: the next state and the output the engine
+// gives for it there. Returns -1 if the table does not have it, what
+// process() returns otherwise.
+//----------------------------------------------------------
+int UkEngine::processAutomaton(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
+{
+    if (keyCode == 0 || keyCode >= UKAUTO_TELEX_W_LABEL || m_autoLogLen == UKAUTO_MAX_LOG)
+        return -1;
+
+    //the table has the keys typed with caps lock off
+    int capsLockOn = 0;
+    int shiftPressed = 0;
+    if (m_keyCheckFunc)
+        m_keyCheckFunc(&shiftPressed, &capsLockOn);
+    if (capsLockOn)
+        return -1;
+
+    uint32_t target, opOffset;
+    if (m_pAuto->isBreakKey(keyCode)) {
+        const UkAutomatonState & state = m_pAuto->state(m_autoState);
+        if (!state.wordEnd)
+            return -1;
+        const UkAutomatonWordEnd & end = m_pAuto->wordEnd(state);
+        opOffset = end.op[wordEndRestore(end)];
+        target = m_pAuto->wordBreak();
+    }
+    else {
+        int edge = -1;
+        if (m_telexWAsMapChar)
+            edge = m_pAuto->findEdge(m_autoState, keyCode | UKAUTO_TELEX_W_LABEL);
+        if (edge < 0)
+            edge = m_pAuto->findEdge(m_autoState, keyCode);
+        if (edge < 0)
+            return -1;
+        opOffset = m_pAuto->edgeOp(edge);
+        target = m_pAuto->edgeTarget(edge);
+    }
+
+    const unsigned char *op = m_pAuto->op(opOffset);
+    int flags = op[0];
+    int len = op[2];
+    if (len + 1 > outSize)
+        return -1;
+
+    memcpy(outBuf, op + 3, len);
+    if (flags & UKAUTO_OP_APPEND_KEY)
+        outBuf[len++] = keyCode;
+    if (flags & UKAUTO_OP_SET_TELEX_W)
+        m_telexWAsMapChar = (flags & UKAUTO_OP_TELEX_W) != 0;
+
+    m_autoLog[m_autoLogLen++] = keyCode;
+    m_autoState = target;
+
+    backs = op[1];
+    outSize = len;
+    outType = (flags & UKAUTO_OP_KEY_OUTPUT)? UkKeyOutput : UkCharOutput;
+    return (flags & UKAUTO_OP_RETURN)? 1 : 0;
+}
+
+//----------------------------------------------------------
+// Which output of a word break in the table processWordEnd() would give
+//----------------------------------------------------------
+int UkEngine::wordEndRestore(const UkAutomatonWordEnd & end)
+{
+    //learned words are given back whatever the spell check says
+    if (m_pLearned && m_pLearned->count() > 0 && m_pLearned->contains(end.keyHash))
+        return ukr_word;
+
+    //non-Vietnamese words have no dictKey, and the words without marks,
+    //which have none either, give the same output for ukr_word as for
+    //ukr_none: so a word without dictKey counts as rejected here
+    bool autoRestore = m_pCtrl->options.autoNonVnRestore;
+    bool unknown = end.dictKey && m_pDict && m_pDict->isLoaded() &&
+        !m_pDict->contains(m_pAuto->key(end.dictKey), end.dictKey & 0xFF);
+    bool rejected = !end.dictKey || unknown;
+
+    if (rejected && autoRestore && m_pForeign && m_pForeign->isLoaded() &&
+        m_pForeign->mayContain(end.keyHash))
+        return ukr_word;
+
+    if (autoRestore && unknown)
+        return ukr_keys;
+
+    return ukr_none;
+}
+
+//----------------------------------------------------------
+// Runs the keys taken from the table since reset() through the engine.
+// They were all typed with caps lock off.
+//----------------------------------------------------------
+void UkEngine::leaveAutomaton()
+{
+    if (m_autoState < 0)
+        return;
+
+    unsigned char log[UKAUTO_MAX_LOG];
+    int logLen = m_autoLogLen;
+    memcpy(log, m_autoLog, logLen);
+
+    //no table for the reset() of a key on the way
+    const UkAutomaton *pAuto = m_pAuto;
+    CheckKeyboardCaseCb keyCheckFunc = m_keyCheckFunc;
+    m_pAuto = 0;
+    m_keyCheckFunc = 0;
+
+    reset();
+    m_telexWAsMapChar = m_autoTelexW;
+
+    unsigned char outBuf[1024];
+    for (int i = 0; i < logLen; i++) {
+        if (log[i] == 0) {
+            settleBuffers();
+        }
+        else {
+            int backs, outSize = sizeof(outBuf);
+            UkOutputType outType;
+            processKey(log[i], backs, outBuf, outSize, outType);
+        }
+    }
+
+    m_pAuto = pAuto;
+    m_keyCheckFunc = keyCheckFunc;
+}
+
 
 //----------------------------------------------------------
 // Returns 0 on success
@@ -1918,16 +1782,59 @@ void UkEngine::synchKeyStrokeBuffer()
     if (m_current >= 0 && m_buffer[m_current].form == vnw_empty) {
         //in character buffer, we have reached a word break,
         //so we also need to move key stroke pointer backward to corresponding word break
-        while (m_keyCurrent >= 0 && m_keyStrokes[m_keyCurrent].ev.chType != ukcWordBreak)
-        {
-            m_keyCurrent--;
+        if (m_keyCurrent >= 0)
+            m_keyCurrent = getKeyWordStart(m_keyCurrent) - 1;
+    }
+}
+
+//----------------------------------------------------------------
+// Brings wordOffset and wordMarked of m_buffer up to date from
+// position from on. A key changes m_buffer from m_changePos on only.
+//----------------------------------------------------------------
+void UkEngine::updateWordInfo(int from)
+{
+    for (int i = (from > 0)? from : 0; i <= m_current; i++) {
+        WordInfo & entry = m_buffer[i];
+        if (entry.form == vnw_empty) {
+            entry.wordOffset = 0;
+            entry.wordMarked = false;
+        }
+        else if (i > 0 && m_buffer[i-1].form != vnw_empty) {
+            entry.wordOffset = m_buffer[i-1].wordOffset + 1;
+            entry.wordMarked = m_buffer[i-1].wordMarked || hasVnMark(i);
+        }
+        else {
+            entry.wordOffset = 0;
+            entry.wordMarked = hasVnMark(i);
         }
     }
 }
 
+//----------------------------------------------------------------
+// Same as updateWordInfo() for wordOffset and convertedPos of
+// m_keyStrokes
+//----------------------------------------------------------------
+void UkEngine::updateKeyWordInfo(int from)
+{
+    for (int i = (from > 0)? from : 0; i <= m_keyCurrent; i++) {
+        KeyBufEntry & key = m_keyStrokes[i];
+        key.wordOffset = 0;
+        key.convertedPos = SCHAR_MAX;
+        if (key.ev.chType == ukcWordBreak)
+            continue;
+        if (i > 0 && m_keyStrokes[i-1].ev.chType != ukcWordBreak) {
+            key.wordOffset = m_keyStrokes[i-1].wordOffset + 1;
+            key.convertedPos = m_keyStrokes[i-1].convertedPos;
+        }
+        if (key.converted && key.bufPos < key.convertedPos)
+            key.convertedPos = key.bufPos;
+    }
+}
+
 //---------------------------------------------
 int UkEngine::processBackspace(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
 {
+    leaveAutomaton();
     outType = UkCharOutput;
     if (!m_pCtrl->vietKey || m_current < 0) {
         backs = 0;
@@ -1939,13 +1846,13 @@ int UkEngine::processBackspace(int & backs, unsigned char *outBuf, int & outSize
     m_changePos = m_current + 1;
     markChange(m_current);
 
+    //the tone may move only if the previous symbol ends a vowel sequence
     if (m_current == 0 || 
         m_buffer[m_current].form == vnw_empty ||
         m_buffer[m_current].form == vnw_nonVn ||
         m_buffer[m_current].form == vnw_c ||
-        m_buffer[m_current-1].form == vnw_c ||
-        m_buffer[m_current-1].form == vnw_cvc ||
-        m_buffer[m_current-1].form == vnw_vc) {
+        (m_buffer[m_current-1].form != vnw_v &&
+         m_buffer[m_current-1].form != vnw_cv)) {
 
         m_current--;
         backs = m_backs;
@@ -1979,6 +1886,7 @@ int UkEngine::processBackspace(int & backs, unsigned char *outBuf, int & outSize
     markChange(curTonePos);
     m_buffer[curTonePos].tone = 0;
     m_current--;
+    updateWordInfo(m_changePos);
     synchKeyStrokeBuffer();
     backs = m_backs;
     writeOutput(outBuf, outSize);
@@ -1992,6 +1900,13 @@ void UkEngine::reset()
     m_keyCurrent = -1;
     m_singleMode = false;
     m_toEscape = false;
+
+    m_autoLogLen = 0;
+    m_autoState = -1;
+    if (m_pAuto && m_pCtrl && m_pAuto->matches(m_pCtrl)) {
+        m_autoState = m_pAuto->root();
+        m_autoTelexW = m_telexWAsMapChar;
+    }
 }
 
 //------------------------------------------------
@@ -2003,10 +1918,6 @@ void UkEngine::resetKeyBuf()
 //------------------------------------------------
 UkEngine::UkEngine()
 {
-    if (!m_classInit) {
-        engineClassInit();
-        m_classInit = true;
-    }
     m_pCtrl = 0;
     m_bufSize = MAX_UK_ENGINE;
     m_keyBufSize = MAX_UK_ENGINE;
@@ -2014,9 +1925,20 @@ UkEngine::UkEngine()
     m_keyCurrent = -1;
     m_singleMode = false;
     m_keyCheckFunc = 0;
+    m_pDict = 0;
+    m_pForeign = 0;
+    m_pLearned = 0;
     m_reverted = false;
     m_toEscape = false;
     m_keyRestored = false;
+    m_telexWAsMapChar = false;
+    m_pAuto = 0;
+    m_autoState = -1;
+    m_autoTelexW = false;
+    m_autoLogLen = 0;
+    //fields an entry does not use are never written, so UkAutomatonBuilder
+    //would tell states apart by what was left in them
+    memset(m_buffer, 0, sizeof(m_buffer));
 }
 
 //----------------------------------------------------
@@ -2038,6 +1960,9 @@ void UkEngine::prepareBuffer()
             memmove(m_buffer, m_buffer+rid, (m_current-rid+1)*sizeof(WordInfo));
             m_current -= rid;
         }
+        for (int i = 0; i <= m_keyCurrent; i++)
+            m_keyStrokes[i].bufPos = (m_current < 0)? -1 : m_keyStrokes[i].bufPos - rid;
+        updateKeyWordInfo(0);
     }
 
     //prepare key stroke buffer
@@ -2046,6 +1971,7 @@ void UkEngine::prepareBuffer()
         rid = m_keyCurrent/2;
         memmove(m_keyStrokes, m_keyStrokes + rid, (m_keyCurrent-rid+1)*sizeof(m_keyStrokes[0]));
         m_keyCurrent -= rid;
+        updateKeyWordInfo(0);
     }
 
 }
@@ -2190,35 +2116,36 @@ int UkEngine::macroMatch(UkKeyEvent & ev)
 //----------------------------------------------------
 int UkEngine::restoreKeyStrokes(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
 {
+    leaveAutomaton();
     outType = UkKeyOutput;
     if (!lastWordHasVnMark()) {
         backs = 0;
         outSize = 0;
         return 0;
     }
+    return restoreWordKeys(backs, outBuf, outSize, outType);
+}
 
+//----------------------------------------------------------------
+// Puts back the key strokes of the last word if any of them has been
+// converted, even if the conversion was undone by a repeated key.
+//----------------------------------------------------------------
+int UkEngine::restoreWordKeys(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType)
+{
+    outType = UkKeyOutput;
     m_backs = 0;
     m_changePos = m_current+1;
 
-    int keyStart;
-    bool converted = false;
-    for (keyStart = m_keyCurrent; keyStart >= 0 && m_keyStrokes[keyStart].ev.chType != ukcWordBreak; keyStart--) {
-        if (m_keyStrokes[keyStart].converted) {
-            converted = true;
-        }
-    }
-    keyStart++;
-
-    if (!converted) {
+    if (m_keyCurrent < 0 || m_keyStrokes[m_keyCurrent].convertedPos == SCHAR_MAX) {
         //no key stroke has been converted, so it doesn't make sense to restore key strokes
         backs = 0;
         outSize = 0;
         return 0;
     }
 
-    //int i = m_current;
-    while (m_current >=0 && m_buffer[m_current].form != vnw_empty)
-        m_current--;
+    int keyStart = getKeyWordStart(m_keyCurrent);
+    if (m_current >= 0)
+        m_current = getWordStart(m_current) - 1;
     markChange(m_current+1);
     backs = m_backs;
 
@@ -2233,9 +2160,12 @@ int UkEngine::restoreKeyStrokes(int & backs, unsigned char *outBuf, int & outSiz
         m_pCtrl->input.keyCodeToSymbol(m_keyStrokes[i].ev.keyCode, ev);
         m_keyStrokes[i].converted = false;
         processAppend(ev);
+        m_keyStrokes[i].bufPos = m_current;
     }
     outSize = count;
     m_keyRestoring = false;
+    updateWordInfo(m_changePos);
+    updateKeyWordInfo(keyStart);
 
     return 1;
 }
@@ -2243,35 +2173,15 @@ int UkEngine::restoreKeyStrokes(int & backs, unsigned char *outBuf, int & outSiz
 //--------------------------------------------------
 void UkEngine::setSingleMode()
 {
+    leaveAutomaton();
     m_singleMode = true;
 }
 
-//--------------------------------------------------
-void SetupUnikeyEngine()
-{
-    SetupInputClassifierTable();
-    int i;
-    VnLexiName lexi;
-
-    //Calculate IsoStdVnCharMap
-    for (i=0; i < 256; i++) {
-        IsoStdVnCharMap[i] = i;
-    }
-
-    for (i=0; SpecialWesternChars[i]; i++) {
-        IsoStdVnCharMap[SpecialWesternChars[i]] = (vnl_lastChar + i) + VnStdCharOffset;
-    }
-
-    for (i=0; i < 256; i++) {
-        if ((lexi = IsoToVnLexi(i)) != vnl_nonVnChar) {
-            IsoStdVnCharMap[i] = lexi + VnStdCharOffset;
-        }
-    }
-}
-
 //--------------------------------------------------
 bool UkEngine::atWordBeginning()
 {
+    if (m_autoState >= 0)
+        return (m_pAuto->state(m_autoState).flags & UKAUTO_WORD_BEGINNING) != 0;
     return (m_current < 0 || m_buffer[m_current].form == vnw_empty);
 }
 
@@ -2296,10 +2206,30 @@ int UkEngine::processWordEnd(UkKeyEvent & ev)
         return 0;
     }
 
+    //the user asked for learned words as typed, even Vietnamese ones like
+    //"car"; the foreign filter only decides how a word the spell check
+    //rejects is restored: "as" stays "á" even when the filter has it
+    //the output type only changes when something is restored: the table
+    //cannot tell a rejected word without marks from an accepted one (see
+    //wordEndRestore), and restores nothing for either
     int outSize = 0;
-    if (m_pCtrl->options.autoNonVnRestore && lastWordIsNonVn()) {
+    UkOutputType outType;
+    bool rejected = lastWordIsNonVn() || lastWordIsUnknown();
+    if (lastWordIsLearned() ||
+        (rejected && m_pCtrl->options.autoNonVnRestore && lastWordIsForeign())) {
+        //foreign and learned words also get back keys that only undid a
+        //conversion, like the second s of "class"
+        outSize = *m_pOutSize;
+        if (restoreWordKeys(m_backs, m_pOutBuf, outSize, outType)) {
+            m_outType = outType;
+            m_keyRestored = true;
+            m_outputWritten = true;
+        }
+    }
+    else if (rejected && m_pCtrl->options.autoNonVnRestore) {
         outSize = *m_pOutSize;
-        if (restoreKeyStrokes(m_backs, m_pOutBuf, outSize, m_outType)) {
+        if (restoreKeyStrokes(m_backs, m_pOutBuf, outSize, outType)) {
+            m_outType = outType;
             m_keyRestored = true;
             m_outputWritten = true;
         }
@@ -2368,21 +2298,257 @@ bool UkEngine::lastWordIsNonVn()
     return false;
 }
 
+//---------------------------------------------------------------------------
+// Test if a dictionary is loaded and the last word, a valid syllable
+// otherwise, is not in it. Only words with Vietnamese marks are looked up:
+// the others would not change on restore anyway.
+//---------------------------------------------------------------------------
+bool UkEngine::lastWordIsUnknown()
+{
+    if (!m_pDict || !m_pDict->isLoaded())
+        return false;
+
+    unsigned char key[UKDICT_MAX_KEY];
+    int len = lastWordDictKey(key);
+    return len > 0 && !m_pDict->contains(key, len);
+}
+
+//---------------------------------------------------------------------------
+// Writes the dictionary key of the last word if it is one lastWordIsUnknown()
+// looks up. Returns its length, 0 if there is nothing to look up.
+//---------------------------------------------------------------------------
+int UkEngine::lastWordDictKey(unsigned char *key)
+{
+    if (m_current < 0)
+        return 0;
+
+    if (!lastWordHasVnMark())
+        return 0;
+
+    int start = getWordStart(m_current);
+    int len = m_current - start + 1;
+    if (len > UKDICT_MAX_KEY)
+        return 0;
+
+    for (int i = 0; i < len; i++) {
+        WordInfo & entry = m_buffer[start+i];
+        if (entry.vnSym == vnl_nonVnChar)
+            return 0;
+        key[i] = entry.vnSym + entry.tone * 2;
+    }
+    return len;
+}
+
+//---------------------------------------------------------------------------
+// Test if the key strokes of the last word are in the foreign word filter.
+// The hash of the word is kept with its last key stroke, so this costs the
+// probes of the filter only.
+//---------------------------------------------------------------------------
+bool UkEngine::lastWordIsForeign()
+{
+    if (!m_pForeign || !m_pForeign->isLoaded() || m_keyCurrent < 0)
+        return false;
+
+    KeyBufEntry & last = m_keyStrokes[m_keyCurrent];
+    if (last.ev.chType == ukcWordBreak)
+        return false;
+    return m_pForeign->mayContain(last.wordHash);
+}
+
+//---------------------------------------------------------------------------
+// Test if the user has restored the key strokes of the last word before,
+// so it is to be left as typed
+//---------------------------------------------------------------------------
+bool UkEngine::lastWordIsLearned()
+{
+    if (!m_pLearned || m_pLearned->count() == 0)
+        return false;
+
+    uint64_t hash = lastWordKeyHash();
+    return hash != 0 && m_pLearned->contains(hash);
+}
+
+//---------------------------------------------------------------------------
+// Hash of the key strokes of the last word, 0 if there is none
+//---------------------------------------------------------------------------
+uint64_t UkEngine::lastWordKeyHash()
+{
+    leaveAutomaton();
+    if (m_keyCurrent < 0 || m_keyStrokes[m_keyCurrent].ev.chType == ukcWordBreak)
+        return 0;
+    return m_keyStrokes[m_keyCurrent].wordHash;
+}
+
+//---------------------------------------------------------------------------
+// Whole words may be given back at word end even without a Vietnamese mark
+//---------------------------------------------------------------------------
+bool UkEngine::keepsConvertedPrefix()
+{
+    return (m_pForeign && m_pForeign->isLoaded()) ||
+           (m_pLearned && m_pLearned->count() > 0);
+}
+
 //---------------------------------------------------------------------------
 // Test if last word has a Vietnamese mark, that is tones, decorators
 //---------------------------------------------------------------------------
 bool UkEngine::lastWordHasVnMark()
 {
-    for (int i=m_current; i>=0 && m_buffer[i].form != vnw_empty; i--) {
-        VnLexiName sym = m_buffer[i].vnSym;
-        if (sym != vnl_nonVnChar) {
-            if (IsVnVowel[sym]) {
-                if (m_buffer[i].tone)
-                    return true;
+    return m_current >= 0 && m_buffer[m_current].wordMarked;
+}
+
+//---------------------------------------------------------------------------
+// Test if the symbol at pos carries a tone or a decorator
+//---------------------------------------------------------------------------
+bool UkEngine::hasVnMark(int pos)
+{
+    VnLexiName sym = m_buffer[pos].vnSym;
+    if (sym == vnl_nonVnChar)
+        return false;
+    if (IsVnVowel[sym] && m_buffer[pos].tone)
+        return true;
+    return (sym != StdVnRootChar[sym]);
+}
+
+//---------------------------------------------------------------------------
+// Returns the first position in m_buffer that a coming key may still change
+// (backspace aside). That is the start of the syllable being typed. A non-Vn
+// word keeps its last two symbols, since 'dd' looks at the previous one, and
+// the syllable of the previous one, which a backspace brings back.
+//---------------------------------------------------------------------------
+int UkEngine::getActiveStart()
+{
+    if (m_buffer[m_current].form != vnw_nonVn)
+        return getSyllableStart(m_current);
+    return (m_current > 0)? getSyllableStart(m_current - 1) : 0;
+}
+
+//---------------------------------------------------------------------------
+// Returns the start of the syllable ending at pos
+//---------------------------------------------------------------------------
+int UkEngine::getSyllableStart(int pos)
+{
+    WordInfo & entry = m_buffer[pos];
+    int start;
+
+    switch (entry.form) {
+    case vnw_empty:
+        return pos + 1;
+    case vnw_nonVn:
+        return pos;
+    case vnw_c:
+    case vnw_cv:
+    case vnw_cvc:
+        start = pos - entry.c1Offset;
+        if (m_buffer[start].cseq != cs_nil)
+            start -= CSeqList[m_buffer[start].cseq].len - 1;
+        break;
+    default:
+        start = pos - entry.vOffset;
+        if (m_buffer[start].vseq != vs_nil)
+            start -= VSeqList[m_buffer[start].vseq].len - 1;
+        break;
+    }
+    return (start < 0)? 0 : start;
+}
+
+//---------------------------------------------------------------------------
+// Returns the start of the word ending at pos, pos+1 if that is a word break
+//---------------------------------------------------------------------------
+int UkEngine::getWordStart(int pos)
+{
+    if (m_buffer[pos].form == vnw_empty)
+        return pos + 1;
+    return pos - m_buffer[pos].wordOffset;
+}
+
+//---------------------------------------------------------------------------
+// Same as getWordStart() in m_keyStrokes
+//---------------------------------------------------------------------------
+int UkEngine::getKeyWordStart(int pos)
+{
+    if (pos < 0 || m_keyStrokes[pos].ev.chType == ukcWordBreak)
+        return pos + 1;
+    return pos - m_keyStrokes[pos].wordOffset;
+}
+
+//---------------------------------------------------------------------------
+// Drops everything before the word being typed, so that the caller can
+// commit it. Returns the number of backspaces covering what is left, or -1
+// if nothing can be dropped because a macro may still reach back.
+// A word past SETTLE_WORD_LIMIT symbols is cut before the syllable being
+// typed, unless it carries Vietnamese marks, since restoring key strokes
+// rewrites the whole word.
+//---------------------------------------------------------------------------
+int UkEngine::settlePrefix()
+{
+    if (m_autoState >= 0) {
+        const UkAutomatonState & state = m_pAuto->state(m_autoState);
+        if ((state.flags & UKAUTO_SETTLE) &&
+            ((state.flags & UKAUTO_SETTLE_KEEPING) || !keepsConvertedPrefix())) {
+            if (state.settleTarget == (uint32_t)m_autoState)
+                return state.settleSteps;
+            if (m_autoLogLen < UKAUTO_MAX_LOG) {
+                m_autoLog[m_autoLogLen++] = 0;
+                m_autoState = state.settleTarget;
+                return state.settleSteps;
             }
-            if (sym != StdVnRootChar[sym] )
-                return true;
         }
+        leaveAutomaton();
     }
-    return false;
+    return settleBuffers();
+}
+
+//---------------------------------------------------------------------------
+// Returns the first position in m_buffer that settleBuffers() keeps: the
+// whole word being typed, since backspaces may go back into any part of it
+// and keys after them change it again. Only a word longer than
+// SETTLE_WORD_LIMIT is cut, before the syllable being typed.
+//---------------------------------------------------------------------------
+int UkEngine::getSettleStart()
+{
+    int start = getWordStart(m_current);
+    if (m_current - start < SETTLE_WORD_LIMIT)
+        return start;
+
+    start = getActiveStart();
+    if (start > 0 && m_buffer[start-1].wordMarked)
+        start = getWordStart(start-1);
+
+    //with foreign or learned words, a prefix where a key was converted is
+    //kept too: the whole word may still be given back at word end
+    if (start > 0 && keepsConvertedPrefix() &&
+        m_keyCurrent >= 0 && m_keyStrokes[m_keyCurrent].convertedPos < start)
+        start = getWordStart(start-1);
+    return start;
+}
+
+//---------------------------------------------------------------------------
+// settlePrefix() on the buffers of the engine, out of the table
+//---------------------------------------------------------------------------
+int UkEngine::settleBuffers()
+{
+    if (m_pCtrl->options.macroEnabled)
+        return -1;
+    if (m_current < 0)
+        return 0;
+
+    int start = getSettleStart();
+    if (start > 0) {
+        int keyStart;
+        for (keyStart = m_keyCurrent; keyStart >= 0 && m_keyStrokes[keyStart].bufPos >= start; keyStart--);
+        keyStart++;
+
+        memmove(m_buffer, m_buffer+start, (m_current-start+1)*sizeof(WordInfo));
+        m_current -= start;
+        memmove(m_keyStrokes, m_keyStrokes+keyStart, (m_keyCurrent-keyStart+1)*sizeof(m_keyStrokes[0]));
+        m_keyCurrent -= keyStart;
+        for (int i = 0; i <= m_keyCurrent; i++)
+            m_keyStrokes[i].bufPos -= start;
+
+        //the word may have lost its start, but not a Vietnamese mark
+        for (int i = 0; i <= m_current && m_buffer[i].wordOffset > i; i++)
+            m_buffer[i].wordOffset = i;
+        updateKeyWordInfo(0);
+    }
+    return getSeqSteps(0, m_current);
 }
@@ -28,8 +28,13 @@
 #include "vnlexi.h"
 #include "inputproc.h"
 #include "mactab.h"
+#include "ukdict.h"
+#include "ukbloom.h"
+#include "ukwordset.h"
+#include "ukautomaton.h"
 
-//This is a shared object among processes, do not put any pointer in it
+//Settings of the engine, one per process. Only the system macro table
+//it refers to is shared among processes (see CMacroTable)
 struct UkSharedMem {
     //states
     int initialized;
@@ -45,14 +50,23 @@ struct UkSharedMem {
 };
 
 #define MAX_UK_ENGINE 128
+//settlePrefix() keeps the word being typed whole up to this many symbols,
+//which no syllable comes near
+#define SETTLE_WORD_LIMIT 32
 
-enum VnWordForm {vnw_nonVn, vnw_empty, vnw_c, vnw_v, vnw_cv, vnw_vc, vnw_cvc};
+enum VnWordForm : signed char {vnw_nonVn, vnw_empty, vnw_c, vnw_v, vnw_cv, vnw_vc, vnw_cvc};
 
 typedef void (* CheckKeyboardCaseCb)(int *pShiftPressed, int *pCapslockOn);
 
 struct KeyBufEntry {
     UkKeyEvent ev;
     bool converted;
+    unsigned char wordOffset; //keys of the word before this one
+    signed char bufPos; //position of the last symbol in m_buffer after this key
+    //least bufPos of the converted keys of the word up to this one,
+    //SCHAR_MAX if there is none
+    signed char convertedPos;
+    uint64_t wordHash; //UkBloomHashAdd() over the keys of the word up to this one
 };
 
 class UkEngine
@@ -69,6 +83,38 @@ public:
         m_keyCheckFunc = pFunc;
     }
 
+    void setDictionary(UkDictionary *pDict)
+    {
+        m_pDict = pDict;
+    }
+
+    void setForeignFilter(UkBloomFilter *pFilter)
+    {
+        m_pForeign = pFilter;
+    }
+
+    void setLearnedWords(UkWordSet *pWords)
+    {
+        m_pLearned = pWords;
+    }
+
+    //the table is used from the next reset() on, if it was built for the
+    //input method, charset and options in use
+    void setAutomaton(const UkAutomaton *pAuto)
+    {
+        leaveAutomaton();
+        m_pAuto = pAuto;
+    }
+
+    //brings the state of the engine up to the keys taken from the table
+    //and goes on without it until the next reset(). Call this before
+    //changing the options or the word lists, the keys are run again with
+    //them otherwise.
+    void leaveAutomaton();
+    bool inAutomaton() const { return m_autoState >= 0; }
+
+    uint64_t lastWordKeyHash();
+
     bool atWordBeginning();
 
     int process(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
@@ -78,6 +124,7 @@ public:
     int processBackspace(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
     void reset();
     int restoreKeyStrokes(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
+    int settlePrefix();
 
     //following methods must be public just to enable the use of pointers to them
     //they should not be called from outside.
@@ -93,8 +140,12 @@ public:
     int processEscChar(UkKeyEvent & ev);
 
 protected:
-    static bool m_classInit;
+    friend class UkAutomatonBuilder;
+
     CheckKeyboardCaseCb m_keyCheckFunc;
+    UkDictionary *m_pDict;
+    UkBloomFilter *m_pForeign;
+    UkWordSet *m_pLearned;
     UkSharedMem *m_pCtrl;
 
     int m_changePos;
@@ -108,6 +159,14 @@ protected:
     KeyBufEntry m_keyStrokes[MAX_UK_ENGINE];
     int m_keyCurrent;
     bool m_toEscape;
+    bool m_telexWAsMapChar; //last 'w' was typed as "ư", kept over reset()
+
+    const UkAutomaton *m_pAuto;
+    int m_autoState; //state in m_pAuto, -1 when not in the table
+    bool m_autoTelexW; //m_telexWAsMapChar when the table was entered
+    //keys taken from the table since reset(), 0 for settlePrefix()
+    unsigned char m_autoLog[UKAUTO_MAX_LOG];
+    int m_autoLogLen;
 
     //varables valid in one session
     unsigned char *m_pOutBuf;
@@ -118,26 +177,38 @@ protected:
     bool m_keyRestoring;
     UkOutputType m_outType;
   
+    //16 bytes, so that the entries of the word being typed take a cache
+    //line or two
     struct WordInfo {
         //info for word ending at this position
         VnWordForm form;
-        int c1Offset, vOffset, c2Offset;
+        signed char c1Offset, vOffset, c2Offset;
 
         union {
             VowelSeq vseq;
             ConSeq cseq;
         };
 
+        //symbols of the word before this one, and whether one of them or
+        //this one has a Vietnamese mark. Kept by updateWordInfo()
+        unsigned char wordOffset;
+        bool wordMarked;
+
         //info for current symbol
-        int caps, tone;
+        signed char caps, tone;
         //canonical symbol, after caps, tone are removed
         //for non-Vn, vnSym == -1
         VnLexiName vnSym;
-        int keyCode;
+        unsigned int keyCode;
     };
 
     WordInfo m_buffer[MAX_UK_ENGINE];
 
+    int processKey(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
+    int processAutomaton(unsigned int keyCode, int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
+    int wordEndRestore(const UkAutomatonWordEnd & end);
+    int settleBuffers();
+    int getSettleStart();
     int processHookWithUO(UkKeyEvent & ev);
     int macroMatch(UkKeyEvent & ev);
     void markChange(int pos);
@@ -151,10 +222,21 @@ protected:
     int processNoSpellCheck(UkKeyEvent & ev);
     int processWordEnd(UkKeyEvent & ev);
     void synchKeyStrokeBuffer();
+    void updateWordInfo(int from);
+    void updateKeyWordInfo(int from);
     bool lastWordHasVnMark();
+    bool hasVnMark(int pos);
+    int getActiveStart();
+    int getSyllableStart(int pos);
+    int getWordStart(int pos);
+    int getKeyWordStart(int pos);
     bool lastWordIsNonVn();
+    bool lastWordIsUnknown();
+    int lastWordDictKey(unsigned char *key);
+    bool lastWordIsForeign();
+    bool lastWordIsLearned();
+    bool keepsConvertedPrefix();
+    int restoreWordKeys(int & backs, unsigned char *outBuf, int & outSize, UkOutputType & outType);
 };
 
-void SetupUnikeyEngine();
-
 #endif
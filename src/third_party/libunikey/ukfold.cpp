@@ -0,0 +1,465 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+
+#include "ukfold.h"
+#include "ukutf8.h"
+#include "charset.h"
+#include "uksimd.h"
+
+#define FOLD_FLAG_SETS 8
+// Bytes folded at a time by UkFoldHash()
+#define FOLD_HASH_CHUNK 2048
+
+#define HASH_P1 0x9e3779b97f4a7c15ULL
+#define HASH_P2 0xc2b2ae3d27d4eb4fULL
+
+//---------------------------------------------------------------
+// Text is folded a window of 64 bytes at a time: the letters beyond ASCII
+// in it are found from one bit mask, and the runs between them are copied
+// (and lower cased) a block at a time.
+//---------------------------------------------------------------
+#define FOLD_WINDOW 64
+
+// With byte permutes and compaction (AVX-512 VBMI and VBMI2) a whole
+// window, letters included, is folded in registers; see foldWindows().
+#if defined(UK_BLOCK) && defined(__AVX512VBMI__) && defined(__AVX512VBMI2__)
+#define FOLD_PERMUTE
+#endif
+
+#ifdef UK_BLOCK
+// Adds caseBit to the bytes 'A'..'Z'
+static inline UkBlock lowerBlock(UkBlock v, UkBlock caseBit)
+{
+    return UkAdd(v, UkAnd(UkInRange(v, 'A', 'Z'), caseBit));
+}
+
+// Bit i set if byte i is 0xC0..0xFF, the first byte of a sequence:
+// (signed) greater than 0xBF and not ASCII.
+static inline uint64_t windowLeads(const unsigned char *p)
+{
+    uint64_t leads = 0;
+    for (int i = 0; i < FOLD_WINDOW / UK_BLOCK; i++) {
+        UkBlock v = UkLoadBlock(p + i * UK_BLOCK);
+        leads |= (uint64_t)UkHighBits(UkAnd(UkGreater(v, UkSetBlock(0xBF)), v))
+            << (i * UK_BLOCK);
+    }
+    return leads;
+}
+#endif
+
+//---------------------------------------------------------------
+// Folded UTF-8 of the code points Vietnamese letters live in, per set of
+// flags: the bytes in the low 24 bits, their count in the high 8.
+// Entries 0..255 are U+00C0..U+01BF (2 byte sequences led by C3..C6),
+// 256..383 U+1E80..U+1EFF (E1 BA xx and E1 BB xx). Built once, on first
+// use.
+//---------------------------------------------------------------
+struct UkFoldTables {
+    uint32_t letters[FOLD_FLAG_SETS][384];
+#ifdef FOLD_PERMUTE
+    // The same split in planes of one byte each, the count last, for
+    // looking them up 64 at a time
+    unsigned char planes[FOLD_FLAG_SETS][4][384];
+#endif
+
+    UkFoldTables()
+    {
+        for (int flags = 0; flags < FOLD_FLAG_SETS; flags++) {
+            for (int i = 0; i < 256; i++)
+                letters[flags][i] = fold(0xC0 + i, flags);
+            for (int i = 0; i < 128; i++)
+                letters[flags][256 + i] = fold(0x1E80 + i, flags);
+#ifdef FOLD_PERMUTE
+            for (int b = 0; b < 4; b++)
+                for (int i = 0; i < 384; i++)
+                    planes[flags][b][i] = (unsigned char)(letters[flags][i] >> (8 * b));
+#endif
+        }
+    }
+
+    static uint32_t fold(uint32_t cp, int flags)
+    {
+        int lexi = UkUnicodeToLexi(cp);
+        if (lexi != vnl_nonVnChar) {
+            if (flags & UKFOLD_CASE)
+                lexi |= 1;
+            if (flags & UKFOLD_MARKS)
+                lexi = StdVnRootChar[lexi];
+            else if (flags & UKFOLD_TONES)
+                lexi = StdVnNoTone[lexi];
+            cp = UnicodeTable[lexi];
+        }
+
+        if (cp < 0x80)
+            return (1u << 24) | cp;
+        if (cp < 0x800)
+            return (2u << 24) | (0xC0 | (cp >> 6)) | ((0x80 | (cp & 0x3F)) << 8);
+        return (3u << 24) | (0xE0 | (cp >> 12)) | ((0x80 | ((cp >> 6) & 0x3F)) << 8) |
+            ((0x80 | (cp & 0x3F)) << 16);
+    }
+};
+
+static const UkFoldTables &foldTables()
+{
+    static const UkFoldTables tables;
+    return tables;
+}
+
+//---------------------------------------------------------------
+// The folded letter starting with bytes c, c1, c2 and its length in n,
+// or n = 0 if they are not a letter of the tables. The bytes of anything
+// else are copied one by one, the same as invalid ones.
+//---------------------------------------------------------------
+// Vietnamese text mixes both lengths about evenly, so this picks one
+// with masks instead of branches.
+static inline uint32_t foldLetter(unsigned c, unsigned c1, unsigned c2,
+                                  const uint32_t *letters, int &n)
+{
+    unsigned two = (c - 0xC3 < 4) & ((c1 & 0xC0) == 0x80);
+    unsigned three = (c == 0xE1) & (c1 - 0xBA < 2) & ((c2 & 0xC0) == 0x80);
+    unsigned twoIndex = (((c & 0x1F) << 6) | (c1 & 0x3F)) - 0xC0;
+    unsigned threeIndex = 256 + (((c1 & 1) << 6) | (c2 & 0x3F));
+    n = 2 * two + 3 * three;
+    return letters[(twoIndex & (0u - two)) | (threeIndex & (0u - three))];
+}
+
+#ifdef UK_BLOCK
+//---------------------------------------------------------------
+// Copies p[0, len) to q a whole block at a time, lower casing ASCII
+// letters if caseBit has 0x20. Always reads and writes one block, and
+// up to a block more than len after that.
+//---------------------------------------------------------------
+static inline void copyRun(unsigned char *q, const unsigned char *p, long len,
+                           UkBlock caseBit)
+{
+    UkStoreBlock(q, lowerBlock(UkLoadBlock(p), caseBit));
+    for (long i = UK_BLOCK; i < len; i += UK_BLOCK)
+        UkStoreBlock(q + i, lowerBlock(UkLoadBlock(p + i), caseBit));
+}
+
+#ifdef FOLD_PERMUTE
+//---------------------------------------------------------------
+// Bytes of one plane of the tables at the 64 indexes in idx. Its 384
+// entries are 6 banks of 64, for the leads C3..C6, E1 BA and E1 BB: idx
+// has the bank's low bit in bit 6 above the 6 bits of the index in it,
+// each vpermi2b looks up 2 banks, and banks23 and banks45 pick from them.
+//---------------------------------------------------------------
+static inline __m512i lookupPlane(const unsigned char *plane, __m512i idx,
+                                  __mmask64 banks23, __mmask64 banks45)
+{
+    __m512i r = _mm512_permutex2var_epi8(_mm512_loadu_si512(plane), idx,
+                                         _mm512_loadu_si512(plane + 64));
+    r = _mm512_mask_blend_epi8(banks23, r,
+                               _mm512_permutex2var_epi8(_mm512_loadu_si512(plane + 128), idx,
+                                                        _mm512_loadu_si512(plane + 192)));
+    return _mm512_mask_blend_epi8(banks45, r,
+                                  _mm512_permutex2var_epi8(_mm512_loadu_si512(plane + 256), idx,
+                                                           _mm512_loadu_si512(plane + 320)));
+}
+
+// Byte i - 1 and i - 2 of a vector at byte i, with vpermb
+static const unsigned char foldShift[2][FOLD_WINDOW] = {
+    {63, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+     22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42,
+     43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62},
+    {62, 63, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+     21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41,
+     42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61}
+};
+
+//---------------------------------------------------------------
+// Folds the windows from p up to windowsEnd to q, a whole number of
+// windows, and returns the end of the output. Reads up to a block past
+// windowsEnd and writes whole windows: q is never ahead of p, so the
+// output has room. p is left after the last letter read, which may end
+// past windowsEnd.
+//
+// Each window is folded in place, every letter's bytes from the planes
+// looked up at its first byte, then the bytes a letter folds away are
+// dropped with vpcompressb. A letter that runs past the window is folded
+// on its own, and its bytes in the next window are skipped there.
+//---------------------------------------------------------------
+static unsigned char *foldWindows(const unsigned char *&p, const unsigned char *windowsEnd,
+                                  unsigned char *q, const UkFoldTables &tables, int flags)
+{
+    int set = flags & (FOLD_FLAG_SETS - 1);
+    const unsigned char (*planes)[384] = tables.planes[set];
+    const __m512i caseBit = _mm512_set1_epi8((flags & UKFOLD_CASE) ? 0x20 : 0);
+    const __m512i shift1 = _mm512_loadu_si512(foldShift[0]);
+    const __m512i shift2 = _mm512_loadu_si512(foldShift[1]);
+    const __m512i lowBits = _mm512_set1_epi8(0x3F);
+    unsigned skip = 0;
+
+    const unsigned char *w = p;
+    for (; w < windowsEnd; w += FOLD_WINDOW) {
+        __m512i v0 = _mm512_loadu_si512(w);
+        __m512i v1 = _mm512_loadu_si512(w + 1);
+        __m512i v2 = _mm512_loadu_si512(w + 2);
+        __mmask64 upper = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v0, _mm512_set1_epi8('A')),
+                                                 _mm512_set1_epi8('Z' - 'A'));
+        __m512i out = _mm512_add_epi8(v0, _mm512_maskz_mov_epi8(upper, caseBit));
+        __mmask64 keep = ~0ULL << skip;
+
+        // the first bytes of letters, the same as foldLetter() takes
+        __m512i c1 = _mm512_sub_epi8(v1, _mm512_set1_epi8(0x80));
+        __m512i c2 = _mm512_sub_epi8(v2, _mm512_set1_epi8(0x80));
+        __mmask64 two = _mm512_cmple_epu8_mask(_mm512_sub_epi8(v0, _mm512_set1_epi8(0xC3)),
+                                               _mm512_set1_epi8(3)) &
+            _mm512_cmple_epu8_mask(c1, lowBits);
+        __mmask64 three = _mm512_cmpeq_epi8_mask(v0, _mm512_set1_epi8(0xE1)) &
+            _mm512_cmple_epu8_mask(_mm512_sub_epi8(v1, _mm512_set1_epi8(0xBA)),
+                                   _mm512_set1_epi8(1)) &
+            _mm512_cmple_epu8_mask(c2, lowBits);
+        __mmask64 starts = two | three;
+        __mmask64 over = (two & (1ULL << 63)) | (three & (3ULL << 62));
+
+        if (starts) {
+            __m512i bank = _mm512_mask_blend_epi8(
+                three, _mm512_sub_epi8(v0, _mm512_set1_epi8(0xC3)),
+                _mm512_sub_epi8(v1, _mm512_set1_epi8(0xBA - 4)));
+            __m512i idx = _mm512_mask_blend_epi8(three, c1, c2);
+            idx = _mm512_mask_add_epi8(idx, _mm512_test_epi8_mask(bank, _mm512_set1_epi8(1)),
+                                       idx, _mm512_set1_epi8(0x40));
+            __mmask64 banks23 = _mm512_cmpge_epu8_mask(bank, _mm512_set1_epi8(2));
+            __mmask64 banks45 = _mm512_cmpge_epu8_mask(bank, _mm512_set1_epi8(4));
+
+            __m512i len = lookupPlane(planes[3], idx, banks23, banks45);
+            __mmask64 keeps2 = starts & _mm512_cmpge_epu8_mask(len, _mm512_set1_epi8(2));
+            __mmask64 keeps3 = three & _mm512_cmpge_epu8_mask(len, _mm512_set1_epi8(3));
+            keep &= ~((starts & ~keeps2) << 1) & ~((three & ~keeps3) << 2);
+
+            out = _mm512_mask_blend_epi8(starts, out, lookupPlane(planes[0], idx, banks23, banks45));
+            out = _mm512_mask_permutexvar_epi8(out, starts << 1, shift1,
+                                               lookupPlane(planes[1], idx, banks23, banks45));
+            out = _mm512_mask_permutexvar_epi8(out, three << 2, shift2,
+                                               lookupPlane(planes[2], idx, banks23, banks45));
+        }
+        if (over)
+            keep &= (1ULL << __builtin_ctzll(over)) - 1;
+
+        _mm512_storeu_si512(q, _mm512_maskz_compress_epi8(keep, out));
+        q += __builtin_popcountll(keep);
+
+        skip = 0;
+        if (over) {
+            int at = __builtin_ctzll(over);
+            const unsigned char *s = w + at;
+            int n;
+            uint32_t v = foldLetter(s[0], s[1], s[2], tables.letters[set], n);
+            memcpy(q, &v, 4);   // the count byte is overwritten next
+            q += v >> 24;
+            skip = at + n - FOLD_WINDOW;
+        }
+    }
+    p = w + skip;
+    return q;
+}
+#else
+//---------------------------------------------------------------
+// Folds the windows from p up to windowsEnd to q, a whole number of
+// windows, and returns the end of the output. Reads and writes up to a
+// block past windowsEnd: q is never ahead of p, so the output has room.
+// p is left after the last letter read, which may end past windowsEnd.
+//---------------------------------------------------------------
+static unsigned char *foldWindows(const unsigned char *&p, const unsigned char *windowsEnd,
+                                  unsigned char *q, const UkFoldTables &tables, int flags)
+{
+    const uint32_t *letters = tables.letters[flags & (FOLD_FLAG_SETS - 1)];
+    UkBlock caseBit = UkSetBlock((flags & UKFOLD_CASE) ? 0x20 : 0);
+    // the input from run on is not written yet
+    const unsigned char *run = p;
+    for (const unsigned char *w = p; w < windowsEnd; w += FOLD_WINDOW) {
+        uint64_t leads = windowLeads(w);
+        while (leads) {
+            const unsigned char *s = w + __builtin_ctzll(leads);
+            leads &= leads - 1;
+            int n;
+            uint32_t v = foldLetter(s[0], s[1], s[2], letters, n);
+            if (!n)
+                continue;
+            copyRun(q, run, s - run, caseBit);
+            q += s - run;
+            memcpy(q, &v, 4);   // the count byte is overwritten next
+            q += v >> 24;
+            run = s + n;
+        }
+        if (run < w + FOLD_WINDOW) {
+            copyRun(q, run, w + FOLD_WINDOW - run, caseBit);
+            q += w + FOLD_WINDOW - run;
+            run = w + FOLD_WINDOW;
+        }
+    }
+    p = run;
+    return q;
+}
+#endif // FOLD_PERMUTE
+#endif // UK_BLOCK
+
+//---------------------------------------------------------------
+int UkFoldUtf8(const char *in, int inLen, char *out, int flags)
+{
+    const UkFoldTables &tables = foldTables();
+    const unsigned char *p = (const unsigned char *)in;
+    const unsigned char *end = p + inLen;
+    unsigned char *q = (unsigned char *)out;
+
+#ifdef UK_BLOCK
+    if (end - p >= FOLD_WINDOW + UK_BLOCK) {
+        long windows = (end - p - UK_BLOCK) / FOLD_WINDOW;
+        q = foldWindows(p, p + windows * FOLD_WINDOW, q, tables, flags);
+    }
+
+    // The rest, less than a window and a block, is folded the same way
+    // from a copy padded with NULs, which fold to themselves.
+    if (p < end) {
+        unsigned char tail[2 * FOLD_WINDOW + UK_BLOCK];
+        unsigned char folded[2 * FOLD_WINDOW + UK_BLOCK];
+        long left = end - p;
+        long padded = (left + FOLD_WINDOW - 1) / FOLD_WINDOW * FOLD_WINDOW;
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, p, left);
+
+        const unsigned char *t = tail;
+        long len = foldWindows(t, tail + padded, folded, tables, flags) - folded;
+        len -= padded - left;
+        memcpy(q, folded, len);
+        q += len;
+    }
+#else
+    bool lower = (flags & UKFOLD_CASE) != 0;
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) {
+            *q++ = (lower && c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+            p++;
+            continue;
+        }
+
+        int n;
+        uint32_t v = foldLetter(c, end - p > 1 ? p[1] : 0, end - p > 2 ? p[2] : 0,
+                                tables.letters[flags & (FOLD_FLAG_SETS - 1)], n);
+        if (!n) {
+            *q++ = c;
+            p++;
+            continue;
+        }
+        for (uint32_t i = 0; i < (v >> 24); i++)
+            *q++ = (unsigned char)(v >> (8 * i));
+        p += n;
+    }
+#endif
+    return (int)(q - (unsigned char *)out);
+}
+
+//---------------------------------------------------------------
+// Two multiply-rotate lanes over 16-byte blocks, so consecutive blocks
+// do not wait on each other's multiplies, and a splitmix64 finish.
+//---------------------------------------------------------------
+struct UkHashState {
+    uint64_t a;
+    uint64_t b;
+    uint64_t len;
+
+    explicit UkHashState(uint64_t seed)
+    {
+        a = seed ^ HASH_P1;
+        b = seed ^ HASH_P2;
+        len = 0;
+    }
+
+    static uint64_t rotl(uint64_t x, int n)
+    {
+        return (x << n) | (x >> (64 - n));
+    }
+
+    void block(const unsigned char *p)
+    {
+        uint64_t w[2];
+        memcpy(w, p, sizeof(w));
+        a = rotl((a ^ w[0]) * HASH_P1, 31);
+        b = rotl((b ^ w[1]) * HASH_P2, 29);
+        len += 16;
+    }
+
+    // n < 16 bytes left
+    uint64_t finish(const unsigned char *p, int n)
+    {
+        if (n > 0) {
+            unsigned char last[16];
+            memset(last, 0, sizeof(last));
+            memcpy(last, p, n);
+            block(last);
+            len += n - 16;
+        }
+        uint64_t h = a ^ rotl(b, 32) ^ (len * HASH_P2);
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+};
+
+//---------------------------------------------------------------
+uint64_t UkHashBytes(const char *data, int len, uint64_t seed)
+{
+    UkHashState state(seed);
+    const unsigned char *p = (const unsigned char *)data;
+    for (; len >= 16; p += 16, len -= 16)
+        state.block(p);
+    return state.finish(p, len);
+}
+
+//---------------------------------------------------------------
+uint64_t UkFoldHash(const char *in, int inLen, int flags, uint64_t seed)
+{
+    UkHashState state(seed);
+    // folded bytes left over from the last chunk in front, < 16 of them
+    char buf[16 + FOLD_HASH_CHUNK];
+    int kept = 0;
+    int pos = 0;
+
+    while (pos < inLen) {
+        int end = pos + FOLD_HASH_CHUNK;
+        if (end >= inLen) {
+            end = inLen;
+        } else {
+            // Do not cut a letter in two, a part of it would be copied
+            // instead of folded. Letters are 3 bytes at most and start
+            // with a byte that is no continuation byte.
+            if ((in[end] & 0xC0) == 0x80) {
+                if ((in[end - 1] & 0xC0) != 0x80)
+                    end -= 1;
+                else if ((in[end - 2] & 0xC0) != 0x80)
+                    end -= 2;
+            }
+        }
+
+        int len = kept + UkFoldUtf8(in + pos, end - pos, buf + kept, flags);
+        const unsigned char *p = (const unsigned char *)buf;
+        for (; len >= 16; p += 16, len -= 16)
+            state.block(p);
+        memmove(buf, p, len);
+        kept = len;
+        pos = end;
+    }
+    return state.finish((const unsigned char *)buf, kept);
+}
@@ -0,0 +1,61 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_FOLD_H
+#define __UK_FOLD_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Case folding and tone/mark stripping of UTF-8 text, for building and
+// looking up search keys ("Tiếng Việt" -> "tieng viet"). Unlike the
+// toLower and removeTone options of VnConvert these work on UTF-8 directly,
+// keep no global state and are safe from any thread.
+//
+// Only ASCII letters and the precomposed Vietnamese letters of charset.h
+// are folded: lower case is StdVnToLower(), UKFOLD_TONES is StdVnNoTone[]
+// and UKFOLD_MARKS is StdVnGetRoot(), which leaves plain ASCII ("đ" -> "d").
+// Every other byte is copied as it is, invalid UTF-8 included.
+//
+// A folded letter is never longer than the letter, so the output of a
+// fold is at most as long as its input. Runs of ASCII are folded a vector
+// at a time (AVX2 or SSE2, as the compiler targets); letters beyond ASCII
+// go through a table per set of flags, looked up a 64 byte window at a
+// time with byte permutes where the compiler targets AVX-512 VBMI2 and
+// one letter at a time elsewhere.
+//----------------------------------------------------------------------
+
+#define UKFOLD_CASE  1  // to lower case
+#define UKFOLD_TONES 2  // drop the tone: "ế" -> "ê"
+#define UKFOLD_MARKS 4  // drop the tone and the marks: "ế" -> "e", "đ" -> "d"
+#define UKFOLD_ALL   (UKFOLD_CASE | UKFOLD_MARKS)
+
+// Writes in[0, inLen) folded to out, which has room for inLen bytes and
+// does not overlap in. Returns the length written.
+int UkFoldUtf8(const char *in, int inLen, char *out, int flags);
+
+// A 64-bit hash of bytes, for keys in hash tables and sketches; not for
+// anything that needs to resist chosen inputs.
+uint64_t UkHashBytes(const char *data, int len, uint64_t seed = 0);
+
+// Same as UkHashBytes() of the text UkFoldUtf8() writes for in, without
+// writing it out anywhere.
+uint64_t UkFoldHash(const char *in, int inLen, int flags, uint64_t seed = 0);
+
+#endif
@@ -0,0 +1,274 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <ctype.h>
+#include <string.h>
+
+#include "ukkeystroke.h"
+#include "inputproc.h"
+#include "charset.h"
+#include "ukutf8.h"
+
+#define MAX_WORD_LETTERS 64
+
+//---------------------------------------------------------------
+// Actions which put a mark on a letter, the preferred one first, each list
+// ending with -1
+//---------------------------------------------------------------
+static const int RoofA[] = {vneRoof_a, vneRoofAll, -1};
+static const int RoofE[] = {vneRoof_e, vneRoofAll, -1};
+static const int RoofO[] = {vneRoof_o, vneRoofAll, -1};
+static const int Bowl[] = {vneBowl, vneHookAll, vne_telex_w, -1};
+static const int HookO[] = {vneHook_o, vneHook_uo, vneHookAll, vne_telex_w, -1};
+static const int HookU[] = {vneHook_u, vneHook_uo, vneHookAll, vne_telex_w, -1};
+static const int StrokeD[] = {vneDd, -1};
+
+//---------------------------------------------------------------
+static const int *markActions(int noToneLower)
+{
+    switch (noToneLower) {
+    case vnl_ar: return RoofA;
+    case vnl_er: return RoofE;
+    case vnl_or: return RoofO;
+    case vnl_ab: return Bowl;
+    case vnl_oh: return HookO;
+    case vnl_uh: return HookU;
+    case vnl_dd: return StrokeD;
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------
+static UkKeyMapping *builtInMapping(UkInputMethod im)
+{
+    switch (im) {
+    case UkTelex: return TelexMethodMapping;
+    case UkSimpleTelex: return SimpleTelexMethodMapping;
+    case UkSimpleTelex2: return SimpleTelex2MethodMapping;
+    case UkVni: return VniMethodMapping;
+    default: return 0;
+    }
+}
+
+//---------------------------------------------------------------
+static bool isVowelRoot(char ch)
+{
+    return strchr("aeiouyAEIOUY", ch) != 0;
+}
+
+//---------------------------------------------------------------
+UkKeyStrokeWriter::UkKeyStrokeWriter()
+{
+    memset(m_letters, 0, sizeof(m_letters));
+    for (int i = 0; i < 128; i++)
+        m_keyAction[i] = vneNormal;
+    m_tonePlace = ToneAtWordEnd;
+    m_markPlace = MarkAfterLetter;
+    m_random = 2463534242u;
+}
+
+//---------------------------------------------------------------
+int UkKeyStrokeWriter::init(UkInputMethod im)
+{
+    UkKeyMapping *map = builtInMapping(im);
+    if (!map)
+        return 0;
+
+    // First key of each action, letters in lower case
+    char actionKey[vneCount];
+    memset(actionKey, 0, sizeof(actionKey));
+    for (int i = 0; i < 128; i++)
+        m_keyAction[i] = vneNormal;
+
+    for (int i = 0; map[i].key; i++) {
+        unsigned char key = map[i].key;
+        int action = map[i].action;
+        if (key >= 128)
+            continue;
+        m_keyAction[key] = action;
+        if (action >= vneCount)
+            continue;   // types a letter, like '[' in Telex
+        m_keyAction[tolower(key)] = action;
+        if (!actionKey[action])
+            actionKey[action] = tolower(key);
+    }
+
+    for (int i = 0; i < vnl_lastChar; i++) {
+        LetterKeys &keys = m_letters[i];
+        int noTone = StdVnNoTone[i];
+        keys.base = (char)UnicodeTable[StdVnRootChar[i]];
+        keys.isVowel = isVowelRoot(keys.base);
+        keys.mark = 0;
+        keys.tone = 0;
+
+        const int *actions = markActions(noTone | 1);
+        if (actions) {
+            for (int a = 0; actions[a] >= 0 && !keys.mark; a++) {
+                keys.mark = actionKey[actions[a]];
+                keys.hooksPair = actions[a] == vneHook_uo ||
+                    actions[a] == vneHookAll || actions[a] == vne_telex_w;
+            }
+            if (!keys.mark)
+                return 0;
+        }
+
+        int tone = keys.isVowel ? (i - noTone) / 2 : 0;
+        if (tone) {
+            keys.tone = actionKey[vneTone0 + tone];
+            if (!keys.tone)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+//---------------------------------------------------------------
+void UkKeyStrokeWriter::setPlaces(TonePlace tone, MarkPlace mark)
+{
+    m_tonePlace = tone;
+    m_markPlace = mark;
+}
+
+//---------------------------------------------------------------
+void UkKeyStrokeWriter::setSeed(uint32_t seed)
+{
+    m_random = seed ? seed : 2463534242u;
+}
+
+//---------------------------------------------------------------
+// xorshift32
+//---------------------------------------------------------------
+uint32_t UkKeyStrokeWriter::random()
+{
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+//---------------------------------------------------------------
+void UkKeyStrokeWriter::writeWord(const VnLexiName *word, int len, std::string &keys)
+{
+    bool toneAtEnd = m_tonePlace == ToneAtWordEnd ||
+        (m_tonePlace == ToneRandom && (random() & 1));
+    bool markAtEnd = m_markPlace == MarkAtWordEnd ||
+        (m_markPlace == MarkRandom && (random() & 1));
+
+    // Keys of a word in capitals are typed in capitals
+    bool capitals = len > 1;
+    for (int i = 0; i < len && capitals; i++)
+        capitals = !(word[i] & 1);
+
+    char marks[MAX_WORD_LETTERS];
+    int markCount = 0;
+    char tone = 0;
+    char last = 0;
+    for (int i = 0; i < len; i++) {
+        const LetterKeys &k = m_letters[word[i]];
+
+        // A plain letter which is also an action key, like the second o of
+        // "xoong" in Telex, would act on the first one: typing it again
+        // takes the action back.
+        if (!k.mark && tolower(k.base) == tolower(last) &&
+            m_keyAction[(unsigned char)tolower(k.base)] != vneNormal)
+            keys += k.base;
+        keys += k.base;
+        last = k.base;
+
+        if (k.mark) {
+            char mark = capitals ? toupper(k.mark) : k.mark;
+            // At the word end one key hooks both letters of "ươ"
+            bool pairDone = k.hooksPair && i > 0 &&
+                (StdVnNoTone[word[i]] | 1) == vnl_oh &&
+                (StdVnNoTone[word[i - 1]] | 1) == vnl_uh;
+            if (!markAtEnd)
+                keys += mark;
+            else if (!pairDone)
+                marks[markCount++] = mark;
+            last = 0;
+        }
+        if (k.tone) {
+            tone = capitals ? toupper(k.tone) : k.tone;
+            if (!toneAtEnd) {
+                keys += tone;
+                tone = 0;
+            }
+            last = 0;
+        }
+    }
+
+    for (int i = 0; i < markCount; i++)
+        keys += marks[i];
+    if (tone)
+        keys += tone;
+}
+
+//---------------------------------------------------------------
+// Whether a key of the action typed right after the word would change it
+// instead of being typed
+//---------------------------------------------------------------
+bool UkKeyStrokeWriter::appliesAfter(int action, const VnLexiName *word, int len) const
+{
+    if (action >= vneCount)
+        return true;
+    for (int i = 0; i < len; i++) {
+        const LetterKeys &k = m_letters[word[i]];
+        if (action == vneDd ? (k.base == 'd' || k.base == 'D') : k.isVowel)
+            return true;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------
+void UkKeyStrokeWriter::write(const char *in, int inLen, std::string &keys)
+{
+    const unsigned char *p = (const unsigned char *)in;
+    VnLexiName word[MAX_WORD_LETTERS];
+    int len = 0;
+
+    for (int pos = 0; pos < inLen; ) {
+        uint32_t cp;
+        int n = UkReadUtf8(p + pos, inLen - pos, cp);
+        VnLexiName lexi = UkUnicodeToLexi(cp);
+
+        if (lexi != vnl_nonVnChar) {
+            if (len == MAX_WORD_LETTERS) {
+                writeWord(word, len, keys);
+                len = 0;
+            }
+            word[len++] = lexi;
+            pos += n;
+            continue;
+        }
+
+        bool afterWord = len > 0;
+        if (afterWord)
+            writeWord(word, len, keys);
+        // A key the method would take for a mark is typed twice, the second
+        // time taking the mark back.
+        int action = cp < 128 ? m_keyAction[cp] : vneNormal;
+        if (action != vneNormal &&
+            (action >= vneCount || (afterWord && appliesAfter(action, word, len))))
+            keys += (char)cp;
+        keys.append(in + pos, n);
+        len = 0;
+        pos += n;
+    }
+    if (len > 0)
+        writeWord(word, len, keys);
+}
@@ -0,0 +1,78 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_KEYSTROKE_H
+#define __UK_KEYSTROKE_H
+
+#include <stdint.h>
+#include <string>
+#include "keycons.h"
+#include "vnlexi.h"
+
+//----------------------------------------------------------------------
+// Turns UTF-8 Vietnamese text back into the keys typed for it with Telex,
+// VNI or one of the simple Telex methods, for feeding UkEngine real text in
+// benchmarks and regression runs. The keys of marks and tones come from the method's
+// UkKeyMapping table (TelexMethodMapping, VniMethodMapping...), so a method
+// that changes there changes here.
+//
+// Words are written letter by letter with the key of each roof, hook, bowl
+// or đ stroke right after its letter and the tone key at the end of the
+// word ("tiếng" -> "tieengs" in Telex, "tie6ng1" in VNI): the canonical
+// order. Either can be moved, or chosen at random per word, to get the
+// orders free marking allows. Anything that is not a letter is copied.
+//----------------------------------------------------------------------
+
+class UkKeyStrokeWriter {
+public:
+    enum TonePlace { ToneAtWordEnd, ToneAfterVowel, ToneRandom };
+    enum MarkPlace { MarkAfterLetter, MarkAtWordEnd, MarkRandom };
+
+    UkKeyStrokeWriter();
+
+    // 1 on success, 0 for the other input methods
+    int init(UkInputMethod im);
+    void setPlaces(TonePlace tone, MarkPlace mark);
+    void setSeed(uint32_t seed);
+
+    // Appends the keys typed for the UTF-8 text in[0, inLen) to keys.
+    void write(const char *in, int inLen, std::string &keys);
+
+protected:
+    struct LetterKeys {
+        char base;      // the letter without marks, or its own key
+        char mark;      // 0 if none
+        char tone;      // 0 if none
+        bool isVowel;
+        bool hooksPair; // the mark key hooks "uo" as a pair
+    };
+
+    void writeWord(const VnLexiName *word, int len, std::string &keys);
+    bool appliesAfter(int action, const VnLexiName *word, int len) const;
+    uint32_t random();
+
+    LetterKeys m_letters[vnl_lastChar];
+    // UkKeyEvName of each ASCII key, or vneCount + the letter it types
+    int m_keyAction[128];
+    TonePlace m_tonePlace;
+    MarkPlace m_markPlace;
+    uint32_t m_random;
+};
+
+#endif
@@ -0,0 +1,231 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ukshm.h"
+
+#define UKSHM_NAME_SIZE 64
+
+//---------------------------------------------------------------
+// FNV-1a of the real path of the file and the layout version
+//---------------------------------------------------------------
+static bool SourceHash(const char *sourceFile, uint32_t version, uint64_t &hash)
+{
+    char *path = realpath(sourceFile, 0);
+    if (!path)
+        return false;
+
+    hash = 0xcbf29ce484222325ULL;
+    for (const char *p = path; *p; p++)
+        hash = (hash ^ (unsigned char)*p) * 0x100000001b3ULL;
+    for (int i = 0; i < 4; i++)
+        hash = (hash ^ ((version >> (i * 8)) & 0xFF)) * 0x100000001b3ULL;
+    free(path);
+    return true;
+}
+
+//---------------------------------------------------------------
+static bool SourceHeader(const char *sourceFile, uint32_t version, UkShmHeader &header)
+{
+    struct stat st;
+    if (stat(sourceFile, &st) < 0)
+        return false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UKSHM_MAGIC, sizeof(UKSHM_MAGIC));
+    header.version = version;
+    header.sourceDev = st.st_dev;
+    header.sourceIno = st.st_ino;
+    header.sourceSize = st.st_size;
+    header.sourceTime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+//---------------------------------------------------------------
+static void SegmentName(uint64_t hash, unsigned int uid, char *name)
+{
+    snprintf(name, UKSHM_NAME_SIZE, "/ibus-unikey-%016llx-%u",
+             (unsigned long long)hash, uid);
+}
+
+//---------------------------------------------------------------
+UkShmImage::UkShmImage()
+{
+    m_map = 0;
+    m_mapSize = 0;
+    m_data = 0;
+    m_size = 0;
+    m_rootOwned = false;
+}
+
+//---------------------------------------------------------------
+UkShmImage::~UkShmImage()
+{
+    detach();
+}
+
+//---------------------------------------------------------------
+int UkShmImage::attachSegment(const char *name, const UkShmHeader &source, uint32_t expectedUid)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+
+    // only its owner can write to the segment after this
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_uid != expectedUid ||
+        (st.st_mode & (S_IWGRP | S_IWOTH)) ||
+        st.st_size < (long)sizeof(UkShmHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const UkShmHeader *header = (const UkShmHeader *)map;
+    if (memcmp(header->magic, source.magic, sizeof(header->magic)) != 0 ||
+        header->version != source.version ||
+        !__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) ||
+        header->sourceDev != source.sourceDev ||
+        header->sourceIno != source.sourceIno ||
+        header->sourceSize != source.sourceSize ||
+        header->sourceTime != source.sourceTime ||
+        header->dataSize != (uint64_t)(st.st_size - sizeof(UkShmHeader))) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    m_map = map;
+    m_mapSize = st.st_size;
+    m_data = header + 1;
+    m_size = header->dataSize;
+    m_rootOwned = (expectedUid == 0);
+    return 1;
+}
+
+//---------------------------------------------------------------
+int UkShmImage::attach(const char *sourceFile, uint32_t version)
+{
+    detach();
+
+    uint64_t hash;
+    UkShmHeader source;
+    if (!SourceHash(sourceFile, version, hash) ||
+        !SourceHeader(sourceFile, version, source))
+        return 0;
+
+    char name[UKSHM_NAME_SIZE];
+    SegmentName(hash, 0, name);
+    if (attachSegment(name, source, 0))
+        return 1;
+
+    uid_t uid = geteuid();
+    if (uid == 0)
+        return 0;
+    SegmentName(hash, uid, name);
+    return attachSegment(name, source, uid);
+}
+
+//---------------------------------------------------------------
+int UkShmImage::publish(const char *sourceFile, uint32_t version,
+                        const void *data, long size)
+{
+    detach();
+
+    uint64_t hash;
+    UkShmHeader source;
+    if (size < 0 || !SourceHash(sourceFile, version, hash) ||
+        !SourceHeader(sourceFile, version, source))
+        return 0;
+
+    uid_t uid = geteuid();
+    char name[UKSHM_NAME_SIZE];
+    SegmentName(hash, uid, name);
+
+    // Only the owner can read the segment until it is complete
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        if (attachSegment(name, source, uid))
+            return 1;
+        // stale, replace it. Processes that have it mapped keep their copy
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd < 0)
+        return 0;
+
+    long mapSize = sizeof(UkShmHeader) + size;
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, mapSize) == 0)
+        map = mmap(0, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+
+    UkShmHeader *header = (UkShmHeader *)map;
+    *header = source;
+    header->dataSize = size;
+    memcpy(header + 1, data, size);
+    __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+    munmap(map, mapSize);
+
+    int ret = fchmod(fd, 0644);
+    close(fd);
+    if (ret < 0) {
+        shm_unlink(name);
+        return 0;
+    }
+    return attachSegment(name, source, uid);
+}
+
+//---------------------------------------------------------------
+int UkShmImage::remove(const char *sourceFile, uint32_t version)
+{
+    uint64_t hash;
+    if (!SourceHash(sourceFile, version, hash))
+        return 0;
+
+    char name[UKSHM_NAME_SIZE];
+    SegmentName(hash, geteuid(), name);
+    return shm_unlink(name) == 0;
+}
+
+//---------------------------------------------------------------
+void UkShmImage::detach()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_data = 0;
+    m_size = 0;
+    m_rootOwned = false;
+}
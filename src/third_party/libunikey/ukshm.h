@@ -0,0 +1,90 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_SHM_H
+#define __UK_SHM_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Read-only image of data made from a source file (the system macro
+// table, say), published in a POSIX shared memory segment so that every
+// process on the host maps one copy instead of building its own.
+//
+// The segment of a source file is named after the real path of the file,
+// the layout version of the data and the user who published it. An image
+// is only mapped if it was published by root or by the user itself, so no
+// other user can change what a process reads. Root publishing once serves
+// all users; without that, each user shares one image among its own
+// processes.
+//
+// The header records which file (device, inode, size and time) the image
+// was made from; an image of an older file is stale and is replaced by
+// the next publish. The data is written before the segment becomes
+// readable by others and before the ready flag is set, so a reader never
+// sees a partly written image.
+//----------------------------------------------------------------------
+
+#define UKSHM_MAGIC "UKSHM1"
+
+struct UkShmHeader {
+    char magic[8];
+    uint32_t version;     // layout version of the data
+    uint32_t ready;       // set last by the publisher
+    uint64_t sourceDev;
+    uint64_t sourceIno;
+    uint64_t sourceSize;
+    uint64_t sourceTime;  // modification time, in nanoseconds
+    uint64_t dataSize;    // the data follows the header
+};
+
+class UkShmImage {
+public:
+    UkShmImage();
+    ~UkShmImage();
+
+    // maps the current image of sourceFile, published by root or by this
+    // user. 1 on success
+    int attach(const char *sourceFile, uint32_t version);
+
+    // publishes data as the image of sourceFile under this user's name,
+    // replacing a stale one, and maps it. 1 on success
+    int publish(const char *sourceFile, uint32_t version,
+                const void *data, long size);
+
+    // removes the image of sourceFile this user has published
+    static int remove(const char *sourceFile, uint32_t version);
+
+    void detach();
+    bool isAttached() const { return m_map != 0; }
+    const void *data() const { return m_data; }
+    long size() const { return m_size; }
+    bool ownedByRoot() const { return m_rootOwned; }
+
+protected:
+    int attachSegment(const char *name, const UkShmHeader &source, uint32_t expectedUid);
+
+    void *m_map;
+    long m_mapSize;
+    const void *m_data;
+    long m_size;
+    bool m_rootOwned;
+};
+
+#endif
@@ -0,0 +1,106 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_SIMD_H
+#define __UK_SIMD_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Vectors of bytes for the text kernels (ukfold.cpp, ukcollate.cpp): AVX2
+// or SSE2, whichever the compiler targets. UK_BLOCK is not defined when
+// it targets neither; the kernels then fall back to plain loops.
+//
+// Byte compares are signed, so bytes beyond ASCII are negative.
+//----------------------------------------------------------------------
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define UK_BLOCK 32
+typedef __m256i UkBlock;
+
+inline UkBlock UkLoadBlock(const unsigned char *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+
+inline void UkStoreBlock(unsigned char *p, UkBlock v)
+{
+    _mm256_storeu_si256((__m256i *)p, v);
+}
+
+inline UkBlock UkSetBlock(unsigned char c) { return _mm256_set1_epi8(c); }
+inline UkBlock UkAnd(UkBlock a, UkBlock b) { return _mm256_and_si256(a, b); }
+inline UkBlock UkOr(UkBlock a, UkBlock b) { return _mm256_or_si256(a, b); }
+inline UkBlock UkAdd(UkBlock a, UkBlock b) { return _mm256_add_epi8(a, b); }
+inline UkBlock UkSub(UkBlock a, UkBlock b) { return _mm256_sub_epi8(a, b); }
+// 0xFF where a > b, 0 elsewhere
+inline UkBlock UkGreater(UkBlock a, UkBlock b) { return _mm256_cmpgt_epi8(a, b); }
+// b where mask is 0xFF, a elsewhere
+// Not _mm256_blendv_epi8(): GCC folds it wrongly with -funsigned-char,
+// which libunikey is built with.
+inline UkBlock UkSelect(UkBlock mask, UkBlock a, UkBlock b)
+{
+    return _mm256_or_si256(_mm256_and_si256(mask, b), _mm256_andnot_si256(mask, a));
+}
+// bit i set if byte i is beyond ASCII
+inline uint32_t UkHighBits(UkBlock v) { return (uint32_t)_mm256_movemask_epi8(v); }
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define UK_BLOCK 16
+typedef __m128i UkBlock;
+
+inline UkBlock UkLoadBlock(const unsigned char *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+inline void UkStoreBlock(unsigned char *p, UkBlock v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+inline UkBlock UkSetBlock(unsigned char c) { return _mm_set1_epi8(c); }
+inline UkBlock UkAnd(UkBlock a, UkBlock b) { return _mm_and_si128(a, b); }
+inline UkBlock UkOr(UkBlock a, UkBlock b) { return _mm_or_si128(a, b); }
+inline UkBlock UkAdd(UkBlock a, UkBlock b) { return _mm_add_epi8(a, b); }
+inline UkBlock UkSub(UkBlock a, UkBlock b) { return _mm_sub_epi8(a, b); }
+inline UkBlock UkGreater(UkBlock a, UkBlock b) { return _mm_cmpgt_epi8(a, b); }
+inline UkBlock UkSelect(UkBlock mask, UkBlock a, UkBlock b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+inline uint32_t UkHighBits(UkBlock v) { return (uint32_t)_mm_movemask_epi8(v); }
+
+#endif
+
+#ifdef UK_BLOCK
+// 0xFF where lo <= v <= hi, for 0 < lo <= hi < 0x7F
+inline UkBlock UkInRange(UkBlock v, unsigned char lo, unsigned char hi)
+{
+    return UkAnd(UkGreater(v, UkSetBlock(lo - 1)), UkGreater(UkSetBlock(hi + 1), v));
+}
+#endif
+
+#endif
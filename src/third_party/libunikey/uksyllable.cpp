@@ -0,0 +1,520 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "uksyllable.h"
+#include "ukutf8.h"
+#include "ukdata.h"
+#include "charset.h"
+#include "uksimd.h"
+
+bool isValidCVC(ConSeq c1, VowelSeq v, ConSeq c2);
+int getVowelTonePosition(VowelSeq vs, bool terminated, bool modernStyle);
+
+//---------------------------------------------------------------
+// What a character is to a syllable, a byte: the letter in the low 5
+// bits, its tone (1..5, as in VnLexiName) in the high 3.
+// Letters are 1..SYL_LETTERS-1, lower case and without tone; they are
+// the letters Vietnamese syllables are spelled with, so f, j, w, z and
+// the letters of other scripts are SYL_OTHER.
+//---------------------------------------------------------------
+#define SYL_SEPARATOR 0
+#define SYL_LETTERS   30
+#define SYL_TONE_MARK 30    // a combining tone mark, for the letter before it
+#define SYL_OTHER     31    // a digit, another letter, an invalid byte
+
+// Entries 0..0x7FF are U+0000..U+07FF, 0x800..0x87F U+1E80..U+1EFF
+#define SYL_CHARS (0x800 + 0x80)
+
+// Letters in a syllable at most: 3 consonants, 3 vowels, 2 consonants
+#define SYL_MAX_LEN 8
+
+// A power of two, more than 1.5 times the number of syllables
+#define SYL_SLOTS (1 << 13)
+
+// Buckets of forms, a power of two, and forms a bucket has room for: at
+// 1.6 forms a bucket on average few are left out
+#define SYL_FORM_BUCKETS (1 << 14)
+#define SYL_BUCKET_FORMS 4
+
+//---------------------------------------------------------------
+// The letters of a syllable, 5 bits each, the first one highest
+//---------------------------------------------------------------
+typedef uint64_t UkSylKey;
+
+static inline uint32_t slotOf(uint64_t key, int bits)
+{
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+//---------------------------------------------------------------
+// The tables syllables are read and looked up with. Built once, on
+// first use.
+//
+// A slot of slots is empty (0) or has the key of a syllable in its low
+// 40 bits, the letters its tone may go on in bits 40..47, and those
+// huyền, hỏi and ngã may go on in 48..55: none after a stop consonant.
+// Old and modern style put the tone of "oa", "oe" and "uy" on different
+// letters, so there may be two.
+//
+// forms holds the UTF-8 of the syllables of up to 8 bytes, lower case
+// or with a capital first, with their tone, if any, in place, the first
+// byte lowest: most words of a text are one of them, and are told
+// Vietnamese without reading their letters one by one. A form goes in
+// the bucket its hash picks, so it is looked up with no branch, or if
+// that one is full nowhere, and its syllable is read a character at a
+// time. Forms of ASCII letters push others out; asciiForms is false if
+// one was still left out.
+//---------------------------------------------------------------
+struct UkSyllableTables {
+    uint64_t forms[SYL_FORM_BUCKETS][SYL_BUCKET_FORMS];
+    uint64_t slots[SYL_SLOTS];
+    uint8_t chars[SYL_CHARS];
+    bool asciiForms;
+
+    UkSyllableTables()
+    {
+        uint8_t letterOf[vnl_lastChar];
+        makeLetters(letterOf);
+        makeChars(letterOf);
+
+        memset(slots, 0, sizeof(slots));
+        memset(forms, 0, sizeof(forms));
+        asciiForms = true;
+        for (int c1 = -1; c1 < CSeqCount; c1++) {
+            for (int v = 0; v < VSeqCount; v++) {
+                // q only goes as qu, and gi before a vowel is a consonant:
+                // "quá" is not q-uá, "già" is not g-ìa
+                if (c1 == cs_q || (c1 == cs_g && VSeqList[v].len > 1 && VSeqList[v].v[0] == vnl_i))
+                    continue;
+                for (int c2 = -1; c2 < CSeqCount; c2++) {
+                    if (!VSeqList[v].complete || (c2 >= 0 && !CSeqList[c2].suffix))
+                        continue;
+                    if (!isValidCVC((ConSeq)c1, (VowelSeq)v, (ConSeq)c2))
+                        continue;
+                    addSyllable(letterOf, (ConSeq)c1, (VowelSeq)v, (ConSeq)c2);
+                }
+            }
+        }
+    }
+
+    // Numbers the lower case letters without tone, leaving out those no
+    // syllable has
+    static void makeLetters(uint8_t *letterOf)
+    {
+        int letter = 1;
+        for (int i = 0; i < vnl_lastChar; i++) {
+            if (!(i & 1) || StdVnNoTone[i] != i || i == vnl_f || i == vnl_j ||
+                i == vnl_w || i == vnl_z)
+                letterOf[i] = SYL_OTHER;
+            else
+                letterOf[i] = letter++;
+        }
+    }
+
+    void makeChars(const uint8_t *letterOf)
+    {
+        for (int i = 0; i < SYL_CHARS; i++) {
+            uint32_t cp = (i < 0x800) ? i : 0x1E80 + (i - 0x800);
+            int lexi = UkUnicodeToLexi(cp);
+            if (lexi != vnl_nonVnChar) {
+                lexi |= 1;
+                int base = StdVnNoTone[lexi];
+                chars[i] = letterOf[base] | ((lexi - base) / 2) << 5;
+            } else if (cp < 0x80) {
+                bool digit = (cp >= '0' && cp <= '9');
+                chars[i] = digit ? SYL_OTHER : SYL_SEPARATOR;
+            } else if (cp < 0xC0 || cp == 0xD7 || cp == 0xF7) {
+                chars[i] = SYL_SEPARATOR;
+            } else {
+                chars[i] = SYL_OTHER;
+            }
+        }
+
+        // sắc, huyền, hỏi, ngã, nặng
+        static const uint32_t toneMarks[] = {0x301, 0x300, 0x309, 0x303, 0x323};
+        for (int tone = 1; tone <= 5; tone++)
+            chars[toneMarks[tone - 1]] = SYL_TONE_MARK | tone << 5;
+    }
+
+    void addSyllable(const uint8_t *letterOf, ConSeq c1, VowelSeq v, ConSeq c2)
+    {
+        VnLexiName syms[SYL_MAX_LEN];
+        int len = 0;
+        if (c1 != cs_nil) {
+            for (int i = 0; i < CSeqList[c1].len; i++)
+                syms[len++] = CSeqList[c1].c[i];
+        }
+        int vStart = len;
+        for (int i = 0; i < VSeqList[v].len; i++)
+            syms[len++] = VSeqList[v].v[i];
+        if (c2 != cs_nil) {
+            for (int i = 0; i < CSeqList[c2].len; i++)
+                syms[len++] = CSeqList[c2].c[i];
+        }
+
+        UkSylKey key = 0;
+        for (int i = 0; i < len; i++)
+            key = (key << 5) | letterOf[syms[i]];
+
+        uint64_t places = 0;
+        for (int modern = 0; modern < 2; modern++)
+            places |= 1 << (vStart + getVowelTonePosition(v, c2 == cs_nil, modern));
+        uint64_t softPlaces = places;
+        if (c2 == cs_c || c2 == cs_ch || c2 == cs_p || c2 == cs_t)
+            softPlaces = 0;
+        *findSlot(key) |= key | places << 40 | softPlaces << 48;
+
+        for (int capital = 0; capital < 2; capital++) {
+            addForm(syms, len, -1, 0, capital);
+            for (int tone = 1; tone <= 5; tone++) {
+                for (int pos = 0; pos < len; pos++) {
+                    uint64_t allowed = ((0x1C >> tone) & 1) ? softPlaces : places;
+                    if ((allowed >> pos) & 1)
+                        addForm(syms, len, pos, tone, capital);
+                }
+            }
+        }
+    }
+
+    // Upper case lexi names are the lower case ones less 1
+    void addForm(const VnLexiName *syms, int len, int tonePos, int tone, bool capital)
+    {
+        uint64_t form = 0;
+        int bytes = 0;
+        for (int i = 0; i < len; i++) {
+            int lexi = syms[i] - (capital && i == 0);
+            uint32_t cp = UnicodeTable[lexi + (i == tonePos ? 2 * tone : 0)];
+            // an ASCII capital is lower cased before it is looked up
+            if (capital && i == 0 && cp < 0x80)
+                return;
+            unsigned char utf8[3];
+            int n;
+            if (cp < 0x80) {
+                utf8[0] = cp;
+                n = 1;
+            } else if (cp < 0x800) {
+                utf8[0] = 0xC0 | (cp >> 6);
+                utf8[1] = 0x80 | (cp & 0x3F);
+                n = 2;
+            } else {
+                utf8[0] = 0xE0 | (cp >> 12);
+                utf8[1] = 0x80 | ((cp >> 6) & 0x3F);
+                utf8[2] = 0x80 | (cp & 0x3F);
+                n = 3;
+            }
+            if (bytes + n > 8)
+                return;
+            for (int j = 0; j < n; j++)
+                form |= (uint64_t)utf8[j] << (8 * bytes++);
+        }
+        const uint64_t high = 0x8080808080808080ULL;
+        uint64_t *bucket = forms[slotOf(form, 14)];
+        int i = 0;
+        while (i < SYL_BUCKET_FORMS && bucket[i] != 0 && bucket[i] != form)
+            i++;
+        if (i == SYL_BUCKET_FORMS) {
+            // one beyond ASCII is read a character at a time instead
+            if (form & high)
+                return;
+            i = 0;
+            while (i < SYL_BUCKET_FORMS && !(bucket[i] & high))
+                i++;
+            if (i == SYL_BUCKET_FORMS) {
+                asciiForms = false;
+                return;
+            }
+        }
+        bucket[i] = form;
+    }
+
+    // The slot of key, or the empty one it would go to
+    const uint64_t *findSlot(UkSylKey key) const
+    {
+        uint32_t i = slotOf(key, 13);
+        while (slots[i] != 0 && (slots[i] & 0xFFFFFFFFFFULL) != key)
+            i = (i + 1) & (SYL_SLOTS - 1);
+        return &slots[i];
+    }
+
+    uint64_t *findSlot(UkSylKey key)
+    {
+        return const_cast<uint64_t *>(static_cast<const UkSyllableTables *>(this)->findSlot(key));
+    }
+
+    // form is not 0
+    bool hasForm(uint64_t form) const
+    {
+        const uint64_t *bucket = forms[slotOf(form, 14)];
+        return (bucket[0] == form) | (bucket[1] == form) |
+            (bucket[2] == form) | (bucket[3] == form);
+    }
+};
+
+static const UkSyllableTables &syllableTables()
+{
+    static const UkSyllableTables tables;
+    return tables;
+}
+
+//---------------------------------------------------------------
+// The entry of the character at p, before end, and its length in n.
+// ASCII and U+0080..U+07FF, where Vietnamese letters mostly are, are
+// read inline.
+//---------------------------------------------------------------
+static uint8_t readOtherChar(const uint8_t *chars, const unsigned char *p, long left, int &n)
+{
+    uint32_t cp;
+    n = UkReadUtf8(p, left > 4 ? 4 : (int)left, cp);
+    if (cp < 0x800)
+        return chars[cp];
+    if (cp >= 0x1E80 && cp <= 0x1EFF)
+        return chars[0x800 + (cp - 0x1E80)];
+    if ((cp >= 0x2000 && cp <= 0x206F) || (cp >= 0x3000 && cp <= 0x303F) || cp == 0xFEFF)
+        return SYL_SEPARATOR;
+    return SYL_OTHER;
+}
+
+static inline uint8_t readChar(const uint8_t *chars, const unsigned char *p,
+                               const unsigned char *end, int &n)
+{
+    unsigned c = p[0];
+    if (c < 0x80) {
+        n = 1;
+        return chars[c];
+    }
+    if (c - 0xC2 < 0xE0 - 0xC2 && end - p >= 2 && (p[1] & 0xC0) == 0x80) {
+        n = 2;
+        return chars[((c & 0x1F) << 6) | (p[1] & 0x3F)];
+    }
+    return readOtherChar(chars, p, end - p, n);
+}
+
+//---------------------------------------------------------------
+// A syllable as its characters are read
+//---------------------------------------------------------------
+struct UkSyllableReader {
+    UkSylKey key;
+    int len;
+    int tones;      // tones read, on letters or as marks
+    int tonePos;    // letter of the last one
+    int tone;
+    bool other;     // a character no syllable has
+
+    UkSyllableReader() : key(0), len(0), tones(0), tonePos(0), tone(0), other(false) {}
+
+    void add(uint8_t ch)
+    {
+        unsigned letter = ch & 31;
+        if (letter < SYL_LETTERS) {
+            key = (key << 5) | letter;
+            len++;
+        } else if (letter == SYL_OTHER || len == 0) {
+            other = true;
+        }
+        if (ch >> 5) {
+            tones++;
+            tonePos = len - 1;
+            tone = ch >> 5;
+        }
+    }
+
+    UkSyllableKind kind(const UkSyllableTables &tables) const
+    {
+        if (other || len > SYL_MAX_LEN)
+            return uksNonVn;
+        uint64_t slot = *tables.findSlot(key);
+        if (slot == 0)
+            return uksNonVn;
+        if (tones == 0)
+            return uksVietnamese;
+        if (tones > 1)
+            return uksMisToned;
+        // huyền, hỏi, ngã
+        int shift = ((0x1C >> tone) & 1) ? 48 : 40;
+        return ((slot >> (shift + tonePos)) & 1) ? uksVietnamese : uksMisToned;
+    }
+};
+
+//---------------------------------------------------------------
+// Splits text[from, to) a character at a time, writing the syllables to
+// q. Returns the end of the ones written.
+//---------------------------------------------------------------
+static UkSyllable *splitChars(const UkSyllableTables &tables, const unsigned char *text,
+                              const unsigned char *p, const unsigned char *end, UkSyllable *q)
+{
+    while (p < end) {
+        int n;
+        uint8_t ch = readChar(tables.chars, p, end, n);
+        if (ch == SYL_SEPARATOR) {
+            p += n;
+            continue;
+        }
+
+        const unsigned char *start = p;
+        UkSyllableReader syllable;
+        do {
+            syllable.add(ch);
+            p += n;
+        } while (p < end && (ch = readChar(tables.chars, p, end, n)) != SYL_SEPARATOR);
+
+        q->start = (int)(start - text);
+        q->len = (int)(p - start);
+        q->kind = syllable.kind(tables);
+        q++;
+    }
+    return q;
+}
+
+#ifdef UK_BLOCK
+//---------------------------------------------------------------
+// Text is split a window of 64 bytes at a time: the ASCII separators
+// in it are found from one bit mask, and each run of bytes between them
+// that is a form of tables.forms is a Vietnamese syllable; one of ASCII
+// that is not is no syllable at all, if the forms of ASCII are all
+// there. Other runs, those with separators beyond ASCII in them
+// included, are read a character at a time.
+//---------------------------------------------------------------
+#define SYL_WINDOW 64
+
+// Bit i of sep set if byte i is ASCII and no letter or digit, of high if
+// it is beyond ASCII
+static inline void windowMasks(const unsigned char *p, uint64_t &sep, uint64_t &high)
+{
+    uint64_t kept = 0;
+    high = 0;
+    for (int i = 0; i < SYL_WINDOW / UK_BLOCK; i++) {
+        UkBlock v = UkLoadBlock(p + i * UK_BLOCK);
+        UkBlock alnum = UkOr(UkInRange(v, '0', '9'),
+                             UkOr(UkInRange(v, 'A', 'Z'), UkInRange(v, 'a', 'z')));
+        kept |= (uint64_t)UkHighBits(UkOr(alnum, v)) << (i * UK_BLOCK);
+        high |= (uint64_t)UkHighBits(v) << (i * UK_BLOCK);
+    }
+    sep = ~kept;
+}
+
+// The 8 bytes at p, the first lowest, with 'A'..'Z' lower cased
+static inline uint64_t lowerWord(const unsigned char *p)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    uint64_t ascii = x & (0x7F * ones);
+    uint64_t upper = (ascii + (0x80 - 'A') * ones) & ~(ascii + (0x80 - 'Z' - 1) * ones) &
+        ~x & (0x80 * ones);
+    return x | (upper >> 2);
+}
+
+//---------------------------------------------------------------
+// Splits the windows from p on, while a window and a word more are left
+// before end, writing the syllables to q. p is left at the first byte
+// not split, the start of a syllable or a separator. Returns the end of
+// the syllables written.
+//---------------------------------------------------------------
+static UkSyllable *splitWindows(const UkSyllableTables &tables, const unsigned char *text,
+                                const unsigned char *&p, const unsigned char *end,
+                                UkSyllable *q)
+{
+    const unsigned char *w = p;
+    while (end - w >= SYL_WINDOW + 8) {
+        uint64_t sep, high;
+        windowMasks(w, sep, high);
+        // the byte before w is a separator, or there is none
+        uint64_t starts = ~sep & ((sep << 1) | 1);
+        while (starts) {
+            int s = __builtin_ctzll(starts);
+            uint64_t after = sep & (~0ULL << s);
+            if (!after)
+                break;
+            int e = __builtin_ctzll(after);
+            int len = e - s;
+            uint64_t form = 0;
+            if (len <= 8)
+                form = lowerWord(w + s) & (~0ULL >> (64 - 8 * len));
+            bool found = form && tables.hasForm(form);
+            bool ascii = tables.asciiForms && !(high & (~0ULL << s) & ((1ULL << e) - 1));
+            if (found || ascii) {
+                q->start = (int)(w + s - text);
+                q->len = len;
+                q->kind = found ? uksVietnamese : uksNonVn;
+                q++;
+            } else {
+                q = splitChars(tables, text, w + s, w + e, q);
+            }
+            starts &= starts - 1;
+        }
+
+        if (!starts) {
+            w += SYL_WINDOW;
+            continue;
+        }
+        // a run going on past the window: the next one starts with it,
+        // unless it has the whole window
+        int s = __builtin_ctzll(starts);
+        if (s > 0) {
+            w += s;
+            continue;
+        }
+        const unsigned char *e = w + SYL_WINDOW;
+        while (e < end && (*e >= 0x80 || tables.chars[*e] != SYL_SEPARATOR))
+            e++;
+        q = splitChars(tables, text, w, e, q);
+        w = e;
+    }
+    p = w;
+    return q;
+}
+#endif
+
+//---------------------------------------------------------------
+int UkSplitSyllables(const char *in, int inLen, UkSyllable *out)
+{
+    const UkSyllableTables &tables = syllableTables();
+    const unsigned char *text = (const unsigned char *)in;
+    const unsigned char *p = text;
+    UkSyllable *q = out;
+
+#ifdef UK_BLOCK
+    q = splitWindows(tables, text, p, text + inLen, q);
+#endif
+    q = splitChars(tables, text, p, text + inLen, q);
+    return (int)(q - out);
+}
+
+//---------------------------------------------------------------
+UkSyllableKind UkClassifySyllable(const char *in, int inLen)
+{
+    const UkSyllableTables &tables = syllableTables();
+    const unsigned char *p = (const unsigned char *)in;
+    const unsigned char *end = p + inLen;
+
+    if (p == end)
+        return uksNonVn;
+    UkSyllableReader syllable;
+    while (p < end) {
+        int n;
+        uint8_t ch = readChar(tables.chars, p, end, n);
+        if (ch == SYL_SEPARATOR)
+            return uksNonVn;
+        syllable.add(ch);
+        p += n;
+    }
+    return syllable.kind(tables);
+}
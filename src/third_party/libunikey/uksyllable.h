@@ -0,0 +1,72 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_SYLLABLE_H
+#define __UK_SYLLABLE_H
+
+//----------------------------------------------------------------------
+// Splitting of UTF-8 text into syllables, each told to be Vietnamese or
+// not by the spelling rules of the engine, without typing it through one.
+//
+// A syllable is a run of letters and digits. Blanks, ASCII punctuation,
+// U+0080..U+00BF, U+00D7, U+00F7, U+2000..U+206F, U+3000..U+303F and
+// U+FEFF end it; anything else, invalid UTF-8 included, belongs to it.
+//
+// A syllable is Vietnamese if its letters, lower cased and with the tone
+// left out, are a syllable the engine would spell (see isValidCVC()) and
+// it has at most one tone, on the vowel the engine puts it on, old or
+// modern style, and not huyền, hỏi or ngã after c, ch, p or t. It is
+// mistoned if only its tone breaks these rules: a second tone, or a tone
+// on another letter or one its final consonant does not take. Letters
+// are the precomposed ones of charset.h, and the tone may also follow
+// its vowel as a combining mark, as in composite Unicode.
+//
+// q is only a consonant with the u after it, and gi one before another
+// vowel: "qúa" and "gìa" are mistoned, not q-úa and g-ìa.
+//
+// Syllables are found and told apart with tables of about 600 KB, built
+// once, on first use, and are safe from any thread after that.
+//----------------------------------------------------------------------
+
+enum UkSyllableKind {
+    uksVietnamese,
+    uksNonVn,
+    uksMisToned
+};
+
+// A syllable of the text it was found in: the bytes [start, start + len)
+struct UkSyllable {
+    int start;
+    int len;
+    UkSyllableKind kind;
+};
+
+// Syllables UkSplitSyllables() may find in len bytes, each one and a
+// separator long at the least
+#define UKSYLLABLE_ROOM(len) (((long)(len) + 1) / 2)
+
+// Writes the syllables of in[0, inLen) to out, which has room for
+// UKSYLLABLE_ROOM(inLen) of them, and returns how many there are.
+int UkSplitSyllables(const char *in, int inLen, UkSyllable *out);
+
+// The kind of in[0, inLen) taken as one syllable, uksNonVn if it is empty
+// or has a separator in it.
+UkSyllableKind UkClassifySyllable(const char *in, int inLen);
+
+#endif
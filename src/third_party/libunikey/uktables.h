@@ -0,0 +1,56 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//----------------------------------------------------------------------------
+// Tables derived from the charset tables of data.cpp and the engine tables
+// of ukdata.cpp. uktablegen (gen/uktablegen.cpp) computes them at build
+// time and writes uktables.cpp, so they are const data that needs no
+// setting up when a process starts and whose pages processes share.
+//----------------------------------------------------------------------------
+
+#ifndef __UK_TABLES_H
+#define __UK_TABLES_H
+
+#include "charset.h"
+#include "inputproc.h"
+#include "ukdata.h"
+
+// charset.cpp: the m_stdMap of the charsets, what each byte reads as, and
+// their characters sorted by wideCharCompare() or uniCompInfoCompare(),
+// with the index of each in the high word or in stdIndex
+extern const UKDWORD UnicodeSortedChars[TOTAL_VNCHARS];
+extern const UKWORD SingleByteStdMaps[CONV_TOTAL_SINGLE_CHARSETS][256];
+extern const UKWORD DoubleByteStdMaps[CONV_TOTAL_DOUBLE_CHARSETS][256];
+extern const UKDWORD DoubleByteSortedChars[CONV_TOTAL_DOUBLE_CHARSETS][TOTAL_VNCHARS];
+extern const UKWORD WinCP1258StdMap[256];
+extern const UKDWORD WinCP1258SortedChars[];
+extern const int WinCP1258CharCount;
+extern const UniCompCharInfo UnicodeCompSortedInfo[];
+extern const int UnicodeCompCharCount;
+extern const UKWORD VIQRStdMap[256];
+
+// ukengine.cpp and inputproc.cpp
+extern const VSeqPair SortedVSeqList[];
+extern const CSeqPair SortedCSeqList[];
+extern const VCPair SortedVCPairList[];
+extern const bool IsVnVowel[vnl_lastChar];
+extern const UkCharType UkcMap[256];
+extern const StdVnChar IsoStdVnCharMap[256];
+
+#endif
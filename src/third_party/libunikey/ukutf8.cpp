@@ -0,0 +1,102 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+
+#include "ukutf8.h"
+#include "charset.h"
+
+#define LETTER_TABLE_SIZE 0x2000
+
+//---------------------------------------------------------------
+// Index + 1 in UnicodeTable of the code points of Vietnamese letters,
+// 0 for other code points. Built once, on first use.
+//---------------------------------------------------------------
+struct UkLetterTable {
+    uint8_t index[LETTER_TABLE_SIZE];
+
+    UkLetterTable()
+    {
+        memset(index, 0, sizeof(index));
+        for (int i = 0; i < TOTAL_ALPHA_VNCHARS; i++) {
+            if (UnicodeTable[i] < LETTER_TABLE_SIZE)
+                index[UnicodeTable[i]] = i + 1;
+        }
+    }
+};
+
+//---------------------------------------------------------------
+VnLexiName UkUnicodeToLexi(uint32_t cp)
+{
+    static const UkLetterTable table;
+    if (cp >= LETTER_TABLE_SIZE)
+        return vnl_nonVnChar;
+    return (VnLexiName)(table.index[cp] - 1);
+}
+
+//---------------------------------------------------------------
+int UkReadUtf8(const unsigned char *p, int len, uint32_t &cp)
+{
+    unsigned char c = p[0];
+    int n;
+    if (c < 0x80) {
+        cp = c;
+        return 1;
+    }
+    if (c >= 0xC2 && c < 0xE0) {
+        n = 2;
+        cp = c & 0x1F;
+    } else if (c >= 0xE0 && c < 0xF0) {
+        n = 3;
+        cp = c & 0x0F;
+    } else if (c >= 0xF0 && c < 0xF5) {
+        n = 4;
+        cp = c & 0x07;
+    } else {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    if (n > len) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    for (int i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    return n;
+}
+
+//---------------------------------------------------------------
+void UkWriteUtf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
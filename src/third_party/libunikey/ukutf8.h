@@ -0,0 +1,42 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_UTF8_H
+#define __UK_UTF8_H
+
+#include <stdint.h>
+#include <string>
+#include "vnlexi.h"
+
+//----------------------------------------------------------------------
+// Plain UTF-8 and Unicode letter helpers, for the code that works on
+// UTF-8 text directly instead of through VnConvert. None of them touch
+// global state, so they are safe from any thread.
+//----------------------------------------------------------------------
+
+// Reads the code point at p (len bytes left, at least 1), or 0xFFFD for a
+// byte that does not start one. Returns the bytes read.
+int UkReadUtf8(const unsigned char *p, int len, uint32_t &cp);
+// Appends a code point of the basic plane.
+void UkWriteUtf8(std::string &out, uint32_t cp);
+// The Vietnamese (or Latin) letter of a code point, vnl_nonVnChar for
+// anything else. Precomposed letters only.
+VnLexiName UkUnicodeToLexi(uint32_t cp);
+
+#endif
@@ -0,0 +1,107 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <string.h>
+
+#include "ukwordset.h"
+
+#define UKWORDSET_MIN_SLOTS 64
+
+//0 is the free slot marker, so hash 0 is stored as 1
+#define SLOT_KEY(h) ((h) ? (h) : 1)
+
+//---------------------------------------------------------------
+UkWordSet::UkWordSet()
+{
+    m_slots = 0;
+    m_mask = 0;
+    m_count = 0;
+}
+
+//---------------------------------------------------------------
+UkWordSet::~UkWordSet()
+{
+    delete [] m_slots;
+}
+
+//---------------------------------------------------------------
+void UkWordSet::clear()
+{
+    delete [] m_slots;
+    m_slots = 0;
+    m_mask = 0;
+    m_count = 0;
+}
+
+//---------------------------------------------------------------
+// FNV hashes are well spread in their high bits, so those pick the slot
+//---------------------------------------------------------------
+bool UkWordSet::contains(uint64_t hash) const
+{
+    if (!m_slots)
+        return false;
+
+    uint64_t key = SLOT_KEY(hash);
+    uint32_t i = (uint32_t)(key >> 32) & m_mask;
+    while (m_slots[i] != 0) {
+        if (m_slots[i] == key)
+            return true;
+        i = (i + 1) & m_mask;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------
+void UkWordSet::add(uint64_t hash)
+{
+    //keep the load factor under 1/2
+    if (!m_slots || (uint32_t)(m_count + 1) * 2 > m_mask + 1)
+        grow();
+
+    uint64_t key = SLOT_KEY(hash);
+    uint32_t i = (uint32_t)(key >> 32) & m_mask;
+    while (m_slots[i] != 0) {
+        if (m_slots[i] == key)
+            return;
+        i = (i + 1) & m_mask;
+    }
+    m_slots[i] = key;
+    m_count++;
+}
+
+//---------------------------------------------------------------
+void UkWordSet::grow()
+{
+    uint32_t size = m_slots ? (m_mask + 1) * 2 : UKWORDSET_MIN_SLOTS;
+    uint64_t *old = m_slots;
+    uint32_t oldSize = m_slots ? m_mask + 1 : 0;
+
+    m_slots = new uint64_t[size];
+    memset(m_slots, 0, size * sizeof(uint64_t));
+    m_mask = size - 1;
+
+    for (uint32_t j = 0; j < oldSize; j++) {
+        if (old[j] == 0)
+            continue;
+        uint32_t i = (uint32_t)(old[j] >> 32) & m_mask;
+        while (m_slots[i] != 0)
+            i = (i + 1) & m_mask;
+        m_slots[i] = old[j];
+    }
+    delete [] old;
+}
@@ -0,0 +1,48 @@
+// -*- coding:unix; mode:c++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+/* Unikey Vietnamese Input Method
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __UK_WORD_SET_H
+#define __UK_WORD_SET_H
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------
+// Set of word hashes (see UkBloomHashAdd), open addressing with linear
+// probing. Lookups are a couple of loads; the table is grown on add, which
+// only happens when the user teaches the engine a word.
+//----------------------------------------------------------------------
+class UkWordSet {
+public:
+    UkWordSet();
+    ~UkWordSet();
+
+    void add(uint64_t hash);
+    bool contains(uint64_t hash) const;
+    void clear();
+    int count() const { return m_count; }
+
+protected:
+    void grow();
+
+    uint64_t *m_slots; //0 marks a free slot
+    uint32_t m_mask;
+    int m_count;
+};
+
+#endif
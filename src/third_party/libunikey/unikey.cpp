@@ -28,6 +28,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "unikey.h"
 #include "ukengine.h"
 #include "usrkeymap.h"
+#include "ukdict.h"
+#include "ukbloom.h"
+#include "ukwordset.h"
+#include "ukdiacritic.h"
+#include "ukautomaton.h"
 
 using namespace std;
 
@@ -35,6 +40,11 @@ using namespace std;
 UkSharedMem *pShMem = 0;
 
 UkEngine MyKbEngine;
+UkDictionary MyDictionary;
+UkBloomFilter MyForeignFilter;
+UkWordSet MyLearnedWords;
+UkDiacriticModel MyDiacriticModel;
+UkAutomaton MyAutomaton;
 
 int UnikeyCapsLockOn = 0;
 int UnikeyShiftPressed = 0;
@@ -74,6 +84,8 @@ void UnikeySetCapsState(int shiftPressed, int CapsLockOn)
 int UnikeySetOutputCharset(int charset)
 {
     pShMem->charsetId = charset;
+    // the charsets of the old output are made again if it comes back
+    VnCharsetLibObj.releaseCharsets();
     MyKbEngine.reset();
     return 1;
 }
@@ -81,6 +93,7 @@ int UnikeySetOutputCharset(int charset)
 //--------------------------------------------
 void UnikeySetOptions(UnikeyOptions *pOpt)
 {
+  MyKbEngine.leaveAutomaton();
   pShMem->options.freeMarking = pOpt->freeMarking;
   pShMem->options.modernStyle = pOpt->modernStyle;
   pShMem->options.macroEnabled = pOpt->macroEnabled;
@@ -118,7 +131,6 @@ void UnikeyCheckKbCase(int *pShiftPressed, int *pCapsLockOn)
 //--------------------------------------------
 void UnikeySetup()
 {
-    SetupUnikeyEngine();
     pShMem = new UkSharedMem;
     pShMem->input.init();
     pShMem->macStore.init();
@@ -126,6 +138,10 @@ void UnikeySetup()
     pShMem->usrKeyMapLoaded = 0;
     MyKbEngine.setCtrlInfo(pShMem);
     MyKbEngine.setCheckKbCaseFunc(&UnikeyCheckKbCase);
+    MyKbEngine.setDictionary(&MyDictionary);
+    MyKbEngine.setForeignFilter(&MyForeignFilter);
+    MyKbEngine.setLearnedWords(&MyLearnedWords);
+    MyKbEngine.setAutomaton(&MyAutomaton);
     UnikeySetInputMethod(UkTelex);
     UnikeySetOutputCharset(CONV_CHARSET_XUTF8);
     pShMem->initialized = 1;
@@ -135,6 +151,13 @@ void UnikeySetup()
 //--------------------------------------------
 void UnikeyCleanup()
 {
+  MyDictionary.unload();
+  MyForeignFilter.unload();
+  MyLearnedWords.clear();
+  MyDiacriticModel.unload();
+  MyKbEngine.leaveAutomaton();
+  MyAutomaton.unload();
+  VnCharsetLibObj.releaseCharsets();
   delete pShMem;
 }
 
@@ -179,6 +202,101 @@ int UnikeyLoadMacroTable(const char *fileName)
   return pShMem->macStore.loadFromFile(fileName);
 }
 
+//--------------------------------------------
+int UnikeyLoadSystemMacroTable(const char *fileName)
+{
+  return pShMem->macStore.loadSharedFile(fileName);
+}
+
+//--------------------------------------------
+int UnikeyLoadDictionary(const char *fileName)
+{
+  MyKbEngine.leaveAutomaton();
+  return MyDictionary.load(fileName);
+}
+
+//--------------------------------------------
+void UnikeyUnloadDictionary()
+{
+  MyKbEngine.leaveAutomaton();
+  MyDictionary.unload();
+}
+
+//--------------------------------------------
+int UnikeyLoadForeignFilter(const char *fileName)
+{
+  MyKbEngine.leaveAutomaton();
+  return MyForeignFilter.load(fileName);
+}
+
+//--------------------------------------------
+void UnikeyUnloadForeignFilter()
+{
+  MyKbEngine.leaveAutomaton();
+  MyForeignFilter.unload();
+}
+
+//--------------------------------------------
+unsigned long long UnikeyLastWordKeyHash()
+{
+  return MyKbEngine.lastWordKeyHash();
+}
+
+//--------------------------------------------
+void UnikeyAddLearnedWord(unsigned long long keyHash)
+{
+  MyKbEngine.leaveAutomaton();
+  MyLearnedWords.add(keyHash);
+}
+
+//--------------------------------------------
+void UnikeyClearLearnedWords()
+{
+  MyKbEngine.leaveAutomaton();
+  MyLearnedWords.clear();
+}
+
+//--------------------------------------------
+int UnikeyLoadDiacriticModel(const char *fileName)
+{
+  return MyDiacriticModel.load(fileName);
+}
+
+//--------------------------------------------
+void UnikeyUnloadDiacriticModel()
+{
+  MyDiacriticModel.unload();
+}
+
+//--------------------------------------------
+int UnikeyRestoreDiacritics(const char *context, const char *text,
+                            char *out, int outSize)
+{
+  if (!MyDiacriticModel.isLoaded())
+    return -1;
+
+  string restored;
+  MyDiacriticModel.restore(text, strlen(text), restored, context);
+  if ((int)restored.size() >= outSize)
+    return -1;
+  memcpy(out, restored.c_str(), restored.size() + 1);
+  return restored.size();
+}
+
+//--------------------------------------------
+int UnikeyLoadAutomaton(const char *fileName)
+{
+  MyKbEngine.leaveAutomaton();
+  return MyAutomaton.load(fileName);
+}
+
+//--------------------------------------------
+void UnikeyUnloadAutomaton()
+{
+  MyKbEngine.leaveAutomaton();
+  MyAutomaton.unload();
+}
+
 //--------------------------------------------
 int UnikeyLoadUserKeyMap(const char *fileName)
 {
@@ -202,3 +320,8 @@ bool UnikeyAtWordBeginning()
     return MyKbEngine.atWordBeginning();
 }
 
+int UnikeySettlePrefix()
+{
+    return MyKbEngine.settlePrefix();
+}
+
@@ -103,14 +103,60 @@ extern "C" {
   int UnikeySetOutputCharset(int charset);
 
   int UnikeyLoadMacroTable(const char *fileName);
+  // load the macros of the host, which the user's own macros override.
+  // The table is mapped from shared memory, so all sessions on the host
+  // share one copy of it (see ukshm.h).
+  int UnikeyLoadSystemMacroTable(const char *fileName);
   int UnikeyLoadUserKeyMap(const char *fileName);
 
+  // load a syllable dictionary made by ibus-unikey-dict. While one is
+  // loaded, auto restore also restores words that are not in it.
+  int UnikeyLoadDictionary(const char *fileName);
+  void UnikeyUnloadDictionary();
+
+  // load a filter of foreign (English) words made by ibus-unikey-dict.
+  // While one is loaded, auto restore gives back all the key strokes of
+  // the words in it that it restores, like the second s of "class".
+  // Vietnamese syllables are left as they are.
+  int UnikeyLoadForeignFilter(const char *fileName);
+  void UnikeyUnloadForeignFilter();
+
+  // words whose key strokes the user keeps restoring are learned: they
+  // are given back as typed at word end from then on, even Vietnamese
+  // syllables like "car" for "cả". A word is known by the hash of its key
+  // strokes; 0 means there is no word being typed.
+  unsigned long long UnikeyLastWordKeyHash();
+  void UnikeyAddLearnedWord(unsigned long long keyHash);
+  void UnikeyClearLearnedWords();
+
+  // load a syllable bigram model made by ibus-unikey-diacritics, for
+  // putting the tones and marks back into text typed without them.
+  int UnikeyLoadDiacriticModel(const char *fileName);
+  void UnikeyUnloadDiacriticModel();
+  // writes the UTF-8 text with its diacritics restored into out, null
+  // terminated. context (may be 0) is the text just before it. Returns the
+  // length written, or -1 if no model is loaded or out is too small.
+  int UnikeyRestoreDiacritics(const char *context, const char *text,
+                              char *out, int outSize);
+
+  // load a table of the engine made by ibus-unikey-automaton. While the
+  // input method, output charset and options are the ones it was made
+  // for, the keys of syllables are looked up in it instead of being run
+  // through the engine; the output is the same.
+  int UnikeyLoadAutomaton(const char *fileName);
+  void UnikeyUnloadAutomaton();
+
   //call this to enable typing vietnamese even in a non-vn sequence
   //e.g: GD&DDT,QDDND...
   //The engine will return to normal mode when a word-break occurs.
   void UnikeySetSingleMode();
 
   bool UnikeyAtWordBeginning();
+
+  // call this to let the engine forget the output before the word being
+  // typed, so that it can be committed. Returns the number of characters
+  // (backspaces) still owned by the engine, or -1 if it keeps everything.
+  int UnikeySettlePrefix();
 #if defined(__cplusplus)
 }
 #endif
@@ -24,7 +24,8 @@
 #ifndef __VN_LEXI_H
 #define __VN_LEXI_H
 
-enum VnLexiName {
+//the engine keeps these in its buffers, so they are stored narrow
+enum VnLexiName : short {
   vnl_nonVnChar = -1,
   vnl_A, vnl_a, vnl_A1, vnl_a1, vnl_A2, vnl_a2, vnl_A3, vnl_a3, vnl_A4, vnl_a4, vnl_A5, vnl_a5,
   vnl_Ar, vnl_ar, vnl_Ar1, vnl_ar1, vnl_Ar2, vnl_ar2, vnl_Ar3, vnl_ar3, vnl_Ar4, vnl_ar4, vnl_Ar5, vnl_ar5,
@@ -49,7 +50,7 @@ enum VnLexiName {
   vnl_lastChar,
 };
 
-enum VowelSeq {
+enum VowelSeq : signed char {
   vs_nil = -1,
   vs_a,
   vs_ar,
@@ -123,7 +124,7 @@ enum VowelSeq {
   vs_yeru
 };
 
-enum ConSeq {
+enum ConSeq : signed char {
   cs_nil = -1,
   cs_b,
   cs_c,
@@ -0,0 +1,239 @@
+#include "unix/ibus/completion_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "third_party/libunikey/ukfold.h"
+
+
+namespace {
+
+const uint32_t kMaxLeafCount = 1u << 28;
+// Longer text has nothing to complete, it is not looked up.
+const size_t kMaxTypedSize = 256;
+
+// Negative if |key| sorts before every key starting with |prefix|, zero if
+// it starts with |prefix|, positive if it sorts after them.
+int ComparePrefix(const char *key, size_t key_size,
+                  const char *prefix, size_t size) {
+    int ret = memcmp(key, prefix, std::min(key_size, size));
+    if (ret != 0) {
+        return ret;
+    }
+    return key_size < size ? -1 : 0;
+}
+
+// Item |i| of |data|, |size| bytes long, as cut by |offset|. The offsets
+// are checked here rather than all at load, which would read a good part
+// of the file in; an item out of bounds is empty.
+const char *Item(const char *data, uint32_t size, const uint32_t *offset,
+                 uint32_t i, size_t *length) {
+    uint32_t begin = offset[i];
+    uint32_t end = offset[i + 1];
+    if (begin > end || end > size) {
+        *length = 0;
+        return data;
+    }
+    *length = end - begin;
+    return data + begin;
+}
+
+
+}  // namespace
+
+
+CompletionIndex::CompletionIndex()
+    : file_(nullptr),
+      entry_count_(0),
+      leaf_count_(0),
+      key_size_(0),
+      word_size_(0),
+      key_offset_(nullptr),
+      word_offset_(nullptr),
+      score_(nullptr),
+      best_(nullptr),
+      keys_(nullptr),
+      words_(nullptr) {
+}
+
+CompletionIndex::~CompletionIndex() {
+    Unload();
+}
+
+bool CompletionIndex::Load(const char *path) {
+    Unload();
+
+    GMappedFile *file = g_mapped_file_new(path, FALSE, nullptr);
+    if (file == nullptr) {
+        return false;
+    }
+
+    const size_t length = g_mapped_file_get_length(file);
+    const char *data = g_mapped_file_get_contents(file);
+    const CompletionHeader *header = reinterpret_cast<const CompletionHeader*>(data);
+    if (length < sizeof(CompletionHeader) ||
+        memcmp(header->magic, kCompletionMagic, sizeof(header->magic)) != 0 ||
+        header->entry_count == 0 ||
+        header->leaf_count < header->entry_count ||
+        header->leaf_count > kMaxLeafCount ||
+        (header->leaf_count & (header->leaf_count - 1)) != 0) {
+        g_mapped_file_unref(file);
+        return false;
+    }
+
+    const size_t n = header->entry_count;
+    const size_t expected = sizeof(CompletionHeader) +
+        (3 * n + 2 + header->leaf_count) * sizeof(uint32_t) +
+        header->key_size + header->word_size;
+    const uint32_t *key_offset = reinterpret_cast<const uint32_t*>(header + 1);
+    const uint32_t *word_offset = key_offset + n + 1;
+    if (length != expected) {
+        g_mapped_file_unref(file);
+        return false;
+    }
+
+    file_ = file;
+    entry_count_ = header->entry_count;
+    leaf_count_ = header->leaf_count;
+    key_size_ = header->key_size;
+    word_size_ = header->word_size;
+    key_offset_ = key_offset;
+    word_offset_ = word_offset;
+    score_ = word_offset_ + n + 1;
+    best_ = score_ + n;
+    keys_ = reinterpret_cast<const char*>(best_ + leaf_count_);
+    words_ = keys_ + header->key_size;
+    return true;
+}
+
+void CompletionIndex::Unload() {
+    if (file_) {
+        g_mapped_file_unref(file_);
+    }
+    file_ = nullptr;
+    entry_count_ = 0;
+    leaf_count_ = 0;
+    key_size_ = 0;
+    word_size_ = 0;
+    key_offset_ = nullptr;
+    word_offset_ = nullptr;
+    score_ = nullptr;
+    best_ = nullptr;
+    keys_ = nullptr;
+    words_ = nullptr;
+}
+
+// static
+std::string CompletionIndex::Normalize(const char *text) {
+    gchar *nfc = g_utf8_normalize(text, -1, G_NORMALIZE_NFC);
+    if (nfc == nullptr) {
+        return std::string();
+    }
+    gchar *lower = g_utf8_strdown(nfc, -1);
+    std::string normalized(lower);
+    g_free(lower);
+    g_free(nfc);
+    return normalized;
+}
+
+// static
+std::string CompletionIndex::MakeKey(const char *text) {
+    const std::string normalized = Normalize(text);
+    std::string key(normalized.size(), '\0');
+    key.resize(UkFoldUtf8(normalized.data(), (int)normalized.size(), &key[0],
+                          UKFOLD_CASE | UKFOLD_TONES));
+    return key;
+}
+
+uint32_t CompletionIndex::Bound(const char *prefix, size_t size,
+                                bool or_equal) const {
+    uint32_t lo = 0;
+    uint32_t hi = entry_count_;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        size_t key_size;
+        const char *key = Item(keys_, key_size_, key_offset_, mid, &key_size);
+        int ret = ComparePrefix(key, key_size, prefix, size);
+        if (or_equal ? ret < 0 : ret <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint32_t CompletionIndex::BestEntry(uint32_t node) const {
+    uint32_t entry = node >= leaf_count_ ? node - leaf_count_ : best_[node];
+    return entry < entry_count_ ? entry : kCompletionNone;
+}
+
+// The heap is ordered by score, then by key, so equal scores come out in
+// alphabetical order.
+// static
+bool CompletionIndex::Worse(const Node &a, const Node &b) {
+    return a.score < b.score || (a.score == b.score && a.entry > b.entry);
+}
+
+void CompletionIndex::Push(uint32_t node, std::vector<Node> *heap) const {
+    uint32_t entry = BestEntry(node);
+    if (entry == kCompletionNone) {
+        return;
+    }
+
+    Node item = { score_[entry], entry, node };
+    heap->push_back(item);
+    std::push_heap(heap->begin(), heap->end(), Worse);
+}
+
+void CompletionIndex::Complete(const char *typed, size_t max_count,
+                               std::vector<Candidate> *out) {
+    out->clear();
+    const size_t typed_size = strlen(typed);
+    if (!loaded() || max_count == 0 || typed_size == 0 ||
+        typed_size > kMaxTypedSize) {
+        return;
+    }
+
+    // Entries hold lower case words, found by their keys without tones.
+    char lower[kMaxTypedSize];
+    char key[kMaxTypedSize];
+    const size_t lower_size = UkFoldUtf8(typed, (int)typed_size, lower, UKFOLD_CASE);
+    const size_t key_size = UkFoldUtf8(lower, (int)lower_size, key, UKFOLD_TONES);
+    const uint32_t first = Bound(key, key_size, true);
+    const uint32_t last = Bound(key, key_size, false);
+    if (first >= last) {
+        return;
+    }
+
+    // Seeds the heap with the O(log n) subtrees covering [first, last), then
+    // always opens the best one: every popped leaf is the best entry left.
+    heap_.clear();
+    for (uint32_t l = first + leaf_count_, r = last + leaf_count_; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) {
+            Push(l++, &heap_);
+        }
+        if (r & 1) {
+            Push(--r, &heap_);
+        }
+    }
+
+    while (!heap_.empty() && out->size() < max_count) {
+        std::pop_heap(heap_.begin(), heap_.end(), Worse);
+        Node top = heap_.back();
+        heap_.pop_back();
+
+        if (top.node < leaf_count_) {
+            Push(2 * top.node, &heap_);
+            Push(2 * top.node + 1, &heap_);
+            continue;
+        }
+
+        size_t size;
+        const char *text = Item(words_, word_size_, word_offset_, top.entry, &size);
+        if (size != 0 && (size != lower_size || memcmp(text, lower, size) != 0)) {
+            Candidate candidate = { text, size, top.score };
+            out->push_back(candidate);
+        }
+    }
+}
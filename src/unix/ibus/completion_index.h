@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "base/port.h"
+
+
+// Words and phrases ranked by frequency, for completing the word being
+// typed. The file is mapped read-only, so it costs no heap however large it
+// is. ibus-unikey-dict builds it.
+//
+// Entries are looked up by a key without tones (see MakeKey): tones are
+// typed last, so "ngươ" is to find "người". Completing folds the typed
+// text into a buffer on the stack and reuses its heap, so it allocates
+// nothing once warm. Keys are sorted, so all entries
+// starting with a prefix are one range, found by binary search: the leaves
+// of a trie, in order. Over the scores lies a tournament tree, each inner
+// node holding the best entry below it, which yields the best k entries of
+// any range in O(k log n), whatever the size of the range.
+//
+// File layout, all numbers in host byte order:
+//   CompletionHeader
+//   uint32_t key_offset[entry_count + 1]   key i is keys[key_offset[i],
+//                                          key_offset[i + 1]), sorted
+//                                          bytewise
+//   uint32_t word_offset[entry_count + 1]  the same into words
+//   uint32_t score[entry_count]
+//   uint32_t best[leaf_count]              best[i], 0 < i < leaf_count, is
+//                                          the entry of inner node i, or
+//                                          kCompletionNone; node i >=
+//                                          leaf_count is entry i - leaf_count
+//   char keys[key_size]
+//   char words[word_size]                  lower case NFC UTF-8
+struct CompletionHeader {
+    char magic[8];
+    uint32_t entry_count;
+    uint32_t leaf_count;  // power of two, at least entry_count
+    uint32_t key_size;
+    uint32_t word_size;
+};
+
+const char kCompletionMagic[] = "UKCOMP1";
+const uint32_t kCompletionNone = 0xFFFFFFFF;
+
+class CompletionIndex {
+public:
+    struct Candidate {
+        const char *text;  // not null terminated
+        size_t size;
+        uint32_t score;
+    };
+
+    CompletionIndex();
+    ~CompletionIndex();
+
+    bool Load(const char *path);
+    void Unload();
+    bool loaded() const { return file_ != nullptr; }
+    size_t size() const { return entry_count_; }
+
+    // Replaces |out| with the at most |max_count| best entries whose key
+    // starts with the key of |typed|, best first, leaving out |typed|
+    // itself. |typed| is precomposed UTF-8, as libunikey writes it.
+    void Complete(const char *typed, size_t max_count,
+                  std::vector<Candidate> *out);
+
+    // Lower case NFC.
+    static std::string Normalize(const char *text);
+    // Normalize() without the tones, as UkFoldUtf8() with UKFOLD_CASE and
+    // UKFOLD_TONES leaves it.
+    static std::string MakeKey(const char *text);
+
+private:
+    struct Node {
+        uint32_t score;
+        uint32_t entry;
+        uint32_t node;
+    };
+
+    // First entry whose key, cut to |size| bytes, compares above |prefix|,
+    // or at or above it if |or_equal|.
+    uint32_t Bound(const char *prefix, size_t size, bool or_equal) const;
+    // Best entry under tree node |node|, or kCompletionNone.
+    uint32_t BestEntry(uint32_t node) const;
+    void Push(uint32_t node, std::vector<Node> *heap) const;
+    static bool Worse(const Node &a, const Node &b);
+
+    // The heap of Complete(), kept for its capacity.
+    std::vector<Node> heap_;
+
+    GMappedFile *file_;
+    uint32_t entry_count_;
+    uint32_t leaf_count_;
+    uint32_t key_size_;
+    uint32_t word_size_;
+    const uint32_t *key_offset_;
+    const uint32_t *word_offset_;
+    const uint32_t *score_;
+    const uint32_t *best_;
+    const char *keys_;
+    const char *words_;
+
+    DISALLOW_COPY_AND_ASSIGN(CompletionIndex);
+};
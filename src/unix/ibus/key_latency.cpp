@@ -0,0 +1,153 @@
+#include "unix/ibus/key_latency.h"
+
+#include <csignal>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "base/logging.h"
+#include "base/singleton.h"
+
+
+namespace {
+
+gboolean DumpOnSignal(gpointer user_data) {
+    Singleton<KeyLatency>::get()->StartOrDump();
+    return G_SOURCE_CONTINUE;
+}
+
+}  // namespace
+
+
+KeyLatency::KeyLatency()
+    : enabled_(false),
+      stage_(WRAPPER),
+      key_start_(0),
+      stage_start_(0),
+      start_ticks_(Ticks()),
+      start_ns_(Now()) {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_time_[i] = 0;
+    }
+}
+
+uint64_t KeyLatency::Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return Now();
+#endif
+}
+
+uint64_t KeyLatency::Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void KeyLatency::BeginKey() {
+    stage_ = WRAPPER;
+    if (!enabled_) {
+        return;
+    }
+
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_time_[i] = 0;
+    }
+    key_start_ = stage_start_ = Ticks();
+}
+
+void KeyLatency::EndKey() {
+    if (!enabled_) {
+        return;
+    }
+
+    uint64_t now = Ticks();
+    stage_time_[stage_] += now - stage_start_;
+    total_.Record(now - key_start_);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stages_[i].Record(stage_time_[i]);
+    }
+}
+
+KeyLatency::Stage KeyLatency::Enter(Stage stage) {
+    Stage previous = stage_;
+    if (enabled_) {
+        uint64_t now = Ticks();
+        stage_time_[stage_] += now - stage_start_;
+        stage_start_ = now;
+    }
+    stage_ = stage;
+    return previous;
+}
+
+double KeyLatency::NanosecondsPerTick() const {
+    uint64_t ticks = Ticks() - start_ticks_;
+    uint64_t ns = Now() - start_ns_;
+    return ticks > 0 ? (double)ns / ticks : 1.0;
+}
+
+void KeyLatency::Write(FILE *out) const {
+    double scale = NanosecondsPerTick();
+    fprintf(out, "# ibus-unikey key latency, nanoseconds\n");
+    total_.Write(out, "total", scale);
+    stages_[ENGINE].Write(out, "engine", scale);
+    stages_[IBUS].Write(out, "ibus", scale);
+    stages_[WRAPPER].Write(out, "wrapper", scale);
+}
+
+void KeyLatency::StartOrDump() {
+    if (!enabled_) {
+        enabled_ = true;
+        BLOG_INFO("Key latency recording started");
+        return;
+    }
+
+    const std::string path = DefaultDumpPath();
+    if (Dump(path)) {
+        BLOG_INFO("Key latency written to {}", path);
+    }
+}
+
+bool KeyLatency::Dump(const std::string &path) const {
+    FILE *out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        BLOG_ERROR("Cannot write key latency to {}: {}", path, strerror(errno));
+        return false;
+    }
+
+    Write(out);
+    fclose(out);
+    return true;
+}
+
+std::string KeyLatency::DefaultDumpPath() {
+    gchar *dir = g_build_filename(g_get_user_cache_dir(), "ibus-unikey", nullptr);
+    g_mkdir_with_parents(dir, 0700);
+    gchar *file = g_build_filename(dir, "latency.txt", nullptr);
+
+    std::string path(file);
+    g_free(file);
+    g_free(dir);
+    return path;
+}
+
+void KeyLatency::InstallSignalHandler() {
+    g_unix_signal_add(SIGUSR1, DumpOnSignal, nullptr);
+}
+
+
+ScopedLatency::ScopedLatency(KeyLatency::Stage stage)
+    : latency_(Singleton<KeyLatency>::get()),
+      previous_(latency_->Enter(stage)) {
+}
+
+ScopedLatency::~ScopedLatency() {
+    latency_->Enter(previous_);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "base/histogram.h"
+#include "base/port.h"
+
+
+// Per key latency of the engine, split into the time spent in libunikey,
+// in IBus calls and in the wrapper around them. A key moves from stage to
+// stage, and every move costs one read of the time stamp counter (rdtsc,
+// clock_gettime where there is none) and no atomic operation; a key is
+// recorded into the histograms once, at its end. A printable key makes
+// about eight reads, so the cost depends on the machine: run
+// ibus-unikey-headless-driver with and without --no-latency to see it.
+//
+// That is more than a key may spend on being watched, so the timing is off
+// until asked for: the first SIGUSR1 or use of the Tools menu entry turns it
+// on, the next ones write the histograms out. Off, a stage move is a store.
+class KeyLatency {
+public:
+    enum Stage {
+        WRAPPER,
+        ENGINE,
+        IBUS,
+        STAGE_COUNT,
+    };
+
+    KeyLatency();
+
+    void BeginKey();
+    void EndKey();
+    // Moves the current key to |stage| and returns the stage it was in.
+    Stage Enter(Stage stage);
+
+    // Turns the clock reads on or off.
+    void SetEnabled(bool enabled) { enabled_ = enabled; }
+    // Turns the timing on if it is off, otherwise dumps to
+    // DefaultDumpPath(): what SIGUSR1 and the Tools menu entry do.
+    void StartOrDump();
+
+    // Writes all histograms to |out| or |path|, in nanoseconds.
+    void Write(FILE *out) const;
+    bool Dump(const std::string &path) const;
+    // $XDG_CACHE_HOME/ibus-unikey/latency.txt
+    static std::string DefaultDumpPath();
+
+    // Calls StartOrDump() whenever SIGUSR1 is received.
+    static void InstallSignalHandler();
+
+    // Ticks of the clock the stages are timed with, and the CLOCK_MONOTONIC
+    // nanoseconds it is calibrated against when writing.
+    static uint64_t Ticks();
+    static uint64_t Now();
+
+private:
+    // The histograms are in ticks; nanoseconds per tick since construction.
+    double NanosecondsPerTick() const;
+
+    Histogram total_;
+    Histogram stages_[STAGE_COUNT];
+
+    bool enabled_;
+    Stage stage_;
+    uint64_t key_start_;
+    uint64_t stage_start_;
+    uint64_t stage_time_[STAGE_COUNT];
+    uint64_t start_ticks_;
+    uint64_t start_ns_;
+
+    DISALLOW_COPY_AND_ASSIGN(KeyLatency);
+};
+
+// Puts the current key in a stage for the lifetime of the object.
+class ScopedLatency {
+public:
+    explicit ScopedLatency(KeyLatency::Stage stage);
+    ~ScopedLatency();
+
+private:
+    KeyLatency *latency_;
+    KeyLatency::Stage previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedLatency);
+};
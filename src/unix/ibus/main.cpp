@@ -5,6 +5,7 @@
 #include "base/logging.h"
 #include "base/version.h"
 
+#include "unix/ibus/key_latency.h"
 #include "unix/ibus/unikey_engine.h"
 
 namespace {
@@ -73,6 +74,7 @@ int main(gint argc, gchar **argv) {
     BLOG_DEBUG("main started");
     ibus_init();
     InitIBusComponent(true);
+    KeyLatency::InstallSignalHandler();
     ibus_main();
     return 0;
 }
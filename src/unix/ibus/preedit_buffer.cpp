@@ -0,0 +1,106 @@
+#include "unix/ibus/preedit_buffer.h"
+
+#include <cstring>
+
+
+PreeditBuffer::PreeditBuffer()
+    : data_(inline_data_),
+      offsets_(inline_offsets_),
+      capacity_(kInlineSize),
+      length_(0) {
+    data_[0] = '\0';
+    offsets_[0] = 0;
+}
+
+// Makes room for |size| bytes holding |length| characters. Both are bounded
+// by the same capacity since a character takes at least one byte.
+void PreeditBuffer::Reserve(size_t size, size_t length) {
+    if (size <= capacity_ && length <= capacity_) {
+        return;
+    }
+
+    size_t capacity = capacity_;
+    while (capacity < size || capacity < length) {
+        capacity *= 2;
+    }
+
+    gchar *data = new gchar[capacity + 1];
+    guint *offsets = new guint[capacity + 1];
+    memcpy(data, data_, this->size() + 1);
+    memcpy(offsets, offsets_, (length_ + 1) * sizeof(guint));
+
+    heap_data_.reset(data);
+    heap_offsets_.reset(offsets);
+    data_ = data;
+    offsets_ = offsets;
+    capacity_ = capacity;
+}
+
+void PreeditBuffer::PushChar(const gchar *utf8, size_t size) {
+    size_t end = this->size();
+    memcpy(data_ + end, utf8, size);
+    data_[end + size] = '\0';
+    offsets_[++length_] = end + size;
+}
+
+void PreeditBuffer::Append(const gchar *utf8, size_t size) {
+    Reserve(this->size() + size, length_ + size);
+
+    size_t start = 0;
+    for (size_t i = 1; i <= size; i++) {
+        // a character ends where the next one starts, or at the end
+        if (i == size || ((guchar)utf8[i] & 0xC0) != 0x80) {
+            PushChar(utf8 + start, i - start);
+            start = i;
+        }
+    }
+}
+
+void PreeditBuffer::AppendLatin(const guchar *latin, size_t size) {
+    Reserve(this->size() + size * 2, length_ + size);
+
+    gchar utf8[2];
+    for (size_t i = 0; i < size; i++) {
+        guchar ch = latin[i];
+        if (ch < 0x80) {
+            utf8[0] = ch;
+            PushChar(utf8, 1);
+        } else {
+            utf8[0] = 0xC0 | (ch >> 6);
+            utf8[1] = 0x80 | (ch & 0x3F);
+            PushChar(utf8, 2);
+        }
+    }
+}
+
+void PreeditBuffer::AppendUnichar(gunichar ch) {
+    gchar utf8[6];
+    gint size = g_unichar_to_utf8(ch, utf8);
+
+    Reserve(this->size() + size, length_ + 1);
+    PushChar(utf8, size);
+}
+
+void PreeditBuffer::EraseChars(size_t num_chars) {
+    length_ -= (num_chars < length_) ? num_chars : length_;
+    data_[offsets_[length_]] = '\0';
+}
+
+void PreeditBuffer::ErasePrefix(size_t num_chars) {
+    if (num_chars >= length_) {
+        Clear();
+        return;
+    }
+
+    size_t shift = offsets_[num_chars];
+    memmove(data_, data_ + shift, size() - shift + 1);
+    for (size_t i = num_chars; i <= length_; i++) {
+        offsets_[i - num_chars] = offsets_[i] - shift;
+    }
+    length_ -= num_chars;
+}
+
+void PreeditBuffer::Clear() {
+    length_ = 0;
+    data_[0] = '\0';
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <glib.h>
+
+#include "base/port.h"
+
+
+// UTF-8 text of the preedit, with the byte offset of every character kept
+// alongside so that characters can be dropped from either end without
+// scanning. Short words live in inline storage and need no heap allocation.
+class PreeditBuffer {
+public:
+    PreeditBuffer();
+    ~PreeditBuffer() {}
+
+    // |utf8| must hold whole characters.
+    void Append(const gchar *utf8, size_t size);
+    // Appends single byte charset output, one character per byte.
+    void AppendLatin(const guchar *latin, size_t size);
+    void AppendUnichar(gunichar ch);
+
+    // Drops the last |num_chars| characters.
+    void EraseChars(size_t num_chars);
+    // Drops the first |num_chars| characters.
+    void ErasePrefix(size_t num_chars);
+    void Clear();
+
+    // Byte offset of the character at |index|, or size() past the end.
+    size_t Offset(size_t index) const {
+        return offsets_[index < length_ ? index : length_];
+    }
+
+    const gchar *c_str() const { return data_; }
+    size_t size() const { return offsets_[length_]; }
+    size_t length() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    // Last byte of the buffer, '\0' when empty.
+    gchar back() const { return empty() ? '\0' : data_[size() - 1]; }
+
+private:
+    static const size_t kInlineSize = 64;
+
+    void Reserve(size_t size, size_t length);
+    void PushChar(const gchar *utf8, size_t size);
+
+    gchar inline_data_[kInlineSize + 1];
+    guint inline_offsets_[kInlineSize + 1];
+    std::unique_ptr<gchar[]> heap_data_;
+    std::unique_ptr<guint[]> heap_offsets_;
+
+    gchar *data_;
+    // offsets_[i] is where character i starts, offsets_[length_] == size().
+    guint *offsets_;
+    size_t capacity_;
+    size_t length_;
+
+    DISALLOW_COPY_AND_ASSIGN(PreeditBuffer);
+};
@@ -6,6 +6,7 @@
 #include "base/singleton.h"
 #include "base/logging.h"
 
+#include "unix/ibus/key_latency.h"
 #include "unix/ibus/unikey_engine_property.h"
 #include "unix/ibus/unikey_wrapper.h"
 
@@ -17,6 +18,7 @@ const char kGObjectDataKey[] = "ibus-unikey-aux-data";
 const gchar kIBusUnikeySchema[] = "org.freedesktop.ibus.engine.unikey";
 const gchar kInputMethodConfig[] = "input-method";
 const gchar kOutputCharsetConfig[] = "output-charset";
+const gchar kKeyLatencyToolMode[] = "key_latency";
 
 
 bool GetDisabled(IBusEngine *engine) {
@@ -78,8 +80,32 @@ PropertyHandler::PropertyHandler()
             prop_output_charset_(nullptr),
             prop_unikey_option_(nullptr),
             prop_unikey_tool_(nullptr),
-            is_disabled_(false) {
+            is_disabled_(false),
+            settings_(nullptr),
+            settings_observer_id_(0),
+            panel_source_id_(0),
+            pending_engine_(nullptr) {
     BLOG_DEBUG("PropertyHandler constructor start");
+    // We have to sink |prop_root_| as well so ibus_engine_register_properties()
+    // in FocusIn() does not destruct it.
+    g_object_ref_sink(prop_root_);
+
+    // Reading GSettings and building the panel are left to the main loop
+    // once it is idle, so they do not delay the first focus and key events
+    // of a freshly spawned engine.
+    panel_source_id_ = g_idle_add(BuildPanelOnIdle, this);
+    BLOG_DEBUG("PropertyHandler constructor end");
+}
+
+gboolean PropertyHandler::BuildPanelOnIdle(gpointer user_data) {
+    PropertyHandler *self = reinterpret_cast<PropertyHandler*>(user_data);
+    self->panel_source_id_ = 0;
+    self->BuildPanel();
+    return G_SOURCE_REMOVE;
+}
+
+void PropertyHandler::BuildPanel() {
+    BLOG_DEBUG("BuildPanel start");
     settings_ = g_settings_new(kIBusUnikeySchema);
     settings_observer_id_ = g_signal_connect(
         settings_,
@@ -92,14 +118,25 @@ PropertyHandler::PropertyHandler()
     AppendOptionPropertyToPanel();
     AppendToolPropertyToPanel();
 
-    // We have to sink |prop_root_| as well so ibus_engine_register_properties()
-    // in FocusIn() does not destruct it.
-    g_object_ref_sink(prop_root_);
-    BLOG_DEBUG("PropertyHandler constructor end");
+    if (pending_engine_) {
+        Register(pending_engine_);
+        g_object_unref(pending_engine_);
+        pending_engine_ = nullptr;
+    }
+    BLOG_DEBUG("BuildPanel end");
 }
 
 PropertyHandler::~PropertyHandler() {
     BLOG_DEBUG("PropertyHandler destructor");
+    if (panel_source_id_ != 0) {
+        g_source_remove(panel_source_id_);
+    }
+
+    if (pending_engine_) {
+        g_object_unref(pending_engine_);
+        pending_engine_ = nullptr;
+    }
+
     if (settings_ != nullptr) {
         if (settings_observer_id_ != 0) {
             g_signal_handler_disconnect(settings_, settings_observer_id_);
@@ -135,6 +172,18 @@ PropertyHandler::~PropertyHandler() {
 
 void PropertyHandler::Register(IBusEngine *engine) {
     BLOG_DEBUG("Register start");
+    if (panel_source_id_ != 0) {
+        // The panel is not built yet, it gets registered once it is.
+        if (pending_engine_ != engine) {
+            if (pending_engine_) {
+                g_object_unref(pending_engine_);
+            }
+            pending_engine_ = engine;
+            g_object_ref(pending_engine_);
+        }
+        return;
+    }
+
     ibus_engine_register_properties(engine, prop_root_);
     UpdateContentType(engine);
     BLOG_DEBUG("Register end");
@@ -316,7 +365,7 @@ void PropertyHandler::AppendToolPropertyToPanel() {
                                                nullptr /* icon */,
                                                nullptr /* tooltip */,
                                                TRUE,
-                                               TRUE,
+                                               entry.visible,
                                                PROP_STATE_UNCHECKED,
                                                nullptr);
         g_object_set_data(G_OBJECT(item), kGObjectDataKey, (gpointer)&entry);
@@ -386,6 +435,11 @@ void PropertyHandler::ProcessPropertyActivate(IBusEngine *engine,
                 const ToolProperty *entry = reinterpret_cast<const ToolProperty*>(
                         g_object_get_data(G_OBJECT(prop), kGObjectDataKey));
 
+                if (!g_strcmp0(entry->mode, kKeyLatencyToolMode)) {
+                    Singleton<KeyLatency>::get()->StartOrDump();
+                    return;
+                }
+
                 BLOG_INFO("Should launch tool: {}", entry->mode);
                 return;
             }
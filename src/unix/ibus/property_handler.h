@@ -26,6 +26,9 @@ public:
     virtual bool IsDisabled() const;
 
 private:
+    static gboolean BuildPanelOnIdle(gpointer user_data);
+    // Reads GSettings and fills |prop_root_|.
+    void BuildPanel();
     void UpdateContentTypeImpl(IBusEngine *engine, bool disabled);
     // Appends input method properties into panel
     void AppendInputMethodPropertyToPanel();
@@ -55,4 +58,8 @@ private:
 
     GSettings *settings_;
     gulong settings_observer_id_;
+
+    guint panel_source_id_;
+    // Engine focused before the panel was built.
+    IBusEngine *pending_engine_;
 };
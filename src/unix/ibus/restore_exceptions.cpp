@@ -0,0 +1,189 @@
+#include "unix/ibus/restore_exceptions.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "base/logging.h"
+#include "third_party/libunikey/unikey.h"
+
+
+namespace {
+
+// The log is rewritten once it has this many lines more than twice the
+// hashes it holds.
+const size_t kRewriteSlack = 64;
+
+bool MakeParentDir(const std::string &path) {
+    gchar *dir = g_path_get_dirname(path.c_str());
+    bool ok = g_mkdir_with_parents(dir, 0700) == 0;
+    g_free(dir);
+    return ok;
+}
+
+}  // namespace
+
+
+RestoreExceptions::RestoreExceptions()
+    : log_lines_(0),
+      stopping_(false) {
+}
+
+RestoreExceptions::~RestoreExceptions() {
+    Stop();
+}
+
+void RestoreExceptions::Load(const std::string &path) {
+    Stop();
+    path_ = path;
+    counts_.clear();
+    log_lines_ = 0;
+    stopping_ = false;
+    ReadLog();
+
+    if (log_lines_ > 2 * counts_.size() + kRewriteSlack) {
+        rewrite_.reset(new Counts(counts_));
+        log_lines_ = counts_.size();
+    }
+    writer_ = std::thread(&RestoreExceptions::WriterLoop, this);
+}
+
+void RestoreExceptions::ReadLog() {
+    FILE *file = fopen(path_.c_str(), "r");
+    if (file == nullptr) {
+        return;
+    }
+
+    char line[64];
+    while (fgets(line, sizeof(line), file)) {
+        uint64_t hash;
+        int count;
+        log_lines_++;
+        if (sscanf(line, "%" SCNx64 " %d", &hash, &count) == 2 &&
+            hash != 0 && count > 0) {
+            counts_[hash] += count;
+        }
+    }
+    fclose(file);
+
+    size_t learned = 0;
+    for (const Counts::value_type &entry : counts_) {
+        if (entry.second >= kLearnAfter) {
+            UnikeyAddLearnedWord(entry.first);
+            learned++;
+        }
+    }
+    BLOG_INFO("Restore exceptions: {} words learned from {}", learned, path_);
+}
+
+void RestoreExceptions::Add(uint64_t hash) {
+    int &count = counts_[hash];
+    if (hash == 0 || count >= kLearnAfter) {
+        return;
+    }
+    if (++count == kLearnAfter) {
+        UnikeyAddLearnedWord(hash);
+    }
+    if (!writer_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (++log_lines_ > 2 * counts_.size() + kRewriteSlack) {
+            // The copy already has this restore and the pending ones.
+            rewrite_.reset(new Counts(counts_));
+            pending_.clear();
+            log_lines_ = counts_.size();
+        } else {
+            pending_.push_back(hash);
+        }
+    }
+    wakeup_.notify_one();
+}
+
+void RestoreExceptions::Stop() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+    writer_.join();
+}
+
+void RestoreExceptions::WriterLoop() {
+    for (;;) {
+        std::vector<uint64_t> hashes;
+        std::unique_ptr<Counts> rewrite;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this] {
+                return stopping_ || rewrite_ || !pending_.empty();
+            });
+            hashes.swap(pending_);
+            rewrite.swap(rewrite_);
+            stopping = stopping_;
+        }
+
+        if (rewrite && !Rewrite(*rewrite)) {
+            BLOG_WARNING("Cannot rewrite {}", path_);
+        }
+        if (!hashes.empty() && !Append(hashes)) {
+            BLOG_WARNING("Cannot append to {}", path_);
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool RestoreExceptions::Append(const std::vector<uint64_t> &hashes) {
+    if (!MakeParentDir(path_)) {
+        return false;
+    }
+    FILE *file = fopen(path_.c_str(), "a");
+    if (file == nullptr) {
+        return false;
+    }
+    for (uint64_t hash : hashes) {
+        fprintf(file, "%016" PRIx64 " 1\n", hash);
+    }
+    bool ok = !ferror(file);
+    return (fclose(file) == 0) && ok;
+}
+
+// Writes a new log next to the old one and renames it over, so a crash
+// leaves one or the other.
+bool RestoreExceptions::Rewrite(const Counts &counts) {
+    if (!MakeParentDir(path_)) {
+        return false;
+    }
+    const std::string temp = path_ + ".tmp";
+    FILE *file = fopen(temp.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    for (const Counts::value_type &entry : counts) {
+        fprintf(file, "%016" PRIx64 " %d\n", entry.first, entry.second);
+    }
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || g_rename(temp.c_str(), path_.c_str()) != 0) {
+        g_unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string RestoreExceptions::DefaultPath() {
+    gchar *file = g_build_filename(g_get_user_data_dir(), "ibus-unikey",
+                                   "restore-exceptions.txt", nullptr);
+    std::string path(file);
+    g_free(file);
+    return path;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "base/port.h"
+
+
+// Words the user keeps restoring to their key strokes with Shift+Space or
+// double Shift. Once a word has been restored kLearnAfter times, libunikey
+// leaves it untransformed (see UnikeyAddLearnedWord).
+//
+// Restores are kept in an append-only log of "hash count" lines, the key
+// stroke hash of UnikeyLastWordKeyHash() in hex. Lines of the same hash add
+// up. All writes to the log, including rewriting it without the repeated
+// hashes, happen on a writer thread; the main loop only reads it at start.
+class RestoreExceptions {
+public:
+    static const int kLearnAfter = 2;
+
+    RestoreExceptions();
+    ~RestoreExceptions();
+
+    // Reads the log at |path|, teaches libunikey the words it learned, and
+    // starts the writer thread.
+    void Load(const std::string &path);
+    // Records one restore of the word with key stroke hash |hash|.
+    void Add(uint64_t hash);
+    // Writes out what is pending and stops the writer thread.
+    void Stop();
+
+    // $XDG_DATA_HOME/ibus-unikey/restore-exceptions.txt
+    static std::string DefaultPath();
+
+private:
+    typedef std::unordered_map<uint64_t, int> Counts;
+
+    void ReadLog();
+    void WriterLoop();
+    bool Append(const std::vector<uint64_t> &hashes);
+    bool Rewrite(const Counts &counts);
+
+    std::string path_;
+    // Restores per hash, and the lines in the log once the writer is done.
+    // Main loop only.
+    Counts counts_;
+    size_t log_lines_;
+
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    // Guarded by |mutex_|.
+    std::vector<uint64_t> pending_;
+    std::unique_ptr<Counts> rewrite_;
+    bool stopping_;
+
+    DISALLOW_COPY_AND_ASSIGN(RestoreExceptions);
+};
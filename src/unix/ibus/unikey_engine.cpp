@@ -12,6 +12,7 @@
 #include "base/logging.h"
 
 #include "unix/ibus/engine_registrar.h"
+#include "unix/ibus/key_latency.h"
 #include "unix/ibus/unikey_wrapper.h"
 
 #include "unix/ibus/property_handler.h"
@@ -93,18 +94,19 @@ void UnikeyEngine::CandidateClicked(
     guint state) {
     BLOG_DEBUG("CandidateClicked");
 
+    Singleton<UnikeyWrapper>::get()->CandidateClicked(engine, index);
 }
 
 void UnikeyEngine::CursorDown(IBusEngine *engine) {
     BLOG_DEBUG("CursorDown");
 
-    g_parent_class->cursor_down(engine);
+    Singleton<UnikeyWrapper>::get()->CursorDown(engine);
 }
 
 void UnikeyEngine::CursorUp(IBusEngine *engine) {
     BLOG_DEBUG("CursorUp");
 
-    g_parent_class->cursor_up(engine);
+    Singleton<UnikeyWrapper>::get()->CursorUp(engine);
 }
 
 void UnikeyEngine::Disable(IBusEngine *engine) {
@@ -143,13 +145,13 @@ void UnikeyEngine::FocusOut(IBusEngine *engine) {
 void UnikeyEngine::PageDown(IBusEngine *engine) {
     BLOG_DEBUG("PageDown");
 
-    g_parent_class->page_down(engine);
+    Singleton<UnikeyWrapper>::get()->PageDown(engine);
 }
 
 void UnikeyEngine::PageUp(IBusEngine *engine) {
     BLOG_DEBUG("PageUp");
 
-    g_parent_class->page_up(engine);
+    Singleton<UnikeyWrapper>::get()->PageUp(engine);
 }
 
 gboolean UnikeyEngine::ProcessKeyEvent(
@@ -159,7 +161,11 @@ gboolean UnikeyEngine::ProcessKeyEvent(
     guint modifiers) {
     BLOG_DEBUG("keyval: {}, keycode: {}, modifiers:  {}", keyval, keycode, modifiers);
 
-    return Singleton<UnikeyWrapper>::get()->ProcessKeyEvent(engine, keyval, keycode, modifiers);
+    KeyLatency *latency = Singleton<KeyLatency>::get();
+    latency->BeginKey();
+    gboolean ret = Singleton<UnikeyWrapper>::get()->ProcessKeyEvent(engine, keyval, keycode, modifiers);
+    latency->EndKey();
+    return ret;
 }
 
 void UnikeyEngine::PropertyActivate(IBusEngine *engine,
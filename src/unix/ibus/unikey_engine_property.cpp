@@ -124,6 +124,14 @@ const ToolProperty kToolPropertiesArray[] = {
         "about_dialog",
         "About Unikey",
         nullptr,
+        true,
+    },
+    {
+        "Tool.KeyLatency",
+        "key_latency",
+        "Record or Dump Key Latency",
+        nullptr,
+        false,
     },
 };
 
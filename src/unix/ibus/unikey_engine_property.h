@@ -48,6 +48,7 @@ struct ToolProperty {
     const char *mode;   // command line passed as --mode=
     const char *label;  // text for the menu.
     const char *icon;   // icon
+    bool visible;       // false for entries only reachable over D-Bus
 };
 
 extern const ToolProperty *kToolProperties;
@@ -2,21 +2,83 @@
 
 #include "unikey_wrapper.h"
 
+#include <functional>
 #include <libintl.h>
 #include <ibus.h>
 
-#include "unix/ibus/utils.h"
-
 #include "third_party/libunikey/unikey.h"
 #include "third_party/libunikey/vnconv.h"
 
 #include "base/logging.h"
+#include "unix/ibus/key_latency.h"
 
 #define _(string) gettext(string)
 
 namespace {
 
-const int kBufferSize = 1024;
+const size_t kCommitBufferSize = 64;
+
+const gchar kDictionaryFile[] = "vietnamese.dict";
+const gchar kForeignFilterFile[] = "english.bloom";
+const gchar kCompletionFile[] = "vietnamese.complete";
+const gchar kDiacriticModelFile[] = "vietnamese.ngram";
+
+// Best completions asked for per key, and shown per page.
+const size_t kCandidateCount = 10;
+const guint kCandidatePageSize = 5;
+
+// Looks for a data file in |data_dir| if it is set, otherwise in the user
+// data directory first, then in the package data directory. Spell check and
+// completion work without them.
+void LoadDataFile(const std::string &data_dir, const gchar *name,
+                  const std::function<bool(const gchar *)> &load) {
+    if (!data_dir.empty()) {
+        gchar *path = g_build_filename(data_dir.c_str(), name, nullptr);
+        if (load(path)) {
+            BLOG_INFO("Data file: {}", path);
+        }
+        g_free(path);
+        return;
+    }
+
+    gchar *path = g_build_filename(g_get_user_data_dir(), "ibus-unikey",
+                                   name, nullptr);
+    bool loaded = load(path);
+#ifdef PKGDATADIR
+    if (!loaded) {
+        g_free(path);
+        path = g_build_filename(PKGDATADIR, name, nullptr);
+        loaded = load(path);
+    }
+#endif
+    if (loaded) {
+        BLOG_INFO("Data file: {}", path);
+    }
+    g_free(path);
+}
+
+// Loads the table of the engine made for the input method, if there is one
+// (see UnikeyLoadAutomaton). It is used only with the output charset and
+// options it was made for.
+void LoadAutomaton(const std::string &data_dir, UkInputMethod method) {
+    UnikeyUnloadAutomaton();
+    switch (method) {
+        case UkTelex:
+            LoadDataFile(data_dir, "telex.automaton", UnikeyLoadAutomaton);
+            break;
+        case UkVni:
+            LoadDataFile(data_dir, "vni.automaton", UnikeyLoadAutomaton);
+            break;
+        case UkSimpleTelex:
+            LoadDataFile(data_dir, "stelex.automaton", UnikeyLoadAutomaton);
+            break;
+        case UkSimpleTelex2:
+            LoadDataFile(data_dir, "stelex2.automaton", UnikeyLoadAutomaton);
+            break;
+        default:
+            break;
+    }
+}
 
 unsigned char kWordBreakSyms[] =
     {
@@ -29,7 +91,13 @@ unsigned char kWordBreakSyms[] =
 } // namespace
 
 void UnikeyWrapper::SetUp() {
+    SetUp(std::string(), RestoreExceptions::DefaultPath());
+}
+
+void UnikeyWrapper::SetUp(const std::string &data_dir,
+                          const std::string &restore_log) {
     BLOG_DEBUG("UnikeyWrapper::SetUp");
+    data_dir_ = data_dir;
     UnikeySetup();
 
     options_.spellCheckEnabled     = 1;
@@ -38,19 +106,74 @@ void UnikeyWrapper::SetUp() {
     options_.freeMarking           = 1;
     options_.macroEnabled          = 0;
     UnikeySetOptions(&options_);
+    restore_exceptions_.Load(restore_log);
 
     input_method_ = UkTelex;
     output_charset_ = 12;
+
+    // Mapping the data files takes longer than the rest of the start on a
+    // cold cache, so they are left to the main loop once it is idle, after
+    // the bus name is acquired; each of them only adds to what the engine
+    // does without it.
+    data_source_id_ = g_idle_add(LoadDataOnIdle, this);
+
+    // The preedit is always underlined as a whole, so one attribute list is
+    // shared by all updates and only its end index changes.
+    preedit_underline_ = ibus_attr_underline_new(IBUS_ATTR_UNDERLINE_SINGLE, 0, 0);
+    preedit_attrs_ = ibus_attr_list_new();
+    g_object_ref_sink(preedit_attrs_);
+    ibus_attr_list_append(preedit_attrs_, preedit_underline_);
+
+    lookup_table_ = ibus_lookup_table_new(kCandidatePageSize, 0, TRUE, FALSE);
+    g_object_ref_sink(lookup_table_);
+
+    commit_buffer_.reserve(kCommitBufferSize);
+}
+
+gboolean UnikeyWrapper::LoadDataOnIdle(gpointer user_data) {
+    UnikeyWrapper *self = reinterpret_cast<UnikeyWrapper*>(user_data);
+    self->data_source_id_ = 0;
+    self->LoadData();
+    return G_SOURCE_REMOVE;
+}
+
+void UnikeyWrapper::LoadData() {
+    BLOG_DEBUG("UnikeyWrapper::LoadData");
+    LoadDataFile(data_dir_, kDictionaryFile, UnikeyLoadDictionary);
+    LoadDataFile(data_dir_, kForeignFilterFile, UnikeyLoadForeignFilter);
+    LoadDataFile(data_dir_, kCompletionFile, [this](const gchar *path) {
+        return LoadCompletion(path);
+    });
+    LoadDataFile(data_dir_, kDiacriticModelFile, UnikeyLoadDiacriticModel);
+    LoadAutomaton(data_dir_, input_method_);
 }
 
 void UnikeyWrapper::CleanUp() {
     BLOG_DEBUG("UnikeyWrapper::CleanUp");
+    if (data_source_id_ != 0) {
+        g_source_remove(data_source_id_);
+        data_source_id_ = 0;
+    }
+    restore_exceptions_.Stop();
     UnikeyCleanup();
+
+    if (preedit_attrs_) {
+        g_object_unref(preedit_attrs_);
+        preedit_attrs_ = nullptr;
+        preedit_underline_ = nullptr;
+    }
+    if (lookup_table_) {
+        g_object_unref(lookup_table_);
+        lookup_table_ = nullptr;
+    }
+    candidates_visible_ = false;
+    completion_.Unload();
 }
 
 void UnikeyWrapper::Reset(IBusEngine* engine) {
     BLOG_DEBUG("UnikeyWrapper::Reset");
     CleanBuffer(engine);
+    last_commit_.clear();
 }
 
 void UnikeyWrapper::SetInputMethod(InputMethod new_method) {
@@ -72,6 +195,9 @@ void UnikeyWrapper::SetInputMethod(InputMethod new_method) {
             break;
     }
     UnikeySetInputMethod(input_method_);
+    if (data_source_id_ == 0) {
+        LoadAutomaton(data_dir_, input_method_);
+    }
 }
 
 void UnikeyWrapper::SetOutputCharset(OutputCharset new_charset) {
@@ -107,40 +233,89 @@ void UnikeyWrapper::SetOutputCharset(OutputCharset new_charset) {
     UnikeySetOutputCharset(output_charset_);
 }
 
+bool UnikeyWrapper::LoadCompletion(const gchar *path) {
+    return completion_.Load(path);
+}
+
 void UnikeyWrapper::CleanBuffer(IBusEngine* engine) {
     BLOG_DEBUG("UnikeyWrapper::CleanBuffer");
     UnikeyResetBuf();
-    buffer_.clear();
+    buffer_.Clear();
+    HideCandidates(engine);
+
+    ScopedLatency latency(KeyLatency::IBUS);
     ibus_engine_hide_preedit_text(engine);
 }
 
 void UnikeyWrapper::CommitPreedit(IBusEngine* engine) {
     BLOG_DEBUG("UnikeyWrapper::CommitPreedit");
 
-    if (buffer_.length() > 0) {
+    if (!buffer_.empty()) {
+        ScopedLatency latency(KeyLatency::IBUS);
         IBusText *text;
 
         text = ibus_text_new_from_static_string(buffer_.c_str());
         ibus_engine_commit_text(engine, text);
+        last_commit_ = buffer_.c_str();
     }
 
     CleanBuffer(engine);  
 }
 
+// Commits the part of the preedit which the engine has let go of, keeping
+// only the word being typed in the preedit.
+void UnikeyWrapper::CommitStablePrefix(IBusEngine* engine) {
+    int active;
+    {
+        ScopedLatency latency(KeyLatency::ENGINE);
+        active = UnikeySettlePrefix();
+    }
+    if (active < 0) {
+        return;
+    }
+
+    if (buffer_.length() <= (guint)active) {
+        return;
+    }
+
+    size_t stable = buffer_.length() - active;
+    BLOG_DEBUG("UnikeyWrapper::CommitStablePrefix: {} chars", stable);
+
+    commit_buffer_.assign(buffer_.c_str(), buffer_.Offset(stable));
+    buffer_.ErasePrefix(stable);
+    last_commit_ = commit_buffer_;
+
+    ScopedLatency latency(KeyLatency::IBUS);
+    IBusText *text;
+    text = ibus_text_new_from_static_string(commit_buffer_.c_str());
+    ibus_engine_commit_text(engine, text);
+}
+
+// Output of the engine is UTF-8 already for Unicode, every other charset
+// gives one byte per character.
+void UnikeyWrapper::AppendEngineOutput() {
+    if (output_charset_ == CONV_CHARSET_XUTF8)
+    {
+        buffer_.Append((const gchar*)UnikeyBuf, UnikeyBufChars);
+    }
+    else
+    {
+        buffer_.AppendLatin(UnikeyBuf, UnikeyBufChars);
+    }
+}
+
 void UnikeyWrapper::UpdatePreedit(IBusEngine* engine,
                                   const gchar *string,
                                   gboolean visible) {
     BLOG_DEBUG("UnikeyWrapper::UpdatePreedit");
+    ScopedLatency latency(KeyLatency::IBUS);
     IBusText *text;
 
     text = ibus_text_new_from_static_string(string);
 
     // underline text
-    ibus_text_append_attribute(text,
-                               IBUS_ATTR_TYPE_UNDERLINE,
-                               IBUS_ATTR_UNDERLINE_SINGLE,
-                               0,
-                               -1);
+    preedit_underline_->end_index = ibus_text_get_length(text);
+    ibus_text_set_attributes(text, preedit_attrs_);
 
     // update and display text
     ibus_engine_update_preedit_text_with_mode(engine,
@@ -150,6 +325,180 @@ void UnikeyWrapper::UpdatePreedit(IBusEngine* engine,
                                               IBUS_ENGINE_PREEDIT_COMMIT);
 }
 
+// Shows the best completions of the preedit, in Unicode output only. The
+// index has them in lower case; a capital first letter is carried over.
+void UnikeyWrapper::UpdateCandidates(IBusEngine* engine) {
+    candidate_count_ = 0;
+    if (completion_.loaded()
+        && output_charset_ == CONV_CHARSET_XUTF8
+        && !buffer_.empty())
+    {
+        completion_.Complete(buffer_.c_str(), kCandidateCount, &matches_);
+
+        gboolean capital = g_unichar_isupper(g_utf8_get_char(buffer_.c_str()));
+        for (const CompletionIndex::Candidate &match : matches_)
+        {
+            if (candidate_count_ == candidates_.size())
+            {
+                candidates_.emplace_back();
+            }
+            std::string &text = candidates_[candidate_count_++];
+            text.assign(match.text, match.size);
+            if (capital)
+            {
+                const gchar *rest = g_utf8_next_char(text.c_str());
+                gchar upper[6];
+                gint size = g_unichar_to_utf8(g_unichar_toupper(g_utf8_get_char(text.c_str())), upper);
+                text.replace(0, rest - text.c_str(), upper, size);
+            }
+        }
+    }
+
+    if (candidate_count_ == 0)
+    {
+        HideCandidates(engine);
+        return;
+    }
+
+    ScopedLatency latency(KeyLatency::IBUS);
+    ibus_lookup_table_clear(lookup_table_);
+    for (size_t i = 0; i < candidate_count_; i++)
+    {
+        ibus_lookup_table_append_candidate(lookup_table_,
+                                           ibus_text_new_from_string(candidates_[i].c_str()));
+    }
+    ibus_engine_update_lookup_table(engine, lookup_table_, TRUE);
+    candidates_visible_ = true;
+}
+
+void UnikeyWrapper::HideCandidates(IBusEngine* engine) {
+    if (!candidates_visible_) {
+        return;
+    }
+    candidate_count_ = 0;
+    candidates_visible_ = false;
+
+    ScopedLatency latency(KeyLatency::IBUS);
+    ibus_engine_hide_lookup_table(engine);
+}
+
+// Commits candidate |index| in place of the preedit.
+void UnikeyWrapper::SelectCandidate(IBusEngine* engine, guint index) {
+    if (!candidates_visible_ || index >= candidate_count_) {
+        return;
+    }
+    BLOG_DEBUG("UnikeyWrapper::SelectCandidate: {}", index);
+
+    commit_buffer_ = candidates_[index];
+    last_commit_ = commit_buffer_;
+    CleanBuffer(engine);
+
+    ScopedLatency latency(KeyLatency::IBUS);
+    IBusText *text;
+    text = ibus_text_new_from_static_string(commit_buffer_.c_str());
+    ibus_engine_commit_text(engine, text);
+}
+
+void UnikeyWrapper::CandidateClicked(IBusEngine* engine, guint index) {
+    if (!candidates_visible_) {
+        return;
+    }
+    guint page_size = ibus_lookup_table_get_page_size(lookup_table_);
+    guint page_start = ibus_lookup_table_get_cursor_pos(lookup_table_) / page_size * page_size;
+    SelectCandidate(engine, page_start + index);
+}
+
+void UnikeyWrapper::CursorUp(IBusEngine* engine) {
+    if (candidates_visible_ && ibus_lookup_table_cursor_up(lookup_table_)) {
+        ibus_engine_update_lookup_table(engine, lookup_table_, TRUE);
+    }
+}
+
+void UnikeyWrapper::CursorDown(IBusEngine* engine) {
+    if (candidates_visible_ && ibus_lookup_table_cursor_down(lookup_table_)) {
+        ibus_engine_update_lookup_table(engine, lookup_table_, TRUE);
+    }
+}
+
+void UnikeyWrapper::PageUp(IBusEngine* engine) {
+    if (candidates_visible_ && ibus_lookup_table_page_up(lookup_table_)) {
+        ibus_engine_update_lookup_table(engine, lookup_table_, TRUE);
+    }
+}
+
+void UnikeyWrapper::PageDown(IBusEngine* engine) {
+    if (candidates_visible_ && ibus_lookup_table_page_down(lookup_table_)) {
+        ibus_engine_update_lookup_table(engine, lookup_table_, TRUE);
+    }
+}
+
+// Commits the preedit with the tones and marks of its words put back, read
+// on from the text committed before it. Unicode output only.
+gboolean UnikeyWrapper::CommitRestoredDiacritics(IBusEngine* engine) {
+    if (buffer_.empty() || output_charset_ != CONV_CHARSET_XUTF8) {
+        return false;
+    }
+
+    // A restored letter takes at most three bytes.
+    std::string restored(3 * buffer_.size() + 1, '\0');
+    int len;
+    {
+        ScopedLatency latency(KeyLatency::ENGINE);
+        len = UnikeyRestoreDiacritics(last_commit_.c_str(), buffer_.c_str(),
+                                      &restored[0], restored.size());
+    }
+    if (len < 0) {
+        return false;
+    }
+    BLOG_DEBUG("UnikeyWrapper::CommitRestoredDiacritics: {} bytes", len);
+
+    commit_buffer_.assign(restored.c_str(), len);
+    last_commit_ = commit_buffer_;
+    CleanBuffer(engine);
+
+    ScopedLatency latency(KeyLatency::IBUS);
+    IBusText *text;
+    text = ibus_text_new_from_static_string(commit_buffer_.c_str());
+    ibus_engine_commit_text(engine, text);
+    return true;
+}
+
+// While candidates are shown, arrows and page keys move through them, Tab
+// takes the one under the cursor and Escape hides them.
+gboolean UnikeyWrapper::ProcessCandidateKey(IBusEngine* engine,
+                                            guint keyval,
+                                            guint modifiers) {
+    if (modifiers & (IBUS_CONTROL_MASK | IBUS_MOD1_MASK)) {
+        return false;
+    }
+
+    switch (keyval) {
+    case IBUS_Up:
+    case IBUS_KP_Up:
+        CursorUp(engine);
+        return true;
+    case IBUS_Down:
+    case IBUS_KP_Down:
+        CursorDown(engine);
+        return true;
+    case IBUS_Page_Up:
+    case IBUS_KP_Page_Up:
+        PageUp(engine);
+        return true;
+    case IBUS_Page_Down:
+    case IBUS_KP_Page_Down:
+        PageDown(engine);
+        return true;
+    case IBUS_Tab:
+        SelectCandidate(engine, ibus_lookup_table_get_cursor_pos(lookup_table_));
+        return true;
+    case IBUS_Escape:
+        HideCandidates(engine);
+        return true;
+    }
+    return false;
+}
+
 gboolean UnikeyWrapper::ProcessKeyEvent(IBusEngine* engine,
                                         guint keyval,
                                         guint keycode,
@@ -181,6 +530,19 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
         return false;
     }
 
+    else if (candidates_visible_ && ProcessCandidateKey(engine, keyval, modifiers))
+    {
+        return true;
+    }
+
+    // Shift+Tab: commit with diacritics restored
+    else if (keyval == IBUS_ISO_Left_Tab
+             && !(modifiers & (IBUS_CONTROL_MASK | IBUS_MOD1_MASK))
+             && CommitRestoredDiacritics(engine))
+    {
+        return true;
+    }
+
     else if (modifiers & IBUS_CONTROL_MASK
              || modifiers & IBUS_MOD1_MASK // alternate mask
              || keyval == IBUS_Control_L
@@ -213,7 +575,10 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
     // capture BackSpace
     else if (keyval == IBUS_BackSpace)
     {
-        UnikeyBackspacePress();
+        {
+            ScopedLatency latency(KeyLatency::ENGINE);
+            UnikeyBackspacePress();
+        }
 
         if (UnikeyBackspaces == 0 || buffer_.empty())
         {
@@ -223,33 +588,29 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
         {
             if (buffer_.length() <= (guint)UnikeyBackspaces)
             {
-                buffer_.clear();
+                buffer_.Clear();
+                HideCandidates(engine);
+
+                ScopedLatency latency(KeyLatency::IBUS);
                 ibus_engine_hide_preedit_text(engine);
             }
             else
             {
-                utils::EraseCharsUtf8(buffer_, UnikeyBackspaces);
+                buffer_.EraseChars(UnikeyBackspaces);
                 UpdatePreedit(engine, buffer_.c_str(), true);
             }
 
             // change tone position after press backspace
             if (UnikeyBufChars > 0)
             {
-                if (output_charset_ == CONV_CHARSET_XUTF8)
-                {
-                    buffer_.append((const gchar*)UnikeyBuf, UnikeyBufChars);
-                }
-                else
-                {
-                    static unsigned char buf[kBufferSize];
-                    int bufSize = kBufferSize;
-
-                    utils::LatinToUtf(buf, UnikeyBuf, UnikeyBufChars, &bufSize);
-                    buffer_.append((const gchar*)buf, kBufferSize - bufSize);
-                }
-
+                AppendEngineOutput();
                 UpdatePreedit(engine, buffer_.c_str(), true);
             }
+
+            if (!buffer_.empty())
+            {
+                UpdateCandidates(engine);
+            }
         }
         return true;
     } // end capture BackSpace
@@ -267,14 +628,17 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
             && UnikeyAtWordBeginning()
             && (keyval == IBUS_w || keyval == IBUS_W))
         {
-            UnikeyPutChar(keyval);
+            {
+                ScopedLatency latency(KeyLatency::ENGINE);
+                UnikeyPutChar(keyval);
+            }
             if (options_.macroEnabled == 0)
             {
                 return false;
             }
             else
             {
-                buffer_.append(keyval==IBUS_w?"w":"W");
+                buffer_.Append(keyval==IBUS_w?"w":"W", 1);
                 UpdatePreedit(engine, buffer_.c_str(), true);
                 return true;
             }
@@ -286,11 +650,21 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
             || (keyval == IBUS_Shift_L || keyval == IBUS_Shift_R) // (&& modifiers & IBUS_SHIFT_MASK), sure this have IBUS_SHIFT_MASK
            )
         {
-            UnikeyRestoreKeyStrokes();
+            unsigned long long hash = UnikeyLastWordKeyHash();
+            {
+                ScopedLatency latency(KeyLatency::ENGINE);
+                UnikeyRestoreKeyStrokes();
+            }
+            // Only a restore that changed the word teaches anything.
+            if (UnikeyBackspaces > 0 || UnikeyBufChars > 0)
+            {
+                restore_exceptions_.Add(hash);
+            }
         } // end shift + space, shift + shift event
 
         else
         {
+            ScopedLatency latency(KeyLatency::ENGINE);
             UnikeyFilter(keyval);
         }
         // end process keyval
@@ -300,46 +674,31 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
         {
             if (buffer_.length() <= (guint)UnikeyBackspaces)
             {
-                buffer_.clear();
+                buffer_.Clear();
             }
             else
             {
-                utils::EraseCharsUtf8(buffer_, UnikeyBackspaces);
+                buffer_.EraseChars(UnikeyBackspaces);
             }
         }
 
         if (UnikeyBufChars > 0)
         {
-            if (output_charset_ == CONV_CHARSET_XUTF8)
-            {
-                buffer_.append((const gchar*)UnikeyBuf, UnikeyBufChars);
-            }
-            else
-            {
-                static unsigned char buf[kBufferSize];
-                int bufSize = kBufferSize;
-
-                utils::LatinToUtf(buf, UnikeyBuf, UnikeyBufChars, &bufSize);
-                buffer_.append((const gchar*)buf, kBufferSize - bufSize);
-            }
+            AppendEngineOutput();
         }
         else if (keyval != IBUS_Shift_L && keyval != IBUS_Shift_R) // if ukengine not process
         {
-            static int n;
-            static char s[6];
-
-            n = g_unichar_to_utf8(keyval, s); // convert ucs4 to utf8 char
-            buffer_.append(s, n);
+            buffer_.AppendUnichar(keyval);
         }
         // end process result of ukengine
 
         // commit string: if need
-        if (buffer_.length() > 0)
+        if (!buffer_.empty())
         {
             static guint i;
             for (i = 0; i < sizeof(kWordBreakSyms); i++)
             {
-                if (kWordBreakSyms[i] == buffer_.at(buffer_.length()-1)
+                if (kWordBreakSyms[i] == (guchar)buffer_.back()
                     && kWordBreakSyms[i] == keyval)
                 {
                     CommitPreedit(engine);
@@ -349,7 +708,9 @@ gboolean UnikeyWrapper::ProcessKeyEventPreedit(IBusEngine* engine,
         }
         // end commit string
 
+        CommitStablePrefix(engine);
         UpdatePreedit(engine, buffer_.c_str(), true);
+        UpdateCandidates(engine);
         return true;
     } //end capture printable char
 
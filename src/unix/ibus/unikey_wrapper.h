@@ -1,11 +1,15 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <ibus.h>
 
 #include "base/port.h"
+#include "unix/ibus/completion_index.h"
 #include "unix/ibus/input_method.h"
 #include "unix/ibus/output_charset.h"
+#include "unix/ibus/preedit_buffer.h"
+#include "unix/ibus/restore_exceptions.h"
 
 #include "third_party/libunikey/unikey.h"
 #include "third_party/libunikey/vnconv.h"
@@ -14,10 +18,22 @@
 class UnikeyWrapper {
 
 public:
-    UnikeyWrapper() {}
+    UnikeyWrapper()
+        : preedit_attrs_(nullptr),
+          preedit_underline_(nullptr),
+          candidate_count_(0),
+          lookup_table_(nullptr),
+          candidates_visible_(false),
+          data_source_id_(0) {}
     virtual ~UnikeyWrapper() {}
 
+    // The data files are loaded once the main loop is idle, the engine
+    // works without them until then.
     void SetUp();
+    // Loads the data files from |data_dir| only and keeps the restore
+    // exceptions in |restore_log|, for tools that must leave the files of
+    // the user alone.
+    void SetUp(const std::string &data_dir, const std::string &restore_log);
     void CleanUp();
     void Reset(IBusEngine* engine);
 
@@ -28,24 +44,62 @@ public:
 
     void SetInputMethod(InputMethod new_method);
     void SetOutputCharset(OutputCharset new_charset);
+    // Word completion index, see CompletionIndex.
+    bool LoadCompletion(const gchar *path);
+
+    // Word completion candidates, |index| is within the current page.
+    void CandidateClicked(IBusEngine* engine, guint index);
+    void CursorUp(IBusEngine* engine);
+    void CursorDown(IBusEngine* engine);
+    void PageUp(IBusEngine* engine);
+    void PageDown(IBusEngine* engine);
 private:
+    static gboolean LoadDataOnIdle(gpointer user_data);
+    void LoadData();
     void CleanBuffer(IBusEngine* engine);
     void UpdatePreedit(IBusEngine* engine,
                        const gchar *string,
                        gboolean visible);
     void CommitPreedit(IBusEngine* engine);
+    void CommitStablePrefix(IBusEngine* engine);
+    void AppendEngineOutput();
+    void UpdateCandidates(IBusEngine* engine);
+    void HideCandidates(IBusEngine* engine);
+    void SelectCandidate(IBusEngine* engine, guint index);
+    gboolean CommitRestoredDiacritics(IBusEngine* engine);
+    gboolean ProcessCandidateKey(IBusEngine* engine,
+                                 guint keyval,
+                                 guint modifiers);
     gboolean ProcessKeyEventPreedit(IBusEngine* engine,
                                     guint keyval,
                                     guint keycode,
                                     guint modifiers);
 
 private:
-    std::string buffer_;
+    PreeditBuffer buffer_;
+    std::string commit_buffer_;
+    // Text committed last, what diacritic restoration reads on from.
+    std::string last_commit_;
+    IBusAttrList *preedit_attrs_;
+    IBusAttribute *preedit_underline_;
+    CompletionIndex completion_;
+    std::vector<CompletionIndex::Candidate> matches_;
+    // Candidates as shown, in the order of the lookup table: the first
+    // |candidate_count_|. The strings are kept for their capacity.
+    std::vector<std::string> candidates_;
+    size_t candidate_count_;
+    IBusLookupTable *lookup_table_;
+    bool candidates_visible_;
     UkInputMethod input_method_;
     unsigned int output_charset_;
     UnikeyOptions options_;
     gboolean process_w_at_begin_;
     gboolean last_key_with_shift_;
+    RestoreExceptions restore_exceptions_;
+    // Where the data files are looked up, empty for the usual places.
+    std::string data_dir_;
+    // The idle source loading the data files, 0 once they are loaded.
+    guint data_source_id_;
 
     DISALLOW_COPY_AND_ASSIGN(UnikeyWrapper);
 };
\ No newline at end of file